@@ -0,0 +1,185 @@
+#include "AssetLoader.h"
+#include "WICTextureLoader.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace DirectX;
+
+AssetLoader::AssetLoader(Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int threadCount)
+{
+	this->device = device;
+	this->context = context;
+	this->unfinishedJobs = 0;
+	this->stopping = false;
+	this->wasProtected = FALSE;
+	this->startTime = std::chrono::high_resolution_clock::now();
+
+	// Workers upload and generate mips through the immediate context
+	if (SUCCEEDED(context.As(&multithread)))
+		wasProtected = multithread->SetMultithreadProtected(TRUE);
+
+	if (threadCount == 0)
+		threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.push_back(std::thread(&AssetLoader::WorkerLoop, this, i));
+}
+
+AssetLoader::~AssetLoader()
+{
+	WaitForAll();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobQueued.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+
+	// The workers are done with the context, so its protection goes back to how it was
+	// (still on if something else needs it, like MeshRegistry)
+	if (multithread)
+		multithread->SetMultithreadProtected(wasProtected);
+}
+
+std::shared_future<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> AssetLoader::LoadTexture(const std::wstring& path)
+{
+	Microsoft::WRL::ComPtr<ID3D11Device> device = this->device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context = this->context;
+	return Load<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>(path, [device, context, path]()
+	{
+		// Decoding only needs the device...
+		Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+		if (FAILED(CreateWICTextureFromFile(device.Get(), path.c_str(), resource.GetAddressOf(), srv.GetAddressOf())))
+			return srv;
+
+		// ...but mips are generated on the GPU, by copying the top level into a texture that has room for them
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> source;
+		resource.As(&source);
+		D3D11_TEXTURE2D_DESC desc = {};
+		source->GetDesc(&desc);
+
+		UINT support = 0;
+		device->CheckFormatSupport(desc.Format, &support);
+		if (!(support & D3D11_FORMAT_SUPPORT_MIP_AUTOGEN))
+			return srv;
+
+		desc.MipLevels = 0;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+		desc.CPUAccessFlags = 0;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> mipped;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> mippedSRV;
+		if (FAILED(device->CreateTexture2D(&desc, 0, mipped.GetAddressOf())) ||
+			FAILED(device->CreateShaderResourceView(mipped.Get(), 0, mippedSRV.GetAddressOf())))
+			return srv;
+
+		context->CopySubresourceRegion(mipped.Get(), 0, 0, 0, 0, source.Get(), 0, 0);
+		context->GenerateMips(mippedSRV.Get());
+		return mippedSRV;
+	});
+}
+
+std::shared_future<Microsoft::WRL::ComPtr<ID3D11Texture2D>> AssetLoader::LoadTextureResource(const std::wstring& path)
+{
+	Microsoft::WRL::ComPtr<ID3D11Device> device = this->device;
+	return Load<Microsoft::WRL::ComPtr<ID3D11Texture2D>>(path, [device, path]()
+	{
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		CreateWICTextureFromFile(device.Get(), path.c_str(), (ID3D11Resource**)texture.GetAddressOf(), 0);
+		return texture;
+	});
+}
+
+void AssetLoader::WaitForAll()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	jobFinished.wait(lock, [this]() { return unfinishedJobs == 0; });
+}
+
+double AssetLoader::GetElapsedMs()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+}
+
+unsigned int AssetLoader::GetThreadCount()
+{
+	return (unsigned int)workers.size();
+}
+
+std::vector<AssetLoadTiming> AssetLoader::GetTimings()
+{
+	std::vector<AssetLoadTiming> sorted;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		sorted = timings;
+	}
+	std::sort(sorted.begin(), sorted.end(),
+		[](const AssetLoadTiming& a, const AssetLoadTiming& b) { return a.Finished < b.Finished; });
+	return sorted;
+}
+
+void AssetLoader::PrintTimings()
+{
+	std::vector<AssetLoadTiming> sorted = GetTimings();
+
+	// Work adds up every asset's time (including any spent waiting on the assets it needs),
+	// so it comes out more than the total when threads overlap
+	double work = 0.0;
+	double finished = 0.0;
+	printf("Loaded %zu asset(s) on %zu thread(s):\n", sorted.size(), workers.size());
+	for (const AssetLoadTiming& timing : sorted)
+	{
+		printf("  %8.2f ms  %ls (waited %.2f ms, took %.2f ms on thread %u)\n",
+			timing.Finished, timing.Name.c_str(), timing.Started - timing.Queued, timing.Finished - timing.Started, timing.Thread);
+		work += timing.Finished - timing.Started;
+		finished = (std::max)(finished, timing.Finished);
+	}
+	printf("  Everything ready after %.2f ms, %.2f ms of work (%.2fx parallel)\n",
+		finished, work, finished > 0.0 ? work / finished : 0.0);
+}
+
+void AssetLoader::Enqueue(const std::wstring& name, std::function<void()> work)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		AssetLoadTiming timing = { name, GetElapsedMs(), 0.0, 0.0, 0 };
+		Job job = { work, (unsigned int)timings.size() };
+		timings.push_back(timing);
+		jobs.push_back(job);
+		unfinishedJobs++;
+	}
+	jobQueued.notify_one();
+}
+
+void AssetLoader::WorkerLoop(unsigned int thread)
+{
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobQueued.wait(lock, [this]() { return stopping || !jobs.empty(); });
+			if (jobs.empty())
+				return;
+
+			job = jobs.front();
+			jobs.pop_front();
+			timings[job.TimingIndex].Started = GetElapsedMs();
+			timings[job.TimingIndex].Thread = thread;
+		}
+
+		// Any exception ends up in the job's future
+		job.Work();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			timings[job.TimingIndex].Finished = GetElapsedMs();
+			unfinishedJobs--;
+		}
+		jobFinished.notify_all();
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <d3d11_4.h>
+#include <wrl/client.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// When one asset was asked for, picked up and finished, in milliseconds since the loader was created
+struct AssetLoadTiming
+{
+	std::wstring Name;
+	double Queued;
+	double Started;
+	double Finished;
+	unsigned int Thread;
+};
+
+// --------------------------------------------------------
+// Loads assets on a pool of worker threads, so files are
+// decoded and their D3D11 resources created in parallel
+//
+// - Each asset is a function queued with Load(), which hands
+//   back a future for its result. Assets that need others
+//   (like a material needing its textures) just wait on
+//   their futures inside their own function.
+// - Jobs start in the order they're queued, so as long as
+//   an asset only waits on ones queued before it, whatever
+//   it waits on is already running and can't be starved
+// - The device is free-threaded, but the immediate context
+//   isn't, so it's made thread safe (multithread protected)
+//   for as long as the loader is around
+// --------------------------------------------------------
+class AssetLoader
+{
+public:
+
+	// Zero threads means one per core
+	AssetLoader(Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int threadCount = 0);
+
+	// Waits for everything still loading
+	~AssetLoader();
+
+	template<typename T>
+	std::shared_future<T> Load(const std::wstring& name, std::function<T()> work)
+	{
+		std::shared_ptr<std::packaged_task<T()>> task = std::make_shared<std::packaged_task<T()>>(work);
+		std::shared_future<T> result = task->get_future().share();
+		Enqueue(name, [task]() { (*task)(); });
+		return result;
+	}
+
+	// A texture with a full mip chain, ready for a material
+	std::shared_future<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> LoadTexture(const std::wstring& path);
+
+	// Just the top mip level, to be copied somewhere else (like a face of a cube map)
+	std::shared_future<Microsoft::WRL::ComPtr<ID3D11Texture2D>> LoadTextureResource(const std::wstring& path);
+
+	void WaitForAll();
+	double GetElapsedMs();
+	unsigned int GetThreadCount();
+
+	// Every asset queued so far, sorted by when each finished (not started yet counts as 0)
+	std::vector<AssetLoadTiming> GetTimings();
+
+	// Per asset and overall, to the console
+	void PrintTimings();
+
+private:
+
+	struct Job
+	{
+		std::function<void()> Work;
+		unsigned int TimingIndex;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	// What the context's protection was before, to put it back
+	Microsoft::WRL::ComPtr<ID3D11Multithread> multithread;
+	BOOL wasProtected;
+
+	std::vector<std::thread> workers;
+	std::deque<Job> jobs;
+	std::mutex mutex;
+	std::condition_variable jobQueued;
+	std::condition_variable jobFinished;
+	unsigned int unfinishedJobs;
+	bool stopping;
+
+	std::vector<AssetLoadTiming> timings;
+	std::chrono::high_resolution_clock::time_point startTime;
+
+	void Enqueue(const std::wstring& name, std::function<void()> work);
+	void WorkerLoop(unsigned int thread);
+};
@@ -0,0 +1,284 @@
+#include "BoundsCalculator.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Jacobi sweeps to diagonalize the covariance (3x3 converges in a handful)
+#define BOUNDS_EIGEN_MAX_SWEEPS 32
+
+BoundingBox BoundsCalculator::CalculateBox(XMFLOAT3 boundsMin, XMFLOAT3 boundsMax)
+{
+	BoundingBox box;
+	BoundingBox::CreateFromPoints(box, XMLoadFloat3(&boundsMin), XMLoadFloat3(&boundsMax));
+	return box;
+}
+
+BoundingSphere BoundsCalculator::CalculateSphere(const Vertex* verts, unsigned int numVerts)
+{
+	if (numVerts == 0)
+		return BoundingSphere(XMFLOAT3(0, 0, 0), 0.0f);
+
+	// The points furthest along each axis, either way
+	unsigned int minIndex[3] = { 0, 0, 0 };
+	unsigned int maxIndex[3] = { 0, 0, 0 };
+	for (unsigned int i = 1; i < numVerts; i++)
+	{
+		const float* p = &verts[i].Position.x;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (p[axis] < (&verts[minIndex[axis]].Position.x)[axis])
+				minIndex[axis] = i;
+			if (p[axis] > (&verts[maxIndex[axis]].Position.x)[axis])
+				maxIndex[axis] = i;
+		}
+	}
+
+	// Start with the sphere between the pair that's furthest apart
+	XMVECTOR a = XMLoadFloat3(&verts[minIndex[0]].Position);
+	XMVECTOR b = XMLoadFloat3(&verts[maxIndex[0]].Position);
+	for (int axis = 1; axis < 3; axis++)
+	{
+		XMVECTOR axisMin = XMLoadFloat3(&verts[minIndex[axis]].Position);
+		XMVECTOR axisMax = XMLoadFloat3(&verts[maxIndex[axis]].Position);
+		if (XMVectorGetX(XMVector3LengthSq(axisMax - axisMin)) > XMVectorGetX(XMVector3LengthSq(b - a)))
+		{
+			a = axisMin;
+			b = axisMax;
+		}
+	}
+
+	// Then grow it just enough to take in every point outside it
+	XMVECTOR center = (a + b) * 0.5f;
+	float radius = XMVectorGetX(XMVector3Length(b - a)) * 0.5f;
+	XMVECTOR boxMin = a;
+	XMVECTOR boxMax = a;
+	for (unsigned int i = 0; i < numVerts; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&verts[i].Position);
+		boxMin = XMVectorMin(boxMin, p);
+		boxMax = XMVectorMax(boxMax, p);
+
+		float distance = XMVectorGetX(XMVector3Length(p - center));
+		if (distance > radius)
+		{
+			float newRadius = (radius + distance) * 0.5f;
+			center += (p - center) * ((newRadius - radius) / distance);
+			radius = newRadius;
+		}
+	}
+
+	// Ritter's sphere can be up to about 5% too big, and the one around the box's
+	// center is sometimes smaller (boxy meshes especially)
+	XMVECTOR boxCenter = (boxMin + boxMax) * 0.5f;
+	float boxRadius = 0.0f;
+	for (unsigned int i = 0; i < numVerts; i++)
+		boxRadius = std::max(boxRadius, XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&verts[i].Position) - boxCenter)));
+	boxRadius = sqrtf(boxRadius);
+
+	BoundingSphere sphere;
+	XMStoreFloat3(&sphere.Center, boxRadius < radius ? boxCenter : center);
+	sphere.Radius = std::min(boxRadius, radius);
+	return sphere;
+}
+
+BoundingOrientedBox BoundsCalculator::CalculateOrientedBox(const Vertex* verts, unsigned int numVerts)
+{
+	BoundingOrientedBox result;
+	if (numVerts == 0)
+	{
+		result.Extents = XMFLOAT3(0, 0, 0);
+		return result;
+	}
+
+	// Covariance of the positions (in doubles, since big meshes sum a lot of small terms)
+	double mean[3] = { 0, 0, 0 };
+	for (unsigned int i = 0; i < numVerts; i++)
+	{
+		mean[0] += verts[i].Position.x;
+		mean[1] += verts[i].Position.y;
+		mean[2] += verts[i].Position.z;
+	}
+	for (int i = 0; i < 3; i++)
+		mean[i] /= numVerts;
+
+	double covariance[3][3] = {};
+	for (unsigned int i = 0; i < numVerts; i++)
+	{
+		double d[3] = { verts[i].Position.x - mean[0], verts[i].Position.y - mean[1], verts[i].Position.z - mean[2] };
+		for (int r = 0; r < 3; r++)
+			for (int c = r; c < 3; c++)
+				covariance[r][c] += d[r] * d[c];
+	}
+	for (int r = 0; r < 3; r++)
+		for (int c = 0; c < r; c++)
+			covariance[r][c] = covariance[c][r];
+
+	// Jacobi eigenvalue method: rotate away the off-diagonal terms one at a time,
+	// accumulating the rotations, whose columns end up as the eigenvectors
+	double eigenvectors[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+	for (int sweep = 0; sweep < BOUNDS_EIGEN_MAX_SWEEPS; sweep++)
+	{
+		double offDiagonal = fabs(covariance[0][1]) + fabs(covariance[0][2]) + fabs(covariance[1][2]);
+		double diagonal = fabs(covariance[0][0]) + fabs(covariance[1][1]) + fabs(covariance[2][2]);
+		if (offDiagonal <= diagonal * 1e-12)
+			break;
+
+		for (int p = 0; p < 2; p++)
+		{
+			for (int q = p + 1; q < 3; q++)
+			{
+				if (covariance[p][q] == 0.0)
+					continue;
+
+				double theta = (covariance[q][q] - covariance[p][p]) / (2.0 * covariance[p][q]);
+				double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+				double c = 1.0 / sqrt(t * t + 1.0);
+				double s = t * c;
+
+				for (int k = 0; k < 3; k++)
+				{
+					double kp = covariance[k][p];
+					double kq = covariance[k][q];
+					covariance[k][p] = c * kp - s * kq;
+					covariance[k][q] = s * kp + c * kq;
+				}
+				for (int k = 0; k < 3; k++)
+				{
+					double pk = covariance[p][k];
+					double qk = covariance[q][k];
+					covariance[p][k] = c * pk - s * qk;
+					covariance[q][k] = s * pk + c * qk;
+				}
+				for (int k = 0; k < 3; k++)
+				{
+					double kp = eigenvectors[k][p];
+					double kq = eigenvectors[k][q];
+					eigenvectors[k][p] = c * kp - s * kq;
+					eigenvectors[k][q] = s * kp + c * kq;
+				}
+			}
+		}
+	}
+
+	// Right handed axes, so they make a proper rotation
+	XMVECTOR axes[3];
+	for (int i = 0; i < 3; i++)
+		axes[i] = XMVector3Normalize(XMVectorSet((float)eigenvectors[0][i], (float)eigenvectors[1][i], (float)eigenvectors[2][i], 0.0f));
+	axes[2] = XMVector3Normalize(XMVector3Cross(axes[0], axes[1]));
+	axes[1] = XMVector3Cross(axes[2], axes[0]);
+
+	// Extents along each axis
+	float axisMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float axisMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	XMVECTOR boxMin = XMLoadFloat3(&verts[0].Position);
+	XMVECTOR boxMax = boxMin;
+	for (unsigned int i = 0; i < numVerts; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&verts[i].Position);
+		boxMin = XMVectorMin(boxMin, p);
+		boxMax = XMVectorMax(boxMax, p);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float d = XMVectorGetX(XMVector3Dot(p, axes[axis]));
+			axisMin[axis] = std::min(axisMin[axis], d);
+			axisMax[axis] = std::max(axisMax[axis], d);
+		}
+	}
+
+	XMVECTOR center = XMVectorZero();
+	for (int axis = 0; axis < 3; axis++)
+		center += axes[axis] * ((axisMin[axis] + axisMax[axis]) * 0.5f);
+	XMStoreFloat3(&result.Center, center);
+	result.Extents = XMFLOAT3((axisMax[0] - axisMin[0]) * 0.5f, (axisMax[1] - axisMin[1]) * 0.5f, (axisMax[2] - axisMin[2]) * 0.5f);
+	XMMATRIX rotation = XMMatrixIdentity();
+	rotation.r[0] = axes[0];
+	rotation.r[1] = axes[1];
+	rotation.r[2] = axes[2];
+	XMStoreFloat4(&result.Orientation, XMQuaternionNormalize(XMQuaternionRotationMatrix(rotation)));
+
+	// Principal axes aren't always the best fit (a cube's are arbitrary), so keep the axis aligned box when it's smaller
+	BoundingBox box;
+	BoundingBox::CreateFromPoints(box, boxMin, boxMax);
+	if (Volume(box) <= Volume(result))
+	{
+		result.Center = box.Center;
+		result.Extents = box.Extents;
+		result.Orientation = XMFLOAT4(0, 0, 0, 1);
+	}
+	return result;
+}
+
+BoundingOrientedBox BoundsCalculator::TransformOrientedBox(const BoundingOrientedBox& box, FXMMATRIX world)
+{
+	// The box's half-axes in world space, which non-uniform scale can skew
+	XMMATRIX rotation = XMMatrixRotationQuaternion(XMLoadFloat4(&box.Orientation));
+	XMVECTOR halfAxes[3] =
+	{
+		XMVector3TransformNormal(rotation.r[0] * box.Extents.x, world),
+		XMVector3TransformNormal(rotation.r[1] * box.Extents.y, world),
+		XMVector3TransformNormal(rotation.r[2] * box.Extents.z, world)
+	};
+
+	// Square them back up (Gram-Schmidt), falling back to the box's own axes if one collapsed
+	XMVECTOR axes[3];
+	axes[0] = XMVector3Normalize(halfAxes[0]);
+	axes[1] = XMVector3Normalize(halfAxes[1] - axes[0] * XMVector3Dot(halfAxes[1], axes[0]));
+	if (XMVectorGetX(XMVector3LengthSq(axes[0])) < 0.5f || XMVectorGetX(XMVector3LengthSq(axes[1])) < 0.5f)
+	{
+		axes[0] = rotation.r[0];
+		axes[1] = rotation.r[1];
+	}
+	axes[2] = XMVector3Cross(axes[0], axes[1]);
+
+	// The skewed box's extent along each new axis is how far its half-axes reach along it
+	BoundingOrientedBox result;
+	XMStoreFloat3(&result.Center, XMVector3Transform(XMLoadFloat3(&box.Center), world));
+	float extents[3];
+	for (int i = 0; i < 3; i++)
+	{
+		extents[i] = 0.0f;
+		for (int j = 0; j < 3; j++)
+			extents[i] += fabsf(XMVectorGetX(XMVector3Dot(axes[i], halfAxes[j])));
+	}
+	result.Extents = XMFLOAT3(extents[0], extents[1], extents[2]);
+
+	XMMATRIX newRotation = XMMatrixIdentity();
+	newRotation.r[0] = axes[0];
+	newRotation.r[1] = axes[1];
+	newRotation.r[2] = axes[2];
+	XMStoreFloat4(&result.Orientation, XMQuaternionNormalize(XMQuaternionRotationMatrix(newRotation)));
+	return result;
+}
+
+BoundingBox BoundsCalculator::TransformBox(const BoundingBox& box, const BoundingOrientedBox& worldOrientedBox, FXMMATRIX world)
+{
+	BoundingBox fromBox;
+	box.Transform(fromBox, world);
+
+	XMFLOAT3 corners[BoundingOrientedBox::CORNER_COUNT];
+	worldOrientedBox.GetCorners(corners);
+	BoundingBox fromOrientedBox;
+	BoundingBox::CreateFromPoints(fromOrientedBox, BoundingOrientedBox::CORNER_COUNT, corners, sizeof(XMFLOAT3));
+
+	// Both contain the mesh, so their overlap does too
+	XMVECTOR boxMin = XMVectorMax(XMLoadFloat3(&fromBox.Center) - XMLoadFloat3(&fromBox.Extents),
+		XMLoadFloat3(&fromOrientedBox.Center) - XMLoadFloat3(&fromOrientedBox.Extents));
+	XMVECTOR boxMax = XMVectorMin(XMLoadFloat3(&fromBox.Center) + XMLoadFloat3(&fromBox.Extents),
+		XMLoadFloat3(&fromOrientedBox.Center) + XMLoadFloat3(&fromOrientedBox.Extents));
+
+	BoundingBox result;
+	BoundingBox::CreateFromPoints(result, boxMin, boxMax);
+	return result;
+}
+
+float BoundsCalculator::Volume(const BoundingBox& box)
+{
+	return 8.0f * box.Extents.x * box.Extents.y * box.Extents.z;
+}
+
+float BoundsCalculator::Volume(const BoundingOrientedBox& box)
+{
+	return 8.0f * box.Extents.x * box.Extents.y * box.Extents.z;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Fits bounding volumes around a mesh's vertices, and moves
+// them into world space
+//
+// - Spheres use Ritter's method (grow a sphere between two
+//   far apart points until it takes in every point), or one
+//   centered on the box if that turns out smaller
+// - Oriented boxes line up with the principal axes of the
+//   vertices (the eigenvectors of their covariance), unless
+//   the axis aligned box is smaller
+// - Everything is done once when a mesh loads, or when an
+//   entity's transform changes, never every frame
+// --------------------------------------------------------
+class BoundsCalculator
+{
+public:
+
+	static DirectX::BoundingBox CalculateBox(DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax);
+	static DirectX::BoundingSphere CalculateSphere(const Vertex* verts, unsigned int numVerts);
+	static DirectX::BoundingOrientedBox CalculateOrientedBox(const Vertex* verts, unsigned int numVerts);
+
+	// Unlike BoundingOrientedBox::Transform(), this stays conservative under non-uniform scale,
+	// where the box's axes get skewed, by fitting a new box around the skewed one
+	static DirectX::BoundingOrientedBox TransformOrientedBox(const DirectX::BoundingOrientedBox& box, DirectX::FXMMATRIX world);
+
+	// The world axis aligned box around both the transformed local box and the already transformed
+	// oriented box, whichever is tighter on each axis
+	static DirectX::BoundingBox TransformBox(const DirectX::BoundingBox& box,
+		const DirectX::BoundingOrientedBox& worldOrientedBox, DirectX::FXMMATRIX world);
+
+	static float Volume(const DirectX::BoundingBox& box);
+	static float Volume(const DirectX::BoundingOrientedBox& box);
+};
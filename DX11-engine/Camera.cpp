@@ -57,14 +57,15 @@ void Camera::Update(float dt)
 		int cursorMovementX = input.GetMouseXDelta();
 		int cursorMovementY = input.GetMouseYDelta();
 		
-		transform.SetRotation(transform.GetPitchYawRoll().x + ((float)cursorMovementY * sensitivity / 100.0f), 
-			transform.GetPitchYawRoll().y + (float)cursorMovementX * sensitivity / 100.0f,
-			transform.GetPitchYawRoll().z);
+		XMFLOAT3 rotation = transform.GetPitchYawRoll();
+		rotation.x += (float)cursorMovementY * sensitivity / 100.0f;
+		rotation.y += (float)cursorMovementX * sensitivity / 100.0f;
 
 		// Clamp Pitch to +-PI/2 (slightly less than that)
-		XMVECTOR pitchVec = XMVectorClamp(XMLoadFloat(&transform.GetPitchYawRoll().x),
+		XMVECTOR pitchVec = XMVectorClamp(XMLoadFloat(&rotation.x),
 			XMVectorSet(-PI / 2.01f, 0, 0, 0), XMVectorSet(PI / 2.01f, 0, 0, 0));
-		XMStoreFloat(&transform.GetPitchYawRoll().x, pitchVec);
+		XMStoreFloat(&rotation.x, pitchVec);
+		transform.SetRotation(rotation);
 	}
 
 	UpdateViewMatrix();
@@ -99,6 +100,18 @@ XMFLOAT4X4 Camera::GetProjection()
 	return projection;
 }
 
+CameraSnapshot Camera::GetSnapshot()
+{
+	CameraSnapshot snapshot = {};
+	snapshot.Position = transform.GetPosition();
+	snapshot.Forward = transform.GetForward();
+	snapshot.Up = transform.GetUp();
+	snapshot.View = view;
+	snapshot.Projection = projection;
+	snapshot.ViewDimensions = viewDimensions;
+	return snapshot;
+}
+
 Transform& Camera::GetTransform()
 {
 	return transform;
@@ -9,6 +9,17 @@ enum CamType
 	Orthographic
 };
 
+// What drawing from a camera needs, as it was at the end of a frame's simulation
+struct CameraSnapshot
+{
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT3 Forward;
+	DirectX::XMFLOAT3 Up;
+	DirectX::XMFLOAT4X4 View;
+	DirectX::XMFLOAT4X4 Projection;
+	DirectX::XMFLOAT2 ViewDimensions;
+};
+
 class Camera
 {
 public:
@@ -43,6 +54,7 @@ public:
 	DirectX::XMFLOAT4X4 GetProjection();
 	void UpdateProjectionMatrix(float viewWidth, float viewHeight);
 	void UpdateViewMatrix();
+	CameraSnapshot GetSnapshot();
 
 private:
 
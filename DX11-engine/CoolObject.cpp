@@ -7,17 +7,16 @@ using namespace DirectX;
 // Constructors call their superclass counterparts
 CoolObject::CoolObject() : GameEntity()
 {
-	totalTime = 0.0f;
-	mousePos = { 0.0f, 0.0f };
-	body = Rigidbody();
+	this->AddComponent<CoolObjectInputs>(CoolObjectInputs());
+	Rigidbody body = Rigidbody();
 	body.gravity = { 0, -9.8f, 0 };
 	this->AddComponent<Rigidbody>(body);
 };
 CoolObject::CoolObject(shared_ptr<Mesh> mesh, shared_ptr<Material> material)
 	: GameEntity(mesh, material) 
 {
-	totalTime = 0.0f;
-	mousePos = { 0.0f, 0.0f };
+	this->AddComponent<CoolObjectInputs>(CoolObjectInputs());
+	Rigidbody body = Rigidbody();
 	body.gravity = { 0, -9.8f, 0 };
 	this->AddComponent<Rigidbody>(body);
 };
@@ -27,44 +26,35 @@ void CoolObject::Init()
 	GetTransform()->SetPosition(-4, 0, 0);
 }
 
-void CoolObject::Update(float deltaTime, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+void CoolObject::AddSystems(SystemScheduler& scheduler)
 {
-	totalTime += deltaTime;
-	mousePos = 
-	{ 
-		(float)Input::GetInstance().GetMouseX(), 
-		(float)Input::GetInstance().GetMouseY() 
-	};
+	// Input isn't touched while systems run, so reading it from any thread is fine
+	scheduler.Add<CoolObjectInputs>("CoolObject inputs", [](float deltaTime, EcsEntity entity, CoolObjectInputs& inputs)
+	{
+		inputs.totalTime += deltaTime;
+		inputs.mousePos = 
+		{ 
+			(float)Input::GetInstance().GetMouseX(), 
+			(float)Input::GetInstance().GetMouseY() 
+		};
+	});
 }
 
-void CoolObject::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camPtr)
+void CoolObject::Snapshot(EntitySnapshot& snapshot)
 {
-	// Do any routine prep work for the material's shaders (i.e. loading stuff)
-	GetMaterial()->PrepareMaterial();
+	GameEntity::Snapshot(snapshot);
 
-	std::shared_ptr<SimpleVertexShader> vs = GetMaterial()->GetVS();
-	std::shared_ptr<SimplePixelShader> ps = GetMaterial()->GetPS();
-
-	// Strings here MUST  match variable names in your shaders cbuffer!
-	vs->SetMatrix4x4("world", GetTransform()->GetWorldMatrix());
-	vs->SetMatrix4x4("worldInvTranspose", GetTransform()->GetWorldInverseTransposeMatrix());
-	vs->SetMatrix4x4("view", camPtr->GetView());
-	vs->SetMatrix4x4("projection", camPtr->GetProjection());
-
-	vs->CopyAllBufferData(); // Adjust vs variable name if necessary
-
-	ps->SetFloat2("mousePos", mousePos);
-	ps->SetFloat("time", totalTime);
-
-	ps->CopyAllBufferData();
-
-	// Set the shaders for this entity
-	GetMaterial()->GetVS()->SetShader();
-	GetMaterial()->GetPS()->SetShader();
+	CoolObjectInputs* inputs = GetComponent<CoolObjectInputs>();
+	snapshot.ShaderInputs = XMFLOAT4(inputs->mousePos.x, inputs->mousePos.y, inputs->totalTime, 0);
+}
 
-	// Draw the mesh
-	GetMesh()->Draw();
+void CoolObject::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const EntitySnapshot& snapshot,
+	XMFLOAT3 cameraPos, XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projMatrix, EntityDrawResult* result, MeshBindings* bindings)
+{
+	// Set before the rest, which copies them to the shader along with everything else
+	std::shared_ptr<SimplePixelShader> ps = snapshot.Material->GetPS();
+	ps->SetFloat2("mousePos", XMFLOAT2(snapshot.ShaderInputs.x, snapshot.ShaderInputs.y));
+	ps->SetFloat("time", snapshot.ShaderInputs.z);
 
-	// reset the SRV's and samplers for the next time so shader is fresh for a different material
-	GetMaterial()->ResetTextureData();
+	GameEntity::Draw(context, snapshot, cameraPos, viewMatrix, projMatrix, result, bindings);
 }
\ No newline at end of file
@@ -2,6 +2,15 @@
 
 #include "GameEntity.h"
 #include "Rigidbody.h"
+#include "SystemScheduler.h"
+
+// What a CoolObject's shader animates with
+class CoolObjectInputs : public Component
+{
+public:
+	float totalTime;
+	DirectX::XMFLOAT2 mousePos;
+};
 
 class CoolObject : public GameEntity
 {
@@ -11,16 +20,22 @@ public:
 	CoolObject();
 	CoolObject(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
 
+	// Every CoolObject's per-frame work, as systems rather than an Update() override
+	static void AddSystems(SystemScheduler& scheduler);
+
 	void Init() override;
-	void Update(float deltaTime, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) override;
-	void Draw(
-		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
-		std::shared_ptr<Camera> camPtr) override;
 
-private:
+	// Its shader inputs go in ShaderInputs: the mouse position in x and y, the time in z
+	void Snapshot(EntitySnapshot& snapshot) override;
 
-	float totalTime;
-	DirectX::XMFLOAT2 mousePos;
-	Rigidbody body;
+	using GameEntity::Draw;
+	void Draw(
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		const EntitySnapshot& snapshot,
+		DirectX::XMFLOAT3 cameraPos,
+		DirectX::XMFLOAT4X4 viewMatrix,
+		DirectX::XMFLOAT4X4 projMatrix,
+		EntityDrawResult* result = 0,
+		MeshBindings* bindings = 0) override;
 
 };
\ No newline at end of file
@@ -0,0 +1,449 @@
+#include "EcsWorld.h"
+#include "Rigidbody.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <typeindex>
+
+using namespace DirectX;
+
+// Singleton requirement
+EcsWorld* EcsWorld::instance;
+
+EcsComponentType EcsWorld::types[ECS_MAX_COMPONENT_TYPES];
+unsigned int EcsWorld::typeCount = 0;
+
+// What the system on this thread may touch, and how often any system overstepped
+static thread_local const EcsAccess* currentAccess = 0;
+static std::atomic<unsigned int> accessViolations(0);
+
+EcsWorld::EcsWorld()
+{
+	this->entityCount = 0;
+}
+
+EcsWorld::~EcsWorld()
+{
+	// Whatever is still alive has its components destroyed properly
+	for (unsigned int i = 0; i < records.size(); i++)
+		if (records[i].alive)
+			Destroy((records[i].generation << ECS_INDEX_BITS) | i);
+}
+
+EcsEntity EcsWorld::Create()
+{
+#if defined(DEBUG) || defined(_DEBUG)
+	CheckStructuralChange("make an entity");
+#endif
+	unsigned int index;
+	if (!freeRecords.empty())
+	{
+		index = freeRecords.back();
+		freeRecords.pop_back();
+	}
+	else
+	{
+		// The last index is never used, so no entity can be ECS_NO_ENTITY
+		if (records.size() >= ECS_INDEX_MASK)
+			return ECS_NO_ENTITY;
+		index = (unsigned int)records.size();
+		records.push_back({ 0, 0, 0, 0, false });
+	}
+
+	Record& record = records[index];
+	record.archetype = 0;
+	record.alive = true;
+	entityCount++;
+	return (record.generation << ECS_INDEX_BITS) | index;
+}
+
+EcsEntity EcsWorld::Clone(EcsEntity source)
+{
+	if (!Find(source))
+		return ECS_NO_ENTITY;
+	EcsEntity entity = Create();
+	if (entity == ECS_NO_ENTITY)
+		return entity;
+
+	// Same archetype, so every column just gets a copy (found again after Create(),
+	// which can move the records)
+	Record& from = *Find(source);
+	Record& to = *Find(entity);
+	if (!from.archetype)
+		return entity;
+
+	Append(from.archetype, entity, to.chunk, to.row);
+	to.archetype = from.archetype;
+	for (unsigned int type : from.archetype->Types)
+		types[type].CopyConstruct(GetComponent(to, type), GetComponent(from, type));
+	return entity;
+}
+
+void EcsWorld::Destroy(EcsEntity entity)
+{
+#if defined(DEBUG) || defined(_DEBUG)
+	CheckStructuralChange("destroy an entity");
+#endif
+	Record* record = Find(entity);
+	if (!record)
+		return;
+
+	if (record->archetype)
+		RemoveRow(record->archetype, record->chunk, record->row);
+	record->archetype = 0;
+	record->alive = false;
+	record->generation = (record->generation + 1) & (0xFFFFFFFF >> ECS_INDEX_BITS);
+	freeRecords.push_back(entity & ECS_INDEX_MASK);
+	entityCount--;
+}
+
+bool EcsWorld::IsAlive(EcsEntity entity)
+{
+	return Find(entity) != 0;
+}
+
+unsigned int EcsWorld::GetEntityCount()
+{
+	return entityCount;
+}
+
+unsigned int EcsWorld::GetArchetypeCount()
+{
+	return (unsigned int)archetypeList.size();
+}
+
+unsigned int EcsWorld::GetChunkCount()
+{
+	unsigned int chunks = 0;
+	for (EcsArchetype* archetype : archetypeList)
+		chunks += (unsigned int)archetype->Chunks.size();
+	return chunks;
+}
+
+void EcsWorld::GetChunks(unsigned long long mask, std::vector<EcsChunkRef>& chunks)
+{
+	for (EcsArchetype* archetype : archetypeList)
+	{
+		if ((archetype->Mask & mask) != mask)
+			continue;
+		for (unsigned int chunk = 0; chunk < archetype->Chunks.size(); chunk++)
+			chunks.push_back({ archetype, chunk });
+	}
+}
+
+const std::vector<EcsArchetype*>& EcsWorld::GetArchetypes()
+{
+	return archetypeList;
+}
+
+const EcsAccess* EcsWorld::SetAccess(const EcsAccess* access)
+{
+	const EcsAccess* previous = currentAccess;
+	currentAccess = access;
+	return previous;
+}
+
+unsigned int EcsWorld::TakeAccessViolations()
+{
+	return accessViolations.exchange(0);
+}
+
+void EcsWorld::CheckAccess(unsigned int type, bool write)
+{
+	if (!currentAccess)
+		return;
+
+	unsigned long long bit = 1ull << type;
+	unsigned long long allowed = write ? currentAccess->Writes : currentAccess->Reads | currentAccess->Writes;
+	if (allowed & bit)
+		return;
+
+	accessViolations++;
+#if defined(DEBUG) || defined(_DEBUG)
+	printf("ECS: system \"%s\" %s component type %u without declaring it\n", currentAccess->Name, write ? "wrote" : "read", type);
+#endif
+}
+
+void EcsWorld::CheckStructuralChange(const char* what)
+{
+	if (!currentAccess)
+		return;
+
+	accessViolations++;
+#if defined(DEBUG) || defined(_DEBUG)
+	printf("ECS: system \"%s\" tried to %s while systems were running\n", currentAccess->Name, what);
+#endif
+}
+
+unsigned int EcsWorld::RegisterType(const EcsComponentType& type)
+{
+	if (typeCount >= ECS_MAX_COMPONENT_TYPES || type.Alignment > ECS_CACHE_LINE)
+	{
+		printf("ECS: too many component types, or one aligned to more than a cache line\n");
+		abort();
+	}
+
+	types[typeCount] = type;
+	return typeCount++;
+}
+
+EcsWorld::Record* EcsWorld::Find(EcsEntity entity)
+{
+	unsigned int index = entity & ECS_INDEX_MASK;
+	if (entity == ECS_NO_ENTITY || index >= records.size())
+		return 0;
+
+	Record& record = records[index];
+	return record.alive && record.generation == entity >> ECS_INDEX_BITS ? &record : 0;
+}
+
+EcsArchetype* EcsWorld::GetArchetype(unsigned long long mask)
+{
+	std::unique_ptr<EcsArchetype>& archetype = archetypes[mask];
+	if (archetype)
+		return archetype.get();
+
+	archetype = std::make_unique<EcsArchetype>();
+	archetype->Mask = mask;
+	archetype->Index = (unsigned int)archetypeList.size();
+	archetype->Count = 0;
+	for (unsigned int type = 0; type < ECS_MAX_COMPONENT_TYPES; type++)
+		if (mask & (1ull << type))
+			archetype->Types.push_back(type);
+
+	// The entity ids, then one column per type, each starting on a new cache line
+	auto layout = [&](unsigned int capacity)
+	{
+		size_t offset = capacity * sizeof(EcsEntity);
+		for (unsigned int type : archetype->Types)
+		{
+			offset = (offset + ECS_CACHE_LINE - 1) & ~(size_t)(ECS_CACHE_LINE - 1);
+			archetype->Offsets[type] = offset;
+			offset += capacity * types[type].Size;
+		}
+		return offset;
+	};
+
+	// As many entities as fit, after the padding between columns
+	size_t rowBytes = sizeof(EcsEntity);
+	for (unsigned int type : archetype->Types)
+		rowBytes += types[type].Size;
+	unsigned int capacity = (std::max)(1u, (unsigned int)(ECS_CHUNK_SIZE / rowBytes));
+	while (capacity > 1 && layout(capacity) > ECS_CHUNK_SIZE)
+		capacity--;
+
+	archetype->Capacity = capacity;
+	archetype->ChunkBytes = (std::max)((size_t)ECS_CHUNK_SIZE, layout(capacity));
+	archetypeList.push_back(archetype.get());
+	return archetype.get();
+}
+
+void* EcsWorld::GetComponent(const Record& record, unsigned int type)
+{
+	EcsArchetype* archetype = record.archetype;
+	return archetype->Chunks[record.chunk].Data + archetype->Offsets[type] + record.row * types[type].Size;
+}
+
+void EcsWorld::Move(EcsEntity entity, Record& record, unsigned long long mask)
+{
+	EcsArchetype* from = record.archetype;
+	EcsArchetype* to = mask ? GetArchetype(mask) : 0;
+	Record moved = { to, 0, 0, record.generation, true };
+
+	if (to)
+	{
+		Append(to, entity, moved.chunk, moved.row);
+		for (unsigned int type : to->Types)
+			if (from && (from->Mask & (1ull << type)))
+				types[type].MoveConstruct(GetComponent(moved, type), GetComponent(record, type));
+	}
+
+	// Takes the moved-from components (and any that were dropped) with it
+	if (from)
+		RemoveRow(from, record.chunk, record.row);
+
+	record.archetype = moved.archetype;
+	record.chunk = moved.chunk;
+	record.row = moved.row;
+}
+
+void EcsWorld::Append(EcsArchetype* archetype, EcsEntity entity, unsigned int& chunk, unsigned int& row)
+{
+	if (archetype->Chunks.empty() || archetype->Chunks.back().Count == archetype->Capacity)
+	{
+		EcsArchetype::Chunk added;
+		added.Memory.reset(new char[archetype->ChunkBytes + ECS_CACHE_LINE]);
+		added.Data = (char*)(((size_t)added.Memory.get() + ECS_CACHE_LINE - 1) & ~(size_t)(ECS_CACHE_LINE - 1));
+		added.Count = 0;
+		archetype->Chunks.push_back(std::move(added));
+	}
+
+	chunk = (unsigned int)archetype->Chunks.size() - 1;
+	row = archetype->Chunks[chunk].Count++;
+	((EcsEntity*)archetype->Chunks[chunk].Data)[row] = entity;
+	archetype->Count++;
+}
+
+void EcsWorld::RemoveRow(EcsArchetype* archetype, unsigned int chunk, unsigned int row)
+{
+	unsigned int lastChunk = (unsigned int)archetype->Chunks.size() - 1;
+	unsigned int lastRow = archetype->Chunks[lastChunk].Count - 1;
+	bool isLast = chunk == lastChunk && row == lastRow;
+
+	// The last row fills the gap, so every column stays packed
+	Record hole = { archetype, chunk, row, 0, true };
+	Record last = { archetype, lastChunk, lastRow, 0, true };
+	for (unsigned int type : archetype->Types)
+	{
+		types[type].Destroy(GetComponent(hole, type));
+		if (!isLast)
+		{
+			types[type].MoveConstruct(GetComponent(hole, type), GetComponent(last, type));
+			types[type].Destroy(GetComponent(last, type));
+		}
+	}
+
+	if (!isLast)
+	{
+		EcsEntity movedEntity = ((EcsEntity*)archetype->Chunks[lastChunk].Data)[lastRow];
+		((EcsEntity*)archetype->Chunks[chunk].Data)[row] = movedEntity;
+		Record& moved = records[movedEntity & ECS_INDEX_MASK];
+		moved.chunk = chunk;
+		moved.row = row;
+	}
+
+	archetype->Count--;
+	if (--archetype->Chunks[lastChunk].Count == 0)
+		archetype->Chunks.pop_back();
+}
+
+// A second component for the benchmark's two-component query
+struct EcsBenchmarkPosition : public Component
+{
+	XMFLOAT3 Position;
+};
+
+EcsBenchmark EcsWorld::Benchmark(unsigned int entityCount)
+{
+	EcsBenchmark result = {};
+	result.Entities = entityCount;
+	const float deltaTime = 1.0f / 60.0f;
+
+	Rigidbody falling = Rigidbody();
+	falling.gravity = XMFLOAT3(0, -9.8f, 0);
+	falling.linearDamping = 0.1f;
+	EcsBenchmarkPosition position = EcsBenchmarkPosition();
+
+	// Each entity as its own heap object with a map of components, held by pointer here so the
+	// map can have the real thing (GameEntity's kept copies of the Component base)
+	struct MapEntity
+	{
+		std::unordered_map<std::type_index, std::shared_ptr<Component>> components;
+	};
+	std::vector<std::unique_ptr<MapEntity>> mapEntities;
+
+	// The same entities here: three quarters with a Rigidbody, half with a position
+	EcsWorld world;
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		EcsEntity entity = world.Create();
+		mapEntities.push_back(std::make_unique<MapEntity>());
+		if (i % 4 != 0)
+		{
+			world.Add<Rigidbody>(entity, falling);
+			mapEntities.back()->components[typeid(Rigidbody)] = std::make_shared<Rigidbody>(falling);
+		}
+		if (i % 2 == 0)
+		{
+			world.Add<EcsBenchmarkPosition>(entity, position);
+			mapEntities.back()->components[typeid(EcsBenchmarkPosition)] = std::make_shared<EcsBenchmarkPosition>(position);
+		}
+	}
+
+	auto integrate = [=](Rigidbody& body)
+	{
+		body.linearVelocity.x = (body.linearVelocity.x + body.gravity.x * deltaTime) * (1.0f - body.linearDamping * deltaTime);
+		body.linearVelocity.y = (body.linearVelocity.y + body.gravity.y * deltaTime) * (1.0f - body.linearDamping * deltaTime);
+		body.linearVelocity.z = (body.linearVelocity.z + body.gravity.z * deltaTime) * (1.0f - body.linearDamping * deltaTime);
+	};
+	auto move = [=](Rigidbody& body, EcsBenchmarkPosition& position)
+	{
+		position.Position.x += body.linearVelocity.x * deltaTime;
+		position.Position.y += body.linearVelocity.y * deltaTime;
+		position.Position.z += body.linearVelocity.z * deltaTime;
+	};
+
+	auto start = std::chrono::high_resolution_clock::now();
+	world.Each<Rigidbody>([&](EcsEntity entity, Rigidbody& body) { integrate(body); });
+	result.EcsMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	for (std::unique_ptr<MapEntity>& entity : mapEntities)
+	{
+		auto found = entity->components.find(typeid(Rigidbody));
+		if (found != entity->components.end())
+			integrate(*(Rigidbody*)found->second.get());
+	}
+	result.MapMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	world.Each<Rigidbody, EcsBenchmarkPosition>([&](EcsEntity entity, Rigidbody& body, EcsBenchmarkPosition& position) { move(body, position); });
+	result.EcsPairMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	for (std::unique_ptr<MapEntity>& entity : mapEntities)
+	{
+		auto foundBody = entity->components.find(typeid(Rigidbody));
+		auto foundPosition = entity->components.find(typeid(EcsBenchmarkPosition));
+		if (foundBody != entity->components.end() && foundPosition != entity->components.end())
+			move(*(Rigidbody*)foundBody->second.get(), *(EcsBenchmarkPosition*)foundPosition->second.get());
+	}
+	result.MapPairMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// Entities were made in the same order, so ids line up with the map entities
+	result.Matches = true;
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		EcsBenchmarkPosition* ecsPosition = world.Get<EcsBenchmarkPosition>((EcsEntity)i);
+		auto found = mapEntities[i]->components.find(typeid(EcsBenchmarkPosition));
+		bool mapHas = found != mapEntities[i]->components.end();
+		if ((ecsPosition != 0) != mapHas ||
+			(ecsPosition && ecsPosition->Position.y != ((EcsBenchmarkPosition*)found->second.get())->Position.y))
+			result.Matches = false;
+	}
+	return result;
+}
+
+EcsComponents::EcsComponents()
+{
+	this->entity = ECS_NO_ENTITY;
+}
+
+EcsComponents::EcsComponents(const EcsComponents& other)
+{
+	this->entity = EcsWorld::GetInstance().Clone(other.entity);
+}
+
+EcsComponents& EcsComponents::operator=(const EcsComponents& other)
+{
+	if (this == &other)
+		return *this;
+
+	EcsWorld& world = EcsWorld::GetInstance();
+	world.Destroy(entity);
+	entity = world.Clone(other.entity);
+	return *this;
+}
+
+EcsComponents::~EcsComponents()
+{
+	EcsWorld::GetInstance().Destroy(entity);
+}
+
+EcsEntity EcsComponents::GetEntity()
+{
+	return entity;
+}
@@ -0,0 +1,355 @@
+#pragma once
+
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// An entity is an index into the world's records in the low bits, and how many times that
+// record has been reused in the high bits, so ids of destroyed entities stay dead
+typedef unsigned int EcsEntity;
+#define ECS_NO_ENTITY 0xFFFFFFFF
+#define ECS_INDEX_BITS 24
+#define ECS_INDEX_MASK ((1u << ECS_INDEX_BITS) - 1)
+
+// Component types are bits in an archetype's mask
+#define ECS_MAX_COMPONENT_TYPES 64
+
+// Archetypes store their entities in chunks of this size, with each
+// component's column starting on its own cache line
+#define ECS_CHUNK_SIZE (16 * 1024)
+#define ECS_CACHE_LINE 64
+
+// How to copy, move and destroy one kind of component without knowing its type
+struct EcsComponentType
+{
+	size_t Size;
+	size_t Alignment;
+	void (*CopyConstruct)(void* destination, const void* source);
+	void (*MoveConstruct)(void* destination, void* source);
+	void (*Destroy)(void* component);
+};
+
+// Every entity with exactly the same set of component types, a column per type
+struct EcsArchetype
+{
+	struct Chunk
+	{
+		std::unique_ptr<char[]> Memory;
+		char* Data;			// Memory, aligned to a cache line. The entity ids come first.
+		unsigned int Count;
+	};
+
+	unsigned long long Mask;
+	unsigned int Index;			// Where it is in the world's list of archetypes
+	std::vector<unsigned int> Types;
+	unsigned int Capacity;		// Entities per chunk
+	size_t ChunkBytes;
+	size_t Offsets[ECS_MAX_COMPONENT_TYPES];	// Where each type's column starts in a chunk
+	std::vector<Chunk> Chunks;	// All full except the last
+	unsigned int Count;
+};
+
+// One chunk of an archetype, for splitting a query up between threads
+struct EcsChunkRef
+{
+	EcsArchetype* Archetype;
+	unsigned int Chunk;
+};
+
+// What the system running on a thread said it would touch (see SystemScheduler), so debug builds can
+// catch it getting any other component, or adding, removing, making or destroying anything
+struct EcsAccess
+{
+	const char* Name;
+	unsigned long long Reads;
+	unsigned long long Writes;
+};
+
+// Iterating Rigidbody components each way, at one entity count
+struct EcsBenchmark
+{
+	unsigned int Entities;
+	double EcsMs;		// Every entity with a Rigidbody (three quarters of them)
+	double MapMs;		// The same through a per-entity unordered_map, the way GameEntity kept them
+	double EcsPairMs;	// Entities with both a Rigidbody and a position (a quarter of them)
+	double MapPairMs;
+	bool Matches;		// Both ended up with the same results
+};
+
+// --------------------------------------------------------
+// An archetype entity-component system
+//
+// - Components are stored by their real type, so nothing
+//   is sliced, in columns (one array per type) inside
+//   16 KB chunks
+// - Entities with the same set of component types share
+//   an archetype, and adding or removing a component moves
+//   the entity's row to another archetype
+// - Each<A, B>() only visits archetypes that have both,
+//   and walks their columns in order, so a query costs
+//   nothing for entities that don't match and no lookups
+//   for the ones that do
+// - Components asked for as const (Each<const A>(),
+//   Get<const A>()) are only read, which is what lets
+//   SystemScheduler run queries side by side
+// - Removing a row moves the archetype's last row into it,
+//   so columns never have gaps
+// - Nothing may add, remove or destroy while Each() runs
+// --------------------------------------------------------
+class EcsWorld
+{
+#pragma region Singleton
+public:
+	// The world GameEntity keeps its components in
+	static EcsWorld& GetInstance()
+	{
+		if (!instance)
+		{
+			instance = new EcsWorld();
+		}
+
+		return *instance;
+	}
+
+private:
+	static EcsWorld* instance;
+#pragma endregion
+
+public:
+
+	// Worlds of their own are fine too (the benchmark makes one)
+	EcsWorld();
+	~EcsWorld();
+	EcsWorld(const EcsWorld& other) = delete;
+	EcsWorld& operator=(const EcsWorld& other) = delete;
+
+	EcsEntity Create();
+	EcsEntity Clone(EcsEntity source);	// A new entity with copies of every component
+	void Destroy(EcsEntity entity);
+	bool IsAlive(EcsEntity entity);
+
+	// Adds a component, or overwrites the one already there. Returns null for dead entities.
+	template <class T>
+	T* Add(EcsEntity entity, const T& component = T())
+	{
+#if defined(DEBUG) || defined(_DEBUG)
+		CheckStructuralChange("add a component");
+#endif
+		Record* record = Find(entity);
+		if (!record)
+			return 0;
+
+		unsigned int type = GetTypeId<T>();
+		unsigned long long mask = record->archetype ? record->archetype->Mask : 0;
+		if (!(mask & (1ull << type)))
+		{
+			Move(entity, *record, mask | (1ull << type));
+			return new (GetComponent(*record, type)) T(component);
+		}
+
+		T* existing = (T*)GetComponent(*record, type);
+		*existing = component;
+		return existing;
+	}
+
+	// Returns false if the entity didn't have one
+	template <class T>
+	bool Remove(EcsEntity entity)
+	{
+#if defined(DEBUG) || defined(_DEBUG)
+		CheckStructuralChange("remove a component");
+#endif
+		Record* record = Find(entity);
+		unsigned long long bit = 1ull << GetTypeId<T>();
+		if (!record || !record->archetype || !(record->archetype->Mask & bit))
+			return false;
+
+		Move(entity, *record, record->archetype->Mask & ~bit);
+		return true;
+	}
+
+	template <class T>
+	bool Has(EcsEntity entity)
+	{
+		Record* record = Find(entity);
+		return record && record->archetype && (record->archetype->Mask & (1ull << GetTypeId<T>()));
+	}
+
+	// Null if the entity doesn't have one. Only valid until something is added to or removed from
+	// an entity of the same archetype, or destroyed.
+	template <class T>
+	T* Get(EcsEntity entity)
+	{
+#if defined(DEBUG) || defined(_DEBUG)
+		CheckAccess(GetTypeId<T>(), !std::is_const<T>::value);
+#endif
+		return Has<T>(entity) ? (T*)GetComponent(*Find(entity), GetTypeId<T>()) : 0;
+	}
+
+	// Calls function(EcsEntity, T&...) for every entity that has all of the given components
+	template <class... T, class Function>
+	void Each(Function function)
+	{
+		unsigned long long mask = GetMask<T...>();
+		for (EcsArchetype* archetype : archetypeList)
+		{
+			if ((archetype->Mask & mask) != mask)
+				continue;
+
+			for (EcsArchetype::Chunk& chunk : archetype->Chunks)
+				EachInChunk<T...>(archetype, chunk, function);
+		}
+	}
+
+	// The same, for one chunk's entities (which has to have all of the components)
+	template <class... T, class Function>
+	static void EachInChunk(EcsArchetype* archetype, EcsArchetype::Chunk& chunk, Function& function)
+	{
+		EcsEntity* entities = (EcsEntity*)chunk.Data;
+		std::tuple<T*...> columns((T*)(chunk.Data + archetype->Offsets[GetTypeId<T>()])...);
+		for (unsigned int row = 0; row < chunk.Count; row++)
+			function(entities[row], std::get<T*>(columns)[row]...);
+	}
+
+	// Every non-empty chunk of every archetype with all of the components in the mask
+	void GetChunks(unsigned long long mask, std::vector<EcsChunkRef>& chunks);
+	const std::vector<EcsArchetype*>& GetArchetypes();
+
+	// Sets what the calling thread's system may touch (null for anything), and returns what it was.
+	// Only checked in debug builds.
+	static const EcsAccess* SetAccess(const EcsAccess* access);
+
+	// How many times a system touched something it didn't declare, since this was last called
+	static unsigned int TakeAccessViolations();
+
+	unsigned int GetEntityCount();
+	unsigned int GetArchetypeCount();
+	unsigned int GetChunkCount();
+
+	// Each type gets the next free bit the first time it's used, in any world. Const makes no difference.
+	// Types should be used once on the main thread (Each() and SystemScheduler::Add() do) before any other.
+	template <class T>
+	static unsigned int GetTypeId()
+	{
+		return GetRegisteredTypeId<typename std::remove_cv<T>::type>();
+	}
+
+	template <class... T>
+	static unsigned long long GetMask()
+	{
+		unsigned long long bits[] = { 0ull, (1ull << GetTypeId<T>())... };
+		unsigned long long mask = 0;
+		for (unsigned long long bit : bits)
+			mask |= bit;
+		return mask;
+	}
+
+	// Times iterating components here against the old per-entity map, with this many entities
+	static EcsBenchmark Benchmark(unsigned int entityCount);
+
+private:
+
+	struct Record
+	{
+		EcsArchetype* archetype;	// Null while the entity has no components
+		unsigned int chunk;
+		unsigned int row;
+		unsigned int generation;
+		bool alive;
+	};
+
+	std::vector<Record> records;
+	std::vector<unsigned int> freeRecords;
+	unsigned int entityCount;
+
+	std::unordered_map<unsigned long long, std::unique_ptr<EcsArchetype>> archetypes;
+	std::vector<EcsArchetype*> archetypeList;	// The same, in the order they were made
+
+	static EcsComponentType types[ECS_MAX_COMPONENT_TYPES];
+	static unsigned int typeCount;
+	static unsigned int RegisterType(const EcsComponentType& type);
+
+	template <class T>
+	static unsigned int GetRegisteredTypeId()
+	{
+		static const unsigned int id = RegisterType({ sizeof(T), alignof(T), &CopyConstruct<T>, &MoveConstruct<T>, &DestroyComponent<T> });
+		return id;
+	}
+
+	// Prints (in debug builds) and counts anything the calling thread's system didn't declare
+	static void CheckAccess(unsigned int type, bool write);
+	static void CheckStructuralChange(const char* what);
+
+	template <class T>
+	static void CopyConstruct(void* destination, const void* source) { new (destination) T(*(const T*)source); }
+	template <class T>
+	static void MoveConstruct(void* destination, void* source) { new (destination) T(std::move(*(T*)source)); }
+	template <class T>
+	static void DestroyComponent(void* component) { ((T*)component)->~T(); }
+
+	Record* Find(EcsEntity entity);
+	EcsArchetype* GetArchetype(unsigned long long mask);
+	void* GetComponent(const Record& record, unsigned int type);
+
+	// Moves an entity's row to the archetype for the given mask, keeping the components both have.
+	// Components only the new archetype has are left unconstructed for the caller.
+	void Move(EcsEntity entity, Record& record, unsigned long long mask);
+	void Append(EcsArchetype* archetype, EcsEntity entity, unsigned int& chunk, unsigned int& row);
+	void RemoveRow(EcsArchetype* archetype, unsigned int chunk, unsigned int row);
+};
+
+// --------------------------------------------------------
+// Components owned by an object, kept in the world from
+// EcsWorld::GetInstance() (see GameEntity)
+//
+// - The entity is only made when the first component is
+//   added, so objects without any cost nothing there
+// - Copies get their own entity, with copies of every
+//   component, and the entity goes when this does
+// --------------------------------------------------------
+class EcsComponents
+{
+public:
+
+	EcsComponents();
+	EcsComponents(const EcsComponents& other);
+	EcsComponents& operator=(const EcsComponents& other);
+	~EcsComponents();
+
+	// Null if there isn't one
+	template <class T>
+	T* Get()
+	{
+		return EcsWorld::GetInstance().Get<T>(entity);
+	}
+
+	// Returns false (and changes nothing) if there's already one of this type
+	template <class T>
+	bool Add(const T& component)
+	{
+		EcsWorld& world = EcsWorld::GetInstance();
+		if (!world.IsAlive(entity))
+			entity = world.Create();
+		if (world.Has<T>(entity))
+			return false;
+		world.Add<T>(entity, component);
+		return true;
+	}
+
+	template <class T>
+	bool Remove()
+	{
+		return EcsWorld::GetInstance().Remove<T>(entity);
+	}
+
+	// ECS_NO_ENTITY until the first component is added
+	EcsEntity GetEntity();
+
+private:
+
+	EcsEntity entity;
+};
@@ -0,0 +1,214 @@
+#include "EntityManager.h"
+#include <chrono>
+
+unsigned int EntityManager::poolTypeCount = 0;
+
+EntityManager::EntityManager()
+{
+	this->firstFree = ENTITY_NO_HANDLE;
+	this->lastFree = ENTITY_NO_HANDLE;
+}
+
+EntityManager::~EntityManager()
+{
+	// Every entity has to be destroyed through its own pool, before the pools go
+	for (unsigned int i = 0; i < slots.size(); i++)
+		if (slots[i].entity)
+			slots[i].pool->Free(slots[i].entity);
+}
+
+GameEntity* EntityManager::Get(EntityHandle handle)
+{
+	Slot* slot = Find(handle);
+	return slot ? slot->entity : 0;
+}
+
+bool EntityManager::IsAlive(EntityHandle handle)
+{
+	Slot* slot = Find(handle);
+	return slot && !slot->pendingDestroy;
+}
+
+bool EntityManager::Destroy(EntityHandle handle)
+{
+	Slot* slot = Find(handle);
+	if (!slot || slot->pendingDestroy)
+		return false;
+
+	slot->pendingDestroy = true;
+	pendingDestroy.push_back(handle);
+	return true;
+}
+
+void EntityManager::Flush()
+{
+	for (EntityHandle handle : pendingDestroy)
+		Free(handle & ENTITY_INDEX_MASK);
+	pendingDestroy.clear();
+}
+
+const std::vector<GameEntity*>& EntityManager::GetEntities()
+{
+	return entities;
+}
+
+EntityHandle EntityManager::GetHandle(unsigned int entityIndex)
+{
+	return entityIndex < handles.size() ? handles[entityIndex] : ENTITY_NO_HANDLE;
+}
+
+unsigned int EntityManager::GetCount()
+{
+	return (unsigned int)entities.size();
+}
+
+EntityManagerStats EntityManager::GetStats()
+{
+	EntityManagerStats stats = {};
+	stats.Live = GetCount();
+	stats.PendingDestroy = (unsigned int)pendingDestroy.size();
+	for (const std::unique_ptr<EntityPoolBase>& pool : pools)
+		if (pool)
+			stats.Slabs += pool->GetSlabCount();
+	stats.SlabCapacity = stats.Slabs * ENTITY_SLAB_SIZE;
+	return stats;
+}
+
+unsigned int EntityManager::GetSlotCount()
+{
+	return (unsigned int)slots.size();
+}
+
+EntityManager::Slot* EntityManager::Find(EntityHandle handle)
+{
+	unsigned int index = handle & ENTITY_INDEX_MASK;
+	if (handle == ENTITY_NO_HANDLE || index >= slots.size())
+		return 0;
+
+	Slot& slot = slots[index];
+	return slot.entity && slot.generation == handle >> ENTITY_INDEX_BITS ? &slot : 0;
+}
+
+EntityHandle EntityManager::Place(GameEntity* entity, EntityPoolBase* pool)
+{
+	unsigned int index = firstFree;
+	if (index != ENTITY_NO_HANDLE)
+	{
+		firstFree = slots[index].nextFree;
+		if (firstFree == ENTITY_NO_HANDLE)
+			lastFree = ENTITY_NO_HANDLE;
+	}
+	else
+	{
+		index = (unsigned int)slots.size();
+		slots.push_back({ 0, 0, 0, 0, ENTITY_NO_HANDLE, false });
+	}
+
+	Slot& slot = slots[index];
+	slot.entity = entity;
+	slot.pool = pool;
+	slot.entityIndex = (unsigned int)entities.size();
+	slot.nextFree = ENTITY_NO_HANDLE;
+	slot.pendingDestroy = false;
+
+	EntityHandle handle = (slot.generation << ENTITY_INDEX_BITS) | index;
+	entities.push_back(entity);
+	handles.push_back(handle);
+	return handle;
+}
+
+void EntityManager::Free(unsigned int index)
+{
+	Slot& slot = slots[index];
+
+	// The last entity takes this one's place in the list
+	unsigned int last = (unsigned int)entities.size() - 1;
+	if (slot.entityIndex != last)
+	{
+		entities[slot.entityIndex] = entities[last];
+		handles[slot.entityIndex] = handles[last];
+		slots[handles[last] & ENTITY_INDEX_MASK].entityIndex = slot.entityIndex;
+	}
+	entities.pop_back();
+	handles.pop_back();
+
+	slot.pool->Free(slot.entity);
+	slot.entity = 0;
+	slot.pool = 0;
+	slot.pendingDestroy = false;
+	slot.generation = (slot.generation + 1) & ENTITY_GENERATION_MASK;
+
+	// To the back of the free list
+	slot.nextFree = ENTITY_NO_HANDLE;
+	if (lastFree != ENTITY_NO_HANDLE)
+		slots[lastFree].nextFree = index;
+	else
+		firstFree = index;
+	lastFree = index;
+}
+
+EntityManagerBenchmark EntityManager::Benchmark(unsigned int entityCount, unsigned int rounds)
+{
+	EntityManagerBenchmark result = {};
+	result.Entities = entityCount;
+	result.Rounds = rounds;
+	result.StaleHandlesRejected = true;
+	if (entityCount == 0 || rounds == 0)
+		return result;
+
+	EntityManager manager;
+	std::vector<EntityHandle> spawned(entityCount);
+	std::vector<EntityHandle> previous;
+	std::vector<GameEntity*> allocated(entityCount);
+	unsigned int warmSlabs = 0;
+	double spawnMs = 0, destroyMs = 0, newMs = 0, deleteMs = 0;
+
+	// Like debris: a burst spawned in one frame, all destroyed in a later one
+	for (unsigned int round = 0; round <= rounds; round++)
+	{
+		auto spawnStart = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < entityCount; i++)
+			spawned[i] = manager.Spawn<GameEntity>();
+		auto spawnEnd = std::chrono::high_resolution_clock::now();
+
+		for (EntityHandle handle : previous)
+			if (manager.Get(handle))
+				result.StaleHandlesRejected = false;
+
+		auto destroyStart = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < entityCount; i++)
+			manager.Destroy(spawned[i]);
+		manager.Flush();
+		auto destroyEnd = std::chrono::high_resolution_clock::now();
+
+		// The same entities straight from the heap
+		auto newStart = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < entityCount; i++)
+			allocated[i] = new GameEntity();
+		auto newEnd = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < entityCount; i++)
+			delete allocated[i];
+		auto deleteEnd = std::chrono::high_resolution_clock::now();
+
+		previous = spawned;
+
+		// The first round is only there to grow the pools
+		if (round == 0)
+		{
+			warmSlabs = manager.GetStats().Slabs;
+			continue;
+		}
+		spawnMs += std::chrono::duration<double, std::milli>(spawnEnd - spawnStart).count();
+		destroyMs += std::chrono::duration<double, std::milli>(destroyEnd - destroyStart).count();
+		newMs += std::chrono::duration<double, std::milli>(newEnd - newStart).count();
+		deleteMs += std::chrono::duration<double, std::milli>(deleteEnd - newEnd).count();
+	}
+
+	double perEntity = 1000000.0 / ((double)entityCount * rounds);
+	result.SpawnNs = spawnMs * perEntity;
+	result.DestroyNs = destroyMs * perEntity;
+	result.NewNs = newMs * perEntity;
+	result.DeleteNs = deleteMs * perEntity;
+	result.SteadyStateSlabs = manager.GetStats().Slabs - warmSlabs;
+	return result;
+}
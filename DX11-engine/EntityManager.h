@@ -0,0 +1,236 @@
+#pragma once
+
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "GameEntity.h"
+
+// A handle is an index into the manager's slots in the low bits, and how many times that slot
+// has been reused in the high bits, so handles to destroyed entities stay dead
+typedef unsigned int EntityHandle;
+#define ENTITY_NO_HANDLE 0xFFFFFFFF
+#define ENTITY_INDEX_BITS 20
+#define ENTITY_INDEX_MASK ((1u << ENTITY_INDEX_BITS) - 1)
+#define ENTITY_GENERATION_MASK (0xFFFFFFFF >> ENTITY_INDEX_BITS)
+
+// The all-ones index is never handed out, so no handle is ever ENTITY_NO_HANDLE
+#define ENTITY_MAX_COUNT ENTITY_INDEX_MASK
+
+// Entities of each type are allocated this many at a time
+#define ENTITY_SLAB_SIZE 64
+
+struct EntityManagerStats
+{
+	unsigned int Live;				// Including those waiting to be destroyed
+	unsigned int PendingDestroy;
+	unsigned int Slabs;				// Across every type's pool
+	unsigned int SlabCapacity;		// Entities those slabs can hold
+};
+
+// Spawning and destroying the same number of entities each way, over and over
+struct EntityManagerBenchmark
+{
+	unsigned int Entities;			// Per round
+	unsigned int Rounds;
+	double SpawnNs;					// Per entity, through the manager
+	double DestroyNs;				// Per entity, including the end of frame flush
+	double NewNs;					// Per entity, with new and delete
+	double DeleteNs;
+	unsigned int SteadyStateSlabs;	// Slabs allocated after the first round (should be none)
+	bool StaleHandlesRejected;		// No handle from an earlier round found anything
+};
+
+// --------------------------------------------------------
+// Storage for one type of entity, in fixed size slabs
+//
+// - Slabs are never freed until the pool is, so once it
+//   has grown to the most entities alive at once,
+//   spawning and destroying never touches the allocator
+// --------------------------------------------------------
+class EntityPoolBase
+{
+public:
+	virtual ~EntityPoolBase() {}
+
+	// Destroys an entity from this pool and keeps its memory for the next one
+	virtual void Free(GameEntity* entity) = 0;
+	virtual unsigned int GetSlabCount() = 0;
+};
+
+template <class T>
+class EntityPool : public EntityPoolBase
+{
+public:
+
+	// Uninitialized memory for one T
+	void* Allocate()
+	{
+		if (freeSlots.empty())
+			AddSlab();
+
+		void* slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+
+	void Free(GameEntity* entity) override
+	{
+		T* object = static_cast<T*>(entity);
+		object->~T();
+		freeSlots.push_back(object);	// Never grows past the capacity AddSlab() reserved
+	}
+
+	void Reserve(unsigned int count)
+	{
+		while (slabs.size() * ENTITY_SLAB_SIZE < count)
+			AddSlab();
+	}
+
+	unsigned int GetSlabCount() override { return (unsigned int)slabs.size(); }
+
+private:
+
+	typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Storage;
+
+	std::vector<std::unique_ptr<Storage[]>> slabs;
+	std::vector<void*> freeSlots;
+
+	void AddSlab()
+	{
+		slabs.emplace_back(new Storage[ENTITY_SLAB_SIZE]);
+		freeSlots.reserve(slabs.size() * ENTITY_SLAB_SIZE);
+
+		// Backwards, so the slab is handed out front to back
+		Storage* slab = slabs.back().get();
+		for (int i = ENTITY_SLAB_SIZE - 1; i >= 0; i--)
+			freeSlots.push_back(&slab[i]);
+	}
+};
+
+// --------------------------------------------------------
+// Owns the game's entities and hands out handles to them
+//
+// - Entities live in per-type slab pools (see EntityPool),
+//   and the manager keeps a dense list of them to iterate
+// - Handles are 32 bits: a slot index and a generation,
+//   which goes up whenever the slot's entity is destroyed,
+//   so Get() on a stale handle returns null rather than
+//   whatever took its place
+// - Destroy() only marks the entity. It stays usable until
+//   Flush() at the end of the frame, so nothing in the
+//   middle of a frame is left with a dangling pointer.
+// - Spawn, Destroy, Get and the per-entity part of Flush()
+//   are all O(1)
+// --------------------------------------------------------
+class EntityManager
+{
+public:
+
+	EntityManager();
+	~EntityManager();	// Destroys every entity still alive
+	EntityManager(const EntityManager& other) = delete;
+	EntityManager& operator=(const EntityManager& other) = delete;
+
+	// Constructs a T (a GameEntity or a subclass of it) in its pool with the given arguments
+	template <class T, class... Args>
+	EntityHandle Spawn(Args&&... args)
+	{
+		if (GetSlotCount() == ENTITY_MAX_COUNT && firstFree == ENTITY_NO_HANDLE)
+			return ENTITY_NO_HANDLE;
+
+		EntityPool<T>* pool = GetPool<T>();
+		T* entity = new (pool->Allocate()) T(std::forward<Args>(args)...);
+		return Place(entity, pool);
+	}
+
+	// Makes room for this many entities of a type up front, so spawning them doesn't allocate
+	template <class T>
+	void Reserve(unsigned int count)
+	{
+		GetPool<T>()->Reserve(count);
+		slots.reserve(count);
+		entities.reserve(count);
+		handles.reserve(count);
+		pendingDestroy.reserve(count);
+	}
+
+	// Null for handles whose entity has been destroyed. Entities waiting to be destroyed are still returned.
+	GameEntity* Get(EntityHandle handle);
+
+	template <class T>
+	T* Get(EntityHandle handle) { return static_cast<T*>(Get(handle)); }
+
+	// Alive and not waiting to be destroyed
+	bool IsAlive(EntityHandle handle);
+
+	// Destroys the entity at the next Flush(). Returns false if it's already gone or going.
+	bool Destroy(EntityHandle handle);
+
+	// Destroys everything Destroy() was called on. Called once a frame, after drawing.
+	void Flush();
+
+	// Every live entity, in no particular order once any have been destroyed. Spawning or
+	// flushing changes the list, so it mustn't be iterated across either.
+	const std::vector<GameEntity*>& GetEntities();
+	EntityHandle GetHandle(unsigned int entityIndex);
+	unsigned int GetCount();
+
+	EntityManagerStats GetStats();
+
+	// Times spawning and destroying entities here against new and delete
+	static EntityManagerBenchmark Benchmark(unsigned int entityCount, unsigned int rounds);
+
+private:
+
+	struct Slot
+	{
+		GameEntity* entity;		// Null while the slot is free
+		EntityPoolBase* pool;
+		unsigned int generation;
+		unsigned int entityIndex;	// Where it is in entities and handles
+		unsigned int nextFree;
+		bool pendingDestroy;
+	};
+
+	std::vector<Slot> slots;
+
+	// Free slots are reused oldest first, which spreads generations over every slot
+	// and makes it take as long as possible for a stale handle to match again
+	unsigned int firstFree;
+	unsigned int lastFree;
+
+	std::vector<GameEntity*> entities;
+	std::vector<EntityHandle> handles;
+	std::vector<EntityHandle> pendingDestroy;
+
+	// One pool per type, indexed by GetPoolId()
+	std::vector<std::unique_ptr<EntityPoolBase>> pools;
+	static unsigned int poolTypeCount;
+
+	template <class T>
+	static unsigned int GetPoolId()
+	{
+		static const unsigned int id = poolTypeCount++;
+		return id;
+	}
+
+	template <class T>
+	EntityPool<T>* GetPool()
+	{
+		static_assert(std::is_base_of<GameEntity, T>::value, "Only GameEntity and its subclasses can be spawned");
+
+		unsigned int id = GetPoolId<T>();
+		if (id >= pools.size())
+			pools.resize(id + 1);
+		if (!pools[id])
+			pools[id].reset(new EntityPool<T>());
+		return static_cast<EntityPool<T>*>(pools[id].get());
+	}
+
+	unsigned int GetSlotCount();
+	Slot* Find(EntityHandle handle);
+	EntityHandle Place(GameEntity* entity, EntityPoolBase* pool);
+	void Free(unsigned int index);
+};
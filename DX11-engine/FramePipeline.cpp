@@ -0,0 +1,285 @@
+#include "FramePipeline.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std::chrono;
+
+// Copies without giving up the memory the destination already has
+template <class T>
+static void CopyVector(ImVector<T>& destination, const ImVector<T>& source)
+{
+	destination.resize(source.Size);
+	if (source.Size > 0)
+		memcpy(destination.Data, source.Data, source.size_in_bytes());
+}
+
+// Keeps a thread busy for a while, like real work would
+static void Spin(double ms)
+{
+	high_resolution_clock::time_point end = high_resolution_clock::now() + duration_cast<high_resolution_clock::duration>(duration<double, std::milli>(ms));
+	while (high_resolution_clock::now() < end);
+}
+
+static double MsBetween(high_resolution_clock::time_point start, high_resolution_clock::time_point end)
+{
+	return duration<double, std::milli>(end - start).count();
+}
+
+FrameSnapshot::FrameSnapshot()
+{
+	this->Frame = 0;
+	this->Width = 0;
+	this->Height = 0;
+	this->Camera = {};
+	this->Ambient = DirectX::XMFLOAT3(0, 0, 0);
+	this->LightView = {};
+	this->LightProjection = {};
+	this->Defragment = false;
+	this->Drawn = false;
+	this->RenderMs = 0.0;
+	this->LatencyMs = 0.0;
+}
+
+void FrameSnapshot::CopyUI(ImDrawData* drawData)
+{
+	ui.Clear();
+	if (!drawData || !drawData->Valid)
+		return;
+
+	// Everything but the lists themselves, which ImGui owns and reuses
+	ui = *drawData;
+	while (uiLists.size() < (size_t)drawData->CmdListsCount)
+		uiLists.emplace_back(new ImDrawList(ImGui::GetDrawListSharedData()));
+
+	uiListPointers.resize(drawData->CmdListsCount);
+	for (int i = 0; i < drawData->CmdListsCount; i++)
+	{
+		ImDrawList* source = drawData->CmdLists[i];
+		ImDrawList* copy = uiLists[i].get();
+		CopyVector(copy->CmdBuffer, source->CmdBuffer);
+		CopyVector(copy->IdxBuffer, source->IdxBuffer);
+		CopyVector(copy->VtxBuffer, source->VtxBuffer);
+		copy->Flags = source->Flags;
+		uiListPointers[i] = copy;
+	}
+	ui.CmdLists = uiListPointers.empty() ? 0 : &uiListPointers[0];
+}
+
+ImDrawData* FrameSnapshot::GetUI()
+{
+	return &ui;
+}
+
+FramePipeline::FramePipeline(std::function<void(FrameSnapshot&)> render, bool pipelined)
+{
+	this->render = render;
+	this->pipelined = pipelined;
+	this->submitted = 0;
+	this->stopping = false;
+	this->drawn = 0;
+	this->stats = {};
+	this->stats.Pipelined = pipelined;
+	this->lastCollected = 0;
+	this->latencyCount = 0;
+	memset(latencies, 0, sizeof(latencies));
+
+	// Started either way, so switching is just a matter of where frames go
+	renderThread = std::thread(&FramePipeline::RenderLoop, this);
+}
+
+FramePipeline::~FramePipeline()
+{
+	WaitForIdle();
+	stopping = true;
+	Wake(wakeRenderer);
+	renderThread.join();
+}
+
+FrameSnapshot& FramePipeline::GetSnapshot()
+{
+	return frames.GetWriteBuffer();
+}
+
+void FramePipeline::Submit()
+{
+	high_resolution_clock::time_point start = high_resolution_clock::now();
+	double waitMs = 0.0;
+
+	FrameSnapshot& frame = frames.GetWriteBuffer();
+	frame.Frame = ++submitted;
+	frame.Drawn = false;
+
+	if (pipelined)
+	{
+		frames.Publish();
+		Wake(wakeRenderer);
+
+		// The next frame doesn't read its input until this one's started drawing, so it can't fall behind
+		high_resolution_clock::time_point waitStart = high_resolution_clock::now();
+		WaitFor(wakeSimulation, [this]() { return !frames.HasFresh(); });
+		waitMs = MsBetween(waitStart, high_resolution_clock::now());
+
+		// What came back is the frame the render thread just finished with
+		Collect(frames.GetWriteBuffer());
+	}
+	else
+	{
+		Draw(frame);
+		drawn.store(frame.Frame, std::memory_order_release);
+		Collect(frame);
+	}
+
+	high_resolution_clock::time_point end = high_resolution_clock::now();
+	if (submitted > 1)
+	{
+		stats.FrameMs = MsBetween(lastSubmit, end);
+		stats.SimulationMs = MsBetween(lastSubmit, start);
+	}
+	stats.WaitMs = waitMs;
+	stats.Frame = submitted;
+	lastSubmit = end;
+}
+
+void FramePipeline::WaitForIdle()
+{
+	WaitFor(wakeSimulation, [this]() { return drawn.load(std::memory_order_acquire) == submitted; });
+}
+
+void FramePipeline::SetPipelined(bool pipelined)
+{
+	if (pipelined == this->pipelined)
+		return;
+
+	// Whichever thread draws next has to see everything the last one did
+	WaitForIdle();
+	this->pipelined = pipelined;
+	stats.Pipelined = pipelined;
+}
+
+bool FramePipeline::IsPipelined()
+{
+	return pipelined;
+}
+
+FramePipelineStats FramePipeline::GetStats()
+{
+	FramePipelineStats current = stats;
+	unsigned int count = (std::min)(latencyCount, (unsigned int)FRAME_PIPELINE_LATENCY_FRAMES);
+	current.AverageLatencyMs = 0.0;
+	current.MaxLatencyMs = 0.0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		current.AverageLatencyMs += latencies[i];
+		current.MaxLatencyMs = (std::max)(current.MaxLatencyMs, latencies[i]);
+	}
+	if (count > 0)
+		current.AverageLatencyMs /= count;
+	return current;
+}
+
+void FramePipeline::Draw(FrameSnapshot& frame)
+{
+	high_resolution_clock::time_point start = high_resolution_clock::now();
+	render(frame);
+	high_resolution_clock::time_point end = high_resolution_clock::now();
+
+	frame.RenderMs = MsBetween(start, end);
+	frame.LatencyMs = MsBetween(frame.InputTime, end);
+	frame.PresentTime = end;
+	frame.Drawn = true;
+}
+
+// Takes what drawing a frame found out, once it's back on this thread
+void FramePipeline::Collect(FrameSnapshot& frame)
+{
+	if (!frame.Drawn || frame.Frame <= lastCollected)
+		return;
+	lastCollected = frame.Frame;
+
+	stats.RenderMs = frame.RenderMs;
+	stats.LatencyMs = frame.LatencyMs;
+	latencies[latencyCount % FRAME_PIPELINE_LATENCY_FRAMES] = frame.LatencyMs;
+	latencyCount++;
+}
+
+void FramePipeline::RenderLoop()
+{
+	while (true)
+	{
+		WaitFor(wakeRenderer, [this]() { return frames.HasFresh() || stopping.load(std::memory_order_acquire); });
+		if (stopping.load(std::memory_order_acquire))
+			return;
+
+		// Taking it lets simulation carry on with the next one
+		frames.Acquire();
+		Wake(wakeSimulation);
+
+		FrameSnapshot& frame = frames.GetReadBuffer();
+		Draw(frame);
+		drawn.store(frame.Frame, std::memory_order_release);
+		Wake(wakeSimulation);
+	}
+}
+
+// Sleepers check their predicate with the mutex held, so taking it here means they've either
+// seen the change already or are waiting and will get the notification
+void FramePipeline::Wake(std::condition_variable& condition)
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	condition.notify_all();
+}
+
+FramePipelineBenchmark FramePipeline::Benchmark(double simulationMs, double renderMs, unsigned int frameCount)
+{
+	FramePipelineBenchmark result = {};
+	result.Frames = frameCount;
+	result.SimulationMs = simulationMs;
+	result.RenderMs = renderMs;
+	result.InOrder = true;
+	if (frameCount == 0)
+		return result;
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		// Each frame carries its own number in the camera, so anything drawn from a mixed up snapshot shows
+		unsigned int lastDrawn = 0;
+		bool inOrder = true;
+		FramePipeline pipeline([&](FrameSnapshot& frame)
+		{
+			Spin(renderMs);
+			if (frame.Frame != lastDrawn + 1 || frame.Camera.Position.x != (float)frame.Frame)
+				inOrder = false;
+			lastDrawn = frame.Frame;
+		}, pass == 1);
+
+		double maxLatencyMs = 0.0;
+		high_resolution_clock::time_point start = high_resolution_clock::now();
+		for (unsigned int i = 0; i < frameCount; i++)
+		{
+			FrameSnapshot& frame = pipeline.GetSnapshot();
+			frame.InputTime = high_resolution_clock::now();
+			Spin(simulationMs);
+			frame.Camera.Position.x = (float)(i + 1);
+			pipeline.Submit();
+			maxLatencyMs = (std::max)(maxLatencyMs, pipeline.GetStats().MaxLatencyMs);
+		}
+		pipeline.WaitForIdle();
+		double frameMs = MsBetween(start, high_resolution_clock::now()) / frameCount;
+
+		if (!inOrder || lastDrawn != frameCount)
+			result.InOrder = false;
+		if (pass == 0)
+		{
+			result.SerialFrameMs = frameMs;
+			result.SerialMaxLatencyMs = maxLatencyMs;
+		}
+		else
+		{
+			result.PipelinedFrameMs = frameMs;
+			result.PipelinedMaxLatencyMs = maxLatencyMs;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Camera.h"
+#include "EntityManager.h"
+#include "Lights.h"
+#include "MagicMirrorManager.h"
+#include "TripleBuffer.h"
+#include "ImGui/imgui.h"
+
+// Frames input latency is averaged (and its worst case taken) over
+#define FRAME_PIPELINE_LATENCY_FRAMES 64
+
+// Times either thread checks for the other before going to sleep
+#define FRAME_PIPELINE_SPIN 64
+
+// --------------------------------------------------------
+// Everything one frame is drawn from, copied out at the end
+// of its simulation so the next one can start straight away
+//
+// Nothing in here may point at anything the simulation
+// changes, apart from EntitySnapshot::Entity (for calling
+// Draw() on). Meshes and materials are held on to, so they
+// outlive the frame even if the game lets go of them.
+// --------------------------------------------------------
+struct FrameSnapshot
+{
+	unsigned int Frame;		// Counting from 1, set by FramePipeline::Submit()
+	std::chrono::high_resolution_clock::time_point InputTime;	// When the input this frame was simulated from was read
+	unsigned int Width;
+	unsigned int Height;
+
+	CameraSnapshot Camera;
+	std::vector<EntitySnapshot> Entities;
+	std::vector<EntityHandle> Handles;	// Alongside Entities, for handing their results back
+	MirrorSnapshot Mirrors[2];
+	std::vector<Light> Lights;
+	DirectX::XMFLOAT3 Ambient;
+	DirectX::XMFLOAT4X4 LightView;
+	DirectX::XMFLOAT4X4 LightProjection;
+	bool Defragment;	// Defragment the geometry pool before drawing (it needs the device context)
+
+	// Filled in by whoever draws it, and still there when it comes back round to be written again
+	std::vector<EntityDrawResult> Results;	// Alongside Entities
+	bool Drawn;
+	double RenderMs;
+	double LatencyMs;	// From InputTime to presenting
+	std::chrono::high_resolution_clock::time_point PresentTime;
+
+	FrameSnapshot();
+	FrameSnapshot(const FrameSnapshot& other) = delete;
+	FrameSnapshot& operator=(const FrameSnapshot& other) = delete;
+
+	// Copies ImGui's output for the frame, since ImGui starts on the next one while this one is drawn.
+	// Draw lists are reused from frame to frame.
+	void CopyUI(ImDrawData* drawData);
+	ImDrawData* GetUI();
+
+private:
+
+	ImDrawData ui;
+	std::vector<std::unique_ptr<ImDrawList>> uiLists;
+	std::vector<ImDrawList*> uiListPointers;
+};
+
+struct FramePipelineStats
+{
+	bool Pipelined;
+	unsigned int Frame;			// Submitted so far
+	double FrameMs;				// From one Submit() to the next
+	double SimulationMs;		// Of that, not spent waiting in Submit() (or drawing, when it's not pipelined)
+	double WaitMs;				// Simulation waiting for the render thread to take the last frame
+	double RenderMs;
+	double LatencyMs;			// Input to present, for the last frame drawn
+	double AverageLatencyMs;	// Over the last FRAME_PIPELINE_LATENCY_FRAMES frames
+	double MaxLatencyMs;
+};
+
+// A made up game loop with a fixed amount of work for each side, run both ways
+struct FramePipelineBenchmark
+{
+	unsigned int Frames;
+	double SimulationMs;		// Per frame, as asked for
+	double RenderMs;
+	double SerialFrameMs;		// Per frame, as measured
+	double PipelinedFrameMs;
+	double SerialMaxLatencyMs;
+	double PipelinedMaxLatencyMs;
+	bool InOrder;				// Every frame was drawn once, in order, from what was submitted
+};
+
+// --------------------------------------------------------
+// Draws each frame on a render thread while the next one
+// is simulated, or right away on the same thread, so the
+// two can be compared
+//
+// - The game fills in GetSnapshot() at the end of a frame's
+//   simulation and Submit()s it. Snapshots go through a
+//   TripleBuffer, so handing one over never takes a lock.
+// - Submit() waits for the render thread to take the frame
+//   before it returns, which it does as soon as it's done
+//   with the last one, so simulation is never more than a
+//   frame ahead. That keeps input latency to about two frames
+//   at worst (one pipelined against the other), and every
+//   frame is drawn.
+// - The render thread is the only one using the device
+//   context while pipelined, so anything else that needs it
+//   has to WaitForIdle() first (like resizing)
+// - Only the thread that makes the pipeline can use it
+// --------------------------------------------------------
+class FramePipeline
+{
+public:
+
+	// render(frame) draws and presents a frame, on the render thread when pipelined, otherwise in Submit()
+	FramePipeline(std::function<void(FrameSnapshot&)> render, bool pipelined = true);
+	~FramePipeline();
+	FramePipeline(const FramePipeline& other) = delete;
+	FramePipeline& operator=(const FramePipeline& other) = delete;
+
+	// The snapshot to fill in with the frame that was just simulated. It still has whatever it had the
+	// last time round (so it doesn't have to allocate), including the results of drawing it.
+	FrameSnapshot& GetSnapshot();
+
+	// Hands the snapshot over to be drawn, then (when pipelined) waits for the render thread to take it
+	void Submit();
+
+	// Waits until everything submitted has been drawn
+	void WaitForIdle();
+
+	// Waits until everything submitted has been drawn, then switches
+	void SetPipelined(bool pipelined);
+	bool IsPipelined();
+
+	FramePipelineStats GetStats();
+
+	// Runs a number of frames through a pipeline that spins for the given times to simulate and draw each
+	static FramePipelineBenchmark Benchmark(double simulationMs, double renderMs, unsigned int frameCount);
+
+private:
+
+	std::function<void(FrameSnapshot&)> render;
+	TripleBuffer<FrameSnapshot> frames;
+	bool pipelined;
+	unsigned int submitted;
+
+	std::thread renderThread;
+	std::atomic<bool> stopping;
+	std::atomic<unsigned int> drawn;	// The last frame the render thread finished
+
+	// Either thread sleeps here, after spinning, until the other has done its part
+	std::mutex sleepMutex;
+	std::condition_variable wakeRenderer;
+	std::condition_variable wakeSimulation;
+
+	// Only touched by the thread that made the pipeline
+	FramePipelineStats stats;
+	std::chrono::high_resolution_clock::time_point lastSubmit;
+	unsigned int lastCollected;
+	double latencies[FRAME_PIPELINE_LATENCY_FRAMES];
+	unsigned int latencyCount;
+
+	void Draw(FrameSnapshot& frame);
+	void Collect(FrameSnapshot& frame);
+	void RenderLoop();
+
+	// Spins, then sleeps on the condition, until the predicate's true
+	template <class Predicate>
+	void WaitFor(std::condition_variable& condition, Predicate predicate)
+	{
+		for (int spin = 0; spin < FRAME_PIPELINE_SPIN; spin++)
+		{
+			if (predicate())
+				return;
+			std::this_thread::yield();
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		condition.wait(lock, predicate);
+	}
+
+	void Wake(std::condition_variable& condition);
+};
@@ -2,18 +2,20 @@
 #include "Vertex.h"
 #include "Input.h"
 #include "Helpers.h"
+#include "VertexCompression.h"
+#include "TransformSystem.h"
 
 // This code assumes files are in "ImGui" subfolder!
 // Adjust as necessary for your own folder structure
 #include "ImGui/imgui.h"
 #include "ImGui/imgui_impl_dx11.h"
 #include "ImGui/imgui_impl_win32.h"
-#include "WICTextureLoader.h"
 
 // Needed for a helper function to load pre-compiled shader files
 #pragma comment(lib, "d3dcompiler.lib")
 #include <d3dcompiler.h>
 #include <iostream>
+#include <algorithm>
 
 // For the DirectX Math library
 using namespace DirectX;
@@ -48,6 +50,10 @@ Game::Game(HINSTANCE hInstance)
 	lightProj = {};
 	shadowMapRes = 0;
 	ambientLight = {};
+	firstFrameMs = 0.0;
+	assetThreads = 0;
+	defragmentRequested = false;
+	pipelinedRendering = true;
 }
 
 // --------------------------------------------------------
@@ -57,15 +63,14 @@ Game::Game(HINSTANCE hInstance)
 // --------------------------------------------------------
 Game::~Game()
 {
+	// The render thread has to finish with everything below first
+	framePipeline.reset();
+
 	// ImGui clean up
 	ImGui_ImplDX11_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
 
-	// Clean up the game entities (as these were made on the heap)
-	for (GameEntity* obj : gameObjects)
-		delete obj;
-
 	// Call Release() on any Direct3D objects made within this class
 	// - Note: this is unnecessary for D3D objects stored in ComPtrs
 }
@@ -76,6 +81,18 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	// Assets are loaded on other threads while the rest is set up (see AssetLoader),
+	// and startup is timed from here until the first frame is presented
+	initTime = std::chrono::high_resolution_clock::now();
+
+	// Before the loader, which puts the context's thread protection back how it found it,
+	// and the registry needs it left on (see MeshRegistry)
+	meshRegistry = std::make_shared<MeshRegistry>(device, context);
+	AssetLoader loader(device, context);
+	jobSystem = std::make_shared<JobSystem>();
+	systems = std::make_shared<SystemScheduler>(&EcsWorld::GetInstance(), jobSystem.get());
+	CoolObject::AddSystems(*systems);
+
 	// Initialize ImGui itself & platform/renderer backends
 	IMGUI_CHECKVERSION();
 	ImGui::CreateContext();
@@ -186,9 +203,18 @@ void Game::Init()
 	// Helper methods for loading shaders, creating some basic
 	// geometry to draw and some simple camera matrices.
 	//  - You'll be expanding and/or replacing these later
-	LoadShaders();
+	std::shared_future<void> shadersLoaded = LoadShaders(loader);
 
-	CreateGeometry();
+	CreateGeometry(loader, shadersLoaded);
+
+	// When each asset was ready, for tracking down slow startups. The loader waits for
+	// everything when it goes at the end of this anyway, so waiting here costs nothing.
+	loader.WaitForAll();
+	assetTimings = loader.GetTimings();
+	assetThreads = loader.GetThreadCount();
+#if defined(DEBUG) || defined(_DEBUG)
+	loader.PrintTimings();
+#endif
 	
 	// Set initial graphics API state
 	//  - These settings persist until we change them
@@ -200,6 +226,9 @@ void Game::Init()
 		// Essentially: "What kind of shape should the GPU draw with our vertices?"
 		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 	}
+
+	// Last, since the render thread can use the context from here on
+	framePipeline = std::make_shared<FramePipeline>([this](FrameSnapshot& frame) { RenderFrame(frame); }, pipelinedRendering);
 }
 
 // --------------------------------------------------------
@@ -209,20 +238,45 @@ void Game::Init()
 // - Input Layout creation is done here because it must 
 //    be verified against vertex shader byte code
 // - We'll have that byte code already loaded below
+// - Each shader is loaded by its own job, which fills in
+//    its own member, and the returned future is ready once
+//    they all are
 // --------------------------------------------------------
-void Game::LoadShaders()
+std::shared_future<void> Game::LoadShaders(AssetLoader& loader)
 {
+	std::vector<std::shared_future<void>> loads;
+
 	// Make the shaders with SimpleShader (to see how to make them normally, check previous versions of this project)
-	vertexShader = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"VertexShader.cso").c_str());
-	pixelShader = std::make_shared<SimplePixelShader>(device, context, FixPath(L"PixelShader_PBR.cso").c_str());
+	loads.push_back(loader.Load<void>(L"VertexShader.cso", [this]() {
+		vertexShader = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"VertexShader.cso").c_str()); }));
 
-	customPS = std::make_shared<SimplePixelShader>(device, context, FixPath(L"CustomPS.cso").c_str());
+	// Reflection would give these 32-bit float inputs, so they get
+	// input layouts matching the packed formats instead
+	loads.push_back(loader.Load<void>(L"VertexShader_Compact.cso", [this]() {
+		compactVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"VertexShader_Compact.cso").c_str(),
+			VertexCompression::CreateInputLayout(VERTEX_FORMAT_QUANTIZED, FixPath(L"VertexShader_Compact.cso").c_str(), device), false); }));
+	loads.push_back(loader.Load<void>(L"PixelShader_PBR.cso", [this]() {
+		pixelShader = std::make_shared<SimplePixelShader>(device, context, FixPath(L"PixelShader_PBR.cso").c_str()); }));
 
-	skyVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"VertexShader_Skybox.cso").c_str());
-	skyPS = std::make_shared<SimplePixelShader>(device, context, FixPath(L"PixelShader_Skybox.cso").c_str());
+	loads.push_back(loader.Load<void>(L"CustomPS.cso", [this]() {
+		customPS = std::make_shared<SimplePixelShader>(device, context, FixPath(L"CustomPS.cso").c_str()); }));
+
+	loads.push_back(loader.Load<void>(L"VertexShader_Skybox.cso", [this]() {
+		skyVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"VertexShader_Skybox.cso").c_str()); }));
+	loads.push_back(loader.Load<void>(L"PixelShader_Skybox.cso", [this]() {
+		skyPS = std::make_shared<SimplePixelShader>(device, context, FixPath(L"PixelShader_Skybox.cso").c_str()); }));
 
 	// Create shadow vertex shader
-	shadowVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"VS_ScreenPosition.cso").c_str());
+	loads.push_back(loader.Load<void>(L"VS_ScreenPosition.cso", [this]() {
+		shadowVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"VS_ScreenPosition.cso").c_str()); }));
+	loads.push_back(loader.Load<void>(L"VS_ScreenPosition_Compact.cso", [this]() {
+		shadowCompactVS = std::make_shared<SimpleVertexShader>(device, context, FixPath(L"VS_ScreenPosition_Compact.cso").c_str(),
+			VertexCompression::CreateInputLayout(VERTEX_FORMAT_QUANTIZED, FixPath(L"VS_ScreenPosition_Compact.cso").c_str(), device), false); }));
+
+	// Done once every shader is
+	return loader.Load<void>(L"Shaders", [loads]() {
+		for (const std::shared_future<void>& load : loads)
+			load.get(); });
 }
 
 
@@ -230,7 +284,7 @@ void Game::LoadShaders()
 // --------------------------------------------------------
 // Creates the geometry we're going to draw - a single triangle for now
 // --------------------------------------------------------
-void Game::CreateGeometry()
+void Game::CreateGeometry(AssetLoader& loader, std::shared_future<void> shadersLoaded)
 {
 	// Create some temporary variables to represent colors
 	// - Not necessary, just makes things more readable
@@ -240,15 +294,65 @@ void Game::CreateGeometry()
 	XMFLOAT4 black  = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
 	XMFLOAT4 white  = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 
-	// Create the meshes
-	meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/sphere.obj").c_str(), device, context));
-	meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/torus.obj").c_str(), device, context));
-	meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cylinder.obj").c_str(), device, context));
-	meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/helix.obj").c_str(), device, context));
-	meshes.push_back(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/quad.obj").c_str(), device, context));
+	// Everything is queued on the loader first, biggest first, then picked up below as it's needed.
+	// Nothing waits on anything queued after it, so no job can be stuck behind one waiting on it.
+	std::shared_future<std::shared_ptr<Terrain>> terrainLoad = loader.Load<std::shared_ptr<Terrain>>(L"Terrain", [this]() {
+		return std::make_shared<Terrain>(500, 500, device, context); });
+
+	// Create the meshes (with quantized vertices, so their materials use compactVS), all
+	// sharing one pair of buffers so they can be drawn without rebinding them
+	geometryPool = std::make_shared<GeometryPool>(device, context, VERTEX_FORMAT_QUANTIZED, 1 << 16, 1 << 18);
+	const wchar_t* meshNames[] = { L"sphere", L"torus", L"cylinder", L"helix", L"quad" };
+	std::vector<std::shared_future<std::shared_ptr<Mesh>>> meshLoads;
+	for (const wchar_t* name : meshNames)
+	{
+		std::wstring path = FixPath(std::wstring(L"../../Assets/Models/") + name + L".obj");
+		meshLoads.push_back(loader.Load<std::shared_ptr<Mesh>>(path, [this, path]() {
+			return meshRegistry->Get(path, true, VERTEX_FORMAT_QUANTIZED, MESH_RESIDENCY_NONE, geometryPool); }));
+	}
+
+	std::wstring cubePath = FixPath(L"../../Assets/Models/cube.obj");
+	std::shared_future<std::shared_ptr<Mesh>> cubeLoad = loader.Load<std::shared_ptr<Mesh>>(cubePath, [this, cubePath]() {
+		return meshRegistry->Get(cubePath); });
+
+	// Create materials, each waiting on its shaders and four textures (the last is for the terrain)
+	const wchar_t* textureNames[] = { L"bronze", L"scratched", L"cobblestone", L"rough" };
+	std::vector<std::shared_future<std::shared_ptr<Material>>> materialLoads;
+	for (int i = 0; i < 4; i++)
+	{
+		std::wstring path = FixPath(std::wstring(L"../../Assets/Textures/") + textureNames[i]);
+		std::shared_future<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> albedo = loader.LoadTexture(path + L"_albedo.png");
+		std::shared_future<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> metal = loader.LoadTexture(path + L"_metal.png");
+		std::shared_future<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> normals = loader.LoadTexture(path + L"_normals.png");
+		std::shared_future<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> roughness = loader.LoadTexture(path + L"_roughness.png");
+
+		bool terrain = i == 3;
+		materialLoads.push_back(loader.Load<std::shared_ptr<Material>>(std::wstring(textureNames[i]) + L" material",
+			[this, white, terrain, shadersLoaded, albedo, metal, normals, roughness]()
+		{
+			shadersLoaded.get();
+			std::shared_ptr<Material> mat = std::make_shared<Material>(white, 0.0f, 0.0f, terrain ? vertexShader : compactVS, pixelShader);
+			mat->AddTextureSRV("AlbedoMap", albedo.get());
+			mat->AddTextureSRV("MetalnessMap", metal.get());
+			mat->AddTextureSRV("NormalMap", normals.get());
+			mat->AddTextureSRV("RoughnessMap", roughness.get());
+			return mat;
+		}));
+	}
 
-	// Create the texture ptr for later use
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	// The sky's faces load separately, then get copied into one cube map
+	const wchar_t* faceNames[] = { L"right", L"left", L"up", L"down", L"front", L"back" };
+	std::vector<std::shared_future<Microsoft::WRL::ComPtr<ID3D11Texture2D>>> faceLoads;
+	for (const wchar_t* name : faceNames)
+		faceLoads.push_back(loader.LoadTextureResource(FixPath(std::wstring(L"../../Assets/Textures/Clouds Blue/") + name + L".png")));
+	std::shared_future<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> skyLoad =
+		loader.Load<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>(L"Sky cube map", [this, faceLoads]()
+	{
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> faces[6];
+		for (int i = 0; i < 6; i++)
+			faces[i] = faceLoads[i].get();
+		return Skybox::CreateCubemap(faces, device, context);
+	});
 
 	// Create sampler description
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerState;
@@ -263,72 +367,43 @@ void Game::CreateGeometry()
 	// Create the sampler state from the description
 	device->CreateSamplerState(&samplerDesc, samplerState.GetAddressOf());
 
-	// Create materials
+	// Now wait for what the objects need
+	for (std::shared_future<std::shared_ptr<Mesh>>& load : meshLoads)
+		meshes.push_back(load.get());
+
 	std::vector<std::shared_ptr<Material>> mats;
-	mats.push_back(std::make_shared<Material>(white, 0.0f, 0.0f, vertexShader, pixelShader));
-	mats.push_back(std::make_shared<Material>(white, 0.0f, 0.0f, vertexShader, pixelShader));
-	mats.push_back(std::make_shared<Material>(white, 0.0f, 0.0f, vertexShader, pixelShader));
-	mats.push_back(std::make_shared<Material>(white, 0.0f, 0.0f, vertexShader, pixelShader));
+	for (std::shared_future<std::shared_ptr<Material>>& load : materialLoads)
+		mats.push_back(load.get());
 	// weird material
+	shadersLoaded.get();
 	mats.push_back(std::make_shared<Material>(white, 0.1f, 0.0f, vertexShader, customPS));
-
-	// Mat 0
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/bronze_albedo.png").c_str(), 0, srv.GetAddressOf());
-	mats[0]->AddTextureSRV("AlbedoMap", srv);
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/bronze_metal.png").c_str(), 0, srv.GetAddressOf());
-	mats[0]->AddTextureSRV("MetalnessMap", srv);
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/bronze_normals.png").c_str(), 0, srv.GetAddressOf());
-	mats[0]->AddTextureSRV("NormalMap", srv);
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/bronze_roughness.png").c_str(), 0, srv.GetAddressOf());
-	mats[0]->AddTextureSRV("RoughnessMap", srv);
-
-	// Mat 1
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/scratched_albedo.png").c_str(), 0, srv.GetAddressOf());
-	mats[1]->AddTextureSRV("AlbedoMap", srv);
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/scratched_metal.png").c_str(), 0, srv.GetAddressOf());
-	mats[1]->AddTextureSRV("MetalnessMap", srv);
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/scratched_normals.png").c_str(), 0, srv.GetAddressOf());
-	mats[1]->AddTextureSRV("NormalMap", srv);
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/scratched_roughness.png").c_str(), 0, srv.GetAddressOf());
-	mats[1]->AddTextureSRV("RoughnessMap", srv);
-
-	// Mat 2
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/cobblestone_albedo.png").c_str(), 0, srv.GetAddressOf());
-	mats[2]->AddTextureSRV("AlbedoMap", srv);
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/cobblestone_metal.png").c_str(), 0, srv.GetAddressOf());
-	mats[2]->AddTextureSRV("MetalnessMap", srv);
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/cobblestone_normals.png").c_str(), 0, srv.GetAddressOf());
-	mats[2]->AddTextureSRV("NormalMap", srv);
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/cobblestone_roughness.png").c_str(), 0, srv.GetAddressOf());
-	mats[2]->AddTextureSRV("RoughnessMap", srv);
-
-	// Mat 3
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/rough_albedo.png").c_str(), 0, srv.GetAddressOf());
-	mats[3]->AddTextureSRV("AlbedoMap", srv);
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/rough_normals.png").c_str(), 0, srv.GetAddressOf());
-	mats[3]->AddTextureSRV("NormalMap", srv);
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/rough_metal.png").c_str(), 0, srv.GetAddressOf());
-	mats[3]->AddTextureSRV("MetalnessMap", srv);
-	CreateWICTextureFromFile(device.Get(), context.Get(), FixPath(L"../../Assets/Textures/rough_roughness.png").c_str(), 0, srv.GetAddressOf());
-	mats[3]->AddTextureSRV("RoughnessMap", srv);
 	
 	// Add default sampler and other maps for each material
 	for (std::shared_ptr<Material> mat : mats)
 		mat->AddSampler("SamplerOptions", samplerState);
 
 	// Create the game objects
-	gameObjects.push_back(new GameEntity(meshes[0], mats[0]));
-	gameObjects.push_back(new GameEntity(meshes[1], mats[1]));
+	entityManager = std::make_shared<EntityManager>();
+	entityManager->Spawn<GameEntity>(meshes[0], mats[0]);
+	entityManager->Spawn<GameEntity>(meshes[1], mats[1]);
+
+	entityManager->Spawn<GameEntity>(meshes[2], mats[2]);
+	entityManager->Spawn<GameEntity>(meshes[2], mats[2]);
+	entityManager->Spawn<GameEntity>(meshes[2], mats[2]);
+	entityManager->Spawn<GameEntity>(meshes[2], mats[2]);
 
-	gameObjects.push_back(new GameEntity(meshes[2], mats[2]));
-	gameObjects.push_back(new GameEntity(meshes[2], mats[2]));
-	gameObjects.push_back(new GameEntity(meshes[2], mats[2]));
-	gameObjects.push_back(new GameEntity(meshes[2], mats[2]));
+	entityManager->Spawn<GameEntity>(meshes[3], mats[0]);
 
-	gameObjects.push_back(new GameEntity(meshes[3], mats[0]));
+	entityManager->Spawn<GameEntity>(meshes[0], mats[1]);
+	entityManager->Spawn<TerrainEntity>(terrainLoad.get(), mats[3], XMFLOAT2(2.5f, 2.5f)); // cool terrain entity
 
-	gameObjects.push_back(new GameEntity(meshes[0], mats[1]));
-	gameObjects.push_back(new TerrainEntity(std::make_shared<Terrain>(500, 500, device, context), mats[3], XMFLOAT2(2.5f, 2.5f))); // cool terrain entity
+	// Nothing has been destroyed yet, so these are in the order they were spawned
+	const std::vector<GameEntity*>& gameObjects = entityManager->GetEntities();
+
+	// Only ones with UpdateEnabled set are updated, every frame until they're told otherwise
+	updateScheduler = std::make_shared<UpdateScheduler>(entityManager.get());
+	for (unsigned int i = 0; i < entityManager->GetCount(); i++)
+		updateScheduler->Add(entityManager->GetHandle(i));
 	
 	// Create the mirror manager (this creates the mirrors and sets up all the backend)
 	mirrorManager = std::make_shared<MagicMirrorManager>(activeCam, device, context);
@@ -355,15 +430,15 @@ void Game::CreateGeometry()
 	gameObjects[8]->GetTransform()->SetScale(1.0f, 10.0f,1.0f);
 	gameObjects[8]->SetTextureUniformScale(0.1f);
 
+	// Everything starts at the top of the hierarchy, parents are picked in the UI
+	transformHierarchy = std::make_shared<TransformHierarchy>();
+	for (GameEntity* obj : gameObjects)
+		transformHierarchy->Add(obj->GetTransform());
+	for (int i = 0; i < 2; i++)
+		transformHierarchy->Add(mirrorManager->GetMirror(i)->GetTransform());
+
 	// Create the skybox
-	skybox = std::make_shared<Skybox>(std::make_shared<Mesh>(FixPath(L"../../Assets/Models/cube.obj").c_str(), device, context), samplerState, device, context, skyVS, skyPS,
-		FixPath(L"../../Assets/Textures/Clouds Blue/right.png").c_str(),
-		FixPath(L"../../Assets/Textures/Clouds Blue/left.png").c_str(),
-		FixPath(L"../../Assets/Textures/Clouds Blue/up.png").c_str(),
-		FixPath(L"../../Assets/Textures/Clouds Blue/down.png").c_str(),
-		FixPath(L"../../Assets/Textures/Clouds Blue/front.png").c_str(),
-		FixPath(L"../../Assets/Textures/Clouds Blue/back.png").c_str()
-		);
+	skybox = std::make_shared<Skybox>(cubeLoad.get(), samplerState, device, skyVS, skyPS, skyLoad.get());
 }
 
 
@@ -374,6 +449,10 @@ void Game::CreateGeometry()
 // --------------------------------------------------------
 void Game::OnResize()
 {
+	// The render thread can't be drawing to anything that's about to be replaced
+	if (framePipeline)
+		framePipeline->WaitForIdle();
+
 	// Handle base-level DX resize stuff
 	DXCore::OnResize();
 
@@ -388,18 +467,29 @@ void Game::OnResize()
 // --------------------------------------------------------
 void Game::Update(float deltaTime, float totalTime)
 {
-	for (GameEntity* gameObj : gameObjects)
-		gameObj->Update(deltaTime, context);
+	// Input was read just before this, and the frame's latency is counted from here
+	inputTime = std::chrono::high_resolution_clock::now();
+
+	// Whichever entities are due an update this frame, by how far they are from the camera for those that care.
+	// Anything added during this waits until next frame, and anything destroyed stays until the end of it.
+	updateScheduler->Run(deltaTime, totalTime, activeCam->GetTransform().GetPosition(), context);
+
+	// Then everything that's been moved to systems, in parallel where they don't touch the same components
+	systems->Run(deltaTime);
 
 	activeCam->Update(deltaTime);
-	activeCam->UpdateViewMatrix();
 
-	// Update mirror view matrices & cams
-	mirrorManager->Update(deltaTime, context, activeCam);
+	// Meshes may have stopped being used, which can free up some of the budget
+	meshRegistry->EnforceBudget();
+	activeCam->UpdateViewMatrix();
 
 	// Update UI
 	this->UpdateUI(deltaTime);
 
+	// Last, so everything that moved this frame (including edits in the UI) has moved its
+	// children before the frame's drawn and anything (like the mirrors) looks at world matrices
+	transformHierarchy->Update();
+
 	// Example input checking: Quit if the escape key is pressed
 	if (Input::GetInstance().KeyDown(VK_ESCAPE))
 		Quit();
@@ -430,6 +520,58 @@ void Game::UpdateUI(float deltaTime)
 	ImGui::Text("FPS: %f", ImGui::GetIO().Framerate);
 	ImGui::Text("Window Width: %i", this->windowWidth);
 	ImGui::Text("Window Height: %i", this->windowHeight);
+	ImGui::Text("Time to First Frame: %.2f ms", firstFrameMs);
+
+	// Work adds up every asset's time (including any spent waiting on the assets it needs),
+	// so it comes out more than the total when threads overlap
+	double assetWorkMs = 0.0;
+	double assetsReadyMs = 0.0;
+	for (const AssetLoadTiming& timing : assetTimings)
+	{
+		assetWorkMs += timing.Finished - timing.Started;
+		assetsReadyMs = (std::max)(assetsReadyMs, timing.Finished);
+	}
+	if (ImGui::TreeNode("Asset Load Times", "Assets: %zu ready after %.2f ms, %.2f ms of work on %u thread(s) (%.2fx parallel)",
+		assetTimings.size(), assetsReadyMs, assetWorkMs, assetThreads, assetsReadyMs > 0.0 ? assetWorkMs / assetsReadyMs : 0.0))
+	{
+		for (const AssetLoadTiming& timing : assetTimings)
+		{
+			ImGui::Text("%8.2f ms  %s (waited %.2f ms, took %.2f ms on thread %u)", timing.Finished, WideToNarrow(timing.Name).c_str(),
+				timing.Started - timing.Queued, timing.Finished - timing.Started, timing.Thread);
+		}
+		ImGui::TreePop();
+	}
+	ImGui::Text("World Matrices Rebuilt: %u (since the last frame)", Transform::TakeMatrixBuildCount());
+
+	TransformHierarchyStats hierarchyStats = transformHierarchy->GetStats();
+	ImGui::Text("Hierarchy: %u transforms, %u deep, %u propagated last frame", hierarchyStats.Nodes, hierarchyStats.Depth, hierarchyStats.Recomputed);
+
+	const std::vector<GameEntity*>& gameObjects = entityManager->GetEntities();
+	EntityManagerStats entityStats = entityManager->GetStats();
+	ImGui::Text("Entities: %u (%u being destroyed), %u slabs with room for %u", entityStats.Live, entityStats.PendingDestroy, entityStats.Slabs, entityStats.SlabCapacity);
+
+	UpdateSchedulerStats updateStats = updateScheduler->GetStats();
+	ImGui::Text("Updates: %u of %u entities, %u skipped (%u disabled, %u sleeping, %u not due), %.3f ms",
+		updateStats.Updated, updateStats.Entities, updateStats.Skipped, updateStats.Disabled, updateStats.Sleeping,
+		updateStats.NotDue, updateStats.LastRunMs);
+	ImGui::Text("Timers: %u waiting, %u fired (last frame)", updateStats.TimersPending, updateStats.TimersFired);
+
+	SystemSchedulerStats systemStats = systems->GetStats();
+	ImGui::Text("Systems: %u (%u dependencies), %u chunks, %.3f ms on %u threads", systemStats.Systems, systemStats.Dependencies,
+		systemStats.Chunks, systemStats.LastRunMs, jobSystem->GetThreadCount());
+#if defined(DEBUG) || defined(_DEBUG)
+	ImGui::Text("System conflicts: %u, undeclared access: %u (last frame)", systemStats.Conflicts, systemStats.AccessViolations);
+#endif
+
+	// Drawing on the render thread while the next frame's simulated, or straight after it, to compare
+	ImGui::Checkbox("Pipelined Rendering", &pipelinedRendering);
+	if (pipelinedRendering && !framePipeline->IsPipelined())
+		ImGui::Text("(Not while in exclusive fullscreen)");
+	FramePipelineStats frameStats = framePipeline->GetStats();
+	ImGui::Text("Frame: %.2f ms (simulation %.2f ms, waiting %.2f ms), render %.2f ms",
+		frameStats.FrameMs, frameStats.SimulationMs, frameStats.WaitMs, frameStats.RenderMs);
+	ImGui::Text("Input Latency: %.2f ms (average %.2f ms, worst %.2f ms over %d frames)",
+		frameStats.LatencyMs, frameStats.AverageLatencyMs, frameStats.MaxLatencyMs, FRAME_PIPELINE_LATENCY_FRAMES);
 
 	// Camera details
 	if (ImGui::Button("Next Camera", ImVec2(150, 25)))
@@ -442,6 +584,56 @@ void Game::UpdateUI(float deltaTime)
 		camIndex = (--camIndex) % cams.size();
 		activeCam = cams[camIndex];
 	}
+
+	// Meshlet culling, totalled over every object's last draw
+	MeshletCullStats culled = {};
+	for (int i = 0; i < gameObjects.size(); i++)
+	{
+		MeshletCullStats stats = gameObjects[i]->GetLastCullStats();
+		culled.Meshlets += stats.Meshlets;
+		culled.Triangles += stats.Triangles;
+		culled.BackfaceCulledTriangles += stats.BackfaceCulledTriangles;
+		culled.FrustumCulledTriangles += stats.FrustumCulledTriangles;
+	}
+	if (culled.Triangles > 0)
+	{
+		ImGui::Text("Meshlets: %u (%u triangles)", culled.Meshlets, culled.Triangles);
+		ImGui::Text("Culled: %.1f%% back-facing, %.1f%% off screen",
+			100.0f * culled.BackfaceCulledTriangles / culled.Triangles, 100.0f * culled.FrustumCulledTriangles / culled.Triangles);
+	}
+
+	// Geometry memory, counting each mesh once however many objects share it
+	std::vector<Mesh*> countedMeshes;
+	MeshMemoryUsage memory = {};
+	for (int i = 0; i < gameObjects.size(); i++)
+	{
+		Mesh* mesh = gameObjects[i]->GetMesh().get();
+		if (!mesh || std::find(countedMeshes.begin(), countedMeshes.end(), mesh) != countedMeshes.end())
+			continue;
+
+		countedMeshes.push_back(mesh);
+		MeshMemoryUsage usage = mesh->GetMemoryUsage();
+		memory.CpuBytes += usage.CpuBytes;
+		memory.GpuBytes += usage.GpuBytes;
+	}
+	ImGui::Text("Geometry Memory: %.2f MB CPU, %.2f MB GPU (%zu meshes)",
+		memory.CpuBytes / (1024.0 * 1024.0), memory.GpuBytes / (1024.0 * 1024.0), countedMeshes.size());
+
+	// How full the shared geometry buffers are
+	GeometryPoolStats pool = geometryPool->GetStats();
+	ImGui::Text("Geometry Pool: %u/%u vertices, %u/%u indices (%u meshes)",
+		pool.VerticesUsed, pool.VertexCapacity, pool.IndicesUsed, pool.IndexCapacity, pool.Allocations);
+	ImGui::Text("Fragmentation: %.1f%% (defragmented %u times, grown %u times)",
+		100.0f * pool.Fragmentation, pool.Defragmentations, pool.Growths);
+	if (ImGui::Button("Defragment", ImVec2(150, 25)))
+		defragmentRequested = true;
+
+	// How often meshes were shared instead of loaded again
+	MeshRegistryStats registry = meshRegistry->GetStats();
+	ImGui::Text("Mesh Registry: %u loaded, %.2f/%.2f MB GPU", registry.Loaded,
+		registry.GpuBytes / (1024.0 * 1024.0), registry.Budget / (1024.0 * 1024.0));
+	ImGui::Text("Hits: %u (%u by contents), misses: %u, evictions: %u",
+		registry.Hits, registry.ContentHits, registry.Misses, registry.Evictions);
 	ImGui::End();
 
 	// Game Object Inspector
@@ -453,9 +645,63 @@ void Game::UpdateUI(float deltaTime)
 	{
 		if (ImGui::TreeNode((void*)(intptr_t)currentTreeSize, "Game Object %d", i))
 		{
-			ImGui::DragFloat3("Position: ", &gameObjects[i]->GetTransform()->GetPosition().x, 0.01f);
-			ImGui::DragFloat3("Rotation: ", &gameObjects[i]->GetTransform()->GetPitchYawRoll().x, 0.01f);
-			ImGui::DragFloat3("Scale: ", &gameObjects[i]->GetTransform()->GetScale().x, 0.01f);
+			EditTransform(gameObjects[i]->GetTransform());
+
+			// Parent, by game object number (moves that would make a loop are ignored)
+			Transform* parent = gameObjects[i]->GetTransform()->GetParent();
+			int parentIndex = -1;
+			for (int j = 0; j < gameObjects.size(); j++)
+				if (gameObjects[j]->GetTransform() == parent)
+					parentIndex = j;
+			if (ImGui::InputInt("Parent (-1 for none): ", &parentIndex) && parentIndex >= -1 && parentIndex < (int)gameObjects.size())
+				transformHierarchy->SetParent(gameObjects[i]->GetTransform(), parentIndex >= 0 ? gameObjects[parentIndex]->GetTransform() : 0);
+
+			// How often its Update() is called
+			EntityHandle handle = entityManager->GetHandle(i);
+			bool updateEnabled = gameObjects[i]->UpdateEnabled;
+			if (ImGui::Checkbox("Update Enabled", &updateEnabled))
+				updateScheduler->SetEnabled(handle, updateEnabled);
+			UpdateRate rate = updateScheduler->GetRate(handle);
+			int rateType = (int)rate.Type;
+			int rateFrames = (int)rate.Frames;
+			bool rateChanged = ImGui::Combo("Update Rate", &rateType, "Every Frame\0Every N Frames\0By Distance\0");
+			if (rateType != UPDATE_RATE_EVERY_FRAME)
+				rateChanged |= ImGui::SliderInt("Frames Between Updates", &rateFrames, 1, UPDATE_MAX_INTERVAL);
+			if (rateType == UPDATE_RATE_DISTANCE)
+				rateChanged |= ImGui::DragFloat2("Near/Far Distance", &rate.NearDistance, 0.5f, 0.0f, 1000.0f);
+			if (rateChanged)
+			{
+				rate.Type = (UpdateRateType)rateType;
+				rate.Frames = (unsigned int)rateFrames;
+				updateScheduler->SetRate(handle, rate);
+			}
+			if (updateScheduler->IsSleeping(handle))
+				ImGui::Text("(Sleeping)");
+			else if (ImGui::Button("Sleep 2 Seconds", ImVec2(150, 25)))
+				updateScheduler->Sleep(handle, 2.0f);
+
+			// Level of detail, as last drawn
+			std::shared_ptr<Mesh> mesh = gameObjects[i]->GetMesh();
+			unsigned int lod = gameObjects[i]->GetLastLod();
+			ImGui::DragFloat("LOD Pixel Error: ", &gameObjects[i]->LodPixelError, 0.05f, 0.0f, 100.0f);
+			if (mesh && lod < mesh->GetLodCount())
+			{
+				ImGui::Text("LOD: %u of %u (%u triangles, error %f)",
+					lod, mesh->GetLodCount(), mesh->GetLod(lod).IndexCount / 3, mesh->GetLod(lod).Error);
+			}
+
+			// Memory, and world bounds (which only update when the transform above changes)
+			if (mesh)
+			{
+				MeshMemoryUsage usage = mesh->GetMemoryUsage();
+				ImGui::Text("Mesh Memory: %.1f KB CPU, %.1f KB GPU", usage.CpuBytes / 1024.0, usage.GpuBytes / 1024.0);
+
+				const BoundingSphere& sphere = gameObjects[i]->GetWorldSphere();
+				const BoundingBox& box = gameObjects[i]->GetWorldBox();
+				ImGui::Text("Bounding Sphere: (%.2f, %.2f, %.2f) radius %.2f", sphere.Center.x, sphere.Center.y, sphere.Center.z, sphere.Radius);
+				ImGui::Text("Bounding Box: (%.2f, %.2f, %.2f) extents (%.2f, %.2f, %.2f)",
+					box.Center.x, box.Center.y, box.Center.z, box.Extents.x, box.Extents.y, box.Extents.z);
+			}
 			ImGui::TreePop();
 		}
 		currentTreeSize++;
@@ -466,9 +712,7 @@ void Game::UpdateUI(float deltaTime)
 	{
 		if (ImGui::TreeNode((void*)(intptr_t)currentTreeSize, "Mirror %d", i))
 		{
-			ImGui::DragFloat3("Position: ", &mirrorManager->GetMirror(i)->GetTransform()->GetPosition().x, 0.01f);
-			ImGui::DragFloat3("Rotation: ", &mirrorManager->GetMirror(i)->GetTransform()->GetPitchYawRoll().x, 0.01f);
-			ImGui::DragFloat3("Scale: ", &mirrorManager->GetMirror(i)->GetTransform()->GetScale().x, 0.01f);
+			EditTransform(mirrorManager->GetMirror(i)->GetTransform());
 			ImGui::TreePop();
 		}
 		currentTreeSize++;
@@ -523,14 +767,107 @@ void Game::UpdateUI(float deltaTime)
 	ImGui::End();
 }
 
+void Game::EditTransform(Transform* transform)
+{
+	XMFLOAT3 position = transform->GetPosition();
+	XMFLOAT3 rotation = transform->GetPitchYawRoll();
+	XMFLOAT3 scale = transform->GetScale();
+	if (ImGui::DragFloat3("Position: ", &position.x, 0.01f))
+		transform->SetPosition(position);
+	if (ImGui::DragFloat3("Rotation: ", &rotation.x, 0.01f))
+		transform->SetRotation(rotation);
+	if (ImGui::DragFloat3("Scale: ", &scale.x, 0.01f))
+		transform->SetScale(scale);
+}
+
 // --------------------------------------------------------
-// Clear the screen, redraw everything, present to the user
+// Hand the frame that's just been simulated over to be drawn
+// (see RenderFrame()), by the render thread while the next
+// one is simulated when the pipeline's pipelined
 // --------------------------------------------------------
 void Game::Draw(float deltaTime, float totalTime)
 {
+	const std::vector<GameEntity*>& gameObjects = entityManager->GetEntities();
+	FrameSnapshot& frame = framePipeline->GetSnapshot();
+
+	// This snapshot was last filled in a frame or two ago, and comes back with what drawing it picked
+	if (frame.Drawn)
+	{
+		for (size_t i = 0; i < frame.Handles.size(); i++)
+			if (GameEntity* entity = entityManager->Get(frame.Handles[i]))
+				entity->SetDrawResult(frame.Results[i]);
+
+		// Startup is over once the first frame is up
+		if (firstFrameMs == 0.0)
+		{
+			firstFrameMs = std::chrono::duration<double, std::milli>(frame.PresentTime - initTime).count();
+#if defined(DEBUG) || defined(_DEBUG)
+			printf("First frame presented %.2f ms after Init()\n", firstFrameMs);
+#endif
+		}
+	}
+
+	frame.InputTime = inputTime;
+	frame.Width = windowWidth;
+	frame.Height = windowHeight;
+	frame.Camera = activeCam->GetSnapshot();
+
+	frame.Entities.resize(gameObjects.size());
+	frame.Handles.resize(gameObjects.size());
+	frame.Results.resize(gameObjects.size());
+	for (size_t i = 0; i < gameObjects.size(); i++)
+	{
+		gameObjects[i]->Snapshot(frame.Entities[i]);
+		frame.Handles[i] = entityManager->GetHandle((unsigned int)i);
+	}
+	mirrorManager->Snapshot(frame.Mirrors);
+
+	// update view matrix (in the future this will be redone so it's only recalculated when the light transform changes)
+	XMVECTOR lightDir = XMLoadFloat3(&lights[0].Direction);
+	XMStoreFloat4x4(&lightView, XMMatrixLookToLH(
+		-lightDir * 20, // Position: "Backing up" 20 units from origin
+		lightDir, // Direction: light's direction
+		XMVectorSet(0, 1, 0, 0))); // Up: World up vector (Y axis)
+
+	frame.Lights = lights;
+	frame.Ambient = ambientLight;
+	frame.LightView = lightView;
+	frame.LightProjection = lightProj;
+	frame.Defragment = defragmentRequested;
+	defragmentRequested = false;
+
+	// ImGui starts on the next frame as soon as this one's handed over
+	ImGui::Render();
+	frame.CopyUI(ImGui::GetDrawData());
+
+	// Presenting in exclusive fullscreen can need this thread to handle messages, which it
+	// can't do while it's waiting on the render thread, so that's always drawn from here
+	framePipeline->SetPipelined(pipelinedRendering && !isFullscreen);
+	framePipeline->Submit();
+
+	// Entities destroyed this frame are still in the snapshot, so they have to wait until it's been drawn
+	if (entityManager->GetStats().PendingDestroy > 0)
+		framePipeline->WaitForIdle();
+	entityManager->Flush();
+}
+
+// --------------------------------------------------------
+// Clear the screen, redraw everything, present to the user
+// --------------------------------------------------------
+void Game::RenderFrame(FrameSnapshot& frame)
+{
+	const std::vector<EntitySnapshot>& gameObjects = frame.Entities;
+
+	// Moves meshes around in the shared buffers, so it can't happen while anything's drawing
+	if (frame.Defragment)
+		geometryPool->Defragment();
+
+	// Update mirror view matrices & cams
+	mirrorManager->Update(context, frame.Camera, frame.Mirrors);
+
 	// Frame START
 	// - These things should happen ONCE PER FRAME
-	// - At the beginning of Game::Draw() before drawing *anything*
+	// - At the beginning of Game::RenderFrame() before drawing *anything*
 	{
 		// Clear the back buffer (erases what's on the screen)
 		const float bgColor[4] = { 0.2f, 0.2f, 0.2f, 1.0f }; // dark grey
@@ -541,6 +878,9 @@ void Game::Draw(float deltaTime, float totalTime)
 
 		// Clear the Shadow depth buffer
 		context->ClearDepthStencilView(shadowDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+		// ImGui, the skybox and the mirrors bind their own buffers after the entities
+		meshBindings.Invalidate();
 	}
 	
 	// Bind shadow map to render target view
@@ -558,59 +898,57 @@ void Game::Draw(float deltaTime, float totalTime)
 	viewport.MaxDepth = 1.0f;
 	context->RSSetViewports(1, &viewport);
 
-	// Set to basic VS and render entities
-	shadowVS->SetShader();
-	shadowVS->SetMatrix4x4("view", lightView);
-	shadowVS->SetMatrix4x4("projection", lightProj);
-	for (auto& e : gameObjects)
+	// Set to basic VS and render entities, using the compact
+	// version for meshes that have compact vertices
+	for (const EntitySnapshot& e : gameObjects)
 	{
-		shadowVS->SetMatrix4x4("world", e->GetTransform()->GetWorldMatrix());
-		shadowVS->CopyAllBufferData();
-		e->GetMesh()->Draw();
+		const std::shared_ptr<Mesh>& mesh = e.Mesh;
+		std::shared_ptr<SimpleVertexShader> vs = mesh->GetVertexFormat() == VERTEX_FORMAT_FULL ? shadowVS : shadowCompactVS;
+		vs->SetShader();
+		vs->SetMatrix4x4("view", frame.LightView);
+		vs->SetMatrix4x4("projection", frame.LightProjection);
+		vs->SetMatrix4x4("world", e.World);
+		vs->SetFloat3("positionScale", mesh->GetPositionScale());
+		vs->SetFloat3("positionOffset", mesh->GetPositionOffset());
+		vs->CopyAllBufferData();
+		mesh->Draw(0, &meshBindings);
 	}
 	context->RSSetState(0); // disable depth biasing state
 
 	// Reset the pipeline
-	viewport.Width = (float)this->windowWidth;
-	viewport.Height = (float)this->windowHeight;
+	viewport.Width = (float)frame.Width;
+	viewport.Height = (float)frame.Height;
 	context->RSSetViewports(1, &viewport);
 	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthBufferDSV.Get());
 
-	// update view matrix (in the future this will be redone so it's only recalculated when the light transform changes)
-	XMVECTOR lightDir = XMLoadFloat3(&lights[0].Direction);
-	XMStoreFloat4x4(&lightView, XMMatrixLookToLH(
-		-lightDir * 20, // Position: "Backing up" 20 units from origin
-		lightDir, // Direction: light's direction
-		XMVectorSet(0, 1, 0, 0))); // Up: World up vector (Y axis)
-
 	// Render Game entities
-	for (GameEntity* gameObject : gameObjects)
+	for (size_t i = 0; i < gameObjects.size(); i++)
 	{
-		std::shared_ptr<SimplePixelShader> ps = gameObject->GetMaterial()->GetPS();
-		std::shared_ptr<SimpleVertexShader> vs = gameObject->GetMaterial()->GetVS();
-		vs->SetMatrix4x4("lightView", lightView);
-		vs->SetMatrix4x4("lightProjection", lightProj);
+		const EntitySnapshot& gameObject = gameObjects[i];
+		std::shared_ptr<SimplePixelShader> ps = gameObject.Material->GetPS();
+		std::shared_ptr<SimpleVertexShader> vs = gameObject.Material->GetVS();
+		vs->SetMatrix4x4("lightView", frame.LightView);
+		vs->SetMatrix4x4("lightProjection", frame.LightProjection);
 
 		ps->SetData("lights",                         // name of the lights array in shader
-			&lights[0],                               // address of the data to set
-			sizeof(Light) * (int)lights.size());      // size of the data (whole struct) to set
-		ps->SetFloat3("ambient", ambientLight);
+			&frame.Lights[0],                         // address of the data to set
+			sizeof(Light) * (int)frame.Lights.size()); // size of the data (whole struct) to set
+		ps->SetFloat3("ambient", frame.Ambient);
 		ps->SetShaderResourceView("ShadowMap", shadowSRV);
 		ps->SetSamplerState("ShadowSampler", shadowSS);
-		gameObject->Draw(context, activeCam);
+		gameObject.Entity->Draw(context, gameObject, frame.Camera.Position, frame.Camera.View, frame.Camera.Projection, &frame.Results[i], &meshBindings);
 		ps->SetShaderResourceView("ShadowMap", 0);
 		ps->SetSamplerState("ShadowSampler", 0);
 	}
 
 	// Render the skybox
-	skybox->Draw(context, activeCam);
+	skybox->Draw(context, frame.Camera.View, frame.Camera.Projection);
 
 	// Draw mirrors & update mirror maps, draw all objects through mirrors
-	mirrorManager->Draw(context, activeCam, gameObjects, skybox, lights, ambientLight);
+	mirrorManager->Draw(context, frame.Camera, frame.Mirrors, gameObjects, skybox, frame.Lights, frame.Ambient);
 
 	// Render the UI
-	ImGui::Render();
-	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+	ImGui_ImplDX11_RenderDrawData(frame.GetUI());
 
 	// Frame END
 	// - These should happen exactly ONCE PER FRAME
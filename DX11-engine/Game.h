@@ -3,10 +3,20 @@
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include <vector>
 #include <memory>
+#include <future>
+#include <chrono>
 #include "DXCore.h"
 #include "SimpleShader.h"
 #include "Lights.h"
 #include "Skybox.h"
+#include "AssetLoader.h"
+#include "MeshRegistry.h"
+#include "TransformHierarchy.h"
+#include "EntityManager.h"
+#include "JobSystem.h"
+#include "SystemScheduler.h"
+#include "FramePipeline.h"
+#include "UpdateScheduler.h"
 
 #include "GameEntitySubclassIncludes.h"
 
@@ -28,30 +38,61 @@ public:
 private:
 
 	// Initialization helper methods - feel free to customize, combine, remove, etc.
-	void LoadShaders(); 
-	void CreateGeometry();
+	// Both just queue up work on the loader. Anything needing the shaders waits on the returned future.
+	std::shared_future<void> LoadShaders(AssetLoader& loader);
+	void CreateGeometry(AssetLoader& loader, std::shared_future<void> shadersLoaded);
 	void UpdateUI(float deltaTime);
 
+	// Draws a frame from its snapshot, on the render thread when the pipeline's pipelined (so
+	// only from what's in the snapshot, and things only the render thread touches)
+	void RenderFrame(FrameSnapshot& frame);
+
+	// Position, rotation and scale fields that go through the transform's setters, so it notices
+	void EditTransform(Transform* transform);
+
 	// Note the usage of ComPtr below
 	//  - This is a smart pointer for objects that abide by the
 	//     Component Object Model, which DirectX objects do
 	//  - More info here: https://github.com/Microsoft/DirectXTK/wiki/ComPtr
 
-	std::vector<GameEntity*> gameObjects; // pointers for polymorphic behavior
+	std::shared_ptr<EntityManager> entityManager; // Owns every game object, in pools by type
+	std::shared_ptr<UpdateScheduler> updateScheduler; // Calls each game object's Update() as often as it needs it
+	std::shared_ptr<JobSystem> jobSystem; // One thread per core (this one included) for per-frame work
+	std::shared_ptr<SystemScheduler> systems; // Per-frame work over components, spread over the job system
+	std::shared_ptr<FramePipeline> framePipeline; // Draws each frame on its own thread while the next is simulated
 	std::shared_ptr<MagicMirrorManager> mirrorManager;
+	std::shared_ptr<TransformHierarchy> transformHierarchy; // Every entity's and mirror's transform, so they can have parents
 	std::vector<std::shared_ptr<Mesh>> meshes;
+	std::shared_ptr<GeometryPool> geometryPool; // Shared buffers for the quantized meshes
+	std::shared_ptr<MeshRegistry> meshRegistry; // Every mesh loaded from a file comes from here
+	MeshBindings meshBindings; // What Draw() last bound on the context, only touched by the render thread
 	std::shared_ptr<Skybox> skybox;
 	std::vector<std::shared_ptr<Camera>> cams;
 	std::shared_ptr<Camera> activeCam;
 	int camIndex;
 
+	// When Init() started, and how long after that the first frame was presented (0 until it is)
+	std::chrono::high_resolution_clock::time_point initTime;
+	double firstFrameMs;
+
+	// When each asset Init() loaded was ready (see AssetLoader), and on how many threads, for the stats window
+	std::vector<AssetLoadTiming> assetTimings;
+	unsigned int assetThreads;
+
+	// When this frame's input was read, and whether the geometry pool should be defragmented when it's drawn
+	std::chrono::high_resolution_clock::time_point inputTime;
+	bool defragmentRequested;
+
+	// Whether frames are drawn on the render thread, apart from in exclusive fullscreen (see Draw())
+	bool pipelinedRendering;
+
 	// lights and shadowmap stuff
 	std::vector<Light> lights;
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> shadowDSV;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shadowSRV;
 	Microsoft::WRL::ComPtr<ID3D11RasterizerState> shadowRS;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> shadowSS;
-	std::shared_ptr<SimpleVertexShader> shadowVS;
+	std::shared_ptr<SimpleVertexShader> shadowVS, shadowCompactVS;
 	DirectX::XMFLOAT3 ambientLight;
 
 	DirectX::XMFLOAT4X4 lightView;
@@ -61,6 +102,7 @@ private:
 	// Shaders and shader-related constructs
 	std::shared_ptr<SimplePixelShader> pixelShader, customPS;
 	std::shared_ptr<SimpleVertexShader> vertexShader;
+	std::shared_ptr<SimpleVertexShader> compactVS; // For VERTEX_FORMAT_QUANTIZED meshes
 
 	// Skybox shaders
 	std::shared_ptr<SimpleVertexShader> skyVS;
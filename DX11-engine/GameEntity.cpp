@@ -1,4 +1,7 @@
 #include "GameEntity.h"
+#include "BoundsCalculator.h"
+#include <algorithm>
+#include <cstring>
 
 using namespace std;
 using namespace DirectX;
@@ -9,6 +12,13 @@ GameEntity::GameEntity()
 	this->material = nullptr;
 	textureScale = 1;
 	UpdateEnabled = false;
+	LodPixelError = LOD_MAX_PIXEL_ERROR;
+	lastLod = 0;
+	lastCullStats = {};
+	XMStoreFloat4x4(&boundsWorld, XMMatrixIdentity());
+	boundsTransformVersion = 0;
+	boundsMeshVersion = 0;
+	worldBoundsValid = false;
 }
 
 GameEntity::GameEntity(shared_ptr<Mesh> mesh, shared_ptr<Material> material)
@@ -17,6 +27,13 @@ GameEntity::GameEntity(shared_ptr<Mesh> mesh, shared_ptr<Material> material)
 	this->material = material;
 	textureScale = 1;
 	UpdateEnabled = false;
+	LodPixelError = LOD_MAX_PIXEL_ERROR;
+	lastLod = 0;
+	lastCullStats = {};
+	XMStoreFloat4x4(&boundsWorld, XMMatrixIdentity());
+	boundsTransformVersion = 0;
+	boundsMeshVersion = 0;
+	worldBoundsValid = false;
 }
 
 shared_ptr<Mesh> GameEntity::GetMesh()
@@ -49,22 +66,163 @@ float GameEntity::GetTextureUniformScale()
 	return textureScale;
 }
 
+unsigned int GameEntity::GetLastLod()
+{
+	return lastLod;
+}
+
+MeshletCullStats GameEntity::GetLastCullStats()
+{
+	return lastCullStats;
+}
+
+void GameEntity::SetDrawResult(const EntityDrawResult& result)
+{
+	lastLod = result.Lod;
+	lastCullStats = result.CullStats;
+}
+
+const BoundingBox& GameEntity::GetWorldBox()
+{
+	UpdateWorldBounds();
+	return worldBox;
+}
+
+const BoundingSphere& GameEntity::GetWorldSphere()
+{
+	UpdateWorldBounds();
+	return worldSphere;
+}
+
+const BoundingOrientedBox& GameEntity::GetWorldOrientedBox()
+{
+	UpdateWorldBounds();
+	return worldOrientedBox;
+}
+
+// Brings the world bounds up to date, doing as little as the change allows
+void GameEntity::UpdateWorldBounds()
+{
+	// Neither the transform (or anything above it) nor the mesh has been touched, so there's nothing to compare
+	unsigned int meshVersion = mesh ? mesh->GetBoundsVersion() : 0;
+	if (worldBoundsValid && transform.GetVersion() == boundsTransformVersion && meshVersion == boundsMeshVersion)
+		return;
+	boundsTransformVersion = transform.GetVersion();
+
+	// Compared as a world matrix, since a parent can move this without its own position changing.
+	// The first three rows are rotation and scale, the last one is the position.
+	const XMFLOAT4X4& worldMatrix = transform.GetWorldMatrix();
+	XMFLOAT3 position(worldMatrix._41, worldMatrix._42, worldMatrix._43);
+	XMFLOAT3 lastPosition(boundsWorld._41, boundsWorld._42, boundsWorld._43);
+
+	bool samePosition = position.x == lastPosition.x && position.y == lastPosition.y && position.z == lastPosition.z;
+	bool sameShape = worldBoundsValid && meshVersion == boundsMeshVersion &&
+		memcmp(worldMatrix.m[0], boundsWorld.m[0], sizeof(float) * 12) == 0;
+
+	// Set to the same values it already had
+	if (sameShape && samePosition)
+		return;
+
+	// Only moved, so everything just shifts along with it
+	if (sameShape)
+	{
+		XMVECTOR offset = XMLoadFloat3(&position) - XMLoadFloat3(&lastPosition);
+		XMStoreFloat3(&worldBox.Center, XMLoadFloat3(&worldBox.Center) + offset);
+		XMStoreFloat3(&worldSphere.Center, XMLoadFloat3(&worldSphere.Center) + offset);
+		XMStoreFloat3(&worldOrientedBox.Center, XMLoadFloat3(&worldOrientedBox.Center) + offset);
+		boundsWorld = worldMatrix;
+		return;
+	}
+
+	boundsWorld = worldMatrix;
+	boundsMeshVersion = meshVersion;
+	worldBoundsValid = true;
+
+	if (!mesh)
+	{
+		worldBox = BoundingBox(position, XMFLOAT3(0, 0, 0));
+		worldSphere = BoundingSphere(position, 0.0f);
+		worldOrientedBox = BoundingOrientedBox(position, XMFLOAT3(0, 0, 0), XMFLOAT4(0, 0, 0, 1));
+		return;
+	}
+
+	XMMATRIX world = XMLoadFloat4x4(&transform.GetWorldMatrix());
+	mesh->GetBoundingSphere().Transform(worldSphere, world);
+	worldOrientedBox = BoundsCalculator::TransformOrientedBox(mesh->GetOrientedBox(), world);
+	worldBox = BoundsCalculator::TransformBox(mesh->GetBoundingBox(), worldOrientedBox, world);
+}
+
+// Picks the mesh's level of detail for one view, from how big its error
+// would be on screen at the point of its bounds closest to the camera
+unsigned int GameEntity::SelectLod(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const EntitySnapshot& snapshot,
+	XMFLOAT3 cameraPos, XMFLOAT4X4 projMatrix)
+{
+	if (snapshot.Mesh->GetLodCount() <= 1)
+		return 0;
+
+	D3D11_VIEWPORT viewport = {};
+	UINT numViewports = 1;
+	context->RSGetViewports(&numViewports, &viewport);
+
+	// The world matrix's largest axis scale is how much the mesh's error grows
+	const XMFLOAT4X4& world = snapshot.World;
+	float scale = 0.0f;
+	for (int row = 0; row < 3; row++)
+		scale = (std::max)(scale, XMVectorGetX(XMVector3Length(XMVectorSet(world.m[row][0], world.m[row][1], world.m[row][2], 0))));
+
+	// Pixels per world unit at a distance of 1 (or anywhere, for orthographic projections)
+	float pixelsPerUnit = scale * projMatrix._22 * viewport.Height * 0.5f;
+	if (projMatrix._44 == 0.0f)
+	{
+		const BoundingSphere& sphere = snapshot.WorldSphere;
+		float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&sphere.Center) - XMLoadFloat3(&cameraPos))) - sphere.Radius;
+
+		// Inside the bounds, so full detail
+		if (distance <= 0.0f)
+			return 0;
+		pixelsPerUnit /= distance;
+	}
+
+	return snapshot.Mesh->SelectLod(pixelsPerUnit, snapshot.LodPixelError);
+}
+
 // Init() is meant to be overriden bu subclasses
 void GameEntity::Init() {}
 
 // Update() is meant to be overriden by subclasses
 void GameEntity::Update(float deltaTime, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) {}
 
+void GameEntity::Snapshot(EntitySnapshot& snapshot)
+{
+	snapshot.Entity = this;
+	snapshot.Mesh = mesh;
+	snapshot.Material = material;
+	snapshot.World = transform.GetWorldMatrix();
+	snapshot.WorldInvTranspose = transform.GetWorldInverseTransposeMatrix();
+	snapshot.WorldSphere = mesh ? GetWorldSphere() : BoundingSphere();
+	snapshot.TextureScale = textureScale;
+	snapshot.LodPixelError = LodPixelError;
+	snapshot.ShaderInputs = XMFLOAT4(0, 0, 0, 0);
+}
+
 // Draw the game object using the given camera, setting required shader data
 void GameEntity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, shared_ptr<Camera> camPtr)
 {
-	Draw(context, camPtr->GetTransform().GetPosition(), camPtr->GetView(), camPtr->GetProjection());
+	EntitySnapshot snapshot;
+	Snapshot(snapshot);
+
+	EntityDrawResult result;
+	Draw(context, snapshot, camPtr->GetTransform().GetPosition(), camPtr->GetView(), camPtr->GetProjection(), &result);
+	SetDrawResult(result);
 }
 
-// Draw the game object using a given camera position, view and projection matrix
-void GameEntity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
-	XMFLOAT3 cameraPos, XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projMatrix)
+// Draw the game object as it was in the snapshot, using a given camera position, view and projection matrix
+void GameEntity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const EntitySnapshot& snapshot,
+	XMFLOAT3 cameraPos, XMFLOAT4X4 viewMatrix, XMFLOAT4X4 projMatrix, EntityDrawResult* result, MeshBindings* bindings)
 {
+	const shared_ptr<Mesh>& mesh = snapshot.Mesh;
+	const shared_ptr<Material>& material = snapshot.Material;
+
 	// Do any routine prep work for the material's shaders (i.e. loading stuff)
 	material->PrepareMaterial();
 
@@ -72,10 +230,12 @@ void GameEntity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
 	std::shared_ptr<SimplePixelShader> ps = material->GetPS();
 
 	// Strings here MUST  match variable names in your shaders cbuffer!
-	vs->SetMatrix4x4("world", transform.GetWorldMatrix());
-	vs->SetMatrix4x4("worldInvTranspose", transform.GetWorldInverseTransposeMatrix());
+	vs->SetMatrix4x4("world", snapshot.World);
+	vs->SetMatrix4x4("worldInvTranspose", snapshot.WorldInvTranspose);
 	vs->SetMatrix4x4("view", viewMatrix);
 	vs->SetMatrix4x4("projection", projMatrix);
+	vs->SetFloat3("positionScale", mesh->GetPositionScale());	// Only used by compact vertex shaders
+	vs->SetFloat3("positionOffset", mesh->GetPositionOffset());
 
 	vs->CopyAllBufferData(); // Adjust vs variable name if necessary
 
@@ -83,7 +243,7 @@ void GameEntity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
 	ps->SetFloat("roughness", material->GetRoughness());
 	ps->SetFloat("metalness", material->GetMetalness());
 	ps->SetFloat3("cameraPosition", cameraPos);
-	ps->SetFloat("textureScale", textureScale);
+	ps->SetFloat("textureScale", snapshot.TextureScale);
 
 	ps->CopyAllBufferData();
 
@@ -91,8 +251,37 @@ void GameEntity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
 	vs->SetShader();
 	ps->SetShader();
 
-	// Draw the mesh
-	mesh->Draw();
+	// Draw the mesh, at the level of detail that suits this view
+	unsigned int lod = SelectLod(context, snapshot, cameraPos, projMatrix);
+	MeshletCullStats cullStats = {};
+	if (lod == 0 && mesh->GetMeshletCount() > 0)
+	{
+		// Only draw the meshlets facing the camera and inside the frustum
+		XMMATRIX world = XMLoadFloat4x4(&snapshot.World);
+		XMFLOAT4X4 worldViewProj;
+		XMStoreFloat4x4(&worldViewProj, world * XMLoadFloat4x4(&viewMatrix) * XMLoadFloat4x4(&projMatrix));
+
+		// The camera in the mesh's local space, where the meshlet bounds are
+		XMVECTOR determinant;
+		XMMATRIX invWorld = XMMatrixInverse(&determinant, world);
+		XMFLOAT3 localCameraPos;
+		XMStoreFloat3(&localCameraPos, XMVector3TransformCoord(XMLoadFloat3(&cameraPos), invWorld));
+
+		// A mirrored transform flips which side of each triangle the rasterizer culls
+		MeshletCuller::Cull(mesh->GetMeshlets(), mesh->GetMeshletCount(), worldViewProj, localCameraPos,
+			XMVectorGetX(determinant) > 0.0f, visibleRanges, &cullStats);
+		mesh->Draw(visibleRanges, bindings);
+	}
+	else
+	{
+		mesh->Draw(lod, bindings);
+	}
+
+	if (result)
+	{
+		result->Lod = lod;
+		result->CullStats = cullStats;
+	}
 
 	// reset the SRV's and samplers for the next time so shader is fresh for a different material
 	material->ResetTextureData();
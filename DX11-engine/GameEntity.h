@@ -5,10 +5,31 @@
 #include "Material.h"
 #include "Camera.h"
 #include "Component.h"
+#include "EcsWorld.h"
 
-#include <typeindex>
-#include <typeinfo>
-#include <unordered_map>
+class GameEntity;
+
+// What drawing an entity needs, copied out of it at the end of a frame's simulation
+// so it can be drawn (on another thread, see FramePipeline) while it carries on changing
+struct EntitySnapshot
+{
+	GameEntity* Entity;	// Only for calling Draw() on, which sticks to what's in here
+	std::shared_ptr<::Mesh> Mesh;
+	std::shared_ptr<::Material> Material;
+	DirectX::XMFLOAT4X4 World;
+	DirectX::XMFLOAT4X4 WorldInvTranspose;
+	DirectX::BoundingSphere WorldSphere;
+	float TextureScale;
+	float LodPixelError;
+	DirectX::XMFLOAT4 ShaderInputs;	// Anything else a subclass's Draw() needs, from its Snapshot()
+};
+
+// What drawing an entity from a snapshot picked, for handing back to the entity
+struct EntityDrawResult
+{
+	unsigned int Lod;
+	MeshletCullStats CullStats;
+};
 
 class GameEntity
 {
@@ -17,12 +38,26 @@ private:
 	Transform transform;
 	std::shared_ptr<Mesh> mesh;
 	std::shared_ptr<Material> material;
-	std::unordered_map<std::type_index, Component> components;
+	EcsComponents components;	// Kept in EcsWorld::GetInstance(), so each type is stored whole and in its own column
+
+	// The mesh's bounds in world space, and the world matrix and mesh bounds they were made from
+	DirectX::BoundingBox worldBox;
+	DirectX::BoundingSphere worldSphere;
+	DirectX::BoundingOrientedBox worldOrientedBox;
+	DirectX::XMFLOAT4X4 boundsWorld;
+	unsigned int boundsTransformVersion;
+	unsigned int boundsMeshVersion;
+	bool worldBoundsValid;
+
+	void UpdateWorldBounds();
 
 public:
 
 	bool UpdateEnabled;
 
+	// Largest error (in pixels) the mesh's level of detail can show, see Mesh::SelectLod()
+	float LodPixelError;
+
 	GameEntity();
 	GameEntity(std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
 
@@ -33,38 +68,71 @@ public:
 	void SetTextureUniformScale(float scale);
 	float GetTextureUniformScale();
 
+	// The level of detail this entity's mesh was last drawn at
+	unsigned int GetLastLod();
+
+	// How many of its mesh's meshlets were culled when it was last drawn
+	// (all zero if it was drawn at a lower level of detail, which isn't split up)
+	MeshletCullStats GetLastCullStats();
+
+	// Hands back what drawing a snapshot of this entity picked, for the two above
+	void SetDrawResult(const EntityDrawResult& result);
+
+	// The mesh's bounds in world space. These are only recalculated when they're asked for after
+	// the transform or the mesh's bounds have changed, so entities that don't move cost nothing.
+	const DirectX::BoundingBox& GetWorldBox();
+	const DirectX::BoundingSphere& GetWorldSphere();
+	const DirectX::BoundingOrientedBox& GetWorldOrientedBox();
+
 	virtual void Init();
 	virtual void Update(float deltaTime, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
-	virtual void Draw(
-		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
-		std::shared_ptr<Camera> camPtr);
 
+	// Copies what drawing needs out of the entity. Subclasses with shader inputs of their own add them.
+	virtual void Snapshot(EntitySnapshot& snapshot);
+
+	// Draws the entity as it was in the snapshot, without looking at anything else about it, so it can
+	// be drawn while it's being updated. What it picked goes in the result (if any) rather than the entity.
+	// The context's bindings (if any) go to the mesh's Draw().
 	virtual void Draw(
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		const EntitySnapshot& snapshot,
 		DirectX::XMFLOAT3 cameraPos,
 		DirectX::XMFLOAT4X4 viewMatrix,
-		DirectX::XMFLOAT4X4 projMatrix);
+		DirectX::XMFLOAT4X4 projMatrix,
+		EntityDrawResult* result = 0,
+		MeshBindings* bindings = 0);
+
+	// Snapshots and draws the entity right away, on this thread
+	void Draw(
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		std::shared_ptr<Camera> camPtr);
 
 	// Personal Note: Linker doesn't like separating templated functions between .h and .cpp files. Stupid.
 
-	// Returns this entity's component of the given type
+	// Returns this entity's component of the given type, or null if it doesn't have one
+	template <class ComponentType>
+	ComponentType* GetComponent() { return components.Get<ComponentType>(); }
+
+	// Add a component to this entity. Returns false (and changes nothing) if it already has one of this type.
 	template <class ComponentType>
-	ComponentType& GetComponent() { return components[typeid(ComponentType)]; }
+	bool AddComponent(const ComponentType& component) { return components.Add<ComponentType>(component); }
 
-	// Add a component to this entity
 	template <class ComponentType>
-	bool AddComponent(Component& component)
-	{
-		// If the map already has a component of this type, don't do anything
-		if (components.find(typeid(ComponentType)) != components.end())
-			return false;
+	bool RemoveComponent() { return components.Remove<ComponentType>(); }
 
-		// If not, add it to the map
-		components[typeid(ComponentType)] = component;
-		return true;
-	}
+	// This entity's id in EcsWorld::GetInstance(), for iterating its components alongside everyone else's
+	// with EcsWorld::Each(). ECS_NO_ENTITY until it has a component.
+	EcsEntity GetEntity() { return components.GetEntity(); }
 
 protected:
 
 	float textureScale;
+	unsigned int lastLod;
+	MeshletCullStats lastCullStats;
+
+	// Reused every draw to avoid allocating. Only whichever thread is drawing touches it.
+	std::vector<IndexRange> visibleRanges;
+
+	unsigned int SelectLod(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const EntitySnapshot& snapshot,
+		DirectX::XMFLOAT3 cameraPos, DirectX::XMFLOAT4X4 projMatrix);
 };
\ No newline at end of file
@@ -0,0 +1,230 @@
+#include "GeometryPool.h"
+#include "VertexCompression.h"
+#include <algorithm>
+
+// Where an offset ended up after RangeAllocator::Defragment(), given its moves (sorted by From)
+static unsigned int MovedOffset(const std::vector<RangeMove>& moves, unsigned int offset)
+{
+	auto move = std::lower_bound(moves.begin(), moves.end(), offset,
+		[](const RangeMove& m, unsigned int from) { return m.From < from; });
+	return move != moves.end() && move->From == offset ? move->To : offset;
+}
+
+GeometryPool::GeometryPool(Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	VertexFormat vertexFormat, unsigned int vertexCapacity, unsigned int indexCapacity)
+	: vertexRanges(vertexCapacity), indexRanges(indexCapacity)
+{
+	this->device = device;
+	this->context = context;
+	this->vertexFormat = vertexFormat;
+	this->vertexStride = VertexCompression::GetStride(vertexFormat);
+	this->defragmentations = 0;
+	this->growths = 0;
+
+	CreateBuffers(vertexCapacity, indexCapacity, vertexBuffer, indexBuffer);
+}
+
+unsigned int GeometryPool::Allocate(const void* vertexData, unsigned int numVerts, const unsigned short* indices, unsigned int numIndices)
+{
+	// 16-bit indices can only reach so many vertices past the base vertex
+	if (numVerts == 0 || numIndices == 0 || numVerts > 0xFFFF)
+		return GEOMETRY_POOL_INVALID;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	unsigned int baseVertex = vertexRanges.Allocate(numVerts);
+	unsigned int startIndex = indexRanges.Allocate(numIndices);
+	if (baseVertex == RANGE_ALLOCATOR_INVALID || startIndex == RANGE_ALLOCATOR_INVALID)
+	{
+		// Give back whichever half did fit (freeing an invalid offset does nothing)
+		vertexRanges.Free(baseVertex);
+		indexRanges.Free(startIndex);
+
+		// Grow whichever buffer is short on space overall...
+		unsigned int vertexCapacity = vertexRanges.GetCapacity();
+		unsigned int indexCapacity = indexRanges.GetCapacity();
+		if (vertexCapacity - vertexRanges.GetUsed() < numVerts)
+			vertexCapacity = (std::max)(vertexCapacity * 2, vertexRanges.GetUsed() + numVerts);
+		if (indexCapacity - indexRanges.GetUsed() < numIndices)
+			indexCapacity = (std::max)(indexCapacity * 2, indexRanges.GetUsed() + numIndices);
+		if (vertexCapacity != vertexRanges.GetCapacity() || indexCapacity != indexRanges.GetCapacity())
+			Grow(vertexCapacity, indexCapacity);
+
+		// ...then pack everything together if the space is there, just split up
+		if (vertexRanges.GetLargestFreeRange() < numVerts || indexRanges.GetLargestFreeRange() < numIndices)
+			Compact();
+
+		baseVertex = vertexRanges.Allocate(numVerts);
+		startIndex = indexRanges.Allocate(numIndices);
+	}
+
+	// Copy the geometry into its ranges of the buffers
+	D3D11_BOX vertexBox = { baseVertex * vertexStride, 0, 0, (baseVertex + numVerts) * vertexStride, 1, 1 };
+	context->UpdateSubresource(vertexBuffer.Get(), 0, &vertexBox, vertexData, 0, 0);
+	D3D11_BOX indexBox = { startIndex * (UINT)sizeof(unsigned short), 0, 0, (startIndex + numIndices) * (UINT)sizeof(unsigned short), 1, 1 };
+	context->UpdateSubresource(indexBuffer.Get(), 0, &indexBox, indices, 0, 0);
+
+	// Reuse a freed handle if there is one
+	GeometryAllocation allocation = { baseVertex, numVerts, startIndex, numIndices };
+	unsigned int handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+		allocations[handle] = allocation;
+	}
+	else
+	{
+		handle = (unsigned int)allocations.size();
+		allocations.push_back(allocation);
+	}
+	return handle;
+}
+
+void GeometryPool::Free(unsigned int handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (handle >= allocations.size() || allocations[handle].VertexCount == 0)
+		return;
+
+	vertexRanges.Free(allocations[handle].BaseVertex);
+	indexRanges.Free(allocations[handle].StartIndex);
+	allocations[handle] = GeometryAllocation();
+	freeHandles.push_back(handle);
+}
+
+GeometryAllocation GeometryPool::GetAllocation(unsigned int handle)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return handle < allocations.size() ? allocations[handle] : GeometryAllocation();
+}
+
+GeometryAllocation GeometryPool::GetAllocation(unsigned int handle,
+	Microsoft::WRL::ComPtr<ID3D11Buffer>& allocationVertexBuffer, Microsoft::WRL::ComPtr<ID3D11Buffer>& allocationIndexBuffer)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	allocationVertexBuffer = vertexBuffer;
+	allocationIndexBuffer = indexBuffer;
+	return handle < allocations.size() ? allocations[handle] : GeometryAllocation();
+}
+
+void GeometryPool::Defragment()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	Compact();
+}
+
+void GeometryPool::Compact()
+{
+	std::vector<RangeMove> vertexMoves;
+	std::vector<RangeMove> indexMoves;
+	vertexRanges.Defragment(vertexMoves);
+	indexRanges.Defragment(indexMoves);
+	if (vertexMoves.empty() && indexMoves.empty())
+		return;
+
+	// Copying within one buffer isn't allowed where the ranges overlap, so every
+	// allocation is copied into fresh buffers at its new offset instead
+	Microsoft::WRL::ComPtr<ID3D11Buffer> newVertexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> newIndexBuffer;
+	CreateBuffers(vertexRanges.GetCapacity(), indexRanges.GetCapacity(), newVertexBuffer, newIndexBuffer);
+
+	for (GeometryAllocation& allocation : allocations)
+	{
+		if (allocation.VertexCount == 0)
+			continue;
+
+		unsigned int baseVertex = MovedOffset(vertexMoves, allocation.BaseVertex);
+		unsigned int startIndex = MovedOffset(indexMoves, allocation.StartIndex);
+		CopyRange(newVertexBuffer.Get(), baseVertex * vertexStride,
+			vertexBuffer.Get(), allocation.BaseVertex * vertexStride, allocation.VertexCount * vertexStride);
+		CopyRange(newIndexBuffer.Get(), startIndex * sizeof(unsigned short),
+			indexBuffer.Get(), allocation.StartIndex * sizeof(unsigned short), allocation.IndexCount * sizeof(unsigned short));
+		allocation.BaseVertex = baseVertex;
+		allocation.StartIndex = startIndex;
+	}
+
+	vertexBuffer = newVertexBuffer;
+	indexBuffer = newIndexBuffer;
+	defragmentations++;
+}
+
+VertexFormat GeometryPool::GetVertexFormat()
+{
+	return vertexFormat;
+}
+
+unsigned int GeometryPool::GetVertexStride()
+{
+	return vertexStride;
+}
+
+Microsoft::WRL::ComPtr<ID3D11Buffer> GeometryPool::GetVertexBuffer()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return vertexBuffer;
+}
+
+Microsoft::WRL::ComPtr<ID3D11Buffer> GeometryPool::GetIndexBuffer()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return indexBuffer;
+}
+
+GeometryPoolStats GeometryPool::GetStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	GeometryPoolStats stats = {};
+	stats.VertexCapacity = vertexRanges.GetCapacity();
+	stats.VerticesUsed = vertexRanges.GetUsed();
+	stats.IndexCapacity = indexRanges.GetCapacity();
+	stats.IndicesUsed = indexRanges.GetUsed();
+	stats.Allocations = vertexRanges.GetAllocationCount();
+	stats.Fragmentation = (std::max)(vertexRanges.GetFragmentation(), indexRanges.GetFragmentation());
+	stats.Defragmentations = defragmentations;
+	stats.Growths = growths;
+	return stats;
+}
+
+void GeometryPool::CreateBuffers(unsigned int vertexCapacity, unsigned int indexCapacity,
+	Microsoft::WRL::ComPtr<ID3D11Buffer>& newVertexBuffer, Microsoft::WRL::ComPtr<ID3D11Buffer>& newIndexBuffer)
+{
+	// Default usage, since meshes are copied in and out with UpdateSubresource() and CopySubresourceRegion()
+	D3D11_BUFFER_DESC vbd = {};
+	vbd.Usage = D3D11_USAGE_DEFAULT;
+	vbd.ByteWidth = (std::max)(1u, vertexCapacity) * vertexStride;
+	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	device->CreateBuffer(&vbd, 0, newVertexBuffer.GetAddressOf());
+
+	D3D11_BUFFER_DESC ibd = {};
+	ibd.Usage = D3D11_USAGE_DEFAULT;
+	ibd.ByteWidth = (std::max)(1u, indexCapacity) * sizeof(unsigned short);
+	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	device->CreateBuffer(&ibd, 0, newIndexBuffer.GetAddressOf());
+}
+
+void GeometryPool::Grow(unsigned int vertexCapacity, unsigned int indexCapacity)
+{
+	Microsoft::WRL::ComPtr<ID3D11Buffer> newVertexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> newIndexBuffer;
+	CreateBuffers(vertexCapacity, indexCapacity, newVertexBuffer, newIndexBuffer);
+
+	// Everything stays at the same offset, the new space is just added to the end
+	if (vertexRanges.GetCapacity() > 0)
+		CopyRange(newVertexBuffer.Get(), 0, vertexBuffer.Get(), 0, vertexRanges.GetCapacity() * vertexStride);
+	if (indexRanges.GetCapacity() > 0)
+		CopyRange(newIndexBuffer.Get(), 0, indexBuffer.Get(), 0, indexRanges.GetCapacity() * sizeof(unsigned short));
+
+	vertexBuffer = newVertexBuffer;
+	indexBuffer = newIndexBuffer;
+	vertexRanges.Grow(vertexCapacity);
+	indexRanges.Grow(indexCapacity);
+	growths++;
+}
+
+void GeometryPool::CopyRange(ID3D11Buffer* destination, unsigned int destinationOffset, ID3D11Buffer* source, unsigned int sourceOffset, unsigned int bytes)
+{
+	D3D11_BOX box = { sourceOffset, 0, 0, sourceOffset + bytes, 1, 1 };
+	context->CopySubresourceRegion(destination, 0, destinationOffset, 0, 0, source, 0, &box);
+}
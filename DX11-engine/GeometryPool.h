@@ -0,0 +1,113 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+#include <mutex>
+#include "Vertex.h"
+#include "RangeAllocator.h"
+
+// Returned by GeometryPool::Allocate() when the geometry can't be pooled
+#define GEOMETRY_POOL_INVALID 0xFFFFFFFF
+
+// Where a mesh's geometry ended up in the pool's buffers
+struct GeometryAllocation
+{
+	unsigned int BaseVertex;	// Added to every index by DrawIndexed()
+	unsigned int VertexCount;
+	unsigned int StartIndex;	// Added to the start of every range drawn
+	unsigned int IndexCount;
+};
+
+// How full the pool is, for the stats window
+struct GeometryPoolStats
+{
+	unsigned int VertexCapacity;
+	unsigned int VerticesUsed;
+	unsigned int IndexCapacity;
+	unsigned int IndicesUsed;
+	unsigned int Allocations;
+	float Fragmentation;			// The worse of the two buffers (see RangeAllocator)
+	unsigned int Defragmentations;
+	unsigned int Growths;
+};
+
+// --------------------------------------------------------
+// Packs many static meshes into one vertex buffer and one
+// index buffer, so drawing them one after another doesn't
+// need the input assembler rebound in between
+//
+// - Every mesh in a pool shares one vertex format
+// - Indices are 16-bit and local to each mesh, the base
+//   vertex of its allocation is added when drawing, so
+//   meshes with more than 0xFFFF vertices can't be pooled
+// - Space is handed out by a RangeAllocator per buffer. When
+//   nothing fits, the pool defragments if there's enough
+//   free space in total, otherwise it doubles in size
+// - Allocations are looked up through handles, since
+//   defragmenting moves them
+// - Meshes can be added and removed from any thread (like
+//   while loading in parallel, see AssetLoader), but not
+//   while they're being drawn. Every getter takes the lock,
+//   so drawing can read the pool while a loader adds to it.
+// --------------------------------------------------------
+class GeometryPool
+{
+public:
+
+	GeometryPool(Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		VertexFormat vertexFormat, unsigned int vertexCapacity, unsigned int indexCapacity);
+
+	// Copies in vertices already in the pool's format (see VertexCompression) and returns a
+	// handle to them, or GEOMETRY_POOL_INVALID if there are too many vertices to pool
+	unsigned int Allocate(const void* vertexData, unsigned int numVerts, const unsigned short* indices, unsigned int numIndices);
+	void Free(unsigned int handle);
+	GeometryAllocation GetAllocation(unsigned int handle);
+
+	// The allocation along with the buffers it's in, read together so growing or
+	// defragmenting on another thread can't land between them
+	GeometryAllocation GetAllocation(unsigned int handle,
+		Microsoft::WRL::ComPtr<ID3D11Buffer>& allocationVertexBuffer, Microsoft::WRL::ComPtr<ID3D11Buffer>& allocationIndexBuffer);
+
+	// Packs every allocation to the start of new buffers. Anything holding the old buffers
+	// (like the input assembler) has to pick up the new ones.
+	void Defragment();
+
+	VertexFormat GetVertexFormat();
+	unsigned int GetVertexStride();
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
+	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
+	GeometryPoolStats GetStats();
+
+private:
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	VertexFormat vertexFormat;
+	unsigned int vertexStride;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+
+	// In vertices and indices, not bytes
+	RangeAllocator vertexRanges;
+	RangeAllocator indexRanges;
+
+	// Indexed by handle. Freed handles have no vertices and get reused.
+	std::vector<GeometryAllocation> allocations;
+	std::vector<unsigned int> freeHandles;
+
+	unsigned int defragmentations;
+	unsigned int growths;
+
+	// Guards everything above
+	std::mutex mutex;
+
+	void CreateBuffers(unsigned int vertexCapacity, unsigned int indexCapacity,
+		Microsoft::WRL::ComPtr<ID3D11Buffer>& newVertexBuffer, Microsoft::WRL::ComPtr<ID3D11Buffer>& newIndexBuffer);
+	void Grow(unsigned int vertexCapacity, unsigned int indexCapacity);
+	void Compact();
+	void CopyRange(ID3D11Buffer* destination, unsigned int destinationOffset, ID3D11Buffer* source, unsigned int sourceOffset, unsigned int bytes);
+};
@@ -0,0 +1,689 @@
+#include "GltfLoader.h"
+#include "Material.h"
+#include "MappedFile.h"
+#include "ObjLoader.h"
+#include "WICTextureLoader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+
+using namespace DirectX;
+
+// Deeper JSON than this is treated as malformed, rather than risking the stack
+#define GLTF_MAX_JSON_DEPTH 64
+
+// A parsed JSON value. Strings aren't unescaped or copied, they point into the
+// file, which is all glTF's property names and enums need.
+struct GltfJson
+{
+	enum Type { Null, Bool, Number, String, Array, Object } type;
+	double number;
+	const char* string;
+	size_t length;
+	std::vector<GltfJson> items;	// Array elements, or object member values
+	std::vector<GltfJson> keys;		// Object member names (as strings), matching items
+
+	GltfJson() : type(Null), number(0.0), string(0), length(0) {}
+};
+
+static inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+static inline const char* SkipWhitespace(const char* p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) p++;
+	return p;
+}
+
+// Parses one value, returning where it ended, or null if it's malformed
+static const char* ParseJson(const char* p, const char* end, GltfJson& out, int depth)
+{
+	p = SkipWhitespace(p, end);
+	if (p == end || depth > GLTF_MAX_JSON_DEPTH)
+		return 0;
+
+	switch (*p)
+	{
+	case '{':
+	case '[':
+	{
+		bool object = *p == '{';
+		char close = object ? '}' : ']';
+		out.type = object ? GltfJson::Object : GltfJson::Array;
+		p = SkipWhitespace(p + 1, end);
+		if (p < end && *p == close)
+			return p + 1;
+
+		while (p < end)
+		{
+			if (object)
+			{
+				GltfJson key;
+				p = ParseJson(p, end, key, depth + 1);
+				if (!p || key.type != GltfJson::String)
+					return 0;
+				p = SkipWhitespace(p, end);
+				if (p == end || *p != ':')
+					return 0;
+				p++;
+				out.keys.push_back(key);
+			}
+
+			out.items.push_back(GltfJson());
+			p = ParseJson(p, end, out.items.back(), depth + 1);
+			if (!p)
+				return 0;
+
+			p = SkipWhitespace(p, end);
+			if (p == end)
+				return 0;
+			if (*p == close)
+				return p + 1;
+			if (*p != ',')
+				return 0;
+			p++;
+		}
+		return 0;
+	}
+
+	case '"':
+	{
+		const char* start = ++p;
+		while (p < end && *p != '"')
+			p += (*p == '\\') ? 2 : 1;
+		if (p >= end)
+			return 0;
+		out.type = GltfJson::String;
+		out.string = start;
+		out.length = p - start;
+		return p + 1;
+	}
+
+	case 't':
+	case 'f':
+	case 'n':
+	{
+		const char* words[] = { "true", "false", "null" };
+		for (const char* word : words)
+		{
+			size_t length = strlen(word);
+			if ((size_t)(end - p) >= length && memcmp(p, word, length) == 0)
+			{
+				out.type = word[0] == 'n' ? GltfJson::Null : GltfJson::Bool;
+				out.number = word[0] == 't' ? 1.0 : 0.0;
+				return p + length;
+			}
+		}
+		return 0;
+	}
+
+	default:
+	{
+		// Numbers, by hand so they don't depend on the C locale (like ObjLoader)
+		bool negative = *p == '-';
+		if (negative) p++;
+		if (p == end || !IsDigit(*p))
+			return 0;
+
+		double mantissa = 0.0;
+		int exponent = 0;
+		for (; p < end && IsDigit(*p); p++)
+			mantissa = mantissa * 10.0 + (*p - '0');
+		if (p < end && *p == '.')
+		{
+			for (p++; p < end && IsDigit(*p); p++, exponent--)
+				mantissa = mantissa * 10.0 + (*p - '0');
+		}
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			p++;
+			bool negativeExponent = p < end && *p == '-';
+			if (p < end && (*p == '-' || *p == '+')) p++;
+			int written = 0;
+			for (; p < end && IsDigit(*p); p++)
+				written = (std::min)(written * 10 + (*p - '0'), 1000);
+			exponent += negativeExponent ? -written : written;
+		}
+
+		out.type = GltfJson::Number;
+		out.number = (negative ? -mantissa : mantissa) * std::pow(10.0, exponent);
+		return p;
+	}
+	}
+}
+
+static bool Equals(const GltfJson* value, const char* text)
+{
+	return value && value->type == GltfJson::String &&
+		value->length == strlen(text) && memcmp(value->string, text, value->length) == 0;
+}
+
+static const GltfJson* Member(const GltfJson* object, const char* name)
+{
+	if (!object || object->type != GltfJson::Object)
+		return 0;
+	for (size_t i = 0; i < object->keys.size(); i++)
+	{
+		if (Equals(&object->keys[i], name))
+			return &object->items[i];
+	}
+	return 0;
+}
+
+static const GltfJson* Element(const GltfJson* array, int index)
+{
+	if (!array || array->type != GltfJson::Array || index < 0 || (size_t)index >= array->items.size())
+		return 0;
+	return &array->items[index];
+}
+
+static double NumberOr(const GltfJson* value, double fallback)
+{
+	return value && value->type == GltfJson::Number ? value->number : fallback;
+}
+
+static int IndexOf(const GltfJson* object, const char* name)
+{
+	return (int)NumberOr(Member(object, name), -1.0);
+}
+
+// Finds a buffer view's bytes in the binary chunk. Views of external .bin files aren't supported.
+static bool ResolveView(const GltfJson* view, const char* bin, size_t binSize, const char*& data, size_t& length, unsigned int& stride)
+{
+	if (!view || !bin || IndexOf(view, "buffer") != 0)
+		return false;
+
+	double offset = NumberOr(Member(view, "byteOffset"), 0.0);
+	double byteLength = NumberOr(Member(view, "byteLength"), -1.0);
+	if (offset < 0.0 || byteLength < 0.0 || offset + byteLength > (double)binSize)
+		return false;
+
+	data = bin + (size_t)offset;
+	length = (size_t)byteLength;
+	stride = (unsigned int)NumberOr(Member(view, "byteStride"), 0.0);
+	return true;
+}
+
+// Points an accessor at its elements, or leaves its data null if it's missing or can't be read in place
+static GltfAccessor ResolveAccessor(const GltfJson& root, int index, const char* bin, size_t binSize)
+{
+	GltfAccessor accessor = {};
+	const GltfJson* json = Element(Member(&root, "accessors"), index);
+	if (!json || Member(json, "sparse"))
+		return accessor;
+
+	const GltfJson* type = Member(json, "type");
+	unsigned int components =
+		Equals(type, "SCALAR") ? 1 : Equals(type, "VEC2") ? 2 : Equals(type, "VEC3") ? 3 : Equals(type, "VEC4") ? 4 : 0;
+
+	unsigned int componentType = (unsigned int)NumberOr(Member(json, "componentType"), 0.0);
+	unsigned int componentSize = 0;
+	switch (componentType)
+	{
+	case GLTF_BYTE: case GLTF_UNSIGNED_BYTE: componentSize = 1; break;
+	case GLTF_SHORT: case GLTF_UNSIGNED_SHORT: componentSize = 2; break;
+	case GLTF_UNSIGNED_INT: case GLTF_FLOAT: componentSize = 4; break;
+	}
+
+	const char* viewData;
+	size_t viewLength;
+	unsigned int stride;
+	double count = NumberOr(Member(json, "count"), 0.0);
+	double offset = NumberOr(Member(json, "byteOffset"), 0.0);
+	if (components == 0 || componentSize == 0 || count < 1.0 || count > 0xFFFFFFFF || offset < 0.0 ||
+		!ResolveView(Element(Member(&root, "bufferViews"), IndexOf(json, "bufferView")), bin, binSize, viewData, viewLength, stride))
+		return accessor;
+
+	// Tightly packed unless the view says otherwise, and every element has to be inside the view
+	unsigned int elementSize = components * componentSize;
+	if (stride == 0)
+		stride = elementSize;
+	if (offset + (count - 1.0) * stride + elementSize > (double)viewLength)
+		return accessor;
+
+	accessor.Data = viewData + (size_t)offset;
+	accessor.Count = (unsigned int)count;
+	accessor.Stride = stride;
+	accessor.ComponentType = componentType;
+	accessor.Components = components;
+	const GltfJson* normalized = Member(json, "normalized");
+	accessor.Normalized = normalized && normalized->type == GltfJson::Bool && normalized->number != 0.0;
+	return accessor;
+}
+
+// Attributes have to have a vertex per position and the expected number of components to be used
+static GltfAccessor ResolveAttribute(const GltfJson& root, const GltfJson* attributes, const char* name,
+	unsigned int components, unsigned int vertexCount, const char* bin, size_t binSize)
+{
+	GltfAccessor accessor = ResolveAccessor(root, IndexOf(attributes, name), bin, binSize);
+	if (accessor.Components != components || (vertexCount != 0 && accessor.Count != vertexCount))
+		accessor = GltfAccessor();
+	return accessor;
+}
+
+// The image a texture reference in a material ends up sampling, or -1 if there isn't one
+static int ResolveTexture(const GltfJson& root, const GltfJson* textureInfo)
+{
+	// Only the first uv set is imported
+	if (!textureInfo || NumberOr(Member(textureInfo, "texCoord"), 0.0) != 0.0)
+		return -1;
+	const GltfJson* texture = Element(Member(&root, "textures"), IndexOf(textureInfo, "index"));
+	return texture ? IndexOf(texture, "source") : -1;
+}
+
+bool GltfLoader::IsGlb(const char* data, size_t size)
+{
+	if (size < 12)
+		return false;
+
+	unsigned int magic;
+	unsigned int version;
+	memcpy(&magic, data, 4);
+	memcpy(&version, data + 4, 4);
+	return magic == GLB_MAGIC && version == GLB_VERSION;
+}
+
+bool GltfLoader::Parse(const char* data, size_t size, GltfData& out)
+{
+	out = GltfData();
+	if (!IsGlb(data, size))
+		return false;
+
+	unsigned int totalLength;
+	memcpy(&totalLength, data + 8, 4);
+	if (totalLength > size)
+		return false;
+
+	// The JSON chunk comes first, then the binary chunk if there is one (anything after is skipped)
+	const char* json = 0;
+	size_t jsonSize = 0;
+	const char* bin = 0;
+	size_t binSize = 0;
+	for (size_t offset = 12; offset + 8 <= totalLength;)
+	{
+		unsigned int chunkLength;
+		unsigned int chunkType;
+		memcpy(&chunkLength, data + offset, 4);
+		memcpy(&chunkType, data + offset + 4, 4);
+		offset += 8;
+		if (chunkLength > totalLength - offset)
+			return false;
+
+		if (chunkType == GLB_CHUNK_JSON && !json)
+		{
+			json = data + offset;
+			jsonSize = chunkLength;
+		}
+		else if (chunkType == GLB_CHUNK_BIN && !bin)
+		{
+			bin = data + offset;
+			binSize = chunkLength;
+		}
+		offset += chunkLength;
+	}
+
+	GltfJson root;
+	if (!json || !ParseJson(json, json + jsonSize, root, 0) || root.type != GltfJson::Object)
+		return false;
+
+	// Images, which materials refer to through textures
+	const GltfJson* images = Member(&root, "images");
+	for (size_t i = 0; images && i < images->items.size(); i++)
+	{
+		GltfImage image = {};
+		unsigned int stride;
+		ResolveView(Element(Member(&root, "bufferViews"), IndexOf(&images->items[i], "bufferView")), bin, binSize,
+			image.Data, image.Size, stride);
+		out.images.push_back(image);
+	}
+
+	// Materials, with glTF's defaults for anything left out
+	const GltfJson* materials = Member(&root, "materials");
+	for (size_t i = 0; materials && i < materials->items.size(); i++)
+	{
+		const GltfJson* entry = &materials->items[i];
+		const GltfJson* pbr = Member(entry, "pbrMetallicRoughness");
+		const GltfJson* color = Member(pbr, "baseColorFactor");
+
+		GltfMaterial material;
+		material.BaseColor = XMFLOAT4(
+			(float)NumberOr(Element(color, 0), 1.0), (float)NumberOr(Element(color, 1), 1.0),
+			(float)NumberOr(Element(color, 2), 1.0), (float)NumberOr(Element(color, 3), 1.0));
+		material.Metalness = (float)NumberOr(Member(pbr, "metallicFactor"), 1.0);
+		material.Roughness = (float)NumberOr(Member(pbr, "roughnessFactor"), 1.0);
+		material.BaseColorImage = ResolveTexture(root, Member(pbr, "baseColorTexture"));
+		material.MetalRoughnessImage = ResolveTexture(root, Member(pbr, "metallicRoughnessTexture"));
+		material.NormalImage = ResolveTexture(root, Member(entry, "normalTexture"));
+		if ((size_t)material.BaseColorImage >= out.images.size()) material.BaseColorImage = -1;
+		if ((size_t)material.MetalRoughnessImage >= out.images.size()) material.MetalRoughnessImage = -1;
+		if ((size_t)material.NormalImage >= out.images.size()) material.NormalImage = -1;
+		out.materials.push_back(material);
+	}
+
+	// Every triangle list of every mesh
+	const GltfJson* meshes = Member(&root, "meshes");
+	for (size_t m = 0; meshes && m < meshes->items.size(); m++)
+	{
+		const GltfJson* primitives = Member(&meshes->items[m], "primitives");
+		for (size_t p = 0; primitives && p < primitives->items.size(); p++)
+		{
+			const GltfJson* entry = &primitives->items[p];
+			if (NumberOr(Member(entry, "mode"), GLTF_TRIANGLES) != GLTF_TRIANGLES)
+				continue;
+
+			const GltfJson* attributes = Member(entry, "attributes");
+			GltfPrimitive primitive;
+			primitive.Positions = ResolveAttribute(root, attributes, "POSITION", 3, 0, bin, binSize);
+			if (!primitive.Positions.Data || primitive.Positions.ComponentType != GLTF_FLOAT)
+				continue;
+
+			unsigned int vertexCount = primitive.Positions.Count;
+			primitive.Normals = ResolveAttribute(root, attributes, "NORMAL", 3, vertexCount, bin, binSize);
+			primitive.UVs = ResolveAttribute(root, attributes, "TEXCOORD_0", 2, vertexCount, bin, binSize);
+			primitive.Tangents = ResolveAttribute(root, attributes, "TANGENT", 4, vertexCount, bin, binSize);
+			primitive.Indices = GltfAccessor();
+
+			// Indices that are there but unreadable would leave nothing sensible to draw
+			int indices = IndexOf(entry, "indices");
+			if (indices >= 0)
+			{
+				primitive.Indices = ResolveAccessor(root, indices, bin, binSize);
+				if (!primitive.Indices.Data || primitive.Indices.Components != 1 || primitive.Indices.Normalized ||
+					(primitive.Indices.ComponentType != GLTF_UNSIGNED_BYTE &&
+					 primitive.Indices.ComponentType != GLTF_UNSIGNED_SHORT &&
+					 primitive.Indices.ComponentType != GLTF_UNSIGNED_INT))
+					continue;
+			}
+
+			primitive.Material = IndexOf(entry, "material");
+			if ((size_t)primitive.Material >= out.materials.size())
+				primitive.Material = -1;
+			out.primitives.push_back(primitive);
+		}
+	}
+
+	return !out.primitives.empty();
+}
+
+bool GltfLoader::MatchesVertexLayout(const GltfPrimitive& primitive)
+{
+	const GltfAccessor* attributes[] = { &primitive.Positions, &primitive.Normals, &primitive.UVs, &primitive.Tangents };
+	const size_t offsets[] = { offsetof(Vertex, Position), offsetof(Vertex, Normal), offsetof(Vertex, UV), offsetof(Vertex, Tangent) };
+	for (int i = 0; i < 4; i++)
+	{
+		if (!attributes[i]->Data || attributes[i]->ComponentType != GLTF_FLOAT || attributes[i]->Stride != sizeof(Vertex) ||
+			attributes[i]->Data != primitive.Positions.Data + offsets[i])
+			return false;
+	}
+	return true;
+}
+
+bool GltfLoader::BuildVertices(const GltfPrimitive& primitive, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	verts.clear();
+	indices.clear();
+	unsigned int numVerts = primitive.Positions.Count;
+	if (!primitive.Positions.Data || numVerts == 0)
+		return false;
+
+	if (MatchesVertexLayout(primitive))
+	{
+		// Already interleaved the same way, so the whole block is copied at once
+		verts.resize(numVerts);
+		memcpy(&verts[0], primitive.Positions.Data, (size_t)numVerts * sizeof(Vertex));
+	}
+	else
+	{
+		// Otherwise each attribute is gathered from wherever it is (anything missing stays zero)
+		verts.resize(numVerts);
+		float element[4];
+		for (unsigned int i = 0; i < numVerts; i++)
+		{
+			ReadElement(primitive.Positions, i, element);
+			verts[i].Position = XMFLOAT3(element[0], element[1], element[2]);
+			if (primitive.Normals.Data)
+			{
+				ReadElement(primitive.Normals, i, element);
+				verts[i].Normal = XMFLOAT3(element[0], element[1], element[2]);
+			}
+			if (primitive.UVs.Data)
+			{
+				ReadElement(primitive.UVs, i, element);
+				verts[i].UV = XMFLOAT2(element[0], element[1]);
+			}
+			if (primitive.Tangents.Data)
+			{
+				ReadElement(primitive.Tangents, i, element);
+				verts[i].Tangent = XMFLOAT4(element[0], element[1], element[2], element[3]);
+			}
+		}
+	}
+
+	// Non-indexed primitives just use every vertex in order
+	if (primitive.Indices.Data)
+	{
+		indices.resize(primitive.Indices.Count);
+		for (unsigned int i = 0; i < primitive.Indices.Count; i++)
+		{
+			indices[i] = ReadIndex(primitive.Indices, i);
+			if (indices[i] >= numVerts)
+				return false;
+		}
+	}
+	else
+	{
+		indices.resize(numVerts);
+		for (unsigned int i = 0; i < numVerts; i++)
+			indices[i] = i;
+	}
+	indices.resize(indices.size() - indices.size() % 3);
+
+	// glTF is right-handed, so mirror Z and reverse the winding (uvs already start at the top left, like
+	// DirectX's). Mirroring also flips the sign of cross(N, T), which glTF builds bitangents from, but the
+	// shaders use cross(T, N) (see TangentGenerator), so the tangents' handedness stays as it is.
+	for (Vertex& vertex : verts)
+	{
+		vertex.Position.z *= -1.0f;
+		vertex.Normal.z *= -1.0f;
+		vertex.Tangent.z *= -1.0f;
+	}
+	for (size_t i = 0; i < indices.size(); i += 3)
+		std::swap(indices[i + 1], indices[i + 2]);
+
+	// glTF leaves the normals to the importer when there aren't any, so smooth them from the faces
+	if (!primitive.Normals.Data)
+	{
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			XMVECTOR a = XMLoadFloat3(&verts[indices[i]].Position);
+			XMVECTOR b = XMLoadFloat3(&verts[indices[i + 1]].Position);
+			XMVECTOR c = XMLoadFloat3(&verts[indices[i + 2]].Position);
+			XMVECTOR face = XMVector3Cross(b - a, c - a);	// Area weighted
+			for (int corner = 0; corner < 3; corner++)
+				XMStoreFloat3(&verts[indices[i + corner]].Normal, XMLoadFloat3(&verts[indices[i + corner]].Normal) + face);
+		}
+		for (Vertex& vertex : verts)
+		{
+			XMVECTOR normal = XMLoadFloat3(&vertex.Normal);
+			XMStoreFloat3(&vertex.Normal, XMVectorGetX(XMVector3LengthSq(normal)) > 0.0f ? XMVector3Normalize(normal) : XMVectorSet(0, 1, 0, 0));
+		}
+	}
+
+	return !indices.empty();
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GltfLoader::LoadImage(const GltfImage& image,
+	Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	// Decoded right out of the mapped file, the context is what generates the mips
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (image.Data)
+		CreateWICTextureFromMemory(device.Get(), context.Get(), (const uint8_t*)image.Data, image.Size, 0, srv.GetAddressOf());
+	return srv;
+}
+
+bool GltfLoader::Import(const wchar_t* fileName,
+	Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+	std::shared_ptr<SimpleVertexShader> vertexShader, std::shared_ptr<SimplePixelShader> pixelShader,
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler, GltfModel& out,
+	VertexFormat vertexFormat, MeshResidency residency, std::shared_ptr<GeometryPool> pool)
+{
+	out = GltfModel();
+	MappedFile file(fileName);
+	GltfData gltf;
+	if (!file.IsOpen() || !Parse(file.GetData(), file.GetSize(), gltf))
+		return false;
+
+	// Each image is decoded once, however many materials use it
+	std::vector<Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> images(gltf.images.size());
+	auto getImage = [&](int index)
+	{
+		if (!images[index])
+			images[index] = LoadImage(gltf.images[index], device, context);
+		return images[index];
+	};
+
+	// The shaders use textures in place of the factors, rather than multiplying them together
+	std::vector<std::shared_ptr<Material>> materials;
+	for (const GltfMaterial& gltfMaterial : gltf.materials)
+	{
+		std::shared_ptr<Material> material = std::make_shared<Material>(gltfMaterial.BaseColor,
+			gltfMaterial.Roughness, gltfMaterial.Metalness, vertexShader, pixelShader);
+		if (gltfMaterial.BaseColorImage >= 0 && getImage(gltfMaterial.BaseColorImage))
+			material->AddTextureSRV("AlbedoMap", getImage(gltfMaterial.BaseColorImage));
+		if (gltfMaterial.MetalRoughnessImage >= 0 && getImage(gltfMaterial.MetalRoughnessImage))
+			material->AddTextureSRV("MetalRoughnessMap", getImage(gltfMaterial.MetalRoughnessImage));
+		if (gltfMaterial.NormalImage >= 0 && getImage(gltfMaterial.NormalImage))
+			material->AddTextureSRV("NormalMap", getImage(gltfMaterial.NormalImage));
+		material->AddSampler("SamplerOptions", sampler);
+		materials.push_back(material);
+	}
+
+	// glTF's default material is plain white and fully rough metal
+	std::shared_ptr<Material> defaultMaterial;
+
+	for (unsigned int i = 0; i < gltf.primitives.size(); i++)
+	{
+		std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(fileName, i, device, context, false, true, vertexFormat, residency, pool);
+		if (mesh->GetIndexCount() == 0)
+			continue;
+
+		int index = gltf.primitives[i].Material;
+		if (index < 0 && !defaultMaterial)
+		{
+			defaultMaterial = std::make_shared<Material>(XMFLOAT4(1, 1, 1, 1), 1.0f, 1.0f, vertexShader, pixelShader);
+			defaultMaterial->AddSampler("SamplerOptions", sampler);
+		}
+		out.Meshes.push_back(mesh);
+		out.Materials.push_back(index >= 0 ? materials[index] : defaultMaterial);
+	}
+
+	return !out.Meshes.empty();
+}
+
+bool GltfLoader::Benchmark(const char* data, size_t size, const wchar_t* objFileName, GltfObjBenchmark& out)
+{
+	out = GltfObjBenchmark();
+	MappedFile obj(objFileName);
+	if (!obj.IsOpen())
+		return false;
+
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+
+	auto glbStart = std::chrono::high_resolution_clock::now();
+	GltfData gltf;
+	if (!Parse(data, size, gltf))
+		return false;
+	for (const GltfPrimitive& primitive : gltf.primitives)
+	{
+		BuildVertices(primitive, verts, indices);
+		out.GlbVertices += (unsigned int)verts.size();
+		out.GlbPrimitivesInPlace += MatchesVertexLayout(primitive) ? 1 : 0;
+	}
+	out.GlbPrimitives = (unsigned int)gltf.primitives.size();
+	out.GlbMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - glbStart).count();
+
+	// Loaded the way Mesh loads .obj text, on as many threads as it would use
+	auto objStart = std::chrono::high_resolution_clock::now();
+	unsigned int threadCount = obj.GetSize() >= OBJ_PARALLEL_THRESHOLD ? std::thread::hardware_concurrency() : 1;
+	ObjData objData;
+	if (!ObjLoader::Parse(obj.GetData(), obj.GetSize(), objData, threadCount))
+		return false;
+	ObjLoader::BuildVertices(objData, verts, indices);
+	out.ObjVertices = (unsigned int)verts.size();
+	out.ObjMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - objStart).count();
+	return true;
+}
+
+void GltfLoader::ReadElement(const GltfAccessor& accessor, unsigned int index, float* out)
+{
+	// Integer components are only normalized when the accessor says so
+	const char* element = accessor.Data + (size_t)accessor.Stride * index;
+	for (unsigned int c = 0; c < accessor.Components; c++)
+	{
+		switch (accessor.ComponentType)
+		{
+		case GLTF_FLOAT:
+			memcpy(&out[c], element + c * 4, 4);
+			break;
+		case GLTF_BYTE:
+		{
+			signed char value = (signed char)element[c];
+			out[c] = accessor.Normalized ? (std::max)(value / 127.0f, -1.0f) : value;
+			break;
+		}
+		case GLTF_UNSIGNED_BYTE:
+		{
+			unsigned char value = (unsigned char)element[c];
+			out[c] = accessor.Normalized ? value / 255.0f : value;
+			break;
+		}
+		case GLTF_SHORT:
+		{
+			short value;
+			memcpy(&value, element + c * 2, 2);
+			out[c] = accessor.Normalized ? (std::max)(value / 32767.0f, -1.0f) : value;
+			break;
+		}
+		case GLTF_UNSIGNED_SHORT:
+		{
+			unsigned short value;
+			memcpy(&value, element + c * 2, 2);
+			out[c] = accessor.Normalized ? value / 65535.0f : value;
+			break;
+		}
+		case GLTF_UNSIGNED_INT:
+		{
+			unsigned int value;
+			memcpy(&value, element + c * 4, 4);
+			out[c] = (float)value;
+			break;
+		}
+		}
+	}
+}
+
+unsigned int GltfLoader::ReadIndex(const GltfAccessor& accessor, unsigned int index)
+{
+	const char* element = accessor.Data + (size_t)accessor.Stride * index;
+	switch (accessor.ComponentType)
+	{
+	case GLTF_UNSIGNED_BYTE:
+		return (unsigned char)*element;
+	case GLTF_UNSIGNED_SHORT:
+	{
+		unsigned short value;
+		memcpy(&value, element, 2);
+		return value;
+	}
+	default:
+	{
+		unsigned int value;
+		memcpy(&value, element, 4);
+		return value;
+	}
+	}
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+#include "Mesh.h"
+
+class Material;
+class SimpleVertexShader;
+class SimplePixelShader;
+
+// The parts of a binary glTF (.glb) file: a header, then a JSON chunk and a binary chunk
+#define GLB_MAGIC 0x46546C67		// "glTF"
+#define GLB_VERSION 2
+#define GLB_CHUNK_JSON 0x4E4F534A	// "JSON"
+#define GLB_CHUNK_BIN 0x004E4942	// "BIN\0"
+
+// Accessor component types
+#define GLTF_BYTE 5120
+#define GLTF_UNSIGNED_BYTE 5121
+#define GLTF_SHORT 5122
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT 5125
+#define GLTF_FLOAT 5126
+
+// Primitive modes (only triangle lists are imported)
+#define GLTF_TRIANGLES 4
+
+// One attribute or index array, viewed in place in the file's binary chunk
+struct GltfAccessor
+{
+	const char* Data;			// First element, or null if the primitive doesn't have this one
+	unsigned int Count;
+	unsigned int Stride;		// Bytes from one element to the next
+	unsigned int ComponentType;	// GLTF_BYTE to GLTF_FLOAT
+	unsigned int Components;	// 1 for scalars up to 4 for VEC4
+	bool Normalized;			// Integer components map to 0..1 (or -1..1 when signed)
+};
+
+// One triangle list and the material it's drawn with
+struct GltfPrimitive
+{
+	GltfAccessor Positions;
+	GltfAccessor Normals;
+	GltfAccessor UVs;
+	GltfAccessor Tangents;
+	GltfAccessor Indices;	// Null data for primitives that aren't indexed
+	int Material;			// Index into GltfData::materials, -1 for the default material
+};
+
+// An encoded image (PNG or JPEG), also viewed in place
+struct GltfImage
+{
+	const char* Data;	// Null for images in separate files, which aren't supported
+	size_t Size;
+};
+
+// The metallic-roughness parameters, with textures already resolved to images
+struct GltfMaterial
+{
+	DirectX::XMFLOAT4 BaseColor;
+	float Metalness;
+	float Roughness;
+	int BaseColorImage;			// Indices into GltfData::images, -1 if there's no texture
+	int MetalRoughnessImage;	// Roughness in green, metalness in blue
+	int NormalImage;
+};
+
+// The contents of a .glb file, pointing into the file's own bytes, so the file
+// has to stay mapped (see MappedFile) for as long as this is used
+struct GltfData
+{
+	std::vector<GltfPrimitive> primitives;	// Every triangle list of every mesh, in file order
+	std::vector<GltfMaterial> materials;
+	std::vector<GltfImage> images;
+};
+
+// Every primitive of a file as its own mesh, with the material to draw it with
+struct GltfModel
+{
+	std::vector<std::shared_ptr<Mesh>> Meshes;
+	std::vector<std::shared_ptr<Material>> Materials;	// One per mesh, shared by meshes using the same glTF material
+};
+
+// Load times of the same model as .glb and as .obj text, from parsing to finished vertices
+struct GltfObjBenchmark
+{
+	double GlbMs;
+	double ObjMs;
+	unsigned int GlbVertices;
+	unsigned int ObjVertices;
+	unsigned int GlbPrimitivesInPlace;	// Primitives whose vertices were laid out exactly like Vertex
+	unsigned int GlbPrimitives;
+};
+
+// --------------------------------------------------------
+// Binary glTF 2.0 (.glb) model loading
+//
+// - Nothing is read into buffers of its own: the JSON is
+//   parsed straight out of the mapped file, and accessors
+//   and images are just pointers into its binary chunk
+// - Vertices are built in one pass over those pointers.
+//   When the file interleaves its attributes exactly like
+//   Vertex, that's one block copy instead of a gather.
+// - glTF is right-handed, so Z is flipped and the winding
+//   reversed on the way in (like ObjLoader does). The
+//   converted result is what MeshCache stores, so after
+//   the first load a mesh comes straight from its cache.
+// - Only what the engine can draw is read: triangle lists,
+//   positions, normals, the first uv set, tangents and
+//   the metallic-roughness material. Separate .bin and
+//   image files, sparse accessors and animation are not.
+// --------------------------------------------------------
+class GltfLoader
+{
+public:
+
+	// Checks the header, without parsing anything
+	static bool IsGlb(const char* data, size_t size);
+
+	// Parses a whole .glb file. Returns false if it's malformed or has no triangles.
+	static bool Parse(const char* data, size_t size, GltfData& out);
+
+	// Converts a primitive to the engine's vertices and left-handed space. Missing normals are
+	// smoothed from the faces, and missing tangents are left at zero for TangentGenerator.
+	static bool BuildVertices(const GltfPrimitive& primitive, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+
+	// Whether the primitive's attributes are interleaved exactly like Vertex
+	static bool MatchesVertexLayout(const GltfPrimitive& primitive);
+
+	// Decodes an image straight from the file's bytes, with mips
+	static Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> LoadImage(const GltfImage& image,
+		Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	// Loads every primitive as a Mesh (see its .glb constructor) along with its material
+	static bool Import(const wchar_t* fileName,
+		Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
+		std::shared_ptr<SimpleVertexShader> vertexShader, std::shared_ptr<SimplePixelShader> pixelShader,
+		Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler, GltfModel& out,
+		VertexFormat vertexFormat = VERTEX_FORMAT_FULL, MeshResidency residency = MESH_RESIDENCY_NONE,
+		std::shared_ptr<GeometryPool> pool = 0);
+
+	// Times loading a .glb file against loading the same model from .obj text (see ObjLoader)
+	static bool Benchmark(const char* data, size_t size, const wchar_t* objFileName, GltfObjBenchmark& out);
+
+private:
+
+	static void ReadElement(const GltfAccessor& accessor, unsigned int index, float* out);
+	static unsigned int ReadIndex(const GltfAccessor& accessor, unsigned int index);
+};
@@ -0,0 +1,511 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+// --------------------------------------------------------
+// A Chase-Lev work-stealing deque of jobs, fixed size
+//
+// - Only its owner pushes and pops, at the bottom
+// - Anyone can steal from the top, and the only contention
+//   is over the last job, settled with a compare-exchange
+// - Follows "Correct and Efficient Work-Stealing for Weak
+//   Memory Models" (Le et al. 2013), with the slots
+//   themselves released and acquired so the job's contents
+//   are visible to whoever takes it
+// - Where the paper has a fence, the ordering is on the
+//   load or store next to it instead (a seq_cst store is the
+//   same one locked instruction on x86), as ThreadSanitizer
+//   doesn't follow standalone fences
+// --------------------------------------------------------
+class JobDeque
+{
+public:
+
+	JobDeque() : top(0), bottom(0)
+	{
+		for (std::atomic<Job*>& slot : slots)
+			slot.store(0, std::memory_order_relaxed);
+	}
+
+	// Owner only. Returns false if it's full.
+	bool Push(Job* job)
+	{
+		long long b = bottom.load(std::memory_order_relaxed);
+		long long t = top.load(std::memory_order_acquire);
+		if (b - t >= JOB_SYSTEM_MAX_JOBS)
+			return false;
+
+		slots[b & (JOB_SYSTEM_MAX_JOBS - 1)].store(job, std::memory_order_release);
+		bottom.store(b + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Owner only, newest first
+	Job* Pop()
+	{
+		long long b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_seq_cst);
+		long long t = top.load(std::memory_order_seq_cst);
+
+		if (t > b)
+		{
+			// Already empty
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return 0;
+		}
+
+		Job* job = slots[b & (JOB_SYSTEM_MAX_JOBS - 1)].load(std::memory_order_acquire);
+		if (t == b)
+		{
+			// The last one, which a thief might be taking at the same time
+			if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				job = 0;
+			bottom.store(b + 1, std::memory_order_relaxed);
+		}
+		return job;
+	}
+
+	// Any thread, oldest first. Null if it's empty or another thread got there first.
+	Job* Steal()
+	{
+		long long t = top.load(std::memory_order_seq_cst);
+		long long b = bottom.load(std::memory_order_seq_cst);
+		if (t >= b)
+			return 0;
+
+		Job* job = slots[t & (JOB_SYSTEM_MAX_JOBS - 1)].load(std::memory_order_acquire);
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return 0;
+		return job;
+	}
+
+	bool IsEmpty()
+	{
+		return top.load(std::memory_order_acquire) >= bottom.load(std::memory_order_acquire);
+	}
+
+private:
+
+	// Kept a cache line apart, as thieves hammer top and the owner bottom (padded rather than
+	// aligned, as new doesn't over-align before C++17)
+	std::atomic<long long> top;
+	char topPadding[64];
+	std::atomic<long long> bottom;
+	char bottomPadding[64];
+	std::atomic<Job*> slots[JOB_SYSTEM_MAX_JOBS];
+};
+
+// Everything one thread owns
+struct JobWorker
+{
+	JobDeque Deque;
+	std::unique_ptr<Job[]> Jobs;	// Handed out in order, like a ring
+	unsigned int NextJob;
+	unsigned int Random;			// For picking who to steal from
+};
+
+// Which system (and which of its threads) the calling thread belongs to
+static thread_local JobSystem* currentSystem = 0;
+static thread_local unsigned int currentThread = 0;
+
+JobSystem::JobSystem(unsigned int threadCount)
+{
+	if (threadCount == 0)
+		threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+
+	stopping = false;
+	sleeping = 0;
+	for (unsigned int i = 0; i < threadCount; i++)
+	{
+		workers.push_back(std::unique_ptr<JobWorker>(new JobWorker()));
+		workers[i]->Jobs.reset(new Job[JOB_SYSTEM_MAX_JOBS]);
+		for (unsigned int j = 0; j < JOB_SYSTEM_MAX_JOBS; j++)
+			workers[i]->Jobs[j].Unfinished.store(0, std::memory_order_relaxed);
+		workers[i]->NextJob = 0;
+		workers[i]->Random = 2463534242u + i * 7919u;
+	}
+
+	// This thread is thread 0, everything else gets a worker
+	mainThread = std::this_thread::get_id();
+	for (unsigned int i = 1; i < threadCount; i++)
+		threads.push_back(std::thread(&JobSystem::WorkerLoop, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	jobQueued.notify_all();
+
+	for (std::thread& thread : threads)
+		thread.join();
+}
+
+bool JobSystem::AddContinuation(Job* job, Job* continuation)
+{
+	if (job->ContinuationCount == JOB_MAX_CONTINUATIONS)
+		return false;
+	job->Continuations[job->ContinuationCount++] = continuation;
+	return true;
+}
+
+void JobSystem::Run(Job* job)
+{
+	// Nowhere to put it, so it just runs now
+	if (!GetWorker()->Deque.Push(job))
+	{
+		Execute(job);
+		return;
+	}
+
+	if (sleeping.load(std::memory_order_seq_cst) > 0)
+		jobQueued.notify_one();
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	JobWorker* worker = GetWorker();
+	while (counter.value.load(std::memory_order_acquire) != 0)
+	{
+		Job* job = Find(worker);
+		if (job)
+			Execute(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+unsigned int JobSystem::GetThreadCount()
+{
+	return (unsigned int)workers.size();
+}
+
+int JobSystem::GetThreadIndex()
+{
+	if (currentSystem == this)
+		return (int)currentThread;
+	return std::this_thread::get_id() == mainThread ? 0 : -1;
+}
+
+JobWorker* JobSystem::GetWorker()
+{
+	// Anything but a worker should be thread 0, as other threads aren't allowed
+	return workers[currentSystem == this ? currentThread : 0].get();
+}
+
+Job* JobSystem::Allocate()
+{
+	JobWorker* worker = GetWorker();
+
+	// Usually the next slot is long free. Slots still in use are skipped rather than waited on,
+	// as they can belong to a job further down this thread's own stack, waiting on this one.
+	unsigned int searched = JOB_SYSTEM_SEARCH;
+	for (;;)
+	{
+		for (unsigned int i = 0; i < searched; i++)
+		{
+			unsigned int index = (worker->NextJob + i) & (JOB_SYSTEM_MAX_JOBS - 1);
+			if (worker->Jobs[index].Unfinished.load(std::memory_order_acquire) == 0)
+			{
+				worker->NextJob = index + 1;
+				return &worker->Jobs[index];
+			}
+		}
+
+		// Nothing free nearby, so help until something is. Taking this thread's oldest job
+		// first frees the slot the next search starts from.
+		Job* other = worker->Deque.Steal();
+		if (!other)
+			other = Find(worker);
+		if (other)
+		{
+			Execute(other);
+			continue;
+		}
+
+		// Nothing left to help with, so whatever's free is further on
+		searched = JOB_SYSTEM_MAX_JOBS;
+		std::this_thread::yield();
+	}
+}
+
+Job* JobSystem::Find(JobWorker* worker)
+{
+	Job* job = worker->Deque.Pop();
+	if (job)
+		return job;
+
+	// Start somewhere random, so thieves spread out over everyone else
+	unsigned int count = (unsigned int)workers.size();
+	worker->Random ^= worker->Random << 13;
+	worker->Random ^= worker->Random >> 17;
+	worker->Random ^= worker->Random << 5;
+	unsigned int start = worker->Random % count;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		JobWorker* victim = workers[(start + i) % count].get();
+		if (victim == worker)
+			continue;
+		job = victim->Deque.Steal();
+		if (job)
+			return job;
+	}
+	return 0;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	job->Invoke(job->Data);
+	Finish(job);
+}
+
+void JobSystem::Finish(Job* job)
+{
+	// Children may still be running, in which case the last of them finishes this
+	if (job->Unfinished.fetch_sub(1, std::memory_order_acq_rel) != 2)
+		return;
+
+	// Everything's done, but the slot stays taken until what's needed from it is copied out
+	Job* parent = job->Parent;
+	JobCounter* counter = job->Counter;
+	unsigned int continuationCount = job->ContinuationCount;
+	Job* continuations[JOB_MAX_CONTINUATIONS];
+	std::copy(job->Continuations, job->Continuations + continuationCount, continuations);
+	job->Unfinished.store(0, std::memory_order_release);
+
+	for (unsigned int i = 0; i < continuationCount; i++)
+		Run(continuations[i]);
+	if (parent)
+		Finish(parent);
+	if (counter)
+		counter->value.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void JobSystem::WorkerLoop(unsigned int thread)
+{
+	currentSystem = this;
+	currentThread = thread;
+	JobWorker* worker = workers[thread].get();
+
+	unsigned int idle = 0;
+	while (!stopping.load(std::memory_order_acquire))
+	{
+		Job* job = Find(worker);
+		if (job)
+		{
+			Execute(job);
+			idle = 0;
+			continue;
+		}
+
+		// Spin for a little while, as more work usually shows up soon within a frame...
+		if (++idle < 64)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// ...then sleep. The timeout covers a job queued between looking and sleeping.
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		if (stopping)
+			break;
+		sleeping.fetch_add(1, std::memory_order_seq_cst);
+		jobQueued.wait_for(lock, std::chrono::milliseconds(1));
+		sleeping.fetch_sub(1, std::memory_order_seq_cst);
+		idle = 0;
+	}
+}
+
+JobSystemBenchmark JobSystem::Benchmark(unsigned int threadCount)
+{
+	JobSystemBenchmark result = {};
+	JobSystem jobs(threadCount);
+	result.Threads = jobs.GetThreadCount();
+
+	// Empty jobs, all queued by this thread
+	const unsigned int spawnCount = 100000;
+	{
+		JobCounter counter;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < spawnCount; i++)
+			jobs.Run([]() {}, &counter);
+		jobs.Wait(counter);
+		result.SpawnNs = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / spawnCount;
+	}
+
+	// Empty jobs queued by a hundred jobs, wherever those end up running
+	{
+		JobCounter counter;
+		JobSystem* system = &jobs;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (unsigned int i = 0; i < 100; i++)
+		{
+			jobs.Run([system, &counter]()
+			{
+				for (unsigned int j = 0; j < spawnCount / 100; j++)
+					system->Run([]() {}, &counter);
+			}, &counter);
+		}
+		jobs.Wait(counter);
+		result.NestedSpawnNs = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / spawnCount;
+	}
+
+	// Some arithmetic per element, roughly the weight of a small entity update
+	const unsigned int count = 1 << 22;
+	std::vector<float> serial(count), parallel(count);
+	auto work = [](unsigned int i)
+	{
+		float x = (float)i * 0.001f;
+		return sqrtf(x) * sinf(x) + cosf(x * 0.5f);
+	};
+
+	auto serialStart = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < count; i++)
+		serial[i] = work(i);
+	result.SerialMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - serialStart).count();
+
+	auto parallelStart = std::chrono::high_resolution_clock::now();
+	jobs.ParallelFor(0, count, 4096, [&](unsigned int first, unsigned int end)
+	{
+		for (unsigned int i = first; i < end; i++)
+			parallel[i] = work(i);
+	});
+	result.ParallelForMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - parallelStart).count();
+
+	result.Matches = serial == parallel;
+	return result;
+}
+
+bool JobSystem::SelfTest()
+{
+	bool passed = true;
+	auto check = [&](bool condition, const char* what)
+	{
+		if (condition)
+			return;
+		passed = false;
+#if defined(DEBUG) || defined(_DEBUG)
+		printf("Job system self test failed: %s\n", what);
+#endif
+	};
+
+	// At least a few threads, even on small machines, so there's really something to race
+	JobSystem jobs((std::max)(4u, std::thread::hardware_concurrency()));
+	JobSystem* system = &jobs;
+
+	// Far more jobs than there are slots, so every thread's ring wraps around a few times
+	{
+		const unsigned int count = JOB_SYSTEM_MAX_JOBS * 8;
+		std::vector<unsigned int> ran(count, 0);
+		JobCounter counter;
+		for (unsigned int i = 0; i < count; i++)
+			jobs.Run([&ran, i]() { ran[i]++; }, &counter);
+		jobs.Wait(counter);
+		check(std::count(ran.begin(), ran.end(), 1u) == (long)count, "every job ran exactly once");
+		check(counter.IsDone(), "the counter reached zero");
+	}
+
+	// A parent isn't finished (and its counter isn't done) until its children are
+	{
+		std::atomic<unsigned int> childrenDone(0);
+		std::atomic<bool> parentEarly(false);
+		JobCounter counter;
+		Job* parent = jobs.Create([]() {}, &counter);
+		for (unsigned int i = 0; i < 16; i++)
+		{
+			jobs.Run(jobs.CreateChild(parent, [&childrenDone]()
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+				childrenDone.fetch_add(1);
+			}));
+		}
+		Job* after = jobs.Create([&childrenDone, &parentEarly]() { parentEarly = childrenDone.load() != 16; }, &counter);
+		jobs.AddContinuation(parent, after);
+		jobs.Run(parent);
+		jobs.Wait(counter);
+		check(childrenDone.load() == 16, "children finished before the parent's counter");
+		check(!parentEarly.load(), "continuation ran after the children");
+	}
+
+	// Continuations in a chain run in order
+	{
+		std::vector<unsigned int> order;
+		JobCounter counter;
+		Job* first = jobs.Create([&order]() { order.push_back(0); }, &counter);
+		Job* previous = first;
+		for (unsigned int i = 1; i < 8; i++)
+		{
+			Job* next = jobs.Create([&order, i]() { order.push_back(i); }, &counter);
+			jobs.AddContinuation(previous, next);
+			previous = next;
+		}
+		jobs.Run(first);
+		jobs.Wait(counter);
+		bool inOrder = order.size() == 8;
+		for (unsigned int i = 0; inOrder && i < 8; i++)
+			inOrder = order[i] == i;
+		check(inOrder, "continuations ran in order");
+	}
+
+	// ParallelFor inside ParallelFor, which waits inside jobs
+	{
+		const unsigned int outer = 64, inner = 10000;
+		std::vector<unsigned long long> sums(outer, 0);
+		jobs.ParallelFor(0, outer, 1, [&](unsigned int first, unsigned int end)
+		{
+			for (unsigned int i = first; i < end; i++)
+			{
+				std::atomic<unsigned long long> sum(0);
+				system->ParallelFor(0, inner, 100, [&sum](unsigned int a, unsigned int b)
+				{
+					unsigned long long local = 0;
+					for (unsigned int j = a; j < b; j++)
+						local += j;
+					sum.fetch_add(local);
+				});
+				sums[i] = sum.load();
+			}
+		});
+		unsigned long long expected = (unsigned long long)inner * (inner - 1) / 2;
+		check(std::count(sums.begin(), sums.end(), expected) == (long)outer, "nested parallel for");
+	}
+
+	// Every range is covered exactly once, whatever the grain size
+	for (unsigned int grain : { 0u, 1u, 7u, 1000u, 100000u })
+	{
+		std::vector<unsigned char> covered(12345, 0);
+		jobs.ParallelFor(0, (unsigned int)covered.size(), grain, [&covered](unsigned int first, unsigned int end)
+		{
+			for (unsigned int i = first; i < end; i++)
+				covered[i]++;
+		});
+		check(std::count(covered.begin(), covered.end(), 1) == (long)covered.size(), "parallel for covers each index once");
+	}
+
+	// Work queued from one thread gets picked up by others
+	{
+		std::vector<std::atomic<unsigned int>> perThread(jobs.GetThreadCount());
+		for (std::atomic<unsigned int>& count : perThread)
+			count = 0;
+		JobCounter counter;
+		for (unsigned int i = 0; i < 256; i++)
+		{
+			jobs.Run([system, &perThread]()
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+				perThread[system->GetThreadIndex()]++;
+			}, &counter);
+		}
+		jobs.Wait(counter);
+		unsigned int threadsUsed = 0;
+		for (std::atomic<unsigned int>& count : perThread)
+			threadsUsed += count.load() > 0;
+		check(threadsUsed > 1, "jobs were stolen");
+	}
+
+	return passed;
+}
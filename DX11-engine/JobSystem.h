@@ -0,0 +1,215 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Jobs each thread can have created and not yet finished, and how many each thread's deque holds
+// (both powers of two). A thread that runs out runs other jobs until one of its own finishes.
+#define JOB_SYSTEM_MAX_JOBS 4096
+
+// Slots looked at for a free one before helping with other jobs instead
+#define JOB_SYSTEM_SEARCH 64
+
+// How big a job's function (its lambda and everything it captures) can be
+#define JOB_DATA_SIZE 64
+
+// Jobs a finished job can start
+#define JOB_MAX_CONTINUATIONS 4
+
+// --------------------------------------------------------
+// Counts jobs that haven't finished yet, for waiting on
+// with JobSystem::Wait()
+// --------------------------------------------------------
+class JobCounter
+{
+public:
+
+	JobCounter() : value(0) {}
+	JobCounter(const JobCounter& other) = delete;
+	JobCounter& operator=(const JobCounter& other) = delete;
+
+	unsigned int GetValue() { return value.load(std::memory_order_acquire); }
+	bool IsDone() { return GetValue() == 0; }
+
+private:
+
+	friend class JobSystem;
+	std::atomic<unsigned int> value;
+};
+
+// One piece of work, with its function stored inline so making one never allocates
+struct Job
+{
+	void (*Invoke)(void* data);	// Calls the function stored in Data, then destroys it
+	Job* Parent;				// Not finished until this one is
+	JobCounter* Counter;		// Counted down once this (and all its children) finish
+	std::atomic<unsigned int> Unfinished;	// One more than this and its unfinished children, zero once the slot is free
+	unsigned int ContinuationCount;
+	Job* Continuations[JOB_MAX_CONTINUATIONS];
+	alignas(16) char Data[JOB_DATA_SIZE];
+};
+
+// Spawning empty jobs, and a ParallelFor against a plain loop, at one thread count
+struct JobSystemBenchmark
+{
+	unsigned int Threads;
+	double SpawnNs;			// Per job, to create, run and wait on an empty job from one thread
+	double NestedSpawnNs;	// The same, with jobs spawning jobs across every thread
+	double ParallelForMs;
+	double SerialMs;
+	bool Matches;			// Both loops came up with the same results
+};
+
+struct JobWorker;
+
+// --------------------------------------------------------
+// A pool of threads, one per core, that run small jobs
+//
+// - The thread that makes the system is thread 0, and any
+//   other threads are workers. Only those threads can make,
+//   run or wait on jobs.
+// - Each thread pushes and pops jobs at the bottom of its
+//   own Chase-Lev deque, and threads that run out steal from
+//   the top of someone else's, so nothing is shared until a
+//   thread has nothing to do
+// - Wait() runs other jobs until its counter reaches zero,
+//   so it's safe (and doesn't tie up a thread) inside a job
+// - Every job made with Create() has to be Run() at some
+//   point (directly, or as a continuation), or its slot is
+//   never freed
+// - Anything still queued when the system is destroyed is
+//   dropped, so wait for it first
+// --------------------------------------------------------
+class JobSystem
+{
+public:
+
+	// Zero threads means one per core
+	JobSystem(unsigned int threadCount = 0);
+	~JobSystem();
+	JobSystem(const JobSystem& other) = delete;
+	JobSystem& operator=(const JobSystem& other) = delete;
+
+	// A job for function(), which doesn't start until it's Run(). The counter (if any) counts it
+	// from now until it and any children finish.
+	template <class Function>
+	Job* Create(Function function, JobCounter* counter = 0)
+	{
+		static_assert(sizeof(Function) <= JOB_DATA_SIZE, "Capture less, or capture a pointer to the data");
+		static_assert(alignof(Function) <= 16, "Job functions can't need more than 16 byte alignment");
+
+		Job* job = Allocate();
+		new (job->Data) Function(std::move(function));
+		job->Invoke = &InvokeFunction<Function>;
+		job->Parent = 0;
+		job->Counter = counter;
+		job->ContinuationCount = 0;
+		job->Unfinished.store(2, std::memory_order_relaxed);
+		if (counter)
+			counter->value.fetch_add(1, std::memory_order_relaxed);
+		return job;
+	}
+
+	// A job the parent won't be finished without. Made while the parent is still running
+	// (usually from inside it), or before it's Run().
+	template <class Function>
+	Job* CreateChild(Job* parent, Function function)
+	{
+		Job* job = Create(std::move(function));
+		job->Parent = parent;
+		parent->Unfinished.fetch_add(1, std::memory_order_relaxed);
+		return job;
+	}
+
+	// Runs the continuation once the job (and its children) finish. Only before the job is Run().
+	// Returns false if the job already has JOB_MAX_CONTINUATIONS.
+	bool AddContinuation(Job* job, Job* continuation);
+
+	// Queues a job on this thread, for it or any other to pick up
+	void Run(Job* job);
+
+	template <class Function>
+	Job* Run(Function function, JobCounter* counter = 0)
+	{
+		Job* job = Create(std::move(function), counter);
+		Run(job);
+		return job;
+	}
+
+	// Runs jobs (any, not just the counted ones) until the counter reaches zero
+	void Wait(JobCounter& counter);
+
+	// Calls function(first, end) over [begin, end) in ranges of at most grainSize, in parallel, and
+	// returns once they're all done. Ranges are split in half as they're stolen, so only about
+	// log2(count / grainSize) jobs are ever queued per thread.
+	template <class Function>
+	void ParallelFor(unsigned int begin, unsigned int end, unsigned int grainSize, const Function& function)
+	{
+		if (end <= begin)
+			return;
+		if (grainSize == 0)
+			grainSize = 1;
+
+		JobCounter counter;
+		ParallelForRange(begin, end, grainSize, function, &counter);
+		Wait(counter);
+	}
+
+	unsigned int GetThreadCount();
+
+	// Which thread (0 for the one that made the system) is calling, or -1 for any other
+	int GetThreadIndex();
+
+	// Times spawning and a ParallelFor on a system with this many threads
+	static JobSystemBenchmark Benchmark(unsigned int threadCount);
+
+	// Counters, children, continuations, nesting and running out of job slots, under load.
+	// Returns false (and prints what went wrong in debug builds) if anything didn't add up.
+	static bool SelfTest();
+
+private:
+
+	std::vector<std::unique_ptr<JobWorker>> workers;	// Indexed by thread, including thread 0
+	std::vector<std::thread> threads;
+	std::thread::id mainThread;		// Thread 0
+	std::atomic<bool> stopping;
+
+	// Idle workers sleep here until a job is queued
+	std::mutex sleepMutex;
+	std::condition_variable jobQueued;
+	std::atomic<unsigned int> sleeping;
+
+	template <class Function>
+	static void InvokeFunction(void* data)
+	{
+		Function& function = *(Function*)data;
+		function();
+		function.~Function();
+	}
+
+	template <class Function>
+	void ParallelForRange(unsigned int begin, unsigned int end, unsigned int grainSize, const Function& function, JobCounter* counter)
+	{
+		// Hand off the top half (which is what gets stolen) and keep going with the bottom
+		while (end - begin > grainSize)
+		{
+			unsigned int middle = begin + (end - begin) / 2;
+			Run([this, middle, end, grainSize, &function, counter]() { ParallelForRange(middle, end, grainSize, function, counter); }, counter);
+			end = middle;
+		}
+		function(begin, end);
+	}
+
+	JobWorker* GetWorker();
+	Job* Allocate();
+	Job* Find(JobWorker* worker);
+	void Execute(Job* job);
+	void Finish(Job* job);
+	void WorkerLoop(unsigned int thread);
+};
@@ -71,37 +71,45 @@ void MagicMirrorManager::Init()
 	mirrors[1].GetTransform()->Rotate(0, -1.57f, 0);
 }
 
-void MagicMirrorManager::Update(float deltaTime, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, shared_ptr<Camera> camPtr)
+void MagicMirrorManager::Snapshot(MirrorSnapshot snapshots[2])
 {
-	mirrors[0].GetTransform()->Rotate(0, 0, 0);
-	mirrors[1].GetTransform()->Rotate(0, 0, 0);
+	for (int i = 0; i < 2; i++)
+	{
+		mirrors[i].Snapshot(snapshots[i].Entity);
+		snapshots[i].Position = mirrors[i].GetTransform()->GetPosition();
+		snapshots[i].Forward = mirrors[i].GetTransform()->GetForward();
+		snapshots[i].Rotation = mirrors[i].GetTransform()->GetRotation();
+	}
+}
 
+void MagicMirrorManager::Update(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const CameraSnapshot& camera, const MirrorSnapshot snapshots[2])
+{
 	for (int i = 0; i < 2; i++)
 	{
 		// -- CALCULATE MIRROR CAM POSITION
-		XMMATRIX mirrorInWorld = XMLoadFloat4x4(&mirrors[i].GetTransform()->GetWorldMatrix());
+		XMMATRIX mirrorInWorld = XMLoadFloat4x4(&snapshots[i].Entity.World);
 		XMVECTOR d = XMMatrixDeterminant(mirrorInWorld); // for calculating the inverse world
-		XMMATRIX mirrorOutWorld = XMLoadFloat4x4(&mirrors[(i + 1) % 2].GetTransform()->GetWorldMatrix());
+		XMMATRIX mirrorOutWorld = XMLoadFloat4x4(&snapshots[(i + 1) % 2].Entity.World);
 
-		XMVECTOR camPosOriginal = XMLoadFloat3(&camPtr->GetTransform().GetPosition());
+		XMVECTOR camPosOriginal = XMLoadFloat3(&camera.Position);
 		XMVECTOR camPosMirrorOut = XMVector3Transform(camPosOriginal, XMMatrixInverse(&d, mirrorInWorld)); // cam in mirror-in space
 		camPosMirrorOut = XMVectorMultiply(camPosMirrorOut, XMVectorSet(-1, 1, -1, 1)); // negate x and z
 		camPosMirrorOut = XMVector3Transform(camPosMirrorOut, mirrorOutWorld); // consider cam to be in mirror-out space now, and put it back in world space
 		XMStoreFloat3(&mirrorCamPositions[(i + 1) % 2], camPosMirrorOut);
 
 		// -- CALCULATE MIRROR CAM ROTATION
-		XMVECTOR mirrorInQuat = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&mirrors[i].GetTransform()->GetPitchYawRoll()));
+		XMVECTOR mirrorInQuat = XMLoadFloat4(&snapshots[i].Rotation);
 		XMVECTOR correctionQuat = XMQuaternionRotationAxis(XMVectorSet(0, 1, 0, 0), 3.14159f);
-		XMVECTOR mirrorOutQuat = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&mirrors[(i + 1) % 2].GetTransform()->GetPitchYawRoll()));
+		XMVECTOR mirrorOutQuat = XMLoadFloat4(&snapshots[(i + 1) % 2].Rotation);
 		XMVECTOR quatResult = XMQuaternionMultiply(XMQuaternionMultiply(XMQuaternionInverse(mirrorInQuat), correctionQuat), mirrorOutQuat);
 		// store rotation difference for later use
 		XMStoreFloat4(&mirrorRotDiffs[i], quatResult);
-		XMStoreFloat3(&mirrorCamForwards[(i + 1) % 2], XMVector3Rotate(XMLoadFloat3(&camPtr->GetTransform().GetForward()), quatResult));
-		XMStoreFloat3(&mirrorCamUps[(i + 1) % 2], XMVector3Rotate(XMLoadFloat3(&camPtr->GetTransform().GetUp()), quatResult));
+		XMStoreFloat3(&mirrorCamForwards[(i + 1) % 2], XMVector3Rotate(XMLoadFloat3(&camera.Forward), quatResult));
+		XMStoreFloat3(&mirrorCamUps[(i + 1) % 2], XMVector3Rotate(XMLoadFloat3(&camera.Up), quatResult));
 
 		// launch compute shader to calculate mirror planes in world 
-		mirrorPlanesCS->SetMatrix4x4("mirrorWorld", mirrors[i].GetTransform()->GetWorldMatrix());
-		mirrorPlanesCS->SetMatrix4x4("mirrorWorldInvTranspose", mirrors[i].GetTransform()->GetWorldInverseTransposeMatrix());
+		mirrorPlanesCS->SetMatrix4x4("mirrorWorld", snapshots[i].Entity.World);
+		mirrorPlanesCS->SetMatrix4x4("mirrorWorldInvTranspose", snapshots[i].Entity.WorldInvTranspose);
 		mirrorPlanesCS->SetShader();
 		context->Dispatch(4, 1, 1);
 	}
@@ -110,8 +118,8 @@ void MagicMirrorManager::Update(float deltaTime, Microsoft::WRL::ComPtr<ID3D11De
 
 void MagicMirrorManager::Draw(
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, 
-	shared_ptr<Camera> camPtr, vector<GameEntity*> gameObjects, 
-	shared_ptr<Skybox> skybox, vector<Light> lights, XMFLOAT3 ambient)
+	const CameraSnapshot& camera, const MirrorSnapshot snapshots[2], const vector<EntitySnapshot>& gameObjects, 
+	shared_ptr<Skybox> skybox, const vector<Light>& lights, XMFLOAT3 ambient)
 {
 	// Grab the original render targets for rebinding later
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> tempRender;
@@ -121,13 +129,13 @@ void MagicMirrorManager::Draw(
 	for (int i = 0; i < 2; i++)
 	{
 		// Render all objects through the mirror 
-		mirrorCamView = camPtr->GetView();
+		mirrorCamView = camera.View;
 		// (NOTE: this is recursive because objects inside of mirrors inside of this mirror are also drawn)
 		RenderThroughMirror(i, 0, mirrorCamPositions[(i + 1) % 2], 
-			camPtr->GetTransform().GetPosition(), 
+			camera.Position, 
 			tempRender, tempDepth, 
-			context, camPtr->viewDimensions, 
-			gameObjects, skybox, lights, ambient);
+			context, camera.ViewDimensions, 
+			snapshots, gameObjects, skybox, lights, ambient);
 	}
 
 	// Set back to original DSV
@@ -138,8 +146,8 @@ void MagicMirrorManager::RenderThroughMirror(int mirrorIndex, int depthIndex, XM
 	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> viewportTarget,
 	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> viewportDSV,
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
-	XMFLOAT2 viewDimensions, vector<GameEntity*> gameObjects,
-	shared_ptr<Skybox> skybox, vector<Light> lights, XMFLOAT3 ambient)
+	XMFLOAT2 viewDimensions, const MirrorSnapshot snapshots[2], const vector<EntitySnapshot>& gameObjects,
+	shared_ptr<Skybox> skybox, const vector<Light>& lights, XMFLOAT3 ambient)
 {
 	if (depthIndex >= 8) return; // max mirrors to render through
 
@@ -151,11 +159,12 @@ void MagicMirrorManager::RenderThroughMirror(int mirrorIndex, int depthIndex, XM
 
 	// Setting MirrorMap only matters for when the shader is set to the culled version (so after the first iteration)
 	// Draw to mirrorSRVs[(depthIndex % 2)] using mirrorSRVs[(depthIndex + 1) % 2]
-	mirrors[mirrorIndex % 2].GetMaterial()->GetPS()->SetShaderResourceView("MirrorMap", mirrorSRVs[(depthIndex + 1) % 2]);
-	mirrors[mirrorIndex % 2].GetMaterial()->GetPS()->SetFloat2("mirrorMapDimensions", viewDimensions);
-	mirrors[mirrorIndex % 2].Draw(context, prevMirrorCamPos, mirrorCamView, mirrorProj);
-	mirrors[mirrorIndex % 2].GetMaterial()->GetPS()->SetShaderResourceView("MirrorMap", 0);
-	if (depthIndex == 0) mirrors[mirrorIndex % 2].GetMaterial()->SetPS(mirrorPSCulled); // from here on, use this PS now
+	const EntitySnapshot& mirror = snapshots[mirrorIndex % 2].Entity;
+	mirror.Material->GetPS()->SetShaderResourceView("MirrorMap", mirrorSRVs[(depthIndex + 1) % 2]);
+	mirror.Material->GetPS()->SetFloat2("mirrorMapDimensions", viewDimensions);
+	mirrors[mirrorIndex % 2].Draw(context, mirror, prevMirrorCamPos, mirrorCamView, mirrorProj);
+	mirror.Material->GetPS()->SetShaderResourceView("MirrorMap", 0);
+	if (depthIndex == 0) mirror.Material->SetPS(mirrorPSCulled); // from here on, use this PS now
 
 	// Clear mirror depth buffer
 	context->ClearDepthStencilView(mirrorDSV.Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
@@ -171,12 +180,11 @@ void MagicMirrorManager::RenderThroughMirror(int mirrorIndex, int depthIndex, XM
 		XMLoadFloat3(&mirrorCamUps[(mirrorIndex + 1) % 2])));
 
 	// Re-render all game entities through the mirror
-	for (GameEntity* gameObj : gameObjects)
+	for (const EntitySnapshot& gameObj : gameObjects)
 	{
-		shared_ptr<Material> mat = gameObj->GetMaterial();
+		shared_ptr<Material> mat = gameObj.Material;
 		shared_ptr<SimplePixelShader> tempPS = mat->GetPS();
 		mat->SetPS(mirrorViewPS); // set to mirror pixel shader for drawing through mirror
-		Transform* trans = gameObj->GetTransform();
 
 		std::shared_ptr<SimplePixelShader> ps = mat->GetPS();
 
@@ -185,14 +193,14 @@ void MagicMirrorManager::RenderThroughMirror(int mirrorIndex, int depthIndex, XM
 
 		// send mirror data to PS
 		ps->SetFloat2("mirrorMapDimensions", viewDimensions);
-		ps->SetFloat3("mirrorNormal", mirrors[(mirrorIndex + 1) % 2].GetTransform()->GetForward());
-		ps->SetFloat3("mirrorPos", mirrors[(mirrorIndex + 1) % 2].GetTransform()->GetPosition());
+		ps->SetFloat3("mirrorNormal", snapshots[(mirrorIndex + 1) % 2].Forward);
+		ps->SetFloat3("mirrorPos", snapshots[(mirrorIndex + 1) % 2].Position);
 
 		// Set pixel shader mirror map
 		ps->SetShaderResourceView("MirrorMap", mirrorSRVs[depthIndex % 2]);
 
 		// Draw the mesh
-		gameObj->Draw(context, mirrorCamPos, mirrorCamView, mirrorProj);
+		gameObj.Entity->Draw(context, gameObj, mirrorCamPos, mirrorCamView, mirrorProj);
 
 		ps->SetShaderResourceView("MirrorMap", 0);
 		mat->SetPS(tempPS); // reset back to original pixel shader
@@ -221,8 +229,8 @@ void MagicMirrorManager::RenderThroughMirror(int mirrorIndex, int depthIndex, XM
 		XMVector3Rotate(XMLoadFloat3(&mirrorCamForwards[(mirrorIndex + 1) % 2]), quatVec));
 
 	// DO IT AGANE
-	RenderThroughMirror(mirrorIndex, depthIndex + 1, mirrorCamPos, prevMirrorCamPos, viewportTarget, mirrorDSV, context, viewDimensions, gameObjects, skybox, lights, ambient);
-	mirrors[mirrorIndex % 2].GetMaterial()->SetPS(mirrorPS); // reset to original PS when done
+	RenderThroughMirror(mirrorIndex, depthIndex + 1, mirrorCamPos, prevMirrorCamPos, viewportTarget, mirrorDSV, context, viewDimensions, snapshots, gameObjects, skybox, lights, ambient);
+	mirror.Material->SetPS(mirrorPS); // reset to original PS when done
 }
 
 // Get one of the mirrors (index 0 or 1)
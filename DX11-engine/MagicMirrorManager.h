@@ -5,6 +5,15 @@
 #include "Lights.h"
 #include "Skybox.h"
 
+// Where a mirror was at the end of a frame's simulation
+struct MirrorSnapshot
+{
+	EntitySnapshot Entity;
+	DirectX::XMFLOAT3 Position;
+	DirectX::XMFLOAT3 Forward;
+	DirectX::XMFLOAT4 Rotation;
+};
+
 class MagicMirrorManager : public GameEntity
 {
 public:
@@ -17,12 +26,15 @@ public:
 
 	void Init() override;
 
-	void Update(float deltaTime, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camPtr);
+	// Both mirrors, for drawing with Update() and Draw(), which only use what's in the snapshots
+	void Snapshot(MirrorSnapshot snapshots[2]);
+
+	void Update(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, const CameraSnapshot& camera, const MirrorSnapshot snapshots[2]);
 	
 	void Draw(
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
-		std::shared_ptr<Camera> camPtr, std::vector<GameEntity*> gameObjects, 
-		std::shared_ptr<Skybox> skybox, std::vector<Light> lights, DirectX::XMFLOAT3 ambient);
+		const CameraSnapshot& camera, const MirrorSnapshot snapshots[2], const std::vector<EntitySnapshot>& gameObjects, 
+		std::shared_ptr<Skybox> skybox, const std::vector<Light>& lights, DirectX::XMFLOAT3 ambient);
 
 	MagicMirror* GetMirror(int index);
 
@@ -63,7 +75,8 @@ private:
 		Microsoft::WRL::ComPtr<ID3D11DepthStencilView> viewportDSV,
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,
 		DirectX::XMFLOAT2 viewDimensions,
-		std::vector<GameEntity*> gameObjects,
+		const MirrorSnapshot snapshots[2],
+		const std::vector<EntitySnapshot>& gameObjects,
 		std::shared_ptr<Skybox> skybox,
-		std::vector<Light> lights, DirectX::XMFLOAT3 ambient);
+		const std::vector<Light>& lights, DirectX::XMFLOAT3 ambient);
 };
\ No newline at end of file
@@ -1,6 +1,8 @@
 
 #include <Windows.h>
+#include <cstring>
 #include "Game.h"
+#include "SelfTest.h"
 
 // --------------------------------------------------------
 // Entry point for a graphical (non-console) Windows application
@@ -18,6 +20,10 @@ int WINAPI WinMain(
 	_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 #endif
 
+	// Benchmarks and self tests run on their own, instead of the game, so they're never part of its startup
+	if (strstr(lpCmdLine, "-selftest"))
+		return SelfTest::Run() ? 0 : 1;
+
 	// Create the Game object using
 	// the app handle we got from WinMain
 	Game dxGame(hInstance);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Windows.h>
+
+// --------------------------------------------------------
+// A read-only view of an entire file mapped into memory.
+//
+// The file's contents can be read directly through GetData()
+// without copying them into a buffer first. The view stays
+// valid for as long as this object is alive.
+// --------------------------------------------------------
+class MappedFile
+{
+public:
+
+	MappedFile(const wchar_t* fileName);
+	~MappedFile();
+
+	// Mapped views own OS handles, so don't allow copies
+	MappedFile(const MappedFile& other) = delete;
+	MappedFile& operator=(const MappedFile& other) = delete;
+
+	bool IsOpen();
+	const char* GetData();
+	size_t GetSize();
+
+private:
+
+	HANDLE file;
+	HANDLE mapping;
+	const char* data;
+	size_t size;
+};
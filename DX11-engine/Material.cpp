@@ -86,6 +86,15 @@ void Material::AddTextureSRV(string name, Microsoft::WRL::ComPtr<ID3D11ShaderRes
 	if (strcmp(name.c_str(), "MetalnessMap") == 0) // 4th bit
 		textureBitMask |= 8;
 
+	// glTF packs roughness and metalness into one texture, so it fills both slots (5th bit says which channels to read)
+	if (strcmp(name.c_str(), "MetalRoughnessMap") == 0)
+	{
+		textureBitMask |= 2 | 8 | 16;
+		textureSRVs.insert({ "RoughnessMap", srv });
+		textureSRVs.insert({ "MetalnessMap", srv });
+		return;
+	}
+
 	textureSRVs.insert({ name, srv });
 }
 
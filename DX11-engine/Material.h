@@ -41,7 +41,7 @@ private:
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
 
-	//                                     MetalnessMap NormalMap RoughnessMap AlbedoMap
-	// 00000000 00000000 00000000 0000          0           0          0           0
+	//                               PackedMetalRoughness MetalnessMap NormalMap RoughnessMap AlbedoMap
+	// 00000000 00000000 00000000 000          0               0           0          0           0
 	unsigned int textureBitMask;
 };
\ No newline at end of file
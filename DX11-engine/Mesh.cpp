@@ -1,12 +1,32 @@
 #include "Mesh.h"
+#include "MappedFile.h"
+#include "ObjLoader.h"
+#include "GltfLoader.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshletBuilder.h"
+#include "BoundsCalculator.h"
+#include "VertexCompression.h"
 #include <iostream>
-#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 using namespace DirectX;
 
+
 Mesh::Mesh()
 {
+	this->poolHandle = GEOMETRY_POOL_INVALID;
 	this->indexCount = 0;
+	this->vertexCount = 0;
+	this->residency = MESH_RESIDENCY_NONE;
+	this->boundsMin = XMFLOAT3(0, 0, 0);
+	this->boundsMax = XMFLOAT3(0, 0, 0);
+	this->boundsVersion = 0;
+	this->vertexFormat = VERTEX_FORMAT_FULL;
+	this->vertexStride = sizeof(Vertex);
+	this->indexFormat = DXGI_FORMAT_R32_UINT;
 }
 
 Mesh::Mesh(Vertex* vertices,
@@ -14,342 +34,239 @@ Mesh::Mesh(Vertex* vertices,
 	unsigned int* indices,
 	unsigned int numIndices,
 	Microsoft::WRL::ComPtr<ID3D11Device> device,
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, bool dynamic)
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, bool dynamic, MeshResidency residency)
 {
 	// Store context ptr and index count
 	this->context = context;
+	this->poolHandle = GEOMETRY_POOL_INVALID;
 	this->indexCount = numIndices;
-	
-	for (int i = 0; i < numVerts; i++)
-		this->vertices.push_back(vertices[i]);
+	this->vertexCount = 0;
+	this->boundsVersion = 0;
+	this->vertexFormat = VERTEX_FORMAT_FULL;
+	this->vertexStride = sizeof(Vertex);
+
+	// Dynamic buffers get refilled from the CPU copy, so they have to keep it
+	this->residency = dynamic ? MESH_RESIDENCY_FULL : residency;
 
+	CalculateBounds(vertices, numVerts);
 	CreateBuffers(vertices, numVerts, indices, device, dynamic);
+	KeepResidentCopy(vertices, numVerts, indices, numIndices);
 }
 
 Mesh::Mesh(const wchar_t* fileName,
 	Microsoft::WRL::ComPtr<ID3D11Device> device,
-	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, bool dynamic)
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, bool dynamic, bool optimize,
+	VertexFormat vertexFormat, MeshResidency residency, std::shared_ptr<GeometryPool> pool)
+	: Mesh(fileName, 0, device, context, dynamic, optimize, vertexFormat, residency, pool)
+{
+}
+
+Mesh::Mesh(const wchar_t* fileName, unsigned int part,
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, bool dynamic, bool optimize,
+	VertexFormat vertexFormat, MeshResidency residency, std::shared_ptr<GeometryPool> pool)
 {
 	this->context = context;
+	this->pool = pool;
+	this->poolHandle = GEOMETRY_POOL_INVALID;
 	this->indexCount = 0;
-	// Author: Chris Cascioli
-	// Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
-	// 
-	// - You are allowed to directly copy/paste this into your code base
-	//   for assignments, given that you clearly cite that this is not
-	//   code of your own design.
-	//
-	// - NOTE: You'll need to #include <fstream>
+	this->vertexCount = 0;
+	this->residency = dynamic ? MESH_RESIDENCY_FULL : residency;
+	this->boundsMin = XMFLOAT3(0, 0, 0);
+	this->boundsMax = XMFLOAT3(0, 0, 0);
+	this->boundsVersion = 0;
+	this->indexFormat = DXGI_FORMAT_R32_UINT;
 
+	// Dynamic buffers get whole Vertex structs copied into them
+	this->vertexFormat = dynamic ? VERTEX_FORMAT_FULL : vertexFormat;
+	this->vertexStride = VertexCompression::GetStride(this->vertexFormat);
 
-	// File input object
-	std::ifstream obj(fileName);
+	// Map the file into memory so it can be hashed and parsed in place
+	MappedFile obj(fileName);
 
 	// Check for successful open
-	if (!obj.is_open())
+	if (!obj.IsOpen())
 		return;
 
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;	// Positions from the file
-	std::vector<XMFLOAT3> normals;		// Normals from the file
-	std::vector<XMFLOAT2> uvs;		// UVs from the file
-	std::vector<Vertex> verts;		// Verts we're assembling
-	std::vector<UINT> indices;		// Indices of these verts
-	int vertCounter = 0;			// Count of vertices
-	int indexCounter = 0;			// Count of indices
-	char chars[100];			// String for line reading
-
-	// Still have data left?
-	while (obj.good())
-	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
-
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
-		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// If we only got the first number, chances are the OBJ
-			// file has no UV coordinates.  This isn't great, but we
-			// still want to load the model without crashing, so we
-			// need to re-read a different pattern (in which we assume
-			// there are no UVs denoted for any of the vertices)
-			if (numbersRead == 1)
-			{
-				// Re-read with a different pattern
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-
-				// The following indices are where the UVs should 
-				// have been, so give them a valid value
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-
-				// If we have no UVs, create a single UV coordinate
-				// that will be used for all vertices
-				if (uvs.size() == 0)
-					uvs.push_back(XMFLOAT2(0, 0));
-			}
-
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal's Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-			vertCounter += 3;
-
-			// Add three more indices
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-
-			// Was there a 4th face?
-			// - 12 numbers read means 4 faces WITH uv's
-			// - 8 numbers read means 4 faces WITHOUT uv's
-			if (numbersRead == 12 || numbersRead == 8)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal's Z
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-				vertCounter += 3;
-
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-			}
-		}
-	}
+	// Use the binary cache if there is an up to date one, otherwise parse the
+	// .glb or .obj (only .obj files are text) and write a new cache for next time
+	bool gltf = GltfLoader::IsGlb(obj.GetData(), obj.GetSize());
+	if (!gltf && part > 0)
+		return;
+	unsigned long long sourceHash = MeshCache::HashData(obj.GetData(), obj.GetSize());
+	std::wstring cachePath = MeshCache::GetCachePath(fileName, part);
+	if (LoadFromCache(cachePath.c_str(), sourceHash, device, dynamic, optimize))
+		return;
+	if (gltf)
+		LoadFromGltf(obj.GetData(), obj.GetSize(), part, cachePath.c_str(), sourceHash, device, dynamic, optimize);
+	else
+		LoadFromObj(obj.GetData(), obj.GetSize(), cachePath.c_str(), sourceHash, device, dynamic, optimize);
+}
 
-	// Close the file and create the actual buffers
-	obj.close();
-	this->vertices = verts;
-	this->indexCount = indexCounter;
-
-	// calculate vertex tangents before creating buffers
-	CalculateTangents(&verts[0], vertCounter, &indices[0], indexCount);
-
-	CreateBuffers(&verts[0], vertCounter, &indices[0], device, dynamic);
-
-	// - At this point, "verts" is a vector of Vertex structs, and can be used
-	//    directly to create a vertex buffer:  &verts[0] is the address of the first vert
-	//
-	// - The vector "indices" is similar. It's a vector of unsigned ints and
-	//    can be used directly for the index buffer: &indices[0] is the address of the first int
-	//
-	// - "vertCounter" is the number of vertices
-	// - "indexCounter" is the number of indices
-	// - Yes, these are effectively the same since OBJs do not index entire vertices!  This means
-	//    an index buffer isn't doing much for us.  We could try to optimize the mesh ourselves
-	//    and detect duplicate vertices, but at that point it would be better to use a more
-	//    sophisticated model loading library like TinyOBJLoader or The Open Asset Importer Library
-}
-
-// --------------------------------------------------------
-// Author: Chris Cascioli
-// Purpose: Calculates the tangents of the vertices in a mesh
-// 
-// - You are allowed to directly copy/paste this into your code base
-//   for assignments, given that you clearly cite that this is not
-//   code of your own design.
-//
-// - Code originally adapted from: http://www.terathon.com/code/tangent.html
-//   - Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
-//   - See listing 7.4 in section 7.5 (page 9 of the PDF)
-//
-// - Note: For this code to work, your Vertex format must
-//         contain an XMFLOAT3 called Tangent
-//
-// - Be sure to call this BEFORE creating your D3D vertex/index buffers
-// --------------------------------------------------------
-void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
-{
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].Tangent = XMFLOAT3(0, 0, 0);
-	}
+// Creates the buffers straight from a memory mapped .meshbin file
+// (an unoptimized cache won't be used for an optimized mesh, or vice versa)
+bool Mesh::LoadFromCache(const wchar_t* cachePath, unsigned long long sourceHash,
+	Microsoft::WRL::ComPtr<ID3D11Device> device, bool dynamic, bool optimize)
+{
+	MeshCache cache;
+	if (!cache.Open(cachePath, sourceHash, optimize ? MESH_CACHE_OPTIMIZED : 0))
+		return false;
+
+	const MeshCacheHeader* header = cache.GetHeader();
+	this->indexCount = header->IndexCount;
+	this->boundsMin = header->BoundsMin;
+	this->boundsMax = header->BoundsMax;
+	this->boundingSphere = header->Sphere;
+	this->orientedBox = header->OrientedBox;
+	this->boundsVersion++;
+	this->lods.assign(header->Lods, header->Lods + header->LodCount);
+	this->meshlets.assign(cache.GetMeshlets(), cache.GetMeshlets() + header->MeshletCount);
+
+	CreateBuffers(cache.GetVertices(), header->VertexCount, cache.GetIndices(), device, dynamic);
+	KeepResidentCopy(cache.GetVertices(), header->VertexCount, cache.GetIndices(), lods[0].IndexCount);
+	return true;
+}
 
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
-	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
-
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
-
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
-
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
-
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
-	}
+// Parses .obj text (see ObjLoader for details), optionally optimizes it
+// for the GPU (see MeshOptimizer), then caches the result
+bool Mesh::LoadFromObj(const char* data, size_t size, const wchar_t* cachePath, unsigned long long sourceHash,
+	Microsoft::WRL::ComPtr<ID3D11Device> device, bool dynamic, bool optimize)
+{
+	// Big files are split across every core
+	unsigned int threadCount = size >= OBJ_PARALLEL_THRESHOLD ? std::thread::hardware_concurrency() : 1;
+
+	ObjData objData;
+	if (!ObjLoader::Parse(data, size, objData, threadCount))
+		return false;
+
+	// Assemble the verts and indices from the file's attributes,
+	// welding face corners that share a position, uv and normal
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	ObjLoader::BuildVertices(objData, verts, indices);
+	if (indices.empty())
+		return false;
+
+	return ProcessGeometry(verts, indices, cachePath, sourceHash, device, dynamic, optimize, true);
+}
 
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
-	{
-		// Grab the two vectors
-		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
-		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
+// Converts one primitive of a .glb file (see GltfLoader), reading its attributes
+// straight out of the mapped file, then processes and caches it like an .obj
+bool Mesh::LoadFromGltf(const char* data, size_t size, unsigned int part, const wchar_t* cachePath, unsigned long long sourceHash,
+	Microsoft::WRL::ComPtr<ID3D11Device> device, bool dynamic, bool optimize)
+{
+	GltfData gltf;
+	if (!GltfLoader::Parse(data, size, gltf) || part >= gltf.primitives.size())
+		return false;
 
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	if (!GltfLoader::BuildVertices(gltf.primitives[part], verts, indices))
+		return false;
 
-		// Store the tangent
-		XMStoreFloat3(&verts[i].Tangent, tangent);
-	}
+	// Tangents that came with the file are what its normal maps were baked against, so they're kept
+	return ProcessGeometry(verts, indices, cachePath, sourceHash, device, dynamic, optimize, gltf.primitives[part].Tangents.Data == 0);
 }
 
-void Mesh::CreateBuffers(Vertex* vertices,
+bool Mesh::ProcessGeometry(std::vector<Vertex>& verts, std::vector<unsigned int>& indices,
+	const wchar_t* cachePath, unsigned long long sourceHash,
+	Microsoft::WRL::ComPtr<ID3D11Device> device, bool dynamic, bool optimize, bool calculateTangents)
+{
+	// A vertex can only have one handedness, so the ones shared by mirrored and unmirrored
+	// uvs are split first, before anything's ordered around the vertex count
+	if (calculateTangents)
+		TangentGenerator::SplitMirroredVertices(verts, indices);
+
+	// Reorder triangles and vertices for the vertex cache,
+	// overdraw and vertex fetch, in that order
+	if (optimize)
+		MeshOptimizer::Optimize(verts, indices);
+
+#if defined(DEBUG) || defined(_DEBUG)
+	auto meshletStart = std::chrono::high_resolution_clock::now();
+#endif
+
+	// Split the triangles into meshlets for culling. Optimized meshes have their triangles regrouped
+	// so meshlets come out compact, which undoes some of the vertex fetch ordering, so that's redone
+	// (it only renumbers vertices, so the meshlets' index ranges stay the same).
+	MeshletBuilder::Build(&verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size(), optimize, meshlets);
+	if (optimize)
+		MeshOptimizer::OptimizeVertexFetch(verts, indices);
+
+#if defined(DEBUG) || defined(_DEBUG)
+	double meshletMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - meshletStart).count();
+	printf("  Built %zu meshlet(s) in %.3f ms, %.1f triangles each on average\n",
+		meshlets.size(), meshletMs, meshlets.empty() ? 0.0 : indices.size() / 3.0 / meshlets.size());
+#endif
+
+	this->indexCount = (unsigned int)indices.size();
+
+	// calculate vertex tangents (with handedness, for mirrored UVs) before creating buffers
+	if (calculateTangents)
+		CalculateTangents(&verts[0], (unsigned int)verts.size(), &indices[0], indexCount, TANGENT_MODE_MIKKTSPACE);
+	CalculateBounds(&verts[0], (unsigned int)verts.size());
+
+	// Simplified copies of the triangles are appended to the indices, one per level of detail
+	MeshSimplifier::BuildLods(verts, indices, lods, optimize);
+	this->indexCount = (unsigned int)indices.size();
+
+	CreateBuffers(&verts[0], (unsigned int)verts.size(), &indices[0], device, dynamic);
+
+	// Failing to write the cache isn't fatal, the next run will just parse the text again
+	MeshCache::Write(cachePath, sourceHash, &verts[0], (unsigned int)verts.size(), &indices[0], indexCount,
+		boundsMin, boundsMax, boundingSphere, orientedBox, &lods[0], (unsigned int)lods.size(),
+		meshlets.empty() ? 0 : &meshlets[0], (unsigned int)meshlets.size(), optimize ? MESH_CACHE_OPTIMIZED : 0);
+
+	KeepResidentCopy(&verts[0], (unsigned int)verts.size(), &indices[0], lods[0].IndexCount);
+	return true;
+}
+
+// Split out into TangentGenerator, which batches the triangles for SIMD
+// and spreads big meshes across threads
+void Mesh::CalculateTangents(Vertex* verts, unsigned int numVerts, const unsigned int* indices, unsigned int numIndices,
+	TangentMode mode)
+{
+	TangentGenerator::Generate(verts, numVerts, indices, numIndices, mode);
+}
+
+void Mesh::CreateBuffers(const Vertex* vertices,
 	unsigned int numVerts,
-	unsigned int* indices,
+	const unsigned int* indices,
 	Microsoft::WRL::ComPtr<ID3D11Device> device, bool dynamic)
 {
+	// Without any levels of detail, the whole index buffer is drawn
+	if (lods.empty())
+	{
+		MeshLod full = { 0, indexCount, 0.0f };
+		lods.push_back(full);
+	}
+
+	vertexCount = numVerts;
+
+	// Convert the vertices to the format the buffer holds (bounds must be calculated first)
+	std::vector<unsigned char> encodedVertices;
+	if (vertexFormat != VERTEX_FORMAT_FULL)
+	{
+		VertexCompression::Encode(vertices, numVerts, vertexFormat, boundsMin, boundsMax, encodedVertices);
+	}
+
+	// Small meshes can use 16-bit indices, halving the index buffer
+	std::vector<unsigned short> shortIndices;
+	indexFormat = numVerts <= 0xFFFF ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	if (indexFormat == DXGI_FORMAT_R16_UINT)
+		shortIndices.assign(indices, indices + GetIndexCount());
+
+	// Static meshes go in the pool if it holds the same vertex format. If they don't fit
+	// (too many vertices for 16-bit indices), they get their own buffers like any other mesh.
+	if (pool && !dynamic && pool->GetVertexFormat() == vertexFormat && !shortIndices.empty())
+	{
+		poolHandle = pool->Allocate(encodedVertices.empty() ? (const void*)vertices : &encodedVertices[0], numVerts,
+			&shortIndices[0], GetIndexCount());
+		if (poolHandle != GEOMETRY_POOL_INVALID)
+			return;
+	}
+	pool.reset();
+
 	// Create a VERTEX BUFFER
 	// - This holds the vertex data of triangles for a single object
 	// - This buffer is created on the GPU, which is where the data needs to
@@ -360,7 +277,7 @@ void Mesh::CreateBuffers(Vertex* vertices,
 		//  - After the buffer is created, this description variable is unnecessary
 		D3D11_BUFFER_DESC vbd = {};
 		vbd.Usage = dynamic ? D3D11_USAGE_DYNAMIC : D3D11_USAGE_IMMUTABLE; // should not change unless set to be
-		vbd.ByteWidth = sizeof(Vertex) * numVerts;       // 3 = number of vertices in the buffer
+		vbd.ByteWidth = vertexStride * numVerts;       // 3 = number of vertices in the buffer
 		vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells Direct3D this is a vertex buffer
 		vbd.CPUAccessFlags = dynamic ? D3D11_CPU_ACCESS_WRITE : 0;
 		vbd.MiscFlags = 0;
@@ -370,7 +287,7 @@ void Mesh::CreateBuffers(Vertex* vertices,
 		// - This is how we initially fill the buffer with data
 		// - Essentially, we're specifying a pointer to the data to copy
 		D3D11_SUBRESOURCE_DATA initialVertexData = {};
-		initialVertexData.pSysMem = vertices; // pSysMem = Pointer to System Memory
+		initialVertexData.pSysMem = encodedVertices.empty() ? (const void*)vertices : &encodedVertices[0]; // pSysMem = Pointer to System Memory
 
 		// Actually create the buffer on the GPU with the initial data
 		// - Once we do this, we'll NEVER CHANGE DATA IN THE BUFFER AGAIN
@@ -388,7 +305,7 @@ void Mesh::CreateBuffers(Vertex* vertices,
 		//  - Bind Flag (used as an index buffer instead of a vertex buffer) 
 		D3D11_BUFFER_DESC ibd = {};
 		ibd.Usage = D3D11_USAGE_IMMUTABLE;	// Will NEVER change
-		ibd.ByteWidth = sizeof(unsigned int) * GetIndexCount();	// 3 = number of indices in the buffer
+		ibd.ByteWidth = (indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(unsigned short) : sizeof(unsigned int)) * GetIndexCount();	// 3 = number of indices in the buffer
 		ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;	// Tells Direct3D this is an index buffer
 		ibd.CPUAccessFlags = 0;	// Note: We cannot access the data from C++ (this is good)
 		ibd.MiscFlags = 0;
@@ -396,7 +313,7 @@ void Mesh::CreateBuffers(Vertex* vertices,
 
 		// Specify the initial data for this buffer, similar to above
 		D3D11_SUBRESOURCE_DATA initialIndexData = {};
-		initialIndexData.pSysMem = indices; // pSysMem = Pointer to System Memory
+		initialIndexData.pSysMem = shortIndices.empty() ? (const void*)indices : &shortIndices[0]; // pSysMem = Pointer to System Memory
 
 		// Actually create the buffer with the initial data
 		// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
@@ -404,19 +321,84 @@ void Mesh::CreateBuffers(Vertex* vertices,
 	}
 }
 
+// Finds the smallest axis-aligned box containing all of the given vertices,
+// and fits a sphere and an oriented box around them
+void Mesh::CalculateBounds(const Vertex* verts, unsigned int numVerts)
+{
+	boundsVersion++;
+	boundingSphere = BoundsCalculator::CalculateSphere(verts, numVerts);
+	orientedBox = BoundsCalculator::CalculateOrientedBox(verts, numVerts);
+	if (numVerts == 0)
+	{
+		boundsMin = XMFLOAT3(0, 0, 0);
+		boundsMax = XMFLOAT3(0, 0, 0);
+		return;
+	}
+
+	XMVECTOR minVec = XMLoadFloat3(&verts[0].Position);
+	XMVECTOR maxVec = minVec;
+	for (unsigned int i = 1; i < numVerts; i++)
+	{
+		XMVECTOR pos = XMLoadFloat3(&verts[i].Position);
+		minVec = XMVectorMin(minVec, pos);
+		maxVec = XMVectorMax(maxVec, pos);
+	}
+	XMStoreFloat3(&boundsMin, minVec);
+	XMStoreFloat3(&boundsMax, maxVec);
+}
+
+void Mesh::KeepResidentCopy(const Vertex* verts, unsigned int numVerts, const unsigned int* indices, unsigned int numIndices)
+{
+	// Replaced rather than cleared, so nothing stays allocated
+	std::vector<Vertex>().swap(this->vertices);
+	std::vector<XMFLOAT3>().swap(this->positions);
+	std::vector<unsigned int>().swap(this->indices);
+
+	switch (residency)
+	{
+	case MESH_RESIDENCY_FULL:
+		this->vertices.assign(verts, verts + numVerts);
+		this->indices.assign(indices, indices + numIndices);
+		break;
+
+	case MESH_RESIDENCY_POSITIONS:
+		this->positions.resize(numVerts);
+		for (unsigned int i = 0; i < numVerts; i++)
+			this->positions[i] = verts[i].Position;
+		this->indices.assign(indices, indices + numIndices);
+		break;
+
+	default:
+		break;
+	}
+}
+
 Mesh::~Mesh()
 {
-	// For now, this is empty, as smart pointers are doing the cleanup
+	// Smart pointers clean up everything else
+	if (pool)
+		pool->Free(poolHandle);
+}
+
+void MeshBindings::Invalidate()
+{
+	VertexBuffer.Reset();
+	IndexBuffer.Reset();
 }
 
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer()
 {
-	return vertexBuffer;
+	return pool ? pool->GetVertexBuffer() : vertexBuffer;
 }
 
 Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer() 
 {
-	return indexBuffer;
+	return pool ? pool->GetIndexBuffer() : indexBuffer;
+}
+
+bool Mesh::IsPooled()
+{
+	return pool != 0;
 }
 
 unsigned int Mesh::GetIndexCount()
@@ -424,21 +406,139 @@ unsigned int Mesh::GetIndexCount()
 	return indexCount;
 }
 
-void Mesh::Draw()
+unsigned int Mesh::GetVertexCount()
+{
+	return vertexCount;
+}
+
+MeshResidency Mesh::GetResidency()
 {
+	return residency;
+}
+
+const std::vector<XMFLOAT3>& Mesh::GetPositions()
+{
+	return positions;
+}
+
+const std::vector<unsigned int>& Mesh::GetIndices()
+{
+	return indices;
+}
+
+MeshMemoryUsage Mesh::GetMemoryUsage()
+{
+	MeshMemoryUsage usage = {};
+	usage.CpuBytes = vertices.capacity() * sizeof(Vertex) +
+		positions.capacity() * sizeof(XMFLOAT3) +
+		indices.capacity() * sizeof(unsigned int) +
+		lods.capacity() * sizeof(MeshLod) +
+		meshlets.capacity() * sizeof(Meshlet);
+
+	// Only buffers that were actually created (pooled meshes count their share of the pool)
+	if (vertexBuffer || pool)
+		usage.GpuBytes += (size_t)vertexStride * vertexCount;
+	if (indexBuffer || pool)
+		usage.GpuBytes += (indexFormat == DXGI_FORMAT_R16_UINT ? sizeof(unsigned short) : sizeof(unsigned int)) * (size_t)indexCount;
+	return usage;
+}
+
+XMFLOAT3 Mesh::GetBoundsMin()
+{
+	return boundsMin;
+}
+
+XMFLOAT3 Mesh::GetBoundsMax()
+{
+	return boundsMax;
+}
+
+BoundingBox Mesh::GetBoundingBox()
+{
+	return BoundsCalculator::CalculateBox(boundsMin, boundsMax);
+}
+
+BoundingSphere Mesh::GetBoundingSphere()
+{
+	return boundingSphere;
+}
+
+BoundingOrientedBox Mesh::GetOrientedBox()
+{
+	return orientedBox;
+}
+
+unsigned int Mesh::GetBoundsVersion()
+{
+	return boundsVersion;
+}
+
+VertexFormat Mesh::GetVertexFormat()
+{
+	return vertexFormat;
+}
+
+DXGI_FORMAT Mesh::GetIndexFormat()
+{
+	return indexFormat;
+}
+
+unsigned int Mesh::GetLodCount()
+{
+	return (unsigned int)lods.size();
+}
+
+MeshLod Mesh::GetLod(unsigned int lod)
+{
+	return lods[lod];
+}
+
+unsigned int Mesh::SelectLod(float pixelsPerUnit, float maxPixelError)
+{
+	// Errors only grow from one level to the next
+	unsigned int lod = 0;
+	while (lod + 1 < lods.size() && lods[lod + 1].Error * pixelsPerUnit <= maxPixelError)
+		lod++;
+	return lod;
+}
+
+unsigned int Mesh::GetMeshletCount()
+{
+	return (unsigned int)meshlets.size();
+}
+
+const Meshlet* Mesh::GetMeshlets()
+{
+	return meshlets.empty() ? 0 : &meshlets[0];
+}
+
+XMFLOAT3 Mesh::GetPositionScale()
+{
+	return VertexCompression::GetPositionScale(vertexFormat, boundsMin, boundsMax);
+}
+
+XMFLOAT3 Mesh::GetPositionOffset()
+{
+	return VertexCompression::GetPositionOffset(vertexFormat, boundsMin, boundsMax);
+}
+
+void Mesh::Draw(unsigned int lod, MeshBindings* bindings)
+{
+	// Nothing to draw if the mesh failed to load
+	if (lods.empty())
+		return;
+
 	// DRAW geometry
 	// - These steps are generally repeated for EACH object you draw
 	// - Other Direct3D calls will also be necessary to do more complex things
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
 	{
 		// Set buffers in the input assembler (IA) stage
-		//  - Do this ONCE PER OBJECT, since each object may have different geometry
-		//  - For this demo, this step *could* simply be done once during Init()
-		//  - However, this needs to be done between EACH DrawIndexed() call
-		//     when drawing different geometry, so it's here as an example
-		context->IASetVertexBuffers(0, 1, GetVertexBuffer().GetAddressOf(), &stride, &offset);
-		context->IASetIndexBuffer(GetIndexBuffer().Get(), DXGI_FORMAT_R32_UINT, 0);
+		//  - Each object may have different geometry, so this is done per object...
+		//  - ...unless its buffers are already set, like when the last object drawn
+		//     was in the same GeometryPool
+		unsigned int startIndex;
+		int baseVertex;
+		BindBuffers(startIndex, baseVertex, bindings);
 
 		// Tell Direct3D to draw
 		//  - Begins the rendering pipeline on the GPU
@@ -446,9 +546,50 @@ void Mesh::Draw()
 		//  - This will use all currently set Direct3D resources (shaders, buffers, etc)
 		//  - DrawIndexed() uses the currently set INDEX BUFFER to look up corresponding
 		//     vertices in the currently set VERTEX BUFFER
+		//  - Each level of detail is its own range of the index buffer
+		const MeshLod& range = lods[lod < lods.size() ? lod : lods.size() - 1];
 		context->DrawIndexed(
-			GetIndexCount(),     // The number of indices to use (we could draw a subset if we wanted)
-			0,     // Offset to the first index we want to use
-			0);    // Offset to add to each index when looking up vertices
+			range.IndexCount,     // The number of indices to use (we could draw a subset if we wanted)
+			startIndex + range.StartIndex,     // Offset to the first index we want to use
+			baseVertex);    // Offset to add to each index when looking up vertices
+	}
+}
+
+void Mesh::Draw(const std::vector<IndexRange>& ranges, MeshBindings* bindings)
+{
+	if (lods.empty() || ranges.empty())
+		return;
+
+	// Same as above, but with one DrawIndexed() per range sharing the same buffers
+	unsigned int startIndex;
+	int baseVertex;
+	BindBuffers(startIndex, baseVertex, bindings);
+	for (const IndexRange& range : ranges)
+		context->DrawIndexed(range.IndexCount, startIndex + range.StartIndex, baseVertex);
+}
+
+void Mesh::BindBuffers(unsigned int& startIndex, int& baseVertex, MeshBindings* bindings)
+{
+	// A pooled mesh's offsets only make sense in the buffers they were read along with
+	Microsoft::WRL::ComPtr<ID3D11Buffer> vb = vertexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> ib = indexBuffer;
+	GeometryAllocation allocation = pool ? pool->GetAllocation(poolHandle, vb, ib) : GeometryAllocation();
+	startIndex = allocation.StartIndex;
+	baseVertex = (int)allocation.BaseVertex;
+
+	// The same buffer always has the same stride and index format, so checking the buffers is enough
+	if (!bindings || vb.Get() != bindings->VertexBuffer.Get())
+	{
+		UINT stride = vertexStride;
+		UINT offset = 0;
+		context->IASetVertexBuffers(0, 1, vb.GetAddressOf(), &stride, &offset);
+		if (bindings)
+			bindings->VertexBuffer = vb;
+	}
+	if (!bindings || ib.Get() != bindings->IndexBuffer.Get())
+	{
+		context->IASetIndexBuffer(ib.Get(), indexFormat, 0);
+		if (bindings)
+			bindings->IndexBuffer = ib;
 	}
 }
\ No newline at end of file
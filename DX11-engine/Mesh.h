@@ -3,8 +3,47 @@
 #include <d3d11.h>
 #include <wrl/client.h>
 #include <vector>
+#include <memory>
+#include <DirectXCollision.h>
 #include "DXCore.h"
 #include "Vertex.h"
+#include "TangentGenerator.h"
+#include "MeshSimplifier.h"
+#include "MeshletCuller.h"
+#include "GeometryPool.h"
+
+// Largest error (in pixels) a level of detail is allowed to show on screen
+#define LOD_MAX_PIXEL_ERROR 1.0f
+
+// What a mesh keeps in CPU memory once its buffers are uploaded
+enum MeshResidency
+{
+	MESH_RESIDENCY_NONE,		// Nothing, the GPU buffers are the only copy
+	MESH_RESIDENCY_POSITIONS,	// Positions and full detail indices, for physics and picking
+	MESH_RESIDENCY_FULL			// Whole vertices and full detail indices, for meshes edited on the CPU (always used by dynamic meshes)
+};
+
+// Bytes a mesh is using on each side
+struct MeshMemoryUsage
+{
+	size_t CpuBytes;	// CPU copies of the geometry, plus levels of detail and meshlets
+	size_t GpuBytes;	// Vertex and index buffers
+};
+
+// What's bound to one context's input assembler by Mesh::Draw(), so meshes sharing a
+// GeometryPool only bind it once. Whoever draws on the context owns one and passes it to
+// every draw. It holds references to the buffers, so one released while it's bound (like a
+// pool growing or a mesh being evicted) can't have its address reused by a new buffer and
+// be mistaken for it.
+struct MeshBindings
+{
+	Microsoft::WRL::ComPtr<ID3D11Buffer> VertexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> IndexBuffer;
+
+	// Forgets what's bound, for when something other than a mesh drawn with these bindings
+	// may have changed it (like ImGui, once per frame)
+	void Invalidate();
+};
 
 class Mesh 
 {
@@ -14,22 +53,78 @@ private:
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
 
+	// Static meshes can live in a shared pool instead of their own buffers
+	std::shared_ptr<GeometryPool> pool;
+	unsigned int poolHandle;
+
+	// Binds the buffers if they aren't already (always, without bindings), and gives the offsets the draws need
+	void BindBuffers(unsigned int& startIndex, int& baseVertex, MeshBindings* bindings);
+
 protected:
 
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
 
 	// Hold num indices in index buffer
 	unsigned int indexCount;
+	unsigned int vertexCount;
+
+	// See MeshResidency. Only what the residency calls for is filled in.
+	MeshResidency residency;
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<unsigned int> indices;
 
-	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	// Ranges of the index buffer to draw for each level of detail (see MeshSimplifier).
+	// Meshes that aren't simplified just have the one covering every index.
+	std::vector<MeshLod> lods;
 
-	void CreateBuffers(Vertex* vertices,
+	// Clusters of the first level of detail's triangles, for culling (see MeshletBuilder).
+	// Empty if the mesh wasn't split up.
+	std::vector<Meshlet> meshlets;
+
+	// Local space bounds of the vertices (see BoundsCalculator)
+	DirectX::XMFLOAT3 boundsMin;
+	DirectX::XMFLOAT3 boundsMax;
+	DirectX::BoundingSphere boundingSphere;
+	DirectX::BoundingOrientedBox orientedBox;
+
+	// Goes up every time the bounds change, so world space copies know to update
+	unsigned int boundsVersion;
+
+	// What the vertex and index buffers hold (see VertexCompression).
+	// The CPU side vertices are always full Vertex structs.
+	VertexFormat vertexFormat;
+	unsigned int vertexStride;
+	DXGI_FORMAT indexFormat;
+
+	// See TangentGenerator, which this hands the work off to
+	void CalculateTangents(Vertex* verts, unsigned int numVerts, const unsigned int* indices, unsigned int numIndices,
+		TangentMode mode = TANGENT_MODE_ACCUMULATE);
+	void CalculateBounds(const Vertex* verts, unsigned int numVerts);
+
+	// Keeps whatever CPU copy of the geometry the residency calls for, once the buffers exist
+	void KeepResidentCopy(const Vertex* verts, unsigned int numVerts, const unsigned int* indices, unsigned int numIndices);
+
+	void CreateBuffers(const Vertex* vertices,
 		unsigned int numVerts,
-		unsigned int* indices,
+		const unsigned int* indices,
 		Microsoft::WRL::ComPtr<ID3D11Device> device, bool dynamic = false);
 
+	bool LoadFromCache(const wchar_t* cachePath, unsigned long long sourceHash,
+		Microsoft::WRL::ComPtr<ID3D11Device> device, bool dynamic, bool optimize);
+	bool LoadFromObj(const char* data, size_t size, const wchar_t* cachePath, unsigned long long sourceHash,
+		Microsoft::WRL::ComPtr<ID3D11Device> device, bool dynamic, bool optimize);
+	bool LoadFromGltf(const char* data, size_t size, unsigned int part, const wchar_t* cachePath, unsigned long long sourceHash,
+		Microsoft::WRL::ComPtr<ID3D11Device> device, bool dynamic, bool optimize);
+
+	// Everything after parsing: optimizing, meshlets, tangents, bounds, levels of detail,
+	// then the buffers and the cache. Tangents the file came with can be kept.
+	bool ProcessGeometry(std::vector<Vertex>& verts, std::vector<unsigned int>& indices,
+		const wchar_t* cachePath, unsigned long long sourceHash,
+		Microsoft::WRL::ComPtr<ID3D11Device> device, bool dynamic, bool optimize, bool calculateTangents);
+
 public:
 
+	// Only filled in for MESH_RESIDENCY_FULL
 	std::vector<Vertex> vertices;
 
 	Mesh();
@@ -39,17 +134,63 @@ public:
 		unsigned int* indices, 
 		unsigned int numIndices, 
 		Microsoft::WRL::ComPtr<ID3D11Device> device,
-		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, bool dynamic = false);
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, bool dynamic = false,
+		MeshResidency residency = MESH_RESIDENCY_NONE);
 
+	// Meshes loaded from files are run through MeshOptimizer unless optimize is false.
+	// Compact vertex formats need matching shaders (see VertexShader_Compact.hlsl).
 	Mesh(const wchar_t* fileName,
 		Microsoft::WRL::ComPtr<ID3D11Device> device,
-		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, bool dynamic = false);
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, bool dynamic = false, bool optimize = true,
+		VertexFormat vertexFormat = VERTEX_FORMAT_FULL, MeshResidency residency = MESH_RESIDENCY_NONE,
+		std::shared_ptr<GeometryPool> pool = 0);
+
+	// One part of a file that holds several, like a primitive of a .glb model (see GltfLoader,
+	// which loads all of them). Files are told apart by their contents, not their extension.
+	Mesh(const wchar_t* fileName, unsigned int part,
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, bool dynamic = false, bool optimize = true,
+		VertexFormat vertexFormat = VERTEX_FORMAT_FULL, MeshResidency residency = MESH_RESIDENCY_NONE,
+		std::shared_ptr<GeometryPool> pool = 0);
 
 	~Mesh();
 
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();
 	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
 	unsigned int GetIndexCount();
-	virtual void Draw();
+	unsigned int GetVertexCount();
+	bool IsPooled();
+	MeshResidency GetResidency();
+
+	// CPU copies, empty unless the residency keeps them (full residency has the positions in vertices instead)
+	const std::vector<DirectX::XMFLOAT3>& GetPositions();
+	const std::vector<unsigned int>& GetIndices();
+
+	MeshMemoryUsage GetMemoryUsage();
+	DirectX::XMFLOAT3 GetBoundsMin();
+	DirectX::XMFLOAT3 GetBoundsMax();
+	DirectX::BoundingBox GetBoundingBox();
+	DirectX::BoundingSphere GetBoundingSphere();
+	DirectX::BoundingOrientedBox GetOrientedBox();
+	unsigned int GetBoundsVersion();
+	VertexFormat GetVertexFormat();
+	DXGI_FORMAT GetIndexFormat();
+	unsigned int GetLodCount();
+	MeshLod GetLod(unsigned int lod);
+	unsigned int GetMeshletCount();
+	const Meshlet* GetMeshlets();
+
+	// Picks the lowest detail level whose error stays under maxPixelError,
+	// given how many pixels one local unit covers on screen
+	unsigned int SelectLod(float pixelsPerUnit, float maxPixelError = LOD_MAX_PIXEL_ERROR);
+
+	// What shaders need to turn quantized positions back into local space
+	DirectX::XMFLOAT3 GetPositionScale();
+	DirectX::XMFLOAT3 GetPositionOffset();
+	// Skips binding buffers that are already bound, if given the context's bindings
+	virtual void Draw(unsigned int lod = 0, MeshBindings* bindings = 0);
+
+	// Draws just the given ranges of the index buffer, like the visible meshlets from MeshletCuller
+	virtual void Draw(const std::vector<IndexRange>& ranges, MeshBindings* bindings = 0);
 
 };
\ No newline at end of file
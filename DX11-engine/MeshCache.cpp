@@ -0,0 +1,160 @@
+#include "MeshCache.h"
+#include <fstream>
+#include <cstring>
+
+using namespace DirectX;
+
+std::wstring MeshCache::GetCachePath(const wchar_t* sourceFile, unsigned int part)
+{
+	// The first part keeps the plain name, so single mesh files look the same as ever
+	if (part == 0)
+		return std::wstring(sourceFile) + L".meshbin";
+	return std::wstring(sourceFile) + L"." + std::to_wstring(part) + L".meshbin";
+}
+
+// A fast 64-bit hash that consumes 8 bytes at a time
+unsigned long long MeshCache::HashData(const char* data, size_t size)
+{
+	const unsigned long long k1 = 0x9E3779B97F4A7C15ull;
+	const unsigned long long k2 = 0xC2B2AE3D27D4EB4Full;
+	unsigned long long h = size * k1;
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		unsigned long long word;
+		memcpy(&word, data + i, 8);
+		h ^= word * k2;
+		h = ((h << 31) | (h >> 33)) * k1;
+	}
+
+	// Remaining bytes
+	unsigned long long tail = 0;
+	for (size_t j = 0; i + j < size; j++)
+		tail |= (unsigned long long)(unsigned char)data[i + j] << (j * 8);
+	h ^= tail * k2;
+
+	// Final mix
+	h ^= h >> 33;
+	h *= k2;
+	h ^= h >> 29;
+	return h;
+}
+
+bool MeshCache::Write(const wchar_t* cachePath, unsigned long long sourceHash,
+	const Vertex* vertices, unsigned int numVerts,
+	const unsigned int* indices, unsigned int numIndices,
+	XMFLOAT3 boundsMin, XMFLOAT3 boundsMax,
+	const BoundingSphere& sphere, const BoundingOrientedBox& orientedBox,
+	const MeshLod* lods, unsigned int numLods,
+	const Meshlet* meshlets, unsigned int numMeshlets, unsigned int flags)
+{
+	if (numLods == 0 || numLods > MESH_MAX_LODS)
+		return false;
+
+	MeshCacheHeader header = {};
+	memcpy(header.Magic, "MBIN", 4);
+	header.Version = MESH_CACHE_VERSION;
+	header.Flags = flags;
+	header.SourceHash = sourceHash;
+	header.VertexStride = sizeof(Vertex);
+	header.VertexCount = numVerts;
+	header.IndexCount = numIndices;
+	header.BoundsMin = boundsMin;
+	header.BoundsMax = boundsMax;
+	header.Sphere = sphere;
+	header.OrientedBox = orientedBox;
+	header.LodCount = numLods;
+	memcpy(header.Lods, lods, sizeof(MeshLod) * numLods);
+	header.MeshletCount = numMeshlets;
+
+	// Write to a temporary file first, then swap it in, so a crash
+	// part way through never leaves a truncated cache behind
+	std::wstring tempPath = std::wstring(cachePath) + L".tmp";
+	{
+		std::ofstream out(tempPath.c_str(), std::ios::binary | std::ios::trunc);
+		if (!out.is_open())
+			return false;
+
+		out.write((const char*)&header, sizeof(MeshCacheHeader));
+		out.write((const char*)vertices, sizeof(Vertex) * numVerts);
+		out.write((const char*)indices, sizeof(unsigned int) * numIndices);
+		out.write((const char*)meshlets, sizeof(Meshlet) * numMeshlets);
+		if (!out.good())
+			return false;
+	}
+
+	return MoveFileExW(tempPath.c_str(), cachePath, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+bool MeshCache::Open(const wchar_t* cachePath, unsigned long long sourceHash, unsigned int flags)
+{
+	header = 0;
+	file = std::make_unique<MappedFile>(cachePath);
+	if (!file->IsOpen() || file->GetSize() < sizeof(MeshCacheHeader))
+		return false;
+
+	// Make sure this cache is one we can use
+	const MeshCacheHeader* h = (const MeshCacheHeader*)file->GetData();
+	if (memcmp(h->Magic, "MBIN", 4) != 0 ||
+		h->Version != MESH_CACHE_VERSION ||
+		h->Flags != flags ||
+		h->VertexStride != sizeof(Vertex) ||
+		h->SourceHash != sourceHash)
+		return false;
+
+	// And that it isn't truncated
+	size_t expectedSize = sizeof(MeshCacheHeader) +
+		sizeof(Vertex) * (size_t)h->VertexCount +
+		sizeof(unsigned int) * (size_t)h->IndexCount +
+		sizeof(Meshlet) * (size_t)h->MeshletCount;
+	if (file->GetSize() != expectedSize || h->VertexCount == 0 || h->IndexCount == 0)
+		return false;
+
+	// And that its bounds aren't inside out
+	if (!(h->Sphere.Radius >= 0.0f) || !(h->OrientedBox.Extents.x >= 0.0f) ||
+		!(h->OrientedBox.Extents.y >= 0.0f) || !(h->OrientedBox.Extents.z >= 0.0f))
+		return false;
+
+	// And that every level of detail is inside the index blob
+	if (h->LodCount == 0 || h->LodCount > MESH_MAX_LODS)
+		return false;
+	for (unsigned int i = 0; i < h->LodCount; i++)
+	{
+		if (h->Lods[i].IndexCount == 0 || h->Lods[i].StartIndex > h->IndexCount ||
+			h->Lods[i].IndexCount > h->IndexCount - h->Lods[i].StartIndex)
+			return false;
+	}
+
+	// And that every meshlet is inside the first level of detail
+	const Meshlet* meshlets = (const Meshlet*)((const unsigned int*)((const Vertex*)(h + 1) + h->VertexCount) + h->IndexCount);
+	for (unsigned int i = 0; i < h->MeshletCount; i++)
+	{
+		if (meshlets[i].FirstIndex > h->Lods[0].IndexCount ||
+			meshlets[i].IndexCount > h->Lods[0].IndexCount - meshlets[i].FirstIndex)
+			return false;
+	}
+
+	header = h;
+	return true;
+}
+
+const MeshCacheHeader* MeshCache::GetHeader()
+{
+	return header;
+}
+
+const Vertex* MeshCache::GetVertices()
+{
+	return header ? (const Vertex*)(header + 1) : 0;
+}
+
+const unsigned int* MeshCache::GetIndices()
+{
+	return header ? (const unsigned int*)(GetVertices() + header->VertexCount) : 0;
+}
+
+const Meshlet* MeshCache::GetMeshlets()
+{
+	return header ? (const Meshlet*)(GetIndices() + header->IndexCount) : 0;
+}
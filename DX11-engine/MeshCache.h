@@ -0,0 +1,83 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include "MappedFile.h"
+#include "Vertex.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+
+// Bump this whenever the layout of a .meshbin file changes
+#define MESH_CACHE_VERSION 7
+
+// MeshCacheHeader::Flags bits
+#define MESH_CACHE_OPTIMIZED 0x1	// Indices and vertices were reordered by MeshOptimizer
+
+// The header at the start of every .meshbin file.
+// The vertex blob follows it directly, then the index blob
+// (every level of detail's indices, one after another),
+// then the meshlets of the full resolution level.
+struct MeshCacheHeader
+{
+	char Magic[4];					// Always "MBIN"
+	unsigned int Version;			// MESH_CACHE_VERSION when written
+	unsigned int Flags;				// MESH_CACHE_* bits describing how the data was processed
+	unsigned long long SourceHash;	// Hash of the source file's contents
+	unsigned int VertexStride;		// sizeof(Vertex) when written
+	unsigned int VertexCount;
+	unsigned int IndexCount;
+	DirectX::XMFLOAT3 BoundsMin;	// Local space bounds of all vertices
+	DirectX::XMFLOAT3 BoundsMax;
+	DirectX::BoundingSphere Sphere;	// Tighter bounds, see BoundsCalculator
+	DirectX::BoundingOrientedBox OrientedBox;
+	unsigned int LodCount;			// Always at least 1, the full resolution mesh
+	MeshLod Lods[MESH_MAX_LODS];
+	unsigned int MeshletCount;		// Meshlets covering the first level of detail (see MeshletBuilder)
+};
+
+// --------------------------------------------------------
+// A binary cache of an imported mesh, stored next to its
+// source file as "<source>.meshbin".
+//
+// An open cache is memory mapped, so its vertices and
+// indices can be handed straight to the GPU without any
+// parsing or copying. Caches are tied to the hash of the
+// file they were made from, so editing the source file
+// makes the old cache fail to open.
+// --------------------------------------------------------
+class MeshCache
+{
+public:
+
+	// Returns the path of the cache belonging to the given source file. Files holding
+	// several meshes (like .glb models) get one cache per part: "<source>.<part>.meshbin".
+	static std::wstring GetCachePath(const wchar_t* sourceFile, unsigned int part = 0);
+
+	// Hashes the contents of a source file
+	static unsigned long long HashData(const char* data, size_t size);
+
+	// Writes a new cache file, replacing any existing one
+	static bool Write(const wchar_t* cachePath, unsigned long long sourceHash,
+		const Vertex* vertices, unsigned int numVerts,
+		const unsigned int* indices, unsigned int numIndices,
+		DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax,
+		const DirectX::BoundingSphere& sphere, const DirectX::BoundingOrientedBox& orientedBox,
+		const MeshLod* lods, unsigned int numLods,
+		const Meshlet* meshlets, unsigned int numMeshlets, unsigned int flags = 0);
+
+	// Maps the given cache file, returning false if it is missing, malformed,
+	// from an older version, made from a different source, or processed differently
+	bool Open(const wchar_t* cachePath, unsigned long long sourceHash, unsigned int flags = 0);
+
+	const MeshCacheHeader* GetHeader();
+	const Vertex* GetVertices();
+	const unsigned int* GetIndices();
+	const Meshlet* GetMeshlets();
+
+private:
+
+	std::unique_ptr<MappedFile> file;
+	const MeshCacheHeader* header;
+};
@@ -0,0 +1,378 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+// Forsyth's scoring uses a slightly bigger cache than the one we simulate,
+// since it only models how recently a vertex was used
+#define FORSYTH_CACHE_SIZE 32
+#define FORSYTH_MAX_VALENCE 32
+
+// How far above the ACMR of its whole cluster a piece of it can be and still be split off
+// on its own (Sander et al's lambda, 1 to 3). Higher means more, smaller clusters.
+#define OVERDRAW_ACMR_THRESHOLD 1.05f
+
+// Precomputed parts of Forsyth's vertex score
+struct ForsythScoreTables
+{
+	float cachePosition[FORSYTH_CACHE_SIZE];
+	float valence[FORSYTH_MAX_VALENCE];
+
+	ForsythScoreTables()
+	{
+		for (int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+		{
+			// The last triangle's vertices get a fixed score, so we don't
+			// always continue with the triangle that shares an edge with it
+			cachePosition[i] = i < 3 ? 0.75f :
+				powf(1.0f - (i - 3) * (1.0f / (FORSYTH_CACHE_SIZE - 3)), 1.5f);
+		}
+
+		// Boost vertices with few triangles left, so they get finished off
+		// instead of being left behind as lone triangles for later
+		valence[0] = 0.0f;
+		for (int i = 1; i < FORSYTH_MAX_VALENCE; i++)
+			valence[i] = 2.0f * powf((float)i, -0.5f);
+	}
+};
+
+static float VertexScore(int cachePosition, unsigned int remainingValence)
+{
+	static const ForsythScoreTables tables;
+
+	// No triangles left to draw, so this vertex is irrelevant
+	if (remainingValence == 0)
+		return -1.0f;
+
+	float score = cachePosition >= 0 ? tables.cachePosition[cachePosition] : 0.0f;
+	score += remainingValence < FORSYTH_MAX_VALENCE ?
+		tables.valence[remainingValence] :
+		2.0f * powf((float)remainingValence, -0.5f);
+	return score;
+}
+
+void MeshOptimizer::Optimize(std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	if (indices.empty() || verts.empty())
+		return;
+
+	OptimizeVertexCache(&indices[0], (unsigned int)indices.size(), (unsigned int)verts.size());
+	OptimizeOverdraw(&indices[0], (unsigned int)indices.size(), &verts[0], (unsigned int)verts.size());
+	OptimizeVertexFetch(verts, indices);
+}
+
+void MeshOptimizer::OptimizeVertexCache(unsigned int* indices, unsigned int numIndices, unsigned int numVerts)
+{
+	unsigned int numTris = numIndices / 3;
+	if (numTris == 0)
+		return;
+
+	// Build the list of triangles using each vertex. The first
+	// remaining[v] entries of a vertex's list are the triangles
+	// it still has left to draw.
+	std::vector<unsigned int> remaining(numVerts, 0);
+	for (unsigned int i = 0; i < numTris * 3; i++)
+		remaining[indices[i]]++;
+
+	std::vector<unsigned int> adjacencyStart(numVerts + 1, 0);
+	for (unsigned int v = 0; v < numVerts; v++)
+		adjacencyStart[v + 1] = adjacencyStart[v] + remaining[v];
+
+	std::vector<unsigned int> adjacency(numTris * 3);
+	std::vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (unsigned int t = 0; t < numTris; t++)
+		for (int c = 0; c < 3; c++)
+			adjacency[fill[indices[t * 3 + c]]++] = t;
+
+	// Initial scores, with nothing in the cache yet
+	std::vector<int> cachePosition(numVerts, -1);
+	std::vector<float> vertexScores(numVerts);
+	for (unsigned int v = 0; v < numVerts; v++)
+		vertexScores[v] = VertexScore(-1, remaining[v]);
+
+	std::vector<float> triangleScores(numTris);
+	std::vector<char> triangleAdded(numTris, 0);
+	int bestTriangle = 0;
+	for (unsigned int t = 0; t < numTris; t++)
+	{
+		triangleScores[t] =
+			vertexScores[indices[t * 3 + 0]] +
+			vertexScores[indices[t * 3 + 1]] +
+			vertexScores[indices[t * 3 + 2]];
+		if (triangleScores[t] > triangleScores[bestTriangle])
+			bestTriangle = t;
+	}
+
+	unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+	unsigned int cacheCount = 0;
+	unsigned int scanCursor = 0;
+	std::vector<unsigned int> output(numTris * 3);
+
+	for (unsigned int i = 0; i < numTris; i++)
+	{
+		// If nothing in the cache has triangles left, start over
+		// with the next triangle that hasn't been drawn yet
+		if (bestTriangle < 0)
+		{
+			while (triangleAdded[scanCursor]) scanCursor++;
+			bestTriangle = scanCursor;
+		}
+
+		const unsigned int tri[3] =
+		{
+			indices[bestTriangle * 3 + 0],
+			indices[bestTriangle * 3 + 1],
+			indices[bestTriangle * 3 + 2]
+		};
+		output[i * 3 + 0] = tri[0];
+		output[i * 3 + 1] = tri[1];
+		output[i * 3 + 2] = tri[2];
+		triangleAdded[bestTriangle] = 1;
+
+		// Remove the triangle from its vertices' remaining lists
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = tri[c];
+			unsigned int* list = &adjacency[adjacencyStart[v]];
+			for (unsigned int k = 0; k < remaining[v]; k++)
+			{
+				if (list[k] == (unsigned int)bestTriangle)
+				{
+					list[k] = list[remaining[v] - 1];
+					remaining[v]--;
+					break;
+				}
+			}
+		}
+
+		// The triangle's vertices move to the front of the cache, pushing the rest back
+		unsigned int newCache[FORSYTH_CACHE_SIZE + 3];
+		unsigned int newCount = 0;
+		for (int c = 0; c < 3; c++)
+			newCache[newCount++] = tri[c];
+		for (unsigned int k = 0; k < cacheCount; k++)
+		{
+			unsigned int v = cache[k];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache[newCount++] = v;
+		}
+
+		// Rescore everything that moved (including anything pushed out),
+		// passing the change on to the triangles that use those vertices
+		for (unsigned int k = 0; k < newCount; k++)
+			cachePosition[newCache[k]] = k < FORSYTH_CACHE_SIZE ? (int)k : -1;
+		for (unsigned int k = 0; k < newCount; k++)
+		{
+			unsigned int v = newCache[k];
+			float score = VertexScore(cachePosition[v], remaining[v]);
+			float delta = score - vertexScores[v];
+			vertexScores[v] = score;
+
+			const unsigned int* list = &adjacency[adjacencyStart[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++)
+				triangleScores[list[j]] += delta;
+		}
+
+		cacheCount = std::min(newCount, (unsigned int)FORSYTH_CACHE_SIZE);
+		memcpy(cache, newCache, sizeof(unsigned int) * cacheCount);
+
+		// The next triangle is the best one touching the cache
+		bestTriangle = -1;
+		float bestScore = -1.0f;
+		for (unsigned int k = 0; k < cacheCount; k++)
+		{
+			unsigned int v = cache[k];
+			const unsigned int* list = &adjacency[adjacencyStart[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++)
+			{
+				if (triangleScores[list[j]] > bestScore)
+				{
+					bestScore = triangleScores[list[j]];
+					bestTriangle = list[j];
+				}
+			}
+		}
+	}
+
+	memcpy(indices, &output[0], sizeof(unsigned int) * numTris * 3);
+}
+
+void MeshOptimizer::OptimizeOverdraw(unsigned int* indices, unsigned int numIndices, const Vertex* verts, unsigned int numVerts)
+{
+	unsigned int numTris = numIndices / 3;
+	if (numTris == 0)
+		return;
+
+	// Counts the misses for a triangle in a simulated FIFO cache. Moving time on by more than
+	// the cache size empties it.
+	std::vector<unsigned int> timestamps(numVerts, 0);
+	unsigned int time = VERTEX_CACHE_SIZE + 1;
+	auto triangleMisses = [&](unsigned int t)
+	{
+		unsigned int misses = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = indices[t * 3 + c];
+			if (time - timestamps[v] > VERTEX_CACHE_SIZE)
+			{
+				timestamps[v] = time++;
+				misses++;
+			}
+		}
+		return misses;
+	};
+
+	// First split wherever the cache misses all three vertices of a triangle.
+	// The cache has effectively started over at those points anyway.
+	std::vector<unsigned int> hardStarts;
+	for (unsigned int t = 0; t < numTris; t++)
+	{
+		if (triangleMisses(t) == 3 || t == 0)
+			hardStarts.push_back(t);
+	}
+	hardStarts.push_back(numTris);
+
+	// Then split those further, Tipsify style: run each through an empty cache and cut it off
+	// as soon as the piece so far has an ACMR close enough to the whole cluster's. Reordering
+	// starts each piece with a cold cache, which the threshold says how much to allow for.
+	std::vector<unsigned int> clusterStarts;
+	for (size_t i = 0; i + 1 < hardStarts.size(); i++)
+	{
+		unsigned int start = hardStarts[i];
+		unsigned int end = hardStarts[i + 1];
+
+		time += VERTEX_CACHE_SIZE + 1;
+		unsigned int clusterMisses = 0;
+		for (unsigned int t = start; t < end; t++)
+			clusterMisses += triangleMisses(t);
+		float threshold = OVERDRAW_ACMR_THRESHOLD * clusterMisses / (end - start);
+
+		clusterStarts.push_back(start);
+		time += VERTEX_CACHE_SIZE + 1;
+		unsigned int misses = 0;
+		unsigned int triangles = 0;
+		for (unsigned int t = start; t + 1 < end; t++)
+		{
+			misses += triangleMisses(t);
+			triangles++;
+			if (misses <= threshold * triangles)
+			{
+				clusterStarts.push_back(t + 1);
+				time += VERTEX_CACHE_SIZE + 1;
+				misses = 0;
+				triangles = 0;
+			}
+		}
+	}
+	clusterStarts.push_back(numTris);
+
+	size_t numClusters = clusterStarts.size() - 1;
+	if (numClusters < 2)
+		return;
+
+	// Area weighted centroid and normal of every cluster, and of the mesh as a whole.
+	// The cross product's length is twice the triangle's area, which is all we need.
+	std::vector<XMFLOAT3> clusterCentroids(numClusters);
+	std::vector<XMFLOAT3> clusterNormals(numClusters);
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0.0f;
+	for (size_t i = 0; i < numClusters; i++)
+	{
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0.0f;
+		for (unsigned int t = clusterStarts[i]; t < clusterStarts[i + 1]; t++)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&verts[indices[t * 3 + 0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&verts[indices[t * 3 + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&verts[indices[t * 3 + 2]].Position);
+
+			// Clockwise winding, so this points out of the front face
+			XMVECTOR cross = XMVector3Cross(p1 - p0, p2 - p0);
+			float triArea = XMVectorGetX(XMVector3Length(cross));
+
+			centroid += (p0 + p1 + p2) * (triArea / 3.0f);
+			normal += cross;
+			area += triArea;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+		XMStoreFloat3(&clusterCentroids[i], area > 0.0f ? centroid / area : XMVectorZero());
+		XMStoreFloat3(&clusterNormals[i], XMVector3Normalize(normal));
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// Clusters that are far out from the center and facing outwards are the most
+	// likely to be in front of the rest of the mesh, so they should draw first
+	std::vector<float> sortKeys(numClusters);
+	std::vector<unsigned int> clusterOrder(numClusters);
+	for (size_t i = 0; i < numClusters; i++)
+	{
+		XMVECTOR offset = XMLoadFloat3(&clusterCentroids[i]) - meshCentroid;
+		sortKeys[i] = XMVectorGetX(XMVector3Dot(offset, XMLoadFloat3(&clusterNormals[i])));
+		clusterOrder[i] = (unsigned int)i;
+	}
+	std::stable_sort(clusterOrder.begin(), clusterOrder.end(),
+		[&](unsigned int a, unsigned int b) { return sortKeys[a] > sortKeys[b]; });
+
+	// Write the clusters back in their new order
+	std::vector<unsigned int> output;
+	output.reserve(numTris * 3);
+	for (unsigned int cluster : clusterOrder)
+		output.insert(output.end(),
+			indices + clusterStarts[cluster] * 3,
+			indices + clusterStarts[cluster + 1] * 3);
+
+	memcpy(indices, &output[0], sizeof(unsigned int) * numTris * 3);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	// Number vertices in the order the index buffer first uses them,
+	// dropping any that aren't used at all
+	std::vector<unsigned int> remap(verts.size(), 0xFFFFFFFF);
+	std::vector<Vertex> reordered;
+	reordered.reserve(verts.size());
+	for (unsigned int& index : indices)
+	{
+		if (remap[index] == 0xFFFFFFFF)
+		{
+			remap[index] = (unsigned int)reordered.size();
+			reordered.push_back(verts[index]);
+		}
+		index = remap[index];
+	}
+
+	verts.swap(reordered);
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const unsigned int* indices, unsigned int numIndices,
+	unsigned int numVerts, unsigned int cacheSize)
+{
+	// A vertex is in a FIFO cache if it was one of the
+	// last cacheSize vertices added (hits don't refresh it)
+	std::vector<unsigned int> timestamps(numVerts, 0);
+	unsigned int time = cacheSize + 1;
+	unsigned int usedVerts = 0;
+
+	VertexCacheStats stats = {};
+	for (unsigned int i = 0; i < numIndices; i++)
+	{
+		unsigned int v = indices[i];
+		if (timestamps[v] == 0)
+			usedVerts++;
+		if (time - timestamps[v] > cacheSize)
+		{
+			timestamps[v] = time++;
+			stats.Misses++;
+		}
+	}
+
+	stats.ACMR = numIndices >= 3 ? stats.Misses / (float)(numIndices / 3) : 0.0f;
+	stats.ATVR = usedVerts > 0 ? stats.Misses / (float)usedVerts : 0.0f;
+	return stats;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+
+// Size of the post-transform vertex cache the optimizer and simulator assume
+#define VERTEX_CACHE_SIZE 16
+
+// Results of running an index buffer through a simulated vertex cache
+struct VertexCacheStats
+{
+	unsigned int Misses;	// Number of vertex shader invocations
+	float ACMR;				// Average cache miss ratio: misses per triangle (0.5 is ideal, 3 is worst)
+	float ATVR;				// Average transformed vertex ratio: misses per vertex (1 is ideal)
+};
+
+// --------------------------------------------------------
+// Reorders triangle lists so the GPU does less work drawing them
+//
+// - Vertex cache: Tom Forsyth's "Linear-Speed Vertex Cache
+//   Optimisation", so recently transformed vertices get reused
+// - Overdraw: splits the cache optimized order into clusters that
+//   each keep close to the ACMR they had in place (Sander et al's
+//   "Tipsify" clustering) and sorts them so outward facing,
+//   outermost clusters draw first
+// - Vertex fetch: renumbers vertices in the order they are first
+//   used, so vertex buffer reads walk through memory linearly
+// --------------------------------------------------------
+class MeshOptimizer
+{
+public:
+
+	// Runs every stage below in order
+	static void Optimize(std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+
+	static void OptimizeVertexCache(unsigned int* indices, unsigned int numIndices, unsigned int numVerts);
+	static void OptimizeOverdraw(unsigned int* indices, unsigned int numIndices, const Vertex* verts, unsigned int numVerts);
+	static void OptimizeVertexFetch(std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+
+	// Simulates a FIFO post-transform cache of the given size
+	static VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, unsigned int numIndices,
+		unsigned int numVerts, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+};
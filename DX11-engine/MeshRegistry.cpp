@@ -0,0 +1,218 @@
+#include "MeshRegistry.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include <Windows.h>
+#include <cwctype>
+#include <exception>
+#include <vector>
+
+MeshRegistry::MeshRegistry(Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, size_t budget)
+{
+	this->device = device;
+	this->context = context;
+	this->budget = budget;
+	this->useCounter = 0;
+	this->stats = {};
+
+	// Misses can come from any thread long after loading's done, so this stays on
+	if (SUCCEEDED(context.As(&multithread)))
+		multithread->SetMultithreadProtected(TRUE);
+}
+
+std::shared_ptr<Mesh> MeshRegistry::Get(const std::wstring& path, bool optimize,
+	VertexFormat vertexFormat, MeshResidency residency, std::shared_ptr<GeometryPool> pool)
+{
+	std::wstring settings = MakeSettingsKey(optimize, vertexFormat, residency, pool.get());
+	std::wstring pathKey = NormalizePath(path) + settings;
+	std::shared_ptr<Mesh> mesh;
+
+	// Asked for by this path before
+	std::unique_lock<std::mutex> lock(mutex);
+	auto alias = paths.find(pathKey);
+	if (alias != paths.end() && Find(alias->second, lock, mesh))
+	{
+		stats.Hits++;
+		return mesh;
+	}
+	lock.unlock();
+
+	// Otherwise look it up by its contents, in case it's a copy of something already loaded. Files
+	// that can't be read have nothing to hash, so they're just known by their path.
+	std::wstring contentKey = pathKey;
+	{
+		MappedFile file(path.c_str());
+		if (file.IsOpen())
+		{
+			wchar_t hash[17];
+			swprintf(hash, 17, L"%016llx", MeshCache::HashData(file.GetData(), file.GetSize()));
+			contentKey = hash + settings;
+		}
+	}
+
+	lock.lock();
+	paths[pathKey] = contentKey;
+	if (Find(contentKey, lock, mesh))
+	{
+		stats.Hits++;
+		stats.ContentHits++;
+		return mesh;
+	}
+
+	// Load it, letting anyone else who asks for it meanwhile wait for this to finish
+	stats.Misses++;
+	std::promise<std::shared_ptr<Mesh>> loaded;
+	Entry& entry = entries[contentKey];
+	entry.load = loaded.get_future().share();
+	entry.gpuBytes = 0;
+	entry.lastUsed = ++useCounter;
+	lock.unlock();
+
+	try
+	{
+		mesh = std::make_shared<Mesh>(path.c_str(), device, context, false, optimize, vertexFormat, residency, pool);
+	}
+	catch (...)
+	{
+		// Anyone waiting on this load gets the same exception, and the next Get() tries again
+		lock.lock();
+		entries.erase(contentKey);
+		lock.unlock();
+		loaded.set_exception(std::current_exception());
+		throw;
+	}
+
+	// Loading entries are never evicted, so the entry is still there
+	lock.lock();
+	Entry& done = entries[contentKey];
+	done.mesh = mesh;
+	done.cached = mesh;
+	done.gpuBytes = mesh->GetMemoryUsage().GpuBytes;
+	EnforceBudgetLocked();
+	lock.unlock();
+
+	loaded.set_value(mesh);
+	return mesh;
+}
+
+unsigned int MeshRegistry::GetRefCount(const std::wstring& path, bool optimize,
+	VertexFormat vertexFormat, MeshResidency residency, std::shared_ptr<GeometryPool> pool)
+{
+	std::wstring pathKey = NormalizePath(path) + MakeSettingsKey(optimize, vertexFormat, residency, pool.get());
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto alias = paths.find(pathKey);
+	if (alias == paths.end())
+		return 0;
+	auto entry = entries.find(alias->second);
+	if (entry == entries.end())
+		return 0;
+
+	// Not counting the registry's own reference
+	long count = entry->second.mesh.use_count();
+	return (unsigned int)(entry->second.cached ? count - 1 : count);
+}
+
+void MeshRegistry::EnforceBudget()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	EnforceBudgetLocked();
+}
+
+void MeshRegistry::SetBudget(size_t budget)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	this->budget = budget;
+	EnforceBudgetLocked();
+}
+
+MeshRegistryStats MeshRegistry::GetStats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	MeshRegistryStats current = stats;
+	current.Loaded = 0;
+	current.GpuBytes = 0;
+	for (auto& entry : entries)
+	{
+		if (!entry.second.cached)
+			continue;
+		current.Loaded++;
+		current.GpuBytes += entry.second.gpuBytes;
+	}
+	current.Budget = budget;
+	return current;
+}
+
+std::wstring MeshRegistry::NormalizePath(const std::wstring& path)
+{
+	// The OS resolves relative parts and slashes, and its paths don't care about case
+	std::vector<wchar_t> fullPath(MAX_PATH);
+	DWORD length = GetFullPathNameW(path.c_str(), (DWORD)fullPath.size(), &fullPath[0], 0);
+	if (length >= fullPath.size())
+	{
+		fullPath.resize(length + 1);
+		length = GetFullPathNameW(path.c_str(), (DWORD)fullPath.size(), &fullPath[0], 0);
+	}
+
+	std::wstring normalized = length > 0 ? std::wstring(&fullPath[0], length) : path;
+	for (wchar_t& c : normalized)
+		c = (wchar_t)std::towlower(c);
+	return normalized;
+}
+
+std::wstring MeshRegistry::MakeSettingsKey(bool optimize, VertexFormat vertexFormat, MeshResidency residency, GeometryPool* pool)
+{
+	// The same file loaded differently is a different mesh
+	wchar_t settings[64];
+	swprintf(settings, 64, L"|%d|%d|%d|%p", optimize ? 1 : 0, (int)vertexFormat, (int)residency, (void*)pool);
+	return settings;
+}
+
+bool MeshRegistry::Find(const std::wstring& contentKey, std::unique_lock<std::mutex>& lock, std::shared_ptr<Mesh>& mesh)
+{
+	auto entry = entries.find(contentKey);
+	if (entry == entries.end())
+		return false;
+	entry->second.lastUsed = ++useCounter;
+
+	// Still loading on another thread, so wait for it there (the entry can't be touched while unlocked)
+	if (entry->second.load.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+	{
+		std::shared_future<std::shared_ptr<Mesh>> load = entry->second.load;
+		lock.unlock();
+		mesh = load.get();
+		lock.lock();
+		return true;
+	}
+
+	mesh = entry->second.mesh.lock();
+	return mesh != 0;
+}
+
+void MeshRegistry::EnforceBudgetLocked()
+{
+	// Every loaded mesh counts toward the budget...
+	size_t total = 0;
+	for (auto& entry : entries)
+		total += entry.second.gpuBytes;
+
+	// ...but only ones nothing else is using can go, oldest first
+	while (total > budget)
+	{
+		auto oldest = entries.end();
+		for (auto entry = entries.begin(); entry != entries.end(); ++entry)
+		{
+			if (!entry->second.cached || entry->second.cached.use_count() > 1)
+				continue;
+			if (oldest == entries.end() || entry->second.lastUsed < oldest->second.lastUsed)
+				oldest = entry;
+		}
+		if (oldest == entries.end())
+			break;
+
+		// Dropping the last reference frees the buffers (or the mesh's space in its pool)
+		total -= oldest->second.gpuBytes;
+		entries.erase(oldest);
+		stats.Evictions++;
+	}
+}
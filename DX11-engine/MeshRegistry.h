@@ -0,0 +1,109 @@
+#pragma once
+
+#include <d3d11_4.h>
+#include <wrl/client.h>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Mesh.h"
+
+// Default for how much GPU memory meshes nothing is using can keep held
+#define MESH_REGISTRY_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+// How often lookups found an already loaded mesh, for the stats window
+struct MeshRegistryStats
+{
+	unsigned int Hits;			// Already loaded (or loading) under this path or with the same contents
+	unsigned int ContentHits;	// The subset of hits found through the file's contents, under a different path
+	unsigned int Misses;		// Had to be loaded
+	unsigned int Evictions;		// Unused meshes dropped to stay under budget
+	unsigned int Loaded;		// Meshes alive right now
+	size_t GpuBytes;			// Their vertex and index buffers
+	size_t Budget;
+};
+
+// --------------------------------------------------------
+// Hands out meshes loaded from files, so one file with the
+// same settings is only ever loaded once
+//
+// - Meshes are found by normalized path first, then by the
+//   hash of the file's contents, so copies of a file under
+//   different names share one mesh too
+// - Only weak references are used for finding meshes. The
+//   registry also keeps its own strong reference, so meshes
+//   that nothing uses stay loaded for next time...
+// - ...until the GPU memory of every loaded mesh goes over
+//   the budget. Then unused meshes are dropped, least
+//   recently asked for first, and just get loaded again the
+//   next time they're asked for (quickly, from the binary
+//   cache, see MeshCache)
+// - Get() can be called from any thread at any time: loader
+//   threads (see AssetLoader), the simulation thread, or the
+//   render thread. Two threads asking for the same mesh at
+//   once get the same one, the second waits for the first
+//   to load it.
+// - A miss loads the mesh on the calling thread, uploading
+//   through the immediate context while the render thread
+//   may be drawing with it, so the registry turns on the
+//   context's thread protection for as long as it's around
+// --------------------------------------------------------
+class MeshRegistry
+{
+public:
+
+	MeshRegistry(Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, size_t budget = MESH_REGISTRY_DEFAULT_BUDGET);
+
+	// Same settings as the Mesh constructor. Dynamic meshes are never shared, so they aren't here.
+	// If loading throws, so does every Get() waiting on that load, and nothing's kept.
+	std::shared_ptr<Mesh> Get(const std::wstring& path, bool optimize = true,
+		VertexFormat vertexFormat = VERTEX_FORMAT_FULL, MeshResidency residency = MESH_RESIDENCY_NONE,
+		std::shared_ptr<GeometryPool> pool = 0);
+
+	// How many references there are to a mesh outside of the registry (0 if it isn't loaded)
+	unsigned int GetRefCount(const std::wstring& path, bool optimize = true,
+		VertexFormat vertexFormat = VERTEX_FORMAT_FULL, MeshResidency residency = MESH_RESIDENCY_NONE,
+		std::shared_ptr<GeometryPool> pool = 0);
+
+	// Evicts unused meshes if loaded ones are over budget. Called after every load, and worth
+	// calling whenever meshes may have stopped being used (like once a frame).
+	void EnforceBudget();
+	void SetBudget(size_t budget);
+	MeshRegistryStats GetStats();
+
+	// Lower case, absolute, with any "." and ".." resolved
+	static std::wstring NormalizePath(const std::wstring& path);
+
+private:
+
+	struct Entry
+	{
+		std::shared_future<std::shared_ptr<Mesh>> load;	// Ready once the mesh is
+		std::weak_ptr<Mesh> mesh;
+		std::shared_ptr<Mesh> cached;					// The registry's own reference
+		size_t gpuBytes;
+		unsigned long long lastUsed;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Microsoft::WRL::ComPtr<ID3D11Multithread> multithread;	// Its protection is left on
+
+	// Keyed by content (the file's hash plus the settings), with paths (plus settings)
+	// pointing at the content they were last seen holding
+	std::unordered_map<std::wstring, Entry> entries;
+	std::unordered_map<std::wstring, std::wstring> paths;
+
+	size_t budget;
+	unsigned long long useCounter;
+	MeshRegistryStats stats;
+	std::mutex mutex;
+
+	static std::wstring MakeSettingsKey(bool optimize, VertexFormat vertexFormat, MeshResidency residency, GeometryPool* pool);
+
+	// Looks up a loaded (or loading) mesh, with the lock held. Returns false if there isn't one.
+	bool Find(const std::wstring& contentKey, std::unique_lock<std::mutex>& lock, std::shared_ptr<Mesh>& mesh);
+	void EnforceBudgetLocked();
+};
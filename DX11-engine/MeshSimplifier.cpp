@@ -0,0 +1,373 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+using namespace DirectX;
+
+// Sum of squared distances to a set of planes, weighted by the area of
+// the triangle each plane came from. Stored as the 10 unique entries
+// of the symmetric 4x4 matrix (A, b, c) so that for a point p:
+//   error = p'Ap + 2b'p + c
+struct Quadric
+{
+	double a00, a01, a02, a11, a12, a22;
+	double b0, b1, b2;
+	double c;
+	double weight;
+
+	void AddPlane(double nx, double ny, double nz, double d, double w)
+	{
+		a00 += w * nx * nx; a01 += w * nx * ny; a02 += w * nx * nz;
+		a11 += w * ny * ny; a12 += w * ny * nz; a22 += w * nz * nz;
+		b0 += w * nx * d; b1 += w * ny * d; b2 += w * nz * d;
+		c += w * d * d;
+		weight += w;
+	}
+
+	void Add(const Quadric& other)
+	{
+		a00 += other.a00; a01 += other.a01; a02 += other.a02;
+		a11 += other.a11; a12 += other.a12; a22 += other.a22;
+		b0 += other.b0; b1 += other.b1; b2 += other.b2;
+		c += other.c;
+		weight += other.weight;
+	}
+
+	// Average squared distance from the point to the planes
+	double Error(const XMFLOAT3& p) const
+	{
+		double x = p.x, y = p.y, z = p.z;
+		double e =
+			x * (a00 * x + a01 * y + a02 * z) +
+			y * (a01 * x + a11 * y + a12 * z) +
+			z * (a02 * x + a12 * y + a22 * z) +
+			2.0 * (b0 * x + b1 * y + b2 * z) + c;
+		return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+	}
+};
+
+// A possible collapse of one vertex onto another
+struct Collapse
+{
+	float Cost;
+	float Error;
+	unsigned int From;
+	unsigned int To;
+
+	bool operator<(const Collapse& other) const { return Cost < other.Cost; }
+};
+
+// Hashes exact positions, so vertices split by a normal or uv seam can be found
+struct PositionHash
+{
+	size_t operator()(const XMFLOAT3& p) const
+	{
+		unsigned int bits[3];
+		memcpy(bits, &p, sizeof(bits));
+		return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+	}
+};
+
+struct PositionEqual
+{
+	bool operator()(const XMFLOAT3& a, const XMFLOAT3& b) const
+	{
+		return memcmp(&a, &b, sizeof(XMFLOAT3)) == 0;
+	}
+};
+
+// Would moving "from" onto "to" flip (or nearly flip) any of from's other triangles?
+static bool CollapseFlipsTriangle(const Vertex* verts, const unsigned int* indices,
+	const unsigned int* triangleOffsets, const unsigned int* triangleLists, unsigned int from, unsigned int to)
+{
+	XMVECTOR target = XMLoadFloat3(&verts[to].Position);
+	for (unsigned int t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++)
+	{
+		const unsigned int* tri = &indices[triangleLists[t] * 3];
+		if (tri[0] == to || tri[1] == to || tri[2] == to)
+			continue;
+
+		XMVECTOR p[3], moved[3];
+		for (int c = 0; c < 3; c++)
+		{
+			p[c] = XMLoadFloat3(&verts[tri[c]].Position);
+			moved[c] = tri[c] == from ? target : p[c];
+		}
+
+		XMVECTOR before = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+		XMVECTOR after = XMVector3Cross(moved[1] - moved[0], moved[2] - moved[0]);
+		float lengths = XMVectorGetX(XMVector3Length(before)) * XMVectorGetX(XMVector3Length(after));
+		if (XMVectorGetX(XMVector3Dot(before, after)) <= 0.01f * lengths)
+			return true;
+	}
+	return false;
+}
+
+// Finds the vertex at the given position that shares a triangle with "from"
+static bool FindCollapsePartner(const unsigned int* indices, const unsigned int* triangleOffsets, const unsigned int* triangleLists,
+	const unsigned int* positionIds, unsigned int from, unsigned int toPosition, unsigned int& partner)
+{
+	for (unsigned int t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++)
+	{
+		const unsigned int* tri = &indices[triangleLists[t] * 3];
+		for (int c = 0; c < 3; c++)
+		{
+			if (positionIds[tri[c]] == toPosition)
+			{
+				partner = tri[c];
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+float MeshSimplifier::Simplify(const Vertex* verts, unsigned int numVerts, const unsigned int* indices, unsigned int numIndices,
+	unsigned int targetIndexCount, float maxError, std::vector<unsigned int>& result)
+{
+	result.assign(indices, indices + numIndices);
+	if (numVerts == 0 || numIndices <= targetIndexCount)
+		return 0.0f;
+
+	// Vertices that share a position (split by a normal or uv seam) get one
+	// position id, and have to move together so the seam doesn't crack
+	std::vector<unsigned int> positionIds(numVerts);
+	std::vector<unsigned int> seamOffsets(numVerts + 1, 0);
+	std::vector<unsigned int> seamLists(numVerts);
+	{
+		std::unordered_map<XMFLOAT3, unsigned int, PositionHash, PositionEqual> firstWithPosition;
+		for (unsigned int i = 0; i < numVerts; i++)
+		{
+			positionIds[i] = firstWithPosition.emplace(verts[i].Position, i).first->second;
+			seamOffsets[positionIds[i] + 1]++;
+		}
+		for (unsigned int i = 0; i < numVerts; i++)
+			seamOffsets[i + 1] += seamOffsets[i];
+		std::vector<unsigned int> fill(seamOffsets.begin(), seamOffsets.end() - 1);
+		for (unsigned int i = 0; i < numVerts; i++)
+			seamLists[fill[positionIds[i]]++] = i;
+	}
+
+	// Edges used by exactly one triangle are on a border (more than two
+	// means the surface isn't manifold there, which is just as unsafe)
+	std::vector<bool> locked(numVerts, false);
+	{
+		std::unordered_map<unsigned long long, unsigned int> edgeUses;
+		for (unsigned int i = 0; i < numIndices; i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int a = positionIds[indices[i + e]];
+				unsigned int b = positionIds[indices[i + (e + 1) % 3]];
+				edgeUses[(unsigned long long)std::min(a, b) << 32 | std::max(a, b)]++;
+			}
+		}
+		for (auto& edge : edgeUses)
+		{
+			if (edge.second != 2)
+			{
+				locked[edge.first >> 32] = true;
+				locked[edge.first & 0xFFFFFFFF] = true;
+			}
+		}
+	}
+
+	// Each position starts with the planes of the triangles around it
+	std::vector<Quadric> quadrics(numVerts);
+	memset(&quadrics[0], 0, sizeof(Quadric) * numVerts);
+	for (unsigned int i = 0; i < numIndices; i += 3)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&verts[indices[i]].Position);
+		XMVECTOR normal = XMVector3Cross(XMLoadFloat3(&verts[indices[i + 1]].Position) - p0, XMLoadFloat3(&verts[indices[i + 2]].Position) - p0);
+		float doubleArea = XMVectorGetX(XMVector3Length(normal));
+		if (doubleArea <= 0.0f)
+			continue;
+
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, normal / doubleArea);
+		double d = -XMVectorGetX(XMVector3Dot(normal / doubleArea, p0));
+		for (int c = 0; c < 3; c++)
+			quadrics[positionIds[indices[i + c]]].AddPlane(n.x, n.y, n.z, d, doubleArea * 0.5);
+	}
+
+	// Attribute changes are costed as if they were a distance, scaled to the mesh's size
+	XMVECTOR boundsMin = XMLoadFloat3(&verts[0].Position);
+	XMVECTOR boundsMax = boundsMin;
+	for (unsigned int i = 1; i < numVerts; i++)
+	{
+		boundsMin = XMVectorMin(boundsMin, XMLoadFloat3(&verts[i].Position));
+		boundsMax = XMVectorMax(boundsMax, XMLoadFloat3(&verts[i].Position));
+	}
+	float attributeScale = XMVectorGetX(XMVector3Length(boundsMax - boundsMin)) * 0.5f * LOD_ATTRIBUTE_WEIGHT;
+	attributeScale *= attributeScale;
+
+	// Collapse in passes: find every candidate, then take the cheapest ones that don't
+	// touch each other's triangles, which keeps each pass's flip checks valid
+	float resultError = 0.0f;
+	std::vector<unsigned int> triangleOffsets(numVerts + 1);
+	std::vector<unsigned int> triangleLists;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> collapseTo(numVerts);
+	std::vector<unsigned int> partners;
+	std::vector<bool> touched(numVerts);
+	while (result.size() > targetIndexCount)
+	{
+		unsigned int numTriangles = (unsigned int)result.size() / 3;
+
+		// Which triangles use each vertex
+		std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+		for (unsigned int index : result)
+			triangleOffsets[index + 1]++;
+		for (unsigned int i = 0; i < numVerts; i++)
+			triangleOffsets[i + 1] += triangleOffsets[i];
+		triangleLists.resize(result.size());
+		{
+			std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (unsigned int i = 0; i < (unsigned int)result.size(); i++)
+				triangleLists[fill[result[i]]++] = i / 3;
+		}
+
+		// Every edge can collapse either way, unless the position that would move is locked
+		collapses.clear();
+		for (unsigned int i = 0; i < (unsigned int)result.size(); i += 3)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				unsigned int from = result[i + e];
+				unsigned int to = result[i + (e + 1) % 3];
+				for (int direction = 0; direction < 2; direction++, std::swap(from, to))
+				{
+					unsigned int fromPosition = positionIds[from];
+					unsigned int toPosition = positionIds[to];
+					if (locked[fromPosition] || fromPosition == toPosition)
+						continue;
+
+					Quadric q = quadrics[fromPosition];
+					q.Add(quadrics[toPosition]);
+					float error = (float)q.Error(verts[to].Position);
+
+					XMVECTOR normalChange = XMLoadFloat3(&verts[from].Normal) - XMLoadFloat3(&verts[to].Normal);
+					XMVECTOR uvChange = XMLoadFloat2(&verts[from].UV) - XMLoadFloat2(&verts[to].UV);
+					float attributeError = XMVectorGetX(XMVector3LengthSq(normalChange)) + XMVectorGetX(XMVector2LengthSq(uvChange));
+
+					Collapse collapse = { error + attributeScale * attributeError, sqrtf(error), from, to };
+					collapses.push_back(collapse);
+				}
+			}
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		// Each collapse removes about 2 triangles, so don't overshoot the target by much
+		unsigned int trianglesToRemove = numTriangles - targetIndexCount / 3;
+		unsigned int trianglesRemoved = 0;
+		for (unsigned int i = 0; i < numVerts; i++)
+			collapseTo[i] = i;
+		std::fill(touched.begin(), touched.end(), false);
+
+		for (const Collapse& collapse : collapses)
+		{
+			if (collapse.Error > maxError || trianglesRemoved >= trianglesToRemove)
+				break;
+
+			unsigned int fromPosition = positionIds[collapse.From];
+			unsigned int toPosition = positionIds[collapse.To];
+			if (touched[fromPosition] || touched[toPosition])
+				continue;
+
+			// Every vertex at the moving position needs a neighbour at the target
+			// position to collapse onto, which keeps seams sliding along themselves
+			partners.clear();
+			bool valid = true;
+			for (unsigned int s = seamOffsets[fromPosition]; s < seamOffsets[fromPosition + 1] && valid; s++)
+			{
+				unsigned int from = seamLists[s];
+				if (triangleOffsets[from] == triangleOffsets[from + 1])
+					continue;
+
+				unsigned int partner = from;
+				valid =
+					FindCollapsePartner(&result[0], &triangleOffsets[0], &triangleLists[0], &positionIds[0], from, toPosition, partner) &&
+					!CollapseFlipsTriangle(verts, &result[0], &triangleOffsets[0], &triangleLists[0], from, partner);
+				partners.push_back(from);
+				partners.push_back(partner);
+			}
+			if (!valid)
+				continue;
+
+			// Nothing else this pass can change the triangles around the collapsed position
+			for (size_t k = 0; k < partners.size(); k += 2)
+			{
+				unsigned int from = partners[k];
+				for (unsigned int t = triangleOffsets[from]; t < triangleOffsets[from + 1]; t++)
+				{
+					const unsigned int* tri = &result[triangleLists[t] * 3];
+					for (int c = 0; c < 3; c++)
+						touched[positionIds[tri[c]]] = true;
+					if (positionIds[tri[0]] == toPosition || positionIds[tri[1]] == toPosition || positionIds[tri[2]] == toPosition)
+						trianglesRemoved++;
+				}
+				collapseTo[from] = partners[k + 1];
+			}
+
+			quadrics[toPosition].Add(quadrics[fromPosition]);
+			resultError = std::max(resultError, collapse.Error);
+		}
+
+		if (trianglesRemoved == 0)
+			break;
+
+		// Rebuild the triangle list, dropping the ones that collapsed to lines
+		unsigned int written = 0;
+		for (unsigned int i = 0; i < (unsigned int)result.size(); i += 3)
+		{
+			unsigned int a = collapseTo[result[i]];
+			unsigned int b = collapseTo[result[i + 1]];
+			unsigned int c = collapseTo[result[i + 2]];
+			if (positionIds[a] == positionIds[b] || positionIds[b] == positionIds[c] || positionIds[c] == positionIds[a])
+				continue;
+
+			result[written++] = a;
+			result[written++] = b;
+			result[written++] = c;
+		}
+		result.resize(written);
+	}
+
+	return resultError;
+}
+
+void MeshSimplifier::BuildLods(const std::vector<Vertex>& verts, std::vector<unsigned int>& indices,
+	std::vector<MeshLod>& lods, bool optimize)
+{
+	lods.clear();
+	MeshLod full = { 0, (unsigned int)indices.size(), 0.0f };
+	lods.push_back(full);
+
+	// Every level is simplified from the original, so its error is measured against the real surface
+	unsigned int originalCount = (unsigned int)indices.size();
+	std::vector<unsigned int> simplified;
+	while (lods.size() < MESH_MAX_LODS)
+	{
+		const MeshLod& previous = lods.back();
+		unsigned int target = (unsigned int)(previous.IndexCount / 3 * LOD_REDUCTION) * 3;
+		if (target < LOD_MIN_TRIANGLES * 3)
+			break;
+
+		float error = Simplify(&verts[0], (unsigned int)verts.size(), &indices[0], originalCount, target, FLT_MAX, simplified);
+
+		// Stop once the simplifier can't make meaningful progress (see LOD_MAX_KEPT)
+		if (simplified.size() > previous.IndexCount * LOD_MAX_KEPT)
+			break;
+
+		if (optimize)
+			MeshOptimizer::OptimizeVertexCache(&simplified[0], (unsigned int)simplified.size(), (unsigned int)verts.size());
+
+		MeshLod lod = { (unsigned int)indices.size(), (unsigned int)simplified.size(), std::max(error, previous.Error) };
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		lods.push_back(lod);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+
+// Most levels of detail a mesh can have, including the full resolution one
+#define MESH_MAX_LODS 5
+
+// Each level of detail aims for this fraction of the previous level's triangles
+#define LOD_REDUCTION 0.5f
+
+// Meshes don't get simplified below this many triangles
+#define LOD_MIN_TRIANGLES 32
+
+// A level of detail keeping more than this fraction of the previous level's triangles isn't worth
+// its indices, so that's where the chain stops. It happens once nearly everything left is on an
+// open border (which never moves), or when every remaining collapse would flip a triangle.
+#define LOD_MAX_KEPT 0.9f
+
+// How much a collapse that changes a vertex's normal or uv costs, relative
+// to moving it that far (in units of the mesh's bounding radius)
+#define LOD_ATTRIBUTE_WEIGHT 0.05f
+
+// One level of detail: a range of a mesh's index buffer drawn with the same vertices
+struct MeshLod
+{
+	unsigned int StartIndex;
+	unsigned int IndexCount;
+	float Error;				// Estimate of how far the surface strays from the full resolution one, in
+								// local units (the worst collapse's root mean square distance to its planes)
+};
+
+// --------------------------------------------------------
+// Builds lower detail versions of a mesh using quadric error
+// metrics (Garland and Heckbert's "Surface Simplification
+// Using Quadric Error Metrics")
+//
+// - Edges are collapsed onto one of their vertices, so every
+//   level of detail shares the original vertex buffer and
+//   only needs its own indices
+// - Collapses are ranked by their quadric error, plus a
+//   penalty for how much the normal and uv change, so creases
+//   and uv detail hold up longer
+// - Vertices sharing a position (a normal or uv seam) move
+//   together and only along the seam, so it doesn't crack
+// - Vertices on an open border or a non-manifold edge are
+//   never moved
+// --------------------------------------------------------
+class MeshSimplifier
+{
+public:
+
+	// Collapses edges until there are at most targetIndexCount indices left, or no collapse
+	// stays within maxError. Returns the error of the result (see MeshLod::Error).
+	static float Simplify(const Vertex* verts, unsigned int numVerts, const unsigned int* indices, unsigned int numIndices,
+		unsigned int targetIndexCount, float maxError, std::vector<unsigned int>& result);
+
+	// Appends up to MESH_MAX_LODS - 1 simplified versions of the mesh to its indices,
+	// filling in where each level of detail (including the original) starts
+	static void BuildLods(const std::vector<Vertex>& verts, std::vector<unsigned int>& indices,
+		std::vector<MeshLod>& lods, bool optimize);
+};
@@ -0,0 +1,282 @@
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+// Past this spread (dot of about 0.1, or 84 degrees) a normal cone is too wide to ever cull anything
+#define MESHLET_CONE_MIN_DOT 0.1f
+
+// How much a triangle facing the same way as a meshlet counts in its favour when growing it
+// (0 only looks at distance, 1 makes triangles facing the same way free)
+#define MESHLET_CONE_WEIGHT 1.0f
+
+void MeshletBuilder::Build(const Vertex* verts, unsigned int numVerts, unsigned int* indices, unsigned int numIndices,
+	bool reorder, std::vector<Meshlet>& meshlets)
+{
+	meshlets.clear();
+	unsigned int numTriangles = numIndices / 3;
+	if (numTriangles == 0)
+		return;
+
+	// Which meshlet last used each vertex, to count the new ones a triangle would add
+	std::vector<unsigned int> owner(numVerts, 0xFFFFFFFF);
+	Meshlet meshlet = {};
+
+	if (!reorder)
+	{
+		// Split the triangles into meshlets in the order they already are
+		for (unsigned int t = 0; t < numTriangles; t++)
+		{
+			const unsigned int* tri = &indices[t * 3];
+			unsigned int id = (unsigned int)meshlets.size();
+			unsigned int newVerts = (owner[tri[0]] != id) + (owner[tri[1]] != id) + (owner[tri[2]] != id);
+			if (meshlet.VertexCount + newVerts > MESHLET_MAX_VERTICES || meshlet.IndexCount / 3 == MESHLET_MAX_TRIANGLES)
+			{
+				meshlets.push_back(meshlet);
+				meshlet = {};
+				meshlet.FirstIndex = t * 3;
+				id++;
+			}
+
+			for (int c = 0; c < 3; c++)
+			{
+				if (owner[tri[c]] != id)
+				{
+					owner[tri[c]] = id;
+					meshlet.VertexCount++;
+				}
+			}
+			meshlet.IndexCount += 3;
+		}
+		meshlets.push_back(meshlet);
+
+		for (Meshlet& m : meshlets)
+			ComputeBounds(m, verts, indices);
+		return;
+	}
+
+	// Which triangles use each vertex
+	std::vector<unsigned int> triangleOffsets(numVerts + 1, 0);
+	for (unsigned int i = 0; i < numIndices; i++)
+		triangleOffsets[indices[i] + 1]++;
+	for (unsigned int i = 0; i < numVerts; i++)
+		triangleOffsets[i + 1] += triangleOffsets[i];
+	std::vector<unsigned int> triangleLists(numIndices);
+	{
+		std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (unsigned int i = 0; i < numIndices; i++)
+			triangleLists[fill[indices[i]]++] = i / 3;
+	}
+
+	// Unit normal (zero if it's degenerate) and centroid of each triangle
+	std::vector<XMFLOAT3> triangleNormals(numTriangles);
+	std::vector<XMFLOAT3> triangleCentroids(numTriangles);
+	for (unsigned int t = 0; t < numTriangles; t++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&verts[indices[t * 3]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&verts[indices[t * 3 + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&verts[indices[t * 3 + 2]].Position);
+		XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+		float length = XMVectorGetX(XMVector3Length(normal));
+		XMStoreFloat3(&triangleNormals[t], length > 0.0f ? normal / length : XMVectorZero());
+		XMStoreFloat3(&triangleCentroids[t], (p0 + p1 + p2) / 3.0f);
+	}
+
+	std::vector<bool> emitted(numTriangles, false);
+	std::vector<unsigned int> order;
+	order.reserve(numTriangles);
+	std::vector<unsigned int> meshletVerts;
+	std::vector<unsigned int> previousVerts;
+	unsigned int cursor = 0;
+
+	while (order.size() < numTriangles)
+	{
+		unsigned int id = (unsigned int)meshlets.size();
+		meshlet = {};
+		meshlet.FirstIndex = (unsigned int)order.size() * 3;
+		meshletVerts.clear();
+		XMVECTOR axis = XMVectorZero();
+		XMVECTOR centroidSum = XMVectorZero();
+
+		auto addTriangle = [&](unsigned int t)
+		{
+			emitted[t] = true;
+			order.push_back(t);
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int v = indices[t * 3 + c];
+				if (owner[v] != id)
+				{
+					owner[v] = id;
+					meshletVerts.push_back(v);
+				}
+			}
+			axis += XMLoadFloat3(&triangleNormals[t]);
+			centroidSum += XMLoadFloat3(&triangleCentroids[t]);
+			meshlet.IndexCount += 3;
+		};
+
+		// Start next to the last meshlet if possible, so they don't leave scattered leftovers behind
+		unsigned int seed = 0xFFFFFFFF;
+		for (unsigned int i = 0; i < previousVerts.size() && seed == 0xFFFFFFFF; i++)
+		{
+			unsigned int v = previousVerts[i];
+			for (unsigned int k = triangleOffsets[v]; k < triangleOffsets[v + 1]; k++)
+			{
+				if (!emitted[triangleLists[k]])
+				{
+					seed = triangleLists[k];
+					break;
+				}
+			}
+		}
+		if (seed == 0xFFFFFFFF)
+		{
+			while (emitted[cursor])
+				cursor++;
+			seed = cursor;
+		}
+		addTriangle(seed);
+
+		// Grow it with neighbours that don't add vertices first, then whichever is closest
+		// to the middle of the meshlet and faces the most like it, keeping it round and flat
+		while (meshlet.IndexCount / 3 < MESHLET_MAX_TRIANGLES)
+		{
+			XMVECTOR centroid = centroidSum / (float)(meshlet.IndexCount / 3);
+			XMVECTOR facingAxis = XMVector3Normalize(axis);
+
+			unsigned int best = 0xFFFFFFFF;
+			bool bestAddsVerts = true;
+			float bestScore = FLT_MAX;
+			for (unsigned int v : meshletVerts)
+			{
+				for (unsigned int k = triangleOffsets[v]; k < triangleOffsets[v + 1]; k++)
+				{
+					unsigned int t = triangleLists[k];
+					if (emitted[t])
+						continue;
+
+					const unsigned int* tri = &indices[t * 3];
+					unsigned int newVerts = (owner[tri[0]] != id) + (owner[tri[1]] != id) + (owner[tri[2]] != id);
+					if (meshletVerts.size() + newVerts > MESHLET_MAX_VERTICES)
+						continue;
+
+					float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&triangleCentroids[t]) - centroid));
+					float facing = XMVectorGetX(XMVector3Dot(facingAxis, XMLoadFloat3(&triangleNormals[t])));
+					float score = distance * (1.0f - MESHLET_CONE_WEIGHT * facing);
+					bool addsVerts = newVerts > 0;
+					if ((!addsVerts && bestAddsVerts) || (addsVerts == bestAddsVerts && score < bestScore))
+					{
+						best = t;
+						bestAddsVerts = addsVerts;
+						bestScore = score;
+					}
+				}
+			}
+
+			if (best == 0xFFFFFFFF)
+				break;
+			addTriangle(best);
+		}
+
+		meshlet.VertexCount = (unsigned int)meshletVerts.size();
+		meshlets.push_back(meshlet);
+		previousVerts.swap(meshletVerts);
+	}
+
+	// Rewrite the triangles in meshlet order
+	std::vector<unsigned int> original(indices, indices + numIndices);
+	for (unsigned int i = 0; i < numTriangles; i++)
+	{
+		indices[i * 3 + 0] = original[order[i] * 3 + 0];
+		indices[i * 3 + 1] = original[order[i] * 3 + 1];
+		indices[i * 3 + 2] = original[order[i] * 3 + 2];
+	}
+
+	for (Meshlet& m : meshlets)
+		ComputeBounds(m, verts, indices);
+}
+
+void MeshletBuilder::ComputeBounds(Meshlet& meshlet, const Vertex* verts, const unsigned int* indices)
+{
+	const unsigned int* first = &indices[meshlet.FirstIndex];
+	unsigned int count = meshlet.IndexCount;
+
+	// Ritter's bounding sphere: start between two far apart points, then grow to fit the rest
+	XMVECTOR start = XMLoadFloat3(&verts[first[0]].Position);
+	XMVECTOR a = start;
+	float furthest = -1.0f;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&verts[first[i]].Position);
+		float distance = XMVectorGetX(XMVector3LengthSq(p - start));
+		if (distance > furthest)
+		{
+			furthest = distance;
+			a = p;
+		}
+	}
+	XMVECTOR b = a;
+	furthest = -1.0f;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&verts[first[i]].Position);
+		float distance = XMVectorGetX(XMVector3LengthSq(p - a));
+		if (distance > furthest)
+		{
+			furthest = distance;
+			b = p;
+		}
+	}
+
+	XMVECTOR center = (a + b) * 0.5f;
+	float radius = XMVectorGetX(XMVector3Length(b - a)) * 0.5f;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&verts[first[i]].Position);
+		float distance = XMVectorGetX(XMVector3Length(p - center));
+		if (distance > radius)
+		{
+			// Move the center just enough to take in the point
+			float newRadius = (radius + distance) * 0.5f;
+			center += (p - center) * ((newRadius - radius) / distance);
+			radius = newRadius;
+		}
+	}
+	XMStoreFloat3(&meshlet.Center, center);
+	meshlet.Radius = radius;
+
+	// Normal cone: the average facing, and how far the furthest triangle strays from it
+	XMVECTOR normals[MESHLET_MAX_TRIANGLES];
+	unsigned int numNormals = 0;
+	XMVECTOR axis = XMVectorZero();
+	for (unsigned int i = 0; i + 2 < count && numNormals < MESHLET_MAX_TRIANGLES; i += 3)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&verts[first[i]].Position);
+		XMVECTOR normal = XMVector3Cross(XMLoadFloat3(&verts[first[i + 1]].Position) - p0, XMLoadFloat3(&verts[first[i + 2]].Position) - p0);
+		float length = XMVectorGetX(XMVector3Length(normal));
+		if (length <= 0.0f)
+			continue;
+
+		normals[numNormals++] = normal / length;
+		axis += normal / length;
+	}
+
+	float axisLength = XMVectorGetX(XMVector3Length(axis));
+	if (numNormals == 0 || axisLength <= 0.0f)
+	{
+		meshlet.ConeAxis = XMFLOAT3(0, 0, 1);
+		meshlet.ConeCutoff = 1.0f;
+		return;
+	}
+
+	axis /= axisLength;
+	float minDot = 1.0f;
+	for (unsigned int i = 0; i < numNormals; i++)
+		minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(axis, normals[i])));
+
+	XMStoreFloat3(&meshlet.ConeAxis, axis);
+	meshlet.ConeCutoff = minDot <= MESHLET_CONE_MIN_DOT ? 1.0f : sqrtf(1.0f - minDot * minDot);
+}
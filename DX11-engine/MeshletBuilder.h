@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include "Vertex.h"
+
+// Meshlet size limits, matching what mesh shader hardware likes
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+// A small cluster of neighbouring triangles that can be culled on its own
+struct Meshlet
+{
+	unsigned int FirstIndex;		// Where its triangles start in the mesh's index buffer
+	unsigned int IndexCount;
+	unsigned int VertexCount;		// Unique vertices its triangles use, at most MESHLET_MAX_VERTICES
+	DirectX::XMFLOAT3 Center;		// Bounding sphere
+	float Radius;
+	DirectX::XMFLOAT3 ConeAxis;		// Average direction its triangles face
+	float ConeCutoff;				// Sine of the widest angle between the axis and a triangle's normal,
+									// or 1 if the triangles face too many ways to ever all be back-facing
+};
+
+// --------------------------------------------------------
+// Splits a triangle list into meshlets for cluster culling
+// (see MeshletCuller)
+//
+// - Meshlets are grown one triangle at a time from a seed,
+//   always picking a neighbouring triangle that adds no new
+//   vertices if there is one, otherwise the one closest to
+//   its middle and facing most like the rest, which keeps
+//   meshlets compact and their normal cones narrow
+// - Each meshlet's triangles are made contiguous in the
+//   index buffer, so a visible meshlet is just a range to
+//   draw, and visible neighbours merge into one draw
+// --------------------------------------------------------
+class MeshletBuilder
+{
+public:
+
+	// With reorder, triangles are regrouped into meshlets and the indices are rewritten in meshlet order.
+	// Without it, the triangle order is kept and meshlets are just split off it as they fill up.
+	static void Build(const Vertex* verts, unsigned int numVerts, unsigned int* indices, unsigned int numIndices,
+		bool reorder, std::vector<Meshlet>& meshlets);
+
+	// Recalculates a meshlet's bounding sphere and normal cone, for when its vertices move
+	static void ComputeBounds(Meshlet& meshlet, const Vertex* verts, const unsigned int* indices);
+};
@@ -0,0 +1,137 @@
+#include "MeshletCuller.h"
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+
+// Number of camera positions along each benchmark path
+#define MESHLET_BENCHMARK_VIEWS 64
+
+void MeshletCuller::Cull(const Meshlet* meshlets, unsigned int numMeshlets,
+	const XMFLOAT4X4& worldViewProj, XMFLOAT3 localCameraPos, bool cullBackfaces,
+	std::vector<IndexRange>& ranges, MeshletCullStats* stats)
+{
+	ranges.clear();
+	MeshletCullStats counts = {};
+	counts.Meshlets = numMeshlets;
+
+	// Frustum planes in the mesh's local space (Gribb and Hartmann), pointing inwards
+	const XMFLOAT4X4& m = worldViewProj;
+	XMVECTOR planes[6] =
+	{
+		XMVectorSet(m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41),	// Left
+		XMVectorSet(m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41),	// Right
+		XMVectorSet(m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42),	// Bottom
+		XMVectorSet(m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42),	// Top
+		XMVectorSet(m._13, m._23, m._33, m._43),									// Near
+		XMVectorSet(m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43)	// Far
+	};
+	for (XMVECTOR& plane : planes)
+		plane /= XMVectorGetX(XMVector3Length(plane));
+
+	XMVECTOR cameraPos = XMLoadFloat3(&localCameraPos);
+	for (unsigned int i = 0; i < numMeshlets; i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		unsigned int triangles = meshlet.IndexCount / 3;
+		counts.Triangles += triangles;
+
+		// Completely outside any one plane
+		XMVECTOR center = XMVectorSetW(XMLoadFloat3(&meshlet.Center), 1.0f);
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; p++)
+			outside = XMVectorGetX(XMVector4Dot(planes[p], center)) < -meshlet.Radius;
+		if (outside)
+		{
+			counts.FrustumCulledTriangles += triangles;
+			continue;
+		}
+
+		// The camera is behind every triangle's plane
+		if (cullBackfaces && meshlet.ConeCutoff < 1.0f)
+		{
+			XMVECTOR toCenter = XMLoadFloat3(&meshlet.Center) - cameraPos;
+			float along = XMVectorGetX(XMVector3Dot(toCenter, XMLoadFloat3(&meshlet.ConeAxis)));
+			if (along >= meshlet.ConeCutoff * XMVectorGetX(XMVector3Length(toCenter)) + meshlet.Radius)
+			{
+				counts.BackfaceCulledTriangles += triangles;
+				continue;
+			}
+		}
+
+		// Extend the last range if this meshlet follows straight on from it
+		if (!ranges.empty() && ranges.back().StartIndex + ranges.back().IndexCount == meshlet.FirstIndex)
+		{
+			ranges.back().IndexCount += meshlet.IndexCount;
+		}
+		else
+		{
+			IndexRange range = { meshlet.FirstIndex, meshlet.IndexCount };
+			ranges.push_back(range);
+		}
+	}
+
+	if (stats)
+		*stats = counts;
+}
+
+MeshletCullBenchmark MeshletCuller::Benchmark(const Meshlet* meshlets, unsigned int numMeshlets,
+	XMFLOAT3 boundsMin, XMFLOAT3 boundsMax)
+{
+	MeshletCullBenchmark results = {};
+	XMVECTOR center = (XMLoadFloat3(&boundsMin) + XMLoadFloat3(&boundsMax)) * 0.5f;
+	float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&boundsMax) - XMLoadFloat3(&boundsMin))) * 0.5f;
+	if (numMeshlets == 0 || radius <= 0.0f)
+		return results;
+
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, radius * 0.01f, radius * 100.0f);
+	std::vector<IndexRange> ranges;
+	double totalMs = 0.0;
+
+	// Each path is a list of camera positions and the direction they look in
+	float* fractions[3] = { &results.Orbit, &results.Skim, &results.FlyThrough };
+	for (int path = 0; path < 3; path++)
+	{
+		unsigned long long culled = 0;
+		unsigned long long total = 0;
+		for (int i = 0; i < MESHLET_BENCHMARK_VIEWS; i++)
+		{
+			float t = (float)i / MESHLET_BENCHMARK_VIEWS;
+			float angle = t * XM_2PI;
+			XMVECTOR around = XMVectorSet(cosf(angle), 0.25f, sinf(angle), 0.0f);
+			XMVECTOR position, direction;
+			switch (path)
+			{
+			case 0:
+				position = center + around * (radius * 3.0f);
+				direction = center - position;
+				break;
+			case 1:
+				position = center + around * (radius * 1.1f);
+				direction = XMVectorSet(-sinf(angle) - cosf(angle) * 0.5f, 0.0f, cosf(angle) - sinf(angle) * 0.5f, 0.0f);
+				break;
+			default:
+				position = center + XMVectorSet(radius * (4.0f * t - 2.0f), radius * 0.1f, 0.0f, 0.0f);
+				direction = XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+				break;
+			}
+
+			XMFLOAT4X4 viewProj;
+			XMStoreFloat4x4(&viewProj, XMMatrixLookToLH(position, direction, XMVectorSet(0, 1, 0, 0)) * proj);
+			XMFLOAT3 cameraPos;
+			XMStoreFloat3(&cameraPos, position);
+
+			MeshletCullStats stats;
+			auto start = std::chrono::high_resolution_clock::now();
+			Cull(meshlets, numMeshlets, viewProj, cameraPos, true, ranges, &stats);
+			totalMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			culled += stats.BackfaceCulledTriangles + stats.FrustumCulledTriangles;
+			total += stats.Triangles;
+		}
+		*fractions[path] = total > 0 ? (float)((double)culled / total) : 0.0f;
+	}
+
+	results.MsPerView = totalMs / (3 * MESHLET_BENCHMARK_VIEWS);
+	return results;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+#include "MeshletBuilder.h"
+
+// A range of an index buffer to draw
+struct IndexRange
+{
+	unsigned int StartIndex;
+	unsigned int IndexCount;
+};
+
+// How many meshlets and triangles a cull was given, and threw away
+struct MeshletCullStats
+{
+	unsigned int Meshlets;
+	unsigned int Triangles;
+	unsigned int BackfaceCulledTriangles;
+	unsigned int FrustumCulledTriangles;
+};
+
+// Fraction of triangles culled along each of MeshletCuller::Benchmark()'s camera paths
+struct MeshletCullBenchmark
+{
+	float Orbit;			// Circling the mesh, looking at it
+	float Skim;				// Circling close to the surface, looking along it
+	float FlyThrough;		// Flying straight through the middle
+	double MsPerView;		// Average time to cull once
+};
+
+// --------------------------------------------------------
+// Culls meshlets (see MeshletBuilder) against a view on the CPU
+//
+// - Everything is tested in the mesh's local space: the
+//   frustum planes come straight out of the combined
+//   world-view-projection matrix, and the camera is moved
+//   into local space, so meshlet bounds never need
+//   transforming
+// - A meshlet is back-facing when the camera is behind every
+//   triangle in its normal cone (the test from Zeux's
+//   meshoptimizer, using the bounding sphere)
+// - Visible meshlets that are next to each other in the
+//   index buffer are merged into one range
+// --------------------------------------------------------
+class MeshletCuller
+{
+public:
+
+	// Fills ranges with the parts of the index buffer to draw. Back-face culling assumes
+	// the rasterizer culls back faces, and should be off for mirrored (negative scale) transforms.
+	static void Cull(const Meshlet* meshlets, unsigned int numMeshlets,
+		const DirectX::XMFLOAT4X4& worldViewProj, DirectX::XMFLOAT3 localCameraPos, bool cullBackfaces,
+		std::vector<IndexRange>& ranges, MeshletCullStats* stats = 0);
+
+	// Culls the meshlets from cameras along a few typical paths around their bounds.
+	// Doesn't need a device, so it can run anywhere the mesh data can be loaded.
+	static MeshletCullBenchmark Benchmark(const Meshlet* meshlets, unsigned int numMeshlets,
+		DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax);
+};
@@ -0,0 +1,445 @@
+#include "ObjLoader.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+using namespace DirectX;
+
+// Powers of ten that are exactly representable as doubles
+static const double PowersOf10[] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+static inline bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+// Skips spaces and tabs, but never the end of a line
+static inline const char* SkipSpaces(const char* p, const char* end)
+{
+	while (p < end && IsSpace(*p)) p++;
+	return p;
+}
+
+// Moves to the first character of the next line
+static inline const char* SkipLine(const char* p, const char* end)
+{
+	const char* newline = (const char*)memchr(p, '\n', end - p);
+	return newline ? newline + 1 : end;
+}
+
+// OBJ indices are 1-based, and negative ones count backwards from the
+// most recently read element. A chunk of the file doesn't know how many
+// elements came before it, so negative indices are stored relative to the
+// start of the chunk (tagged with OBJ_RELATIVE_INDEX) and fixed up once all
+// chunks are parsed. Validation against the final array sizes happens later
+// in BuildVertices().
+static inline unsigned int ResolveIndex(int index, size_t count)
+{
+	if (index > 0 && (unsigned int)(index - 1) < OBJ_RELATIVE_INDEX) return (unsigned int)(index - 1);
+	if (index < 0) return OBJ_RELATIVE_INDEX | (unsigned int)((long long)count + index + OBJ_RELATIVE_BIAS);
+	return OBJ_NO_INDEX;
+}
+
+// Turns a chunk relative index into a global one, given the number of
+// elements that came before the chunk
+static inline unsigned int FixupIndex(unsigned int index, size_t base)
+{
+	if (index == OBJ_NO_INDEX || !(index & OBJ_RELATIVE_INDEX))
+		return index;
+
+	long long global = (long long)base + (long long)(index & ~OBJ_RELATIVE_INDEX) - OBJ_RELATIVE_BIAS;
+	return global >= 0 && global < OBJ_RELATIVE_INDEX ? (unsigned int)global : OBJ_NO_INDEX;
+}
+
+bool ObjLoader::Parse(const char* data, size_t size, ObjData& out, unsigned int threadCount)
+{
+	if (threadCount <= 1)
+	{
+		// One chunk covering the whole file, which is already in place
+		ParseChunk(data, data + size, out);
+		FixupChunk(out, 0, 0, 0, out, 0);
+		return !out.corners.empty();
+	}
+
+	// Split the file into roughly even chunks that each start on a new line
+	const char* end = data + size;
+	std::vector<const char*> chunkStarts;
+	chunkStarts.push_back(data);
+	for (unsigned int i = 1; i < threadCount; i++)
+	{
+		const char* start = SkipLine(data + size / threadCount * i, end);
+		if (start > chunkStarts.back() && start < end)
+			chunkStarts.push_back(start);
+	}
+	chunkStarts.push_back(end);
+	size_t numChunks = chunkStarts.size() - 1;
+
+	// Parse every chunk into its own buffers at the same time
+	std::vector<ObjData> chunks(numChunks);
+	{
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < numChunks; i++)
+			workers.emplace_back(ParseChunk, chunkStarts[i], chunkStarts[i + 1], std::ref(chunks[i]));
+		ParseChunk(chunkStarts[0], chunkStarts[1], chunks[0]);
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	// Prefix sums of the chunk sizes give each chunk's offset into the merged arrays
+	std::vector<size_t> positionBase(numChunks + 1, 0);
+	std::vector<size_t> uvBase(numChunks + 1, 0);
+	std::vector<size_t> normalBase(numChunks + 1, 0);
+	std::vector<size_t> cornerBase(numChunks + 1, 0);
+	for (size_t i = 0; i < numChunks; i++)
+	{
+		positionBase[i + 1] = positionBase[i] + chunks[i].positions.size();
+		uvBase[i + 1] = uvBase[i] + chunks[i].uvs.size();
+		normalBase[i + 1] = normalBase[i] + chunks[i].normals.size();
+		cornerBase[i + 1] = cornerBase[i] + chunks[i].corners.size();
+	}
+
+	out.positions.resize(positionBase[numChunks]);
+	out.uvs.resize(uvBase[numChunks]);
+	out.normals.resize(normalBase[numChunks]);
+	out.corners.resize(cornerBase[numChunks]);
+
+	// Copy each chunk into place and fix up its relative indices, again in parallel
+	{
+		std::vector<std::thread> workers;
+		for (size_t i = 1; i < numChunks; i++)
+			workers.emplace_back(FixupChunk, std::cref(chunks[i]), positionBase[i], uvBase[i], normalBase[i], std::ref(out), cornerBase[i]);
+		FixupChunk(chunks[0], 0, 0, 0, out, 0);
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	return !out.corners.empty();
+}
+
+// Checks whether two parses produced exactly the same data, bit for bit
+bool ObjLoader::Identical(const ObjData& a, const ObjData& b)
+{
+	return
+		a.positions.size() == b.positions.size() &&
+		a.uvs.size() == b.uvs.size() &&
+		a.normals.size() == b.normals.size() &&
+		a.corners.size() == b.corners.size() &&
+		memcmp(a.positions.data(), b.positions.data(), sizeof(XMFLOAT3) * a.positions.size()) == 0 &&
+		memcmp(a.uvs.data(), b.uvs.data(), sizeof(XMFLOAT2) * a.uvs.size()) == 0 &&
+		memcmp(a.normals.data(), b.normals.data(), sizeof(XMFLOAT3) * a.normals.size()) == 0 &&
+		memcmp(a.corners.data(), b.corners.data(), sizeof(ObjCorner) * a.corners.size()) == 0;
+}
+
+// Copies a parsed chunk into the merged arrays at the given offsets, converting
+// its relative indices to global ones. The chunk may be the merged data itself.
+void ObjLoader::FixupChunk(const ObjData& chunk, size_t positionBase, size_t uvBase, size_t normalBase, ObjData& out, size_t cornerBase)
+{
+	if (&chunk != &out)
+	{
+		std::copy(chunk.positions.begin(), chunk.positions.end(), out.positions.begin() + positionBase);
+		std::copy(chunk.uvs.begin(), chunk.uvs.end(), out.uvs.begin() + uvBase);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), out.normals.begin() + normalBase);
+	}
+
+	for (size_t i = 0; i < chunk.corners.size(); i++)
+	{
+		const ObjCorner& corner = chunk.corners[i];
+		ObjCorner& fixed = out.corners[cornerBase + i];
+		fixed.Position = FixupIndex(corner.Position, positionBase);
+		fixed.UV = FixupIndex(corner.UV, uvBase);
+		fixed.Normal = FixupIndex(corner.Normal, normalBase);
+	}
+}
+
+// Parses the lines in [begin, end), which must start at the beginning of a line
+void ObjLoader::ParseChunk(const char* begin, const char* end, ObjData& out)
+{
+	const char* p = begin;
+	size_t size = end - begin;
+
+	// Guess capacities from the chunk size so the arrays rarely have to grow
+	// (an average .obj line is roughly 30 bytes, and faces make up about half of them)
+	size_t estimatedLines = size / 30;
+	out.positions.reserve(estimatedLines / 6);
+	out.uvs.reserve(estimatedLines / 6);
+	out.normals.reserve(estimatedLines / 6);
+	out.corners.reserve(estimatedLines / 2 * 3);
+
+	std::vector<ObjCorner> face; // Corners of the face currently being read
+
+	while (p < end)
+	{
+		p = SkipSpaces(p, end);
+		if (p + 1 >= end)
+			break;
+
+		if (p[0] == 'v' && IsSpace(p[1]))
+		{
+			// Flip Z (LH vs. RH)
+			XMFLOAT3 pos = {};
+			p = ParseFloat(SkipSpaces(p + 1, end), end, pos.x);
+			p = ParseFloat(SkipSpaces(p, end), end, pos.y);
+			p = ParseFloat(SkipSpaces(p, end), end, pos.z);
+			pos.z *= -1.0f;
+			out.positions.push_back(pos);
+		}
+		else if (p[0] == 'v' && p[1] == 't')
+		{
+			// Flip the UV's since they're probably "upside down", as DirectX
+			// defines (0,0) as the top left of the texture
+			XMFLOAT2 uv = {};
+			p = ParseFloat(SkipSpaces(p + 2, end), end, uv.x);
+			p = ParseFloat(SkipSpaces(p, end), end, uv.y);
+			uv.y = 1.0f - uv.y;
+			out.uvs.push_back(uv);
+		}
+		else if (p[0] == 'v' && p[1] == 'n')
+		{
+			// Flip the normal's Z
+			XMFLOAT3 norm = {};
+			p = ParseFloat(SkipSpaces(p + 2, end), end, norm.x);
+			p = ParseFloat(SkipSpaces(p, end), end, norm.y);
+			p = ParseFloat(SkipSpaces(p, end), end, norm.z);
+			norm.z *= -1.0f;
+			out.normals.push_back(norm);
+		}
+		else if (p[0] == 'f' && IsSpace(p[1]))
+		{
+			// Read every corner on the line
+			face.clear();
+			bool valid = true;
+			p = SkipSpaces(p + 1, end);
+			while (p < end && *p != '\n' && *p != '#')
+			{
+				ObjCorner corner;
+				p = SkipSpaces(ParseCorner(p, end, out, corner, valid), end);
+				face.push_back(corner);
+			}
+
+			// Triangulate the face as a fan, flipping the winding order
+			// since the model is most likely in a right-handed space
+			if (valid && face.size() >= 3)
+			{
+				for (size_t i = 1; i + 1 < face.size(); i++)
+				{
+					out.corners.push_back(face[0]);
+					out.corners.push_back(face[i + 1]);
+					out.corners.push_back(face[i]);
+				}
+			}
+		}
+
+		p = SkipLine(p, end);
+	}
+}
+
+void ObjLoader::BuildVertices(const ObjData& obj, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	verts.clear();
+	indices.clear();
+	indices.reserve(obj.corners.size());
+
+	// OBJs index each attribute separately, so the same (position, uv, normal)
+	// combination shows up once per face it touches. Weld those corners into a
+	// single shared vertex by looking them up in an open-addressing hash table
+	// that maps each unique combination to its vertex index.
+	size_t tableSize = 16;
+	while (tableSize < obj.corners.size() * 2) tableSize <<= 1;
+	std::vector<unsigned int> table(tableSize, OBJ_NO_INDEX);
+	std::vector<ObjCorner> uniqueCorners; // The combination each vertex was made from
+	uniqueCorners.reserve(obj.corners.size() / 2);
+	verts.reserve(obj.corners.size() / 2);
+
+	for (size_t i = 0; i + 2 < obj.corners.size(); i += 3)
+	{
+		// Skip any triangle that references a position that doesn't exist
+		const ObjCorner* tri = &obj.corners[i];
+		if (tri[0].Position >= obj.positions.size() ||
+			tri[1].Position >= obj.positions.size() ||
+			tri[2].Position >= obj.positions.size())
+			continue;
+
+		for (int c = 0; c < 3; c++)
+		{
+			// Corners without a valid uv or normal get zeroes instead,
+			// so treat all of those as the same "missing" index
+			ObjCorner key = tri[c];
+			if (key.UV >= obj.uvs.size()) key.UV = OBJ_NO_INDEX;
+			if (key.Normal >= obj.normals.size()) key.Normal = OBJ_NO_INDEX;
+
+			// Linear probe until we find this combination or an empty slot
+			size_t slot = HashCorner(key) & (tableSize - 1);
+			while (table[slot] != OBJ_NO_INDEX)
+			{
+				const ObjCorner& existing = uniqueCorners[table[slot]];
+				if (existing.Position == key.Position && existing.UV == key.UV && existing.Normal == key.Normal)
+					break;
+				slot = (slot + 1) & (tableSize - 1);
+			}
+
+			// First time seeing this combination, so make a new vertex for it
+			if (table[slot] == OBJ_NO_INDEX)
+			{
+				Vertex v = {};
+				v.Position = obj.positions[key.Position];
+				if (key.UV != OBJ_NO_INDEX) v.UV = obj.uvs[key.UV];
+				if (key.Normal != OBJ_NO_INDEX) v.Normal = obj.normals[key.Normal];
+
+				table[slot] = (unsigned int)verts.size();
+				uniqueCorners.push_back(key);
+				verts.push_back(v);
+			}
+
+			indices.push_back(table[slot]);
+		}
+	}
+}
+
+// Mixes the three indices of a corner into a well distributed hash
+size_t ObjLoader::HashCorner(const ObjCorner& corner)
+{
+	unsigned long long h = corner.Position * 0x9E3779B97F4A7C15ull;
+	h ^= (corner.UV + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+	h ^= (corner.Normal + 0x85EBCA77C2B2AE63ull) * 0x165667B19E3779F9ull;
+	h ^= h >> 29;
+	return (size_t)h;
+}
+
+// Parses a decimal floating point number such as "-1.25e-3"
+const char* ObjLoader::ParseFloat(const char* p, const char* end, float& out)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	// Gather up to 19 significant digits into an integer,
+	// tracking where the decimal point belongs
+	unsigned long long mantissa = 0;
+	int significantDigits = 0;
+	int exponent = 0;
+	while (p < end && IsDigit(*p))
+	{
+		if (significantDigits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0) significantDigits++;
+		}
+		else exponent++;
+		p++;
+	}
+	if (p < end && *p == '.')
+	{
+		p++;
+		while (p < end && IsDigit(*p))
+		{
+			if (significantDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) significantDigits++;
+				exponent--;
+			}
+			p++;
+		}
+	}
+
+	// Optional exponent
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negativeExponent = *p == '-';
+			p++;
+		}
+		int e = 0;
+		while (p < end && IsDigit(*p))
+		{
+			if (e < 1000) e = e * 10 + (*p - '0');
+			p++;
+		}
+		exponent += negativeExponent ? -e : e;
+	}
+
+	// Scale the mantissa by the exponent, 10^22 at a time if needed
+	double value = (double)mantissa;
+	if (mantissa != 0)
+	{
+		while (exponent > 22) { value *= PowersOf10[22]; exponent -= 22; }
+		while (exponent < -22) { value /= PowersOf10[22]; exponent += 22; }
+		value = exponent >= 0 ? value * PowersOf10[exponent] : value / PowersOf10[-exponent];
+	}
+
+	out = (float)(negative ? -value : value);
+	return p;
+}
+
+const char* ObjLoader::ParseInt(const char* p, const char* end, int& out)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	int value = 0;
+	while (p < end && IsDigit(*p))
+	{
+		value = value * 10 + (*p - '0');
+		p++;
+	}
+
+	out = negative ? -value : value;
+	return p;
+}
+
+// Parses one face corner, which can be any of "v", "v/vt", "v//vn" or "v/vt/vn"
+const char* ObjLoader::ParseCorner(const char* p, const char* end, const ObjData& obj, ObjCorner& out, bool& valid)
+{
+	out.Position = OBJ_NO_INDEX;
+	out.UV = OBJ_NO_INDEX;
+	out.Normal = OBJ_NO_INDEX;
+
+	const char* start = p;
+	int index = 0;
+	p = ParseInt(p, end, index);
+	if (p == start)
+	{
+		// Not a number, so throw the face away and skip past this token
+		valid = false;
+		while (p < end && !IsSpace(*p) && *p != '\n') p++;
+		return p;
+	}
+	out.Position = ResolveIndex(index, obj.positions.size());
+	if (out.Position == OBJ_NO_INDEX)
+		valid = false;
+
+	if (p < end && *p == '/')
+	{
+		p++;
+		if (p < end && *p != '/')
+		{
+			start = p;
+			p = ParseInt(p, end, index);
+			if (p != start) out.UV = ResolveIndex(index, obj.uvs.size());
+		}
+		if (p < end && *p == '/')
+		{
+			p++;
+			start = p;
+			p = ParseInt(p, end, index);
+			if (p != start) out.Normal = ResolveIndex(index, obj.normals.size());
+		}
+	}
+
+	// Skip anything unexpected that's left in the token
+	while (p < end && !IsSpace(*p) && *p != '\n') p++;
+	return p;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// Marks a face corner that has no uv or normal index
+#define OBJ_NO_INDEX 0xFFFFFFFF
+
+// Tags an index that is still relative to the start of the chunk it was
+// parsed in (see ObjLoader::Parse), and the bias applied to those indices
+#define OBJ_RELATIVE_INDEX 0x80000000u
+#define OBJ_RELATIVE_BIAS 0x40000000ll
+
+// Files at least this big are parsed on multiple threads
+#define OBJ_PARALLEL_THRESHOLD (8 * 1024 * 1024)
+
+// One corner of a face: 0-based indices into an ObjData's attribute arrays
+struct ObjCorner
+{
+	unsigned int Position;
+	unsigned int UV;
+	unsigned int Normal;
+};
+
+// The raw contents of an .obj file, already converted to a left-handed space
+struct ObjData
+{
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT2> uvs;
+	std::vector<DirectX::XMFLOAT3> normals;
+	std::vector<ObjCorner> corners; // 3 per triangle, in DirectX winding order
+};
+
+// --------------------------------------------------------
+// Fast .OBJ model parsing, supporting positions, uvs and normals
+//
+// - Works directly on the file's bytes (see MappedFile) instead
+//   of reading it line by line, so no line length limit applies
+// - Numbers are parsed by hand, so results don't depend on the
+//   current C locale and there's no sscanf overhead
+// - Faces with any number of corners are triangulated as fans
+// --------------------------------------------------------
+class ObjLoader
+{
+public:
+
+	// Parses the given .obj text. Returns false if no faces were found.
+	// With more than one thread, the text is split into newline aligned chunks
+	// that are parsed in parallel and merged, giving the exact same result.
+	static bool Parse(const char* data, size_t size, ObjData& out, unsigned int threadCount = 1);
+
+	// Checks whether two parses produced exactly the same data, bit for bit
+	static bool Identical(const ObjData& a, const ObjData& b);
+
+	// Creates a vertex for every unique (position, uv, normal) combination,
+	// along with an index list that shares them between triangles
+	static void BuildVertices(const ObjData& obj, std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+
+private:
+
+	static void ParseChunk(const char* begin, const char* end, ObjData& out);
+	static void FixupChunk(const ObjData& chunk, size_t positionBase, size_t uvBase, size_t normalBase, ObjData& out, size_t cornerBase);
+	static const char* ParseFloat(const char* p, const char* end, float& out);
+	static const char* ParseInt(const char* p, const char* end, int& out);
+	static const char* ParseCorner(const char* p, const char* end, const ObjData& obj, ObjCorner& out, bool& valid);
+	static size_t HashCorner(const ObjCorner& corner);
+};
@@ -51,7 +51,7 @@ float4 main(VertexToPixel input) : SV_TARGET
         float3 N = normalize(input.normal);  // Normal
         float3 T = normalize(input.tangent); // Tangent
         T = normalize(T - N * dot(T, N));    // Gram-Schmidt orthonomalizing of the Tangent
-        float3 B = cross(T, N);              // Bi-tangent
+        float3 B = cross(T, N) * input.handedness; // Bi-tangent
         float3x3 TBN = float3x3(T, B, N);    // TBN rotation matrix
 
         // multiply normal map vector by the TBN matrix
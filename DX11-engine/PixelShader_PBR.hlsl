@@ -73,7 +73,7 @@ float4 main(VertexToPixel input) : SV_TARGET
         float3 N = normalize(input.normal); // Normal
         float3 T = normalize(input.tangent); // Tangent
         T = normalize(T - N * dot(T, N)); // Gram-Schmidt orthonomalizing of the Tangent
-        float3 B = cross(T, N); // Bi-tangent
+        float3 B = cross(T, N) * input.handedness; // Bi-tangent
         float3x3 TBN = float3x3(T, B, N); // TBN rotation matrix
 
         // multiply normal map vector by the TBN matrix
@@ -83,8 +83,9 @@ float4 main(VertexToPixel input) : SV_TARGET
     // Sample the surface texture for the initial pixel color (scale texture if a scale was specified)
     // If using texture for surface, un-correct the color w/ gamma value
     float3 albedoColor = ((textureBitMask & BIT_ALBEDO) == BIT_ALBEDO ? pow(AlbedoMap.Sample(SamplerOptions, input.uv * textureScale).rgb, 2.2f) : 1) * colorTint.xyz;
-    float metal = (textureBitMask & BIT_METALNESS) == BIT_METALNESS ? MetalnessMap.Sample(SamplerOptions, input.uv * textureScale).r : metalness;
-    float rough = (textureBitMask & BIT_ROUGHNESS) == BIT_ROUGHNESS ? RoughnessMap.Sample(SamplerOptions, input.uv * textureScale).r : roughness;
+    bool packed = (textureBitMask & BIT_PACKED_METAL_ROUGHNESS) == BIT_PACKED_METAL_ROUGHNESS;
+    float metal = (textureBitMask & BIT_METALNESS) == BIT_METALNESS ? MetalnessMap.Sample(SamplerOptions, input.uv * textureScale)[packed ? 2 : 0] : metalness;
+    float rough = (textureBitMask & BIT_ROUGHNESS) == BIT_ROUGHNESS ? RoughnessMap.Sample(SamplerOptions, input.uv * textureScale)[packed ? 1 : 0] : roughness;
     
     // Specular color determination -----------------
     // Assume albedo texture is actually holding specular color where metalness == 1
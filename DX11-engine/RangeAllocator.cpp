@@ -0,0 +1,209 @@
+#include "RangeAllocator.h"
+
+RangeAllocator::RangeAllocator(unsigned int capacity)
+{
+	this->capacity = capacity;
+	this->used = 0;
+	if (capacity > 0)
+		AddFreeRange(0, capacity);
+}
+
+unsigned int RangeAllocator::Allocate(unsigned int size)
+{
+	if (size == 0)
+		return RANGE_ALLOCATOR_INVALID;
+
+	// Smallest free range that fits
+	auto best = freeBySize.lower_bound(std::make_pair(size, 0u));
+	if (best == freeBySize.end())
+		return RANGE_ALLOCATOR_INVALID;
+
+	unsigned int offset = best->second;
+	unsigned int rangeSize = best->first;
+	RemoveFreeRange(offset, rangeSize);
+
+	// Whatever's left over stays free
+	if (rangeSize > size)
+		AddFreeRange(offset + size, rangeSize - size);
+
+	allocations[offset] = size;
+	used += size;
+	return offset;
+}
+
+void RangeAllocator::Free(unsigned int offset)
+{
+	auto allocation = allocations.find(offset);
+	if (allocation == allocations.end())
+		return;
+
+	unsigned int size = allocation->second;
+	allocations.erase(allocation);
+	used -= size;
+
+	// Merge with the free ranges on either side
+	auto next = freeByOffset.lower_bound(offset);
+	if (next != freeByOffset.end() && next->first == offset + size)
+	{
+		unsigned int nextSize = next->second;
+		RemoveFreeRange(next->first, nextSize);
+		size += nextSize;
+	}
+
+	auto previous = freeByOffset.lower_bound(offset);
+	if (previous != freeByOffset.begin())
+	{
+		--previous;
+		if (previous->first + previous->second == offset)
+		{
+			unsigned int previousOffset = previous->first;
+			unsigned int previousSize = previous->second;
+			RemoveFreeRange(previousOffset, previousSize);
+			offset = previousOffset;
+			size += previousSize;
+		}
+	}
+
+	AddFreeRange(offset, size);
+}
+
+void RangeAllocator::Grow(unsigned int newCapacity)
+{
+	if (newCapacity <= capacity)
+		return;
+
+	// Extend the free range at the end, if there is one
+	unsigned int offset = capacity;
+	unsigned int size = newCapacity - capacity;
+	if (!freeByOffset.empty())
+	{
+		auto last = --freeByOffset.end();
+		if (last->first + last->second == capacity)
+		{
+			offset = last->first;
+			size += last->second;
+			RemoveFreeRange(last->first, last->second);
+		}
+	}
+
+	AddFreeRange(offset, size);
+	capacity = newCapacity;
+}
+
+void RangeAllocator::Defragment(std::vector<RangeMove>& moves)
+{
+	moves.clear();
+
+	std::map<unsigned int, unsigned int> packed;
+	unsigned int offset = 0;
+	for (auto& allocation : allocations)
+	{
+		if (allocation.first != offset)
+		{
+			RangeMove move = { allocation.first, offset, allocation.second };
+			moves.push_back(move);
+		}
+		packed[offset] = allocation.second;
+		offset += allocation.second;
+	}
+
+	allocations.swap(packed);
+	freeByOffset.clear();
+	freeBySize.clear();
+	if (offset < capacity)
+		AddFreeRange(offset, capacity - offset);
+}
+
+unsigned int RangeAllocator::GetCapacity()
+{
+	return capacity;
+}
+
+unsigned int RangeAllocator::GetUsed()
+{
+	return used;
+}
+
+unsigned int RangeAllocator::GetAllocationCount()
+{
+	return (unsigned int)allocations.size();
+}
+
+unsigned int RangeAllocator::GetFreeRangeCount()
+{
+	return (unsigned int)freeByOffset.size();
+}
+
+unsigned int RangeAllocator::GetLargestFreeRange()
+{
+	return freeBySize.empty() ? 0 : freeBySize.rbegin()->first;
+}
+
+unsigned int RangeAllocator::GetSize(unsigned int offset)
+{
+	auto allocation = allocations.find(offset);
+	return allocation == allocations.end() ? 0 : allocation->second;
+}
+
+float RangeAllocator::GetFragmentation()
+{
+	unsigned int free = capacity - used;
+	return free == 0 ? 0.0f : 1.0f - (float)GetLargestFreeRange() / free;
+}
+
+bool RangeAllocator::Validate()
+{
+	if (freeByOffset.size() != freeBySize.size())
+		return false;
+
+	// Walk both maps in offset order, making sure they tile the capacity with
+	// no gaps or overlaps, and that no two free ranges are left touching
+	auto allocation = allocations.begin();
+	auto range = freeByOffset.begin();
+	unsigned int offset = 0;
+	unsigned int totalUsed = 0;
+	bool lastWasFree = false;
+	while (allocation != allocations.end() || range != freeByOffset.end())
+	{
+		if (allocation != allocations.end() && allocation->first == offset)
+		{
+			if (allocation->second == 0)
+				return false;
+			offset += allocation->second;
+			totalUsed += allocation->second;
+			lastWasFree = false;
+			++allocation;
+		}
+		else if (range != freeByOffset.end() && range->first == offset)
+		{
+			if (range->second == 0 || lastWasFree)
+				return false;
+
+			// The size index has to agree
+			if (freeBySize.count(std::make_pair(range->second, range->first)) == 0)
+				return false;
+
+			offset += range->second;
+			lastWasFree = true;
+			++range;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return offset == capacity && totalUsed == used;
+}
+
+void RangeAllocator::AddFreeRange(unsigned int offset, unsigned int size)
+{
+	freeByOffset[offset] = size;
+	freeBySize.insert(std::make_pair(size, offset));
+}
+
+void RangeAllocator::RemoveFreeRange(unsigned int offset, unsigned int size)
+{
+	freeByOffset.erase(offset);
+	freeBySize.erase(std::make_pair(size, offset));
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <vector>
+
+// Returned by RangeAllocator::Allocate() when nothing fits
+#define RANGE_ALLOCATOR_INVALID 0xFFFFFFFF
+
+// An allocation that Defragment() moved, so whatever it holds needs moving too
+struct RangeMove
+{
+	unsigned int From;
+	unsigned int To;
+	unsigned int Size;
+};
+
+// --------------------------------------------------------
+// Hands out ranges of some larger space (like the elements
+// of a GPU buffer) without touching the space itself, so it
+// works the same with or without a device
+//
+// - Free ranges are kept both by offset, to merge with their
+//   neighbours when freed, and by size, so allocating takes
+//   the smallest range that fits (best fit), which leaves
+//   the big ranges for big requests
+// - Everything is O(log n) in the number of free ranges
+// - Defragment() slides every allocation down to the start,
+//   leaving one free range at the end
+// --------------------------------------------------------
+class RangeAllocator
+{
+public:
+
+	RangeAllocator(unsigned int capacity = 0);
+
+	// Returns the offset of a new range of the given size, or RANGE_ALLOCATOR_INVALID
+	unsigned int Allocate(unsigned int size);
+
+	// Takes an offset returned by Allocate()
+	void Free(unsigned int offset);
+
+	// Adds space to the end (capacity can't shrink)
+	void Grow(unsigned int newCapacity);
+
+	// Packs every allocation together at the start, in the order they are now. Moves are listed
+	// in increasing offset order and only ever go down, so they can be applied one after another
+	// (although a move's source and destination can overlap).
+	void Defragment(std::vector<RangeMove>& moves);
+
+	unsigned int GetCapacity();
+	unsigned int GetUsed();
+	unsigned int GetAllocationCount();
+	unsigned int GetFreeRangeCount();
+	unsigned int GetLargestFreeRange();
+	unsigned int GetSize(unsigned int offset);
+
+	// 0 when all the free space is in one range, approaching 1 as it's split into many small ones
+	float GetFragmentation();
+
+	// Checks that the allocations and free ranges exactly tile the capacity, for debugging
+	bool Validate();
+
+private:
+
+	unsigned int capacity;
+	unsigned int used;
+
+	std::map<unsigned int, unsigned int> allocations;		// Offset -> size
+	std::map<unsigned int, unsigned int> freeByOffset;		// Offset -> size
+	std::set<std::pair<unsigned int, unsigned int>> freeBySize;	// (Size, offset)
+
+	void AddFreeRange(unsigned int offset, unsigned int size);
+	void RemoveFreeRange(unsigned int offset, unsigned int size);
+};
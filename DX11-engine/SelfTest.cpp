@@ -0,0 +1,1175 @@
+#include "SelfTest.h"
+#include "TransformHierarchy.h"
+#include "TransformSystem.h"
+#include "EcsWorld.h"
+#include "EntityManager.h"
+#include "JobSystem.h"
+#include "SystemScheduler.h"
+#include "UpdateScheduler.h"
+#include "FramePipeline.h"
+#include "RangeAllocator.h"
+#include "MappedFile.h"
+#include "ObjLoader.h"
+#include "GltfLoader.h"
+#include "BoundsCalculator.h"
+#include "VertexCompression.h"
+#include "TangentGenerator.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshletBuilder.h"
+#include "MeshletCuller.h"
+#include "MeshSimplifier.h"
+#include "Helpers.h"
+#include <Windows.h>
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Models the mesh tests run on, from the ones the game loads
+static const wchar_t* testModels[] = { L"sphere", L"torus", L"cylinder", L"helix" };
+
+// The game only has a console in debug builds, and this needs one in any
+static void OpenConsole()
+{
+	AllocConsole();
+	FILE* stream;
+	freopen_s(&stream, "CONIN$", "r", stdin);
+	freopen_s(&stream, "CONOUT$", "w", stdout);
+	freopen_s(&stream, "CONOUT$", "w", stderr);
+}
+
+static bool TestTransforms()
+{
+	// World matrix propagation against the recursive way, on something much bigger than the scene
+	TransformHierarchyBenchmark hierarchyBenchmark = TransformHierarchy::Benchmark(100000);
+	printf("Transform hierarchy: %u nodes, %u deep, full update %.2f ms, %u dirty nodes %.3f ms, recursive %.2f ms, max error %g\n",
+		hierarchyBenchmark.Nodes, hierarchyBenchmark.Depth, hierarchyBenchmark.FullUpdateMs, hierarchyBenchmark.PartialRecomputed,
+		hierarchyBenchmark.PartialUpdateMs, hierarchyBenchmark.RecursiveMs, hierarchyBenchmark.MaxError);
+
+	// Batched matrix composition from structure-of-arrays, against one transform at a time
+	TransformSystemBenchmark systemBenchmark = TransformSystem::Benchmark(1000000);
+	printf("Transform system: %u transforms, AVX2 %.2f ms%s, SSE %.2f ms, scalar %.2f ms, max relative error %g\n",
+		systemBenchmark.Transforms, systemBenchmark.Avx2Ms, systemBenchmark.Avx2Available ? "" : " (not supported)",
+		systemBenchmark.SseMs, systemBenchmark.ScalarMs, systemBenchmark.MaxError);
+
+	return hierarchyBenchmark.MaxError <= SELF_TEST_MATRIX_TOLERANCE && systemBenchmark.MaxError <= SELF_TEST_MATRIX_TOLERANCE;
+}
+
+static bool TestEntities()
+{
+	bool passed = true;
+
+	// Archetype component storage against the per-entity map GameEntity used to keep
+	for (unsigned int entities : { 10000u, 100000u, 1000000u })
+	{
+		EcsBenchmark ecsBenchmark = EcsWorld::Benchmark(entities);
+		printf("ECS: %u entities, Rigidbody %.2f ms (map %.2f ms), Rigidbody + position %.2f ms (map %.2f ms)%s\n",
+			ecsBenchmark.Entities, ecsBenchmark.EcsMs, ecsBenchmark.MapMs, ecsBenchmark.EcsPairMs, ecsBenchmark.MapPairMs,
+			ecsBenchmark.Matches ? "" : ", RESULTS DIFFER");
+		passed &= ecsBenchmark.Matches;
+	}
+
+	// Pooled spawning and deferred destruction against new and delete, in bursts like debris
+	EntityManagerBenchmark entityBenchmark = EntityManager::Benchmark(10000, 10);
+	printf("Entity manager: %u entities x %u rounds, spawn %.1f ns (new %.1f ns), destroy %.1f ns (delete %.1f ns), %u slabs after warm up%s\n",
+		entityBenchmark.Entities, entityBenchmark.Rounds, entityBenchmark.SpawnNs, entityBenchmark.NewNs, entityBenchmark.DestroyNs,
+		entityBenchmark.DeleteNs, entityBenchmark.SteadyStateSlabs, entityBenchmark.StaleHandlesRejected ? "" : ", STALE HANDLE MATCHED");
+	passed &= entityBenchmark.StaleHandlesRejected;
+
+	// Skipping disabled, sleeping and distant entities in a crowd, against updating every one of them
+	UpdateSchedulerBenchmark updateBenchmark = UpdateScheduler::Benchmark(10000, 240);
+	printf("Update scheduler: %u entities, every frame %.3f ms, scheduled %.3f ms (%.0f updated, %.0f skipped a frame)%s%s\n",
+		updateBenchmark.Entities, updateBenchmark.EveryFrameMs, updateBenchmark.ScheduledMs, updateBenchmark.UpdatesPerFrame,
+		updateBenchmark.SkippedPerFrame, updateBenchmark.Matches ? "" : ", RATES WRONG", updateBenchmark.TimersOnTime ? "" : ", TIMERS LATE");
+	passed &= updateBenchmark.Matches && updateBenchmark.TimersOnTime;
+
+	return passed;
+}
+
+static bool TestThreads()
+{
+	bool passed = true;
+	unsigned int maxThreads = (std::max)(1u, std::thread::hardware_concurrency());
+
+	// Work stealing correctness, then how it scales up to one thread per core
+	bool jobsPassed = JobSystem::SelfTest();
+	printf("Job system self test %s\n", jobsPassed ? "passed" : "FAILED");
+	passed &= jobsPassed;
+	for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		JobSystemBenchmark jobBenchmark = JobSystem::Benchmark(threads);
+		printf("Job system: %u thread(s), spawn %.1f ns (%.1f ns from jobs), parallel for %.2f ms (serial %.2f ms, %.2fx)%s\n",
+			jobBenchmark.Threads, jobBenchmark.SpawnNs, jobBenchmark.NestedSpawnNs, jobBenchmark.ParallelForMs, jobBenchmark.SerialMs,
+			jobBenchmark.SerialMs / jobBenchmark.ParallelForMs, jobBenchmark.Matches ? "" : ", RESULTS DIFFER");
+		passed &= jobBenchmark.Matches;
+	}
+
+	// Virtual updates against systems, with the same 100k CoolObject-style entities at each thread count
+	for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		SystemSchedulerBenchmark systemsBenchmark = SystemScheduler::Benchmark(100000, threads);
+		printf("Systems: %u entities, %u thread(s), virtual %.2f ms, scheduled %.2f ms (%.2fx), %u conflicts%s\n",
+			systemsBenchmark.Entities, systemsBenchmark.Threads, systemsBenchmark.VirtualMs, systemsBenchmark.ScheduledMs,
+			systemsBenchmark.VirtualMs / systemsBenchmark.ScheduledMs, systemsBenchmark.Conflicts, systemsBenchmark.Matches ? "" : ", RESULTS DIFFER");
+		passed &= systemsBenchmark.Matches && systemsBenchmark.Conflicts == 0;
+	}
+
+	// Simulating and drawing one after another, against side by side, with as much work on each
+	FramePipelineBenchmark pipelineBenchmark = FramePipeline::Benchmark(4.0, 4.0, 60);
+	printf("Frame pipeline: %.1f ms simulation + %.1f ms render, serial %.2f ms a frame (worst latency %.2f ms), pipelined %.2f ms (%.2f ms)%s\n",
+		pipelineBenchmark.SimulationMs, pipelineBenchmark.RenderMs, pipelineBenchmark.SerialFrameMs, pipelineBenchmark.SerialMaxLatencyMs,
+		pipelineBenchmark.PipelinedFrameMs, pipelineBenchmark.PipelinedMaxLatencyMs, pipelineBenchmark.InOrder ? "" : ", FRAMES OUT OF ORDER");
+	passed &= pipelineBenchmark.InOrder;
+
+	return passed;
+}
+
+// Reads a model's .obj text, returning false if it isn't there
+static bool ReadModel(const wchar_t* name, std::string& text)
+{
+	MappedFile file(FixPath(std::wstring(L"../../Assets/Models/") + name + L".obj").c_str());
+	if (!file.IsOpen())
+	{
+		printf("Couldn't open %ls.obj\n", name);
+		return false;
+	}
+	text.assign(file.GetData(), file.GetSize());
+	return true;
+}
+
+// Random allocations, frees, growths and defragments, with a copy of the space where each allocation
+// writes its own id, so any overlap or bad move shows up as the wrong id. Doesn't need a device.
+static bool TestRangeAllocator()
+{
+	const int operations = 20000;
+	RangeAllocator allocator(256);
+	std::vector<int> space(allocator.GetCapacity(), -1);
+	std::map<unsigned int, std::pair<int, unsigned int>> live;	// Offset -> (id, size)
+	std::mt19937 random(17);
+	int nextId = 0;
+	int defragments = 0;
+	bool passed = true;
+
+	for (int i = 0; i < operations && passed; i++)
+	{
+		unsigned int operation = random() % 100;
+		if (operation < 50)
+		{
+			// Mostly small, sometimes big enough to need a growth
+			unsigned int size = 1 + random() % (random() % 8 == 0 ? 256 : 16);
+			unsigned int offset = allocator.Allocate(size);
+			if (offset == RANGE_ALLOCATOR_INVALID)
+			{
+				// Only allowed to fail when nothing fits
+				passed &= allocator.GetLargestFreeRange() < size;
+				allocator.Grow(allocator.GetCapacity() + size);
+				space.resize(allocator.GetCapacity(), -1);
+			}
+			else
+			{
+				passed &= offset + size <= space.size();
+				for (unsigned int j = offset; j < offset + size && passed; j++)
+				{
+					passed &= space[j] == -1;
+					space[j] = nextId;
+				}
+				live[offset] = std::make_pair(nextId++, size);
+			}
+		}
+		else if (operation < 90 && !live.empty())
+		{
+			auto allocation = live.begin();
+			std::advance(allocation, random() % live.size());
+			for (unsigned int j = allocation->first; j < allocation->first + allocation->second.second; j++)
+			{
+				passed &= space[j] == allocation->second.first;
+				space[j] = -1;
+			}
+			allocator.Free(allocation->first);
+			live.erase(allocation);
+		}
+		else if (operation < 98)
+		{
+			allocator.Grow(allocator.GetCapacity() + random() % 64);
+			space.resize(allocator.GetCapacity(), -1);
+		}
+		else
+		{
+			// Moves go down in offset order, so copying forwards is safe even when they overlap
+			std::vector<RangeMove> moves;
+			allocator.Defragment(moves);
+			for (const RangeMove& move : moves)
+			{
+				for (unsigned int j = 0; j < move.Size; j++)
+					space[move.To + j] = space[move.From + j];
+			}
+
+			std::map<unsigned int, std::pair<int, unsigned int>> packed;
+			unsigned int offset = 0;
+			for (auto& allocation : live)
+			{
+				packed[offset] = allocation.second;
+				offset += allocation.second.second;
+			}
+			live.swap(packed);
+			std::fill(space.begin() + offset, space.end(), -1);
+			passed &= allocator.GetFreeRangeCount() <= 1;
+			defragments++;
+		}
+
+		// Everything the allocator thinks it has out, the copy agrees with
+		unsigned int used = 0;
+		for (auto& allocation : live)
+		{
+			passed &= allocator.GetSize(allocation.first) == allocation.second.second;
+			passed &= space[allocation.first] == allocation.second.first && space[allocation.first + allocation.second.second - 1] == allocation.second.first;
+			used += allocation.second.second;
+		}
+		passed &= allocator.Validate() && allocator.GetUsed() == used && allocator.GetAllocationCount() == live.size();
+	}
+
+	printf("Range allocator: %d random operations, %d defragments, capacity %u, %u allocations left in %u free range(s)%s\n",
+		operations, defragments, allocator.GetCapacity(), allocator.GetAllocationCount(), allocator.GetFreeRangeCount(),
+		passed ? "" : ", MISMATCH");
+	return passed;
+}
+
+static double MsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// The parallel .obj parse has to come out exactly the same as the serial one at any thread count
+static bool TestObjParsing()
+{
+	bool passed = true;
+	unsigned int maxThreads = (std::max)(1u, std::thread::hardware_concurrency());
+
+	// The real models, and one big enough to be split up when it's loaded (repeating the
+	// same lines keeps it valid, since every face still points at the first copy's vertices)
+	std::vector<std::wstring> names(std::begin(testModels), std::end(testModels));
+	std::vector<std::string> texts(names.size());
+	for (size_t i = 0; i < names.size(); i++)
+		passed &= ReadModel(names[i].c_str(), texts[i]);
+	std::string big;
+	while (!texts.back().empty() && big.size() < OBJ_PARALLEL_THRESHOLD)
+		big += texts.back();
+	names.push_back(names.back() + L" (repeated)");
+	texts.push_back(big);
+
+	for (size_t i = 0; i < names.size(); i++)
+	{
+		if (texts[i].empty())
+			continue;
+
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		ObjData serial;
+		ObjLoader::Parse(texts[i].data(), texts[i].size(), serial, 1);
+		printf("OBJ parse: %ls, %.1f KB, 1 thread %.3f ms", names[i].c_str(), texts[i].size() / 1024.0, MsSince(start));
+
+		for (unsigned int threads = 2; threads <= maxThreads; threads *= 2)
+		{
+			start = std::chrono::high_resolution_clock::now();
+			ObjData check;
+			ObjLoader::Parse(texts[i].data(), texts[i].size(), check, threads);
+			bool identical = ObjLoader::Identical(serial, check);
+			printf(", %u threads %.3f ms%s", threads, MsSince(start), identical ? "" : " (MISMATCH)");
+			passed &= identical;
+		}
+		printf("\n");
+	}
+	return passed;
+}
+
+// The loader Mesh used before ObjLoader, kept as the baseline for the loading benchmark below
+// - Author: Chris Cascioli
+// - Reads a line at a time into a 100 character buffer and sscanf_s()s it, so longer lines stop it
+// - Every face corner gets its own vertex, in the same order ObjLoader's corners come in
+static bool ReferenceObjLoad(const wchar_t* path, std::vector<Vertex>& verts)
+{
+	std::ifstream obj(path);
+	if (!obj.is_open())
+		return false;
+
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT3> normals;
+	std::vector<DirectX::XMFLOAT2> uvs;
+	char chars[100];
+	while (obj.good())
+	{
+		obj.getline(chars, 100);
+		if (chars[0] == 'v' && chars[1] == 'n')
+		{
+			DirectX::XMFLOAT3 norm;
+			sscanf_s(chars, "vn %f %f %f", &norm.x, &norm.y, &norm.z);
+			normals.push_back(norm);
+		}
+		else if (chars[0] == 'v' && chars[1] == 't')
+		{
+			DirectX::XMFLOAT2 uv;
+			sscanf_s(chars, "vt %f %f", &uv.x, &uv.y);
+			uvs.push_back(uv);
+		}
+		else if (chars[0] == 'v')
+		{
+			DirectX::XMFLOAT3 pos;
+			sscanf_s(chars, "v %f %f %f", &pos.x, &pos.y, &pos.z);
+			positions.push_back(pos);
+		}
+		else if (chars[0] == 'f')
+		{
+			unsigned int i[12];
+			int numbersRead = sscanf_s(chars, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
+				&i[0], &i[1], &i[2], &i[3], &i[4], &i[5], &i[6], &i[7], &i[8], &i[9], &i[10], &i[11]);
+
+			// No uvs, so every corner uses a single made up one
+			if (numbersRead == 1)
+			{
+				numbersRead = sscanf_s(chars, "f %d//%d %d//%d %d//%d %d//%d",
+					&i[0], &i[2], &i[3], &i[5], &i[6], &i[8], &i[9], &i[11]);
+				i[1] = i[4] = i[7] = i[10] = 1;
+				if (uvs.size() == 0)
+					uvs.push_back(DirectX::XMFLOAT2(0, 0));
+			}
+
+			// A triangle, and a second one for a quad (8 or 12 numbers), converted to
+			// a left-handed space: uv and z flipped, and the winding reversed
+			Vertex corners[4];
+			int cornerCount = (numbersRead == 12 || numbersRead == 8) ? 4 : 3;
+			for (int c = 0; c < cornerCount; c++)
+			{
+				corners[c] = Vertex();
+				corners[c].Position = positions[i[c * 3] - 1];
+				corners[c].UV = uvs[i[c * 3 + 1] - 1];
+				corners[c].Normal = normals[i[c * 3 + 2] - 1];
+				corners[c].UV.y = 1.0f - corners[c].UV.y;
+				corners[c].Position.z *= -1.0f;
+				corners[c].Normal.z *= -1.0f;
+			}
+			verts.push_back(corners[0]);
+			verts.push_back(corners[2]);
+			verts.push_back(corners[1]);
+			if (cornerCount == 4)
+			{
+				verts.push_back(corners[0]);
+				verts.push_back(corners[3]);
+				verts.push_back(corners[2]);
+			}
+		}
+	}
+	return !verts.empty();
+}
+
+// Everything Mesh::LoadFromObj() does before processing the geometry: mapping the file, parsing
+// it (on every core when it's big enough) and welding the corners into shared vertices
+static bool FastObjLoad(const wchar_t* path, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	MappedFile file(path);
+	if (!file.IsOpen())
+		return false;
+
+	unsigned int threadCount = file.GetSize() >= OBJ_PARALLEL_THRESHOLD ? std::thread::hardware_concurrency() : 1;
+	ObjData obj;
+	if (!ObjLoader::Parse(file.GetData(), file.GetSize(), obj, threadCount))
+		return false;
+	ObjLoader::BuildVertices(obj, verts, indices);
+	return !indices.empty();
+}
+
+static bool Near(float a, float b)
+{
+	return fabsf(a - b) <= SELF_TEST_OBJ_TOLERANCE * (std::max)(1.0f, fabsf(a));
+}
+
+// Whether both loads came out with the same triangles, corner by corner (within
+// rounding, since sscanf and ObjLoader can round the last bit differently)
+static bool SameCorners(const std::vector<Vertex>& reference, const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices)
+{
+	if (reference.size() != indices.size())
+		return false;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		const Vertex& a = reference[i];
+		const Vertex& b = verts[indices[i]];
+		if (!Near(a.Position.x, b.Position.x) || !Near(a.Position.y, b.Position.y) || !Near(a.Position.z, b.Position.z) ||
+			!Near(a.Normal.x, b.Normal.x) || !Near(a.Normal.y, b.Normal.y) || !Near(a.Normal.z, b.Normal.z) ||
+			!Near(a.UV.x, b.UV.x) || !Near(a.UV.y, b.UV.y))
+			return false;
+	}
+	return true;
+}
+
+// Loads a file both ways, reporting the throughput of each
+static bool BenchmarkObjLoad(const wchar_t* name, const std::wstring& path)
+{
+	size_t size;
+	{
+		MappedFile file(path.c_str());
+		if (!file.IsOpen())
+		{
+			printf("Couldn't open %ls\n", name);
+			return false;
+		}
+		size = file.GetSize();
+	}
+	double megabytes = size / (1024.0 * 1024.0);
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::vector<Vertex> reference;
+	bool referenceLoaded = ReferenceObjLoad(path.c_str(), reference);
+	double referenceMs = MsSince(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	bool loaded = FastObjLoad(path.c_str(), verts, indices);
+	double loadMs = MsSince(start);
+
+	bool same = referenceLoaded && loaded && SameCorners(reference, verts, indices);
+	printf("OBJ load: %ls, %.1f KB, %zu triangles, getline/sscanf %.1f MB/s, ObjLoader %.1f MB/s (%.1fx)%s\n",
+		name, size / 1024.0, indices.size() / 3, megabytes / (referenceMs / 1000.0), megabytes / (loadMs / 1000.0),
+		loadMs > 0.0 ? referenceMs / loadMs : 0.0, same ? "" : ", RESULTS DIFFER");
+	return same;
+}
+
+// A flat grid of SELF_TEST_SYNTHETIC_OBJ_SIZE squares a side, two triangles each, written as .obj text
+static bool WriteSyntheticObj(const std::wstring& path)
+{
+	std::ofstream obj(path, std::ios::binary);
+	if (!obj.is_open())
+		return false;
+
+	const unsigned int size = SELF_TEST_SYNTHETIC_OBJ_SIZE;
+	const unsigned int side = size + 1;
+	std::string text;
+	char line[128];
+	for (unsigned int y = 0; y < side; y++)
+	{
+		for (unsigned int x = 0; x < side; x++)
+		{
+			text.append(line, snprintf(line, sizeof(line), "v %.4f %.4f 0.0\n", x / (float)size - 0.5f, y / (float)size - 0.5f));
+			text.append(line, snprintf(line, sizeof(line), "vt %.5f %.5f\n", x / (float)size, y / (float)size));
+		}
+		obj.write(text.data(), text.size());
+		text.clear();
+	}
+	obj << "vn 0.0 0.0 1.0\n";
+	for (unsigned int y = 0; y < size; y++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int a = y * side + x + 1;
+			unsigned int b = a + 1;
+			unsigned int c = a + side;
+			unsigned int d = c + 1;
+			text.append(line, snprintf(line, sizeof(line), "f %u/%u/1 %u/%u/1 %u/%u/1\n", a, a, b, b, d, d));
+			text.append(line, snprintf(line, sizeof(line), "f %u/%u/1 %u/%u/1 %u/%u/1\n", a, a, d, d, c, c));
+		}
+		obj.write(text.data(), text.size());
+		text.clear();
+	}
+	return obj.good();
+}
+
+// ObjLoader against the loader it replaced, on every model and a multi-million triangle grid
+static bool TestObjLoading()
+{
+	bool passed = true;
+
+	WIN32_FIND_DATAW found;
+	std::wstring folder = FixPath(L"../../Assets/Models/");
+	HANDLE search = FindFirstFileW((folder + L"*.obj").c_str(), &found);
+	if (search == INVALID_HANDLE_VALUE)
+	{
+		printf("Couldn't find any models\n");
+		return false;
+	}
+	do
+	{
+		passed &= BenchmarkObjLoad(found.cFileName, folder + found.cFileName);
+	} while (FindNextFileW(search, &found));
+	FindClose(search);
+
+	wchar_t tempFolder[MAX_PATH];
+	std::wstring synthetic = std::wstring(tempFolder, GetTempPathW(MAX_PATH, tempFolder)) + L"selftest_grid.obj";
+	if (!WriteSyntheticObj(synthetic))
+	{
+		printf("Couldn't write %ls\n", synthetic.c_str());
+		return false;
+	}
+	passed &= BenchmarkObjLoad(L"synthetic grid", synthetic);
+	DeleteFileW(synthetic.c_str());
+	return passed;
+}
+
+// A model's vertices and indices, welded the way Mesh::LoadFromObj() does it
+static bool LoadModel(const wchar_t* name, std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	std::string text;
+	ObjData obj;
+	if (!ReadModel(name, text) || !ObjLoader::Parse(text.data(), text.size(), obj))
+		return false;
+
+	ObjLoader::BuildVertices(obj, verts, indices);
+	return !indices.empty();
+}
+
+// A cube's 36 corners share 8 positions, but each face has its own normal and uvs, so welding
+// should leave exactly 24 vertices (4 per face) and nothing shared across faces. Written out
+// here, as the cube in Assets/Models is two cubes on top of each other.
+static bool TestWelding()
+{
+	std::string text =
+		"v -1 -1 -1\nv 1 -1 -1\nv 1 1 -1\nv -1 1 -1\nv -1 -1 1\nv 1 -1 1\nv 1 1 1\nv -1 1 1\n"
+		"vt 0 0\nvt 1 0\nvt 1 1\nvt 0 1\n"
+		"vn 0 0 -1\nvn 0 0 1\nvn -1 0 0\nvn 1 0 0\nvn 0 -1 0\nvn 0 1 0\n"
+		"f 1/1/1 2/2/1 3/3/1 4/4/1\nf 6/1/2 5/2/2 8/3/2 7/4/2\nf 5/1/3 1/2/3 4/3/3 8/4/3\n"
+		"f 2/1/4 6/2/4 7/3/4 3/4/4\nf 5/1/5 6/2/5 2/3/5 1/4/5\nf 4/1/6 3/2/6 7/3/6 8/4/6\n";
+	ObjData obj;
+	std::vector<Vertex> verts;
+	std::vector<unsigned int> indices;
+	if (!ObjLoader::Parse(text.data(), text.size(), obj))
+		return false;
+	ObjLoader::BuildVertices(obj, verts, indices);
+
+	std::vector<std::vector<float>> positions;
+	for (const Vertex& vertex : verts)
+		positions.push_back({ vertex.Position.x, vertex.Position.y, vertex.Position.z });
+	std::sort(positions.begin(), positions.end());
+	size_t uniquePositions = std::unique(positions.begin(), positions.end()) - positions.begin();
+
+	bool passed = indices.size() == 36 && verts.size() == 24 && uniquePositions == 8;
+	printf("Welding: cube, %zu corners into %zu vertices at %zu positions (%.1f KB -> %.1f KB of vertex data)%s\n",
+		indices.size(), verts.size(), uniquePositions,
+		indices.size() * sizeof(Vertex) / 1024.0, verts.size() * sizeof(Vertex) / 1024.0, passed ? "" : ", MISMATCH");
+	return passed;
+}
+
+// Every model has to come out of the optimizer with a lower ACMR, unless every vertex was
+// already only transformed once, and the overdraw clustering can't give much of that back
+static bool TestVertexCache()
+{
+	bool passed = true;
+
+	WIN32_FIND_DATAW found;
+	HANDLE search = FindFirstFileW(FixPath(L"../../Assets/Models/*.obj").c_str(), &found);
+	if (search == INVALID_HANDLE_VALUE)
+	{
+		printf("Couldn't find any models\n");
+		return false;
+	}
+	do
+	{
+		std::wstring name(found.cFileName, wcslen(found.cFileName) - 4);
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!LoadModel(name.c_str(), verts, indices))
+		{
+			passed = false;
+			continue;
+		}
+
+		unsigned int numVerts = (unsigned int)verts.size();
+		VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(&indices[0], (unsigned int)indices.size(), numVerts);
+
+		std::vector<unsigned int> cacheOnly = indices;
+		MeshOptimizer::OptimizeVertexCache(&cacheOnly[0], (unsigned int)cacheOnly.size(), numVerts);
+		VertexCacheStats cacheOptimized = MeshOptimizer::AnalyzeVertexCache(&cacheOnly[0], (unsigned int)cacheOnly.size(), numVerts);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		MeshOptimizer::Optimize(verts, indices);
+		double optimizeMs = MsSince(start);
+		VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(&indices[0], (unsigned int)indices.size(), (unsigned int)verts.size());
+
+		bool improved = after.ACMR < before.ACMR || before.ATVR == 1.0f;
+		bool overdrawCostOk = after.ACMR <= cacheOptimized.ACMR * SELF_TEST_OVERDRAW_ACMR_COST;
+		printf("Vertex cache: %ls, %zu triangles, ACMR %.3f -> %.3f (%.3f before overdraw ordering), ATVR %.3f -> %.3f, %.2f ms%s\n",
+			name.c_str(), indices.size() / 3, before.ACMR, after.ACMR, cacheOptimized.ACMR, before.ATVR, after.ATVR, optimizeMs,
+			improved ? (overdrawCostOk ? "" : ", OVERDRAW ORDERING TOO COSTLY") : ", NOT IMPROVED");
+		passed &= improved && overdrawCostOk;
+	} while (FindNextFileW(search, &found));
+	FindClose(search);
+
+	return passed;
+}
+
+// Writes each model's processed geometry to a .meshbin and maps it back in, which has to give the
+// same geometry, and only open for the same source and processing
+static bool TestMeshCache()
+{
+	bool passed = true;
+	wchar_t tempFolder[MAX_PATH];
+	std::wstring folder(tempFolder, GetTempPathW(MAX_PATH, tempFolder));
+
+	for (const wchar_t* name : testModels)
+	{
+		std::string text;
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!ReadModel(name, text))
+		{
+			passed = false;
+			continue;
+		}
+		auto textStart = std::chrono::high_resolution_clock::now();
+		if (!LoadModel(name, verts, indices))
+		{
+			passed = false;
+			continue;
+		}
+		double textMs = MsSince(textStart);
+
+		// Everything a real cache holds
+		std::vector<Meshlet> meshlets;
+		std::vector<MeshLod> lods;
+		MeshletBuilder::Build(&verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size(), false, meshlets);
+		MeshSimplifier::BuildLods(verts, indices, lods, false);
+		DirectX::XMFLOAT3 boundsMin = verts[0].Position;
+		DirectX::XMFLOAT3 boundsMax = verts[0].Position;
+		for (const Vertex& vertex : verts)
+		{
+			boundsMin = DirectX::XMFLOAT3((std::min)(boundsMin.x, vertex.Position.x), (std::min)(boundsMin.y, vertex.Position.y), (std::min)(boundsMin.z, vertex.Position.z));
+			boundsMax = DirectX::XMFLOAT3((std::max)(boundsMax.x, vertex.Position.x), (std::max)(boundsMax.y, vertex.Position.y), (std::max)(boundsMax.z, vertex.Position.z));
+		}
+		DirectX::BoundingSphere sphere = BoundsCalculator::CalculateSphere(&verts[0], (unsigned int)verts.size());
+		DirectX::BoundingOrientedBox orientedBox = BoundsCalculator::CalculateOrientedBox(&verts[0], (unsigned int)verts.size());
+
+		unsigned long long hash = MeshCache::HashData(text.data(), text.size());
+		std::wstring path = folder + L"selftest_" + name + L".meshbin";
+		bool matches = MeshCache::Write(path.c_str(), hash, &verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size(),
+			boundsMin, boundsMax, sphere, orientedBox, &lods[0], (unsigned int)lods.size(), &meshlets[0], (unsigned int)meshlets.size(), MESH_CACHE_OPTIMIZED);
+
+		double cacheMs = 0.0;
+		{
+			MeshCache cache;
+			auto cacheStart = std::chrono::high_resolution_clock::now();
+			matches &= cache.Open(path.c_str(), hash, MESH_CACHE_OPTIMIZED);
+			cacheMs = MsSince(cacheStart);
+
+			const MeshCacheHeader* header = cache.GetHeader();
+			matches = matches &&
+				header->VertexCount == verts.size() && header->IndexCount == indices.size() &&
+				header->LodCount == lods.size() && header->MeshletCount == meshlets.size() &&
+				memcmp(cache.GetVertices(), &verts[0], verts.size() * sizeof(Vertex)) == 0 &&
+				memcmp(cache.GetIndices(), &indices[0], indices.size() * sizeof(unsigned int)) == 0 &&
+				memcmp(cache.GetMeshlets(), &meshlets[0], meshlets.size() * sizeof(Meshlet)) == 0 &&
+				memcmp(header->Lods, &lods[0], lods.size() * sizeof(MeshLod)) == 0 &&
+				memcmp(&header->Sphere, &sphere, sizeof(sphere)) == 0 &&
+				memcmp(&header->OrientedBox, &orientedBox, sizeof(orientedBox)) == 0;
+
+			// An edited source, or different processing, mustn't use it
+			MeshCache stale;
+			matches &= !stale.Open(path.c_str(), hash + 1, MESH_CACHE_OPTIMIZED) && !stale.Open(path.c_str(), hash, 0);
+		}
+		DeleteFileW(path.c_str());
+
+		printf("Mesh cache: %ls, %zu vertices, %zu indices, %zu LODs, %zu meshlets, parsing %.3f ms, mapping the cache %.3f ms (%.0fx)%s\n",
+			name, verts.size(), indices.size(), lods.size(), meshlets.size(), textMs, cacheMs, cacheMs > 0.0 ? textMs / cacheMs : 0.0,
+			matches ? "" : ", MISMATCH");
+		passed &= matches;
+	}
+	return passed;
+}
+
+// The sphere and oriented box of every model have to contain all of its vertices. How snugly
+// they fit, relative to the axis aligned box, is printed for tuning.
+static bool TestBounds()
+{
+	using namespace DirectX;
+	bool passed = true;
+
+	WIN32_FIND_DATAW found;
+	HANDLE search = FindFirstFileW(FixPath(L"../../Assets/Models/*.obj").c_str(), &found);
+	if (search == INVALID_HANDLE_VALUE)
+	{
+		printf("Couldn't find any models\n");
+		return false;
+	}
+	do
+	{
+		std::wstring name(found.cFileName, wcslen(found.cFileName) - 4);
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!LoadModel(name.c_str(), verts, indices))
+		{
+			passed = false;
+			continue;
+		}
+
+		XMFLOAT3 boundsMin = verts[0].Position;
+		XMFLOAT3 boundsMax = verts[0].Position;
+		for (const Vertex& vertex : verts)
+		{
+			boundsMin = XMFLOAT3((std::min)(boundsMin.x, vertex.Position.x), (std::min)(boundsMin.y, vertex.Position.y), (std::min)(boundsMin.z, vertex.Position.z));
+			boundsMax = XMFLOAT3((std::max)(boundsMax.x, vertex.Position.x), (std::max)(boundsMax.y, vertex.Position.y), (std::max)(boundsMax.z, vertex.Position.z));
+		}
+		BoundingSphere sphere = BoundsCalculator::CalculateSphere(&verts[0], (unsigned int)verts.size());
+		BoundingOrientedBox orientedBox = BoundsCalculator::CalculateOrientedBox(&verts[0], (unsigned int)verts.size());
+
+		// How far the worst vertex pokes out of each (negative when it's inside)
+		float sphereOutside = -FLT_MAX;
+		float boxOutside = -FLT_MAX;
+		for (const Vertex& vertex : verts)
+		{
+			XMVECTOR position = XMLoadFloat3(&vertex.Position);
+			sphereOutside = (std::max)(sphereOutside, XMVectorGetX(XMVector3Length(position - XMLoadFloat3(&sphere.Center))) - sphere.Radius);
+
+			XMFLOAT3 local;
+			XMStoreFloat3(&local, XMVector3InverseRotate(position - XMLoadFloat3(&orientedBox.Center), XMLoadFloat4(&orientedBox.Orientation)));
+			boxOutside = (std::max)(boxOutside, (std::max)((std::max)(
+				fabsf(local.x) - orientedBox.Extents.x,
+				fabsf(local.y) - orientedBox.Extents.y),
+				fabsf(local.z) - orientedBox.Extents.z));
+		}
+
+		float tolerance = sphere.Radius * SELF_TEST_BOUNDS_TOLERANCE;
+		bool contained = sphereOutside <= tolerance && boxOutside <= tolerance;
+		float boxVolume = BoundsCalculator::Volume(BoundsCalculator::CalculateBox(boundsMin, boundsMax));
+		float sphereVolume = 4.0f / 3.0f * XM_PI * sphere.Radius * sphere.Radius * sphere.Radius;
+		printf("Bounds: %ls, sphere radius %.4f (%.2fx the box's volume), oriented box %.2fx the box's volume%s\n",
+			name.c_str(), sphere.Radius, boxVolume > 0.0f ? sphereVolume / boxVolume : 0.0f,
+			boxVolume > 0.0f ? BoundsCalculator::Volume(orientedBox) / boxVolume : 1.0f,
+			contained ? "" : ", VERTICES OUTSIDE");
+		passed &= contained;
+	} while (FindNextFileW(search, &found));
+	FindClose(search);
+
+	return passed;
+}
+
+// The batched tangents against the original scalar version, at every thread count
+static bool TestTangents()
+{
+	bool passed = true;
+	unsigned int maxThreads = (std::max)(1u, std::thread::hardware_concurrency());
+
+	for (const wchar_t* name : testModels)
+	{
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!LoadModel(name, verts, indices))
+		{
+			passed = false;
+			continue;
+		}
+
+		unsigned int numVerts = (unsigned int)verts.size();
+		unsigned int numIndices = (unsigned int)indices.size();
+		std::vector<Vertex> reference = verts;
+		std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+		TangentGenerator::GenerateReference(&reference[0], numVerts, &indices[0], numIndices);
+		printf("Tangents: %ls, %u vertices, scalar %.3f ms", name, numVerts, MsSince(start));
+
+		for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+		{
+			std::vector<Vertex> check = verts;
+			start = std::chrono::high_resolution_clock::now();
+			TangentGenerator::Generate(&check[0], numVerts, &indices[0], numIndices, TANGENT_MODE_ACCUMULATE, threads);
+			double tangentMs = MsSince(start);
+			float angle = TangentGenerator::CompareTangents(&reference[0], &check[0], numVerts);
+			printf(", %u thread(s) %.3f ms (%.4f deg%s)", threads, tangentMs, angle, angle <= TANGENT_TOLERANCE_DEGREES ? "" : ", MISMATCH");
+			passed &= angle <= TANGENT_TOLERANCE_DEGREES;
+		}
+		printf("\n");
+	}
+	return passed;
+}
+
+// Two squares side by side, facing -z and sharing the edge between them, with the left one's
+// uvs mirrored across it (like a symmetric model's seam). Every corner's tangent has to point
+// along its own side's u with its own side's handedness, which needs the seam's vertices split.
+static bool TestMirroredTangents()
+{
+	std::vector<Vertex> verts;
+	for (int y = 0; y < 2; y++)
+	{
+		for (int x = -1; x <= 1; x++)
+		{
+			Vertex vertex = {};
+			vertex.Position = DirectX::XMFLOAT3((float)x, (float)y, 0.0f);
+			vertex.Normal = DirectX::XMFLOAT3(0.0f, 0.0f, -1.0f);
+			vertex.UV = DirectX::XMFLOAT2((float)abs(x), (float)(1 - y));	// v flipped, like the imported models
+			verts.push_back(vertex);
+		}
+	}
+
+	// Clockwise from the front, left square first
+	std::vector<unsigned int> indices = { 0, 3, 4, 0, 4, 1, 1, 4, 5, 1, 5, 2 };
+	unsigned int added = TangentGenerator::SplitMirroredVertices(verts, indices);
+	TangentGenerator::Generate(&verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size(), TANGENT_MODE_MIKKTSPACE);
+
+	// The right square is mapped the usual way round, so it's right handed
+	bool passed = added == 2;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		const DirectX::XMFLOAT4& tangent = verts[indices[i]].Tangent;
+		float side = i < 6 ? -1.0f : 1.0f;
+		passed &= tangent.w == side && tangent.x * side > 0.999f;
+	}
+
+	printf("Tangents: mirrored quad, %u seam vertices split, left w %.0f, right w %.0f%s\n",
+		added, verts[indices[0]].Tangent.w, verts[indices[6]].Tangent.w, passed ? "" : ", MISMATCH");
+	return passed;
+}
+
+// Writes a model out as a .glb with its attributes interleaved exactly like Vertex, back in glTF's
+// right-handed space (z and winding flipped back), so loading it should give the same vertices
+static void WriteGlb(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices, std::string& glb)
+{
+	std::vector<Vertex> flipped = verts;
+	for (Vertex& vertex : flipped)
+	{
+		vertex.Position.z *= -1.0f;
+		vertex.Normal.z *= -1.0f;
+		vertex.Tangent.z *= -1.0f;
+	}
+	std::vector<unsigned int> wound = indices;
+	for (size_t i = 0; i + 2 < wound.size(); i += 3)
+		std::swap(wound[i + 1], wound[i + 2]);
+
+	size_t vertexBytes = flipped.size() * sizeof(Vertex);
+	size_t indexBytes = wound.size() * sizeof(unsigned int);
+	char json[2048];
+	int jsonLength = snprintf(json, sizeof(json),
+		"{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":%zu}],"
+		"\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%zu,\"byteStride\":%zu},{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}],"
+		"\"accessors\":["
+		"{\"bufferView\":0,\"byteOffset\":%zu,\"componentType\":%d,\"count\":%zu,\"type\":\"VEC3\"},"
+		"{\"bufferView\":0,\"byteOffset\":%zu,\"componentType\":%d,\"count\":%zu,\"type\":\"VEC3\"},"
+		"{\"bufferView\":0,\"byteOffset\":%zu,\"componentType\":%d,\"count\":%zu,\"type\":\"VEC2\"},"
+		"{\"bufferView\":0,\"byteOffset\":%zu,\"componentType\":%d,\"count\":%zu,\"type\":\"VEC4\"},"
+		"{\"bufferView\":1,\"componentType\":%d,\"count\":%zu,\"type\":\"SCALAR\"}],"
+		"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2,\"TANGENT\":3},\"indices\":4}]}]}",
+		vertexBytes + indexBytes, vertexBytes, sizeof(Vertex), vertexBytes, indexBytes,
+		offsetof(Vertex, Position), GLTF_FLOAT, flipped.size(), offsetof(Vertex, Normal), GLTF_FLOAT, flipped.size(),
+		offsetof(Vertex, UV), GLTF_FLOAT, flipped.size(), offsetof(Vertex, Tangent), GLTF_FLOAT, flipped.size(),
+		GLTF_UNSIGNED_INT, wound.size());
+
+	// Both chunks are padded to 4 bytes, the JSON with spaces
+	std::string jsonChunk(json, jsonLength);
+	jsonChunk.append((4 - jsonChunk.size() % 4) % 4, ' ');
+	std::string binChunk((const char*)&flipped[0], vertexBytes);
+	binChunk.append((const char*)&wound[0], indexBytes);
+
+	unsigned int header[3] = { GLB_MAGIC, GLB_VERSION, (unsigned int)(12 + 8 + jsonChunk.size() + 8 + binChunk.size()) };
+	unsigned int jsonHeader[2] = { (unsigned int)jsonChunk.size(), GLB_CHUNK_JSON };
+	unsigned int binHeader[2] = { (unsigned int)binChunk.size(), GLB_CHUNK_BIN };
+	glb.assign((const char*)header, sizeof(header));
+	glb.append((const char*)jsonHeader, sizeof(jsonHeader));
+	glb += jsonChunk;
+	glb.append((const char*)binHeader, sizeof(binHeader));
+	glb += binChunk;
+}
+
+// Each model converted to a .glb, loaded back (which has to give the same vertices), then
+// timed from parsing to finished vertices against loading the .obj it came from
+static bool TestGltf()
+{
+	bool passed = true;
+	for (const wchar_t* name : testModels)
+	{
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!LoadModel(name, verts, indices))
+		{
+			passed = false;
+			continue;
+		}
+		TangentGenerator::Generate(&verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size(), TANGENT_MODE_MIKKTSPACE);
+
+		std::string glb;
+		WriteGlb(verts, indices, glb);
+		GltfData gltf;
+		std::vector<Vertex> glbVerts;
+		std::vector<unsigned int> glbIndices;
+		bool same = GltfLoader::Parse(glb.data(), glb.size(), gltf) && gltf.primitives.size() == 1 &&
+			GltfLoader::BuildVertices(gltf.primitives[0], glbVerts, glbIndices) &&
+			glbVerts.size() == verts.size() && glbIndices == indices &&
+			memcmp(&glbVerts[0], &verts[0], verts.size() * sizeof(Vertex)) == 0;
+
+		GltfObjBenchmark benchmark;
+		std::wstring objPath = FixPath(std::wstring(L"../../Assets/Models/") + name + L".obj");
+		bool benchmarked = GltfLoader::Benchmark(glb.data(), glb.size(), objPath.c_str(), benchmark);
+		printf("glTF: %ls, .glb %.3f ms (%u of %u primitive(s) copied in place, %u vertices), .obj %.3f ms (%u vertices), %.1fx faster%s\n",
+			name, benchmark.GlbMs, benchmark.GlbPrimitivesInPlace, benchmark.GlbPrimitives, benchmark.GlbVertices,
+			benchmark.ObjMs, benchmark.ObjVertices, benchmark.GlbMs > 0.0 ? benchmark.ObjMs / benchmark.GlbMs : 0.0,
+			same ? "" : ", RESULTS DIFFER");
+		passed &= same && benchmarked && benchmark.GlbPrimitivesInPlace == 1;
+	}
+	return passed;
+}
+
+// Vertices pointing every way, including straight along each axis and across the octahedron's folds,
+// with both handednesses and uvs well outside 0 to 1 (where half floats lose the most)
+static void MakeEncodingTestVertices(std::vector<Vertex>& verts)
+{
+	const int steps = 24;
+	for (int i = 0; i <= steps; i++)
+	{
+		for (int j = 0; j < steps * 2; j++)
+		{
+			float theta = DirectX::XM_PI * i / steps;
+			float phi = DirectX::XM_PI * j / steps;
+			DirectX::XMFLOAT3 direction(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+
+			Vertex vertex = {};
+			vertex.Position = DirectX::XMFLOAT3(direction.x * 3.0f, direction.y * 0.5f - 2.0f, direction.z * 7.0f);
+			vertex.Normal = direction;
+			vertex.Tangent = DirectX::XMFLOAT4(direction.z, direction.x, direction.y, (j % 2) ? -1.0f : 1.0f);
+			vertex.UV = DirectX::XMFLOAT2((j - steps) / 3.0f, (i - steps / 2) / 5.0f);
+			verts.push_back(vertex);
+		}
+	}
+}
+
+// Every vertex format, encoded and decoded, has to come back within the error
+// its format allows (see VertexCompression::CheckRoundTrip())
+static bool TestVertexCompression()
+{
+	bool passed = true;
+	std::vector<std::wstring> names(std::begin(testModels), std::end(testModels));
+	names.push_back(L"every direction");
+	const VertexFormat formats[] = { VERTEX_FORMAT_FULL, VERTEX_FORMAT_COMPACT, VERTEX_FORMAT_QUANTIZED };
+	const char* formatNames[] = { "full", "compact", "quantized" };
+
+	for (const std::wstring& name : names)
+	{
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (name == names.back())
+			MakeEncodingTestVertices(verts);
+		else if (LoadModel(name.c_str(), verts, indices))
+			TangentGenerator::Generate(&verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size(), TANGENT_MODE_MIKKTSPACE);
+		else
+		{
+			passed = false;
+			continue;
+		}
+
+		DirectX::XMFLOAT3 boundsMin = verts[0].Position;
+		DirectX::XMFLOAT3 boundsMax = verts[0].Position;
+		for (const Vertex& vertex : verts)
+		{
+			boundsMin = DirectX::XMFLOAT3((std::min)(boundsMin.x, vertex.Position.x), (std::min)(boundsMin.y, vertex.Position.y), (std::min)(boundsMin.z, vertex.Position.z));
+			boundsMax = DirectX::XMFLOAT3((std::max)(boundsMax.x, vertex.Position.x), (std::max)(boundsMax.y, vertex.Position.y), (std::max)(boundsMax.z, vertex.Position.z));
+		}
+
+		printf("Vertex compression: %ls, %zu vertices", name.c_str(), verts.size());
+		for (int f = 0; f < 3; f++)
+		{
+			VertexEncodeError error;
+			bool withinBounds = VertexCompression::CheckRoundTrip(&verts[0], (unsigned int)verts.size(), formats[f], boundsMin, boundsMax, error);
+			printf(", %s %u bytes (position %.6f, normal %.4f deg, tangent %.4f deg, uv %.6f%s)",
+				formatNames[f], VertexCompression::GetStride(formats[f]), error.Position, error.Normal, error.Tangent, error.UV,
+				withinBounds ? "" : ", ERROR BOUNDS EXCEEDED");
+			passed &= withinBounds;
+		}
+		printf("\n");
+	}
+	return passed;
+}
+
+// The levels of detail the simplifier builds for each model, where every level has to have
+// fewer triangles and a larger error than the one before. Closed models get the whole chain,
+// halving until LOD_MIN_TRIANGLES or MESH_MAX_LODS. The helix is two-sided (every edge has four
+// triangles), so all of it is locked and it never gets past the full resolution level.
+static bool TestLods()
+{
+	const wchar_t* names[] = { L"sphere", L"torus", L"cylinder", L"helix" };
+	const size_t expectedLods[] = { 5, 5, 2, 1 };
+
+	bool passed = true;
+	for (int m = 0; m < 4; m++)
+	{
+		const wchar_t* name = names[m];
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!LoadModel(name, verts, indices))
+		{
+			passed = false;
+			continue;
+		}
+
+		std::vector<MeshLod> lods;
+		auto start = std::chrono::high_resolution_clock::now();
+		MeshSimplifier::BuildLods(verts, indices, lods, true);
+		double simplifyMs = MsSince(start);
+
+		bool shrinking = true;
+		printf("LODs: %ls, %.2f ms", name, simplifyMs);
+		for (size_t i = 0; i < lods.size(); i++)
+		{
+			printf(", %u triangles (error %.5f)", lods[i].IndexCount / 3, lods[i].Error);
+			if (i > 0)
+				shrinking &= lods[i].IndexCount < lods[i - 1].IndexCount && lods[i].Error > lods[i - 1].Error;
+		}
+		printf(", %zu level(s)%s\n", lods.size(),
+			!shrinking ? ", NOT SHRINKING" : lods.size() != expectedLods[m] ? ", WRONG LEVEL COUNT" : "");
+		passed &= shrinking && lods.size() == expectedLods[m];
+	}
+	return passed;
+}
+
+// How much cluster culling saves from a few typical camera paths around each model,
+// split into meshlets the way the game's (optimized) meshes are
+// Culls from random views and checks every triangle that's facing the camera and not completely
+// outside the frustum (tested on its own, in clip space) was drawn. Some of the meshlets facing
+// completely away from the camera should have been culled too.
+static bool CheckCullingIsConservative(const std::vector<Vertex>& verts, const std::vector<unsigned int>& indices,
+	const std::vector<Meshlet>& meshlets, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax,
+	unsigned int& missed, unsigned int& backFacing, unsigned int& backFacingCulled)
+{
+	using namespace DirectX;
+	XMVECTOR center = (XMLoadFloat3(&boundsMin) + XMLoadFloat3(&boundsMax)) * 0.5f;
+	float radius = XMVectorGetX(XMVector3Length(XMLoadFloat3(&boundsMax) - XMLoadFloat3(&boundsMin))) * 0.5f;
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV4, 16.0f / 9.0f, radius * 0.01f, radius * 100.0f);
+
+	std::mt19937 random(17);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<IndexRange> ranges;
+	std::vector<char> drawn(indices.size() / 3);
+	missed = backFacing = backFacingCulled = 0;
+	for (int view = 0; view < SELF_TEST_CULLING_VIEWS; view++)
+	{
+		// Anywhere from inside the mesh to well outside it, looking roughly at it
+		XMVECTOR position = center + XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random), 0.0f)) * (radius * (2.5f + 2.0f * unit(random)));
+		XMVECTOR target = center + XMVectorSet(unit(random), unit(random), unit(random), 0.0f) * (radius * 0.5f);
+		XMMATRIX viewProj = XMMatrixLookAtLH(position, target, XMVectorSet(0, 1, 0, 0)) * proj;
+		XMFLOAT4X4 worldViewProj;
+		XMStoreFloat4x4(&worldViewProj, viewProj);
+		XMFLOAT3 cameraPos;
+		XMStoreFloat3(&cameraPos, position);
+
+		MeshletCuller::Cull(&meshlets[0], (unsigned int)meshlets.size(), worldViewProj, cameraPos, true, ranges);
+		std::fill(drawn.begin(), drawn.end(), 0);
+		for (const IndexRange& range : ranges)
+			std::fill(drawn.begin() + range.StartIndex / 3, drawn.begin() + (range.StartIndex + range.IndexCount) / 3, 1);
+
+		for (const Meshlet& meshlet : meshlets)
+		{
+			bool allBackFacing = true;
+			for (unsigned int t = meshlet.FirstIndex / 3; t < (meshlet.FirstIndex + meshlet.IndexCount) / 3; t++)
+			{
+				XMVECTOR p[3];
+				XMVECTOR clip[3];
+				for (int c = 0; c < 3; c++)
+				{
+					p[c] = XMLoadFloat3(&verts[indices[t * 3 + c]].Position);
+					clip[c] = XMVector4Transform(XMVectorSetW(p[c], 1.0f), viewProj);
+				}
+
+				// Clockwise winding, so the cross product points out of the front face
+				bool frontFacing = XMVectorGetX(XMVector3Dot(XMVector3Cross(p[1] - p[0], p[2] - p[0]), position - p[0])) > 0.0f;
+				allBackFacing &= !frontFacing;
+
+				// Outside when all three corners are past the same clip plane
+				bool outside = false;
+				for (int axis = 0; axis < 3 && !outside; axis++)
+				{
+					bool below = true, above = true;
+					for (int c = 0; c < 3; c++)
+					{
+						float value = XMVectorGetByIndex(clip[c], axis);
+						float w = XMVectorGetW(clip[c]);
+						below &= value < (axis == 2 ? 0.0f : -w);
+						above &= value > w;
+					}
+					outside = below || above;
+				}
+
+				if (frontFacing && !outside && !drawn[t])
+					missed++;
+			}
+
+			if (allBackFacing)
+			{
+				backFacing++;
+				backFacingCulled += !drawn[meshlet.FirstIndex / 3];
+			}
+		}
+	}
+	return missed == 0 && backFacingCulled > 0;
+}
+
+static bool TestMeshletCulling()
+{
+	bool passed = true;
+	for (const wchar_t* name : testModels)
+	{
+		std::vector<Vertex> verts;
+		std::vector<unsigned int> indices;
+		if (!LoadModel(name, verts, indices))
+		{
+			passed = false;
+			continue;
+		}
+
+		MeshOptimizer::Optimize(verts, indices);
+		std::vector<Meshlet> meshlets;
+		MeshletBuilder::Build(&verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size(), true, meshlets);
+
+		DirectX::XMFLOAT3 boundsMin = verts[0].Position;
+		DirectX::XMFLOAT3 boundsMax = verts[0].Position;
+		for (const Vertex& vertex : verts)
+		{
+			boundsMin = DirectX::XMFLOAT3((std::min)(boundsMin.x, vertex.Position.x), (std::min)(boundsMin.y, vertex.Position.y), (std::min)(boundsMin.z, vertex.Position.z));
+			boundsMax = DirectX::XMFLOAT3((std::max)(boundsMax.x, vertex.Position.x), (std::max)(boundsMax.y, vertex.Position.y), (std::max)(boundsMax.z, vertex.Position.z));
+		}
+
+		if (meshlets.empty())
+		{
+			printf("Meshlet culling: %ls, NO MESHLETS\n", name);
+			passed = false;
+			continue;
+		}
+
+		MeshletCullBenchmark cullBenchmark = MeshletCuller::Benchmark(&meshlets[0], (unsigned int)meshlets.size(), boundsMin, boundsMax);
+		unsigned int missed, backFacing, backFacingCulled;
+		bool conservative = CheckCullingIsConservative(verts, indices, meshlets, boundsMin, boundsMax, missed, backFacing, backFacingCulled);
+		printf("Meshlet culling: %ls, %zu meshlets, %.1f%% of triangles culled orbiting, %.1f%% skimming, %.1f%% flying through (%.4f ms per view), "
+			"%d random views: %u visible triangles culled, %u of %u back-facing meshlets culled%s\n",
+			name, meshlets.size(), 100.0f * cullBenchmark.Orbit, 100.0f * cullBenchmark.Skim, 100.0f * cullBenchmark.FlyThrough, cullBenchmark.MsPerView,
+			SELF_TEST_CULLING_VIEWS, missed, backFacingCulled, backFacing,
+			missed > 0 ? ", NOT CONSERVATIVE" : backFacingCulled == 0 ? ", NO BACK-FACE CULLING" : "");
+		passed &= conservative;
+	}
+	return passed;
+}
+
+bool SelfTest::Run()
+{
+	OpenConsole();
+
+	// Each runs everything it has even after a failure, so the whole picture's there
+	bool passed = true;
+	passed &= TestTransforms();
+	passed &= TestEntities();
+	passed &= TestThreads();
+	passed &= TestRangeAllocator();
+	passed &= TestObjParsing();
+	passed &= TestObjLoading();
+	passed &= TestWelding();
+	passed &= TestVertexCache();
+	passed &= TestBounds();
+	passed &= TestMeshCache();
+	passed &= TestTangents();
+	passed &= TestMirroredTangents();
+	passed &= TestGltf();
+	passed &= TestVertexCompression();
+	passed &= TestLods();
+	passed &= TestMeshletCulling();
+
+	printf("\nSelf test %s. Press enter to close.\n", passed ? "passed" : "FAILED");
+	getchar();
+	return passed;
+}
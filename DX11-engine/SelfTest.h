@@ -0,0 +1,38 @@
+#pragma once
+
+// Largest difference allowed in any matrix element between a batched or
+// flattened calculation and the straightforward one it replaces
+#define SELF_TEST_MATRIX_TOLERANCE 0.0001f
+
+// Largest relative difference allowed between an .obj value parsed by ObjLoader and by sscanf
+#define SELF_TEST_OBJ_TOLERANCE 0.000001f
+
+// Squares a side in the grid written out to benchmark loading a big .obj (two triangles each)
+#define SELF_TEST_SYNTHETIC_OBJ_SIZE 1000
+
+// How much the overdraw ordering can raise a model's ACMR over what the vertex cache ordering got
+#define SELF_TEST_OVERDRAW_ACMR_COST 1.1f
+
+// Random camera positions each model's meshlets are culled from, to check nothing visible is culled
+#define SELF_TEST_CULLING_VIEWS 256
+
+// How far outside its bounding sphere or oriented box a vertex can be, relative to the sphere's radius
+#define SELF_TEST_BOUNDS_TOLERANCE 0.00001f
+
+// --------------------------------------------------------
+// Every benchmark and self test in the engine, run with
+// -selftest on the command line instead of the game (see
+// Main.cpp), so none of it slows down a normal startup
+//
+// - Results go to a console window of its own, which stays
+//   open until enter is pressed
+// - Nothing here needs a window or a device, so it runs the
+//   same in any build configuration
+// --------------------------------------------------------
+class SelfTest
+{
+public:
+
+	// Returns whether every check passed
+	static bool Run();
+};
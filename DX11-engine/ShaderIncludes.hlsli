@@ -16,9 +16,38 @@ struct VertexShaderInput
     float3 localPosition :   POSITION; // XYZ position
     float3 normal :          NORMAL; // Normal
     float2 uv :              TEXCOORD; // UV coordinate
-    float3 tangent :         TANGENT; // Tangent
+    float4 tangent :         TANGENT; // Tangent, with its handedness in w
 };
 
+// Same as above, but for the compact vertex formats (VertexCompact and
+// VertexQuantized in Vertex.h). Normals and tangents are octahedral
+// encoded, so run them through OctDecode() before using them.
+struct VertexShaderInputCompact
+{
+    float4 localPosition :   POSITION; // XYZ position, relative to the mesh's bounds if quantized
+    float2 normal :          NORMAL; // Octahedral encoded normal
+    float2 uv :              TEXCOORD; // UV coordinate
+    float2 tangent :         TANGENT; // Octahedral encoded tangent, with handedness (see OctDecodeTangent)
+};
+
+// Unfolds an octahedral encoded unit vector (matches VertexCompression::OctDecode)
+float3 OctDecode(float2 e)
+{
+    float3 n = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+// Same as above, but for tangents, which also keep their handedness
+// in the sign of y (matches VertexCompression::OctDecodeTangent)
+float4 OctDecodeTangent(float2 e)
+{
+    float handedness = e.y < 0.0f ? -1.0f : 1.0f;
+    e.y = (e.y - 0.5f * handedness) / 0.49f;
+    return float4(OctDecode(e), handedness);
+}
+
 // Struct representing the data we're sending down the pipeline
 // - Should match our pixel shader's input (hence the name: Vertex to Pixel)
 // - At a minimum, we need a piece of data defined tagged as SV_POSITION
@@ -37,6 +66,7 @@ struct VertexToPixel
     float3 worldPosition :    POSITION;
     float3 tangent :          TANGENT;
     float4 shadowMapPos :     SHADOW_POSITION;
+    float handedness :        HANDEDNESS; // Flips the bitangent where UVs are mirrored
 };
 
 #define LIGHT_TYPE_DIRECTIONAL 0
@@ -61,6 +91,7 @@ struct Light
 #define BIT_ROUGHNESS 2
 #define BIT_NORMAL 4
 #define BIT_METALNESS 8
+#define BIT_PACKED_METAL_ROUGHNESS 16 // Both maps are one glTF texture, roughness in green and metalness in blue
 
 float DiffuseBRDF(float3 normal, float3 dirToLight)
 {
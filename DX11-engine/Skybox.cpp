@@ -148,6 +148,14 @@ Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Skybox::CreateCubemap(
 	CreateWICTextureFromFile(device.Get(), down, (ID3D11Resource**)textures[3].GetAddressOf(), 0);
 	CreateWICTextureFromFile(device.Get(), front, (ID3D11Resource**)textures[4].GetAddressOf(), 0);
 	CreateWICTextureFromFile(device.Get(), back, (ID3D11Resource**)textures[5].GetAddressOf(), 0);
+	return CreateCubemap(textures, device, context);
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> Skybox::CreateCubemap(
+	const Microsoft::WRL::ComPtr<ID3D11Texture2D> textures[6],
+	Microsoft::WRL::ComPtr<ID3D11Device> device,
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
 	// We'll assume all of the textures are the same color format and resolution,
 	// so get the description of the first texture
 	D3D11_TEXTURE2D_DESC faceDesc = {};
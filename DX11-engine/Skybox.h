@@ -35,6 +35,13 @@ public:
 	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> cam);
 	void Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, DirectX::XMFLOAT4X4 view, DirectX::XMFLOAT4X4 projection);
 
+	// Copies six already loaded faces (+X, -X, +Y, -Y, +Z, -Z) into a cube map,
+	// so they can be loaded separately (like in parallel, see AssetLoader)
+	static Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateCubemap(
+		const Microsoft::WRL::ComPtr<ID3D11Texture2D> faces[6],
+		Microsoft::WRL::ComPtr<ID3D11Device> device,
+		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
 private:
 
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler;
@@ -0,0 +1,306 @@
+#include "SystemScheduler.h"
+#include "Rigidbody.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+using namespace DirectX;
+
+// A chunk being written has this added to its usage, one being read has one added
+#define SYSTEM_SCHEDULER_WRITER (1u << 16)
+
+SystemScheduler::SystemScheduler(EcsWorld* world, JobSystem* jobs)
+{
+	this->world = world;
+	this->jobs = jobs;
+	this->stats = {};
+	this->chunkUsageSize = 0;
+	this->conflicts = 0;
+}
+
+void SystemScheduler::Run(float deltaTime)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Entities come and go between frames, so which systems overlap can change
+	stats.Dependencies = 0;
+	stats.Chunks = 0;
+	for (unsigned int i = 0; i < systems.size(); i++)
+	{
+		System& system = *systems[i];
+		system.Chunks.clear();
+		world->GetChunks(system.Mask, system.Chunks);
+		system.Dependents.clear();
+		system.Waiting = 0;
+		system.Ms = 0;
+		stats.Chunks += (unsigned int)system.Chunks.size();
+
+		for (unsigned int j = 0; j < i; j++)
+		{
+			if (!Conflict(*systems[j], system))
+				continue;
+			systems[j]->Dependents.push_back(i);
+			system.Waiting++;
+			stats.Dependencies++;
+		}
+	}
+
+#if defined(DEBUG) || defined(_DEBUG)
+	// Room to track every chunk of every archetype
+	const std::vector<EcsArchetype*>& archetypes = world->GetArchetypes();
+	firstChunk.resize(archetypes.size());
+	size_t chunkCount = 0;
+	for (EcsArchetype* archetype : archetypes)
+	{
+		firstChunk[archetype->Index] = (unsigned int)chunkCount;
+		chunkCount += archetype->Chunks.size();
+	}
+	size_t usageSize = chunkCount * ECS_MAX_COMPONENT_TYPES;
+	if (usageSize > chunkUsageSize)
+	{
+		chunkUsage.reset(new std::atomic<unsigned int>[usageSize]);
+		chunkUsageSize = usageSize;
+	}
+	for (size_t i = 0; i < usageSize; i++)
+		chunkUsage[i].store(0, std::memory_order_relaxed);
+#endif
+
+	// Every job is made before any starts, as the first ones to finish start the rest
+	JobCounter counter;
+	for (std::unique_ptr<System>& system : systems)
+	{
+		System* running = system.get();
+		running->Start = jobs->Create([this, running, deltaTime]() { Execute(running, deltaTime); }, &counter);
+	}
+	for (std::unique_ptr<System>& system : systems)
+		if (system->Waiting.load(std::memory_order_relaxed) == 0)
+			jobs->Run(system->Start);
+	jobs->Wait(counter);
+
+	stats.Systems = (unsigned int)systems.size();
+	stats.LastRunMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	stats.Conflicts = conflicts.exchange(0);
+	stats.AccessViolations = EcsWorld::TakeAccessViolations();
+}
+
+unsigned int SystemScheduler::GetSystemCount()
+{
+	return (unsigned int)systems.size();
+}
+
+const char* SystemScheduler::GetSystemName(unsigned int index)
+{
+	return systems[index]->Access.Name;
+}
+
+double SystemScheduler::GetSystemMs(unsigned int index)
+{
+	return systems[index]->Ms;
+}
+
+SystemSchedulerStats SystemScheduler::GetStats()
+{
+	return stats;
+}
+
+bool SystemScheduler::Conflict(const System& first, const System& second)
+{
+	// Reading the same components is fine, anything written by one can't be touched by the other
+	unsigned long long shared = (first.Access.Writes & second.Mask) | (second.Access.Writes & first.Mask);
+	if (!shared)
+		return false;
+
+	// And only matters if some entity has everything both of them need
+	unsigned long long both = first.Mask | second.Mask;
+	for (EcsArchetype* archetype : world->GetArchetypes())
+		if ((archetype->Mask & both) == both && archetype->Count > 0)
+			return true;
+	return false;
+}
+
+void SystemScheduler::Execute(System* system, float deltaTime)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	jobs->ParallelFor(0, (unsigned int)system->Chunks.size(), system->ChunksPerJob, [this, system, deltaTime](unsigned int first, unsigned int end)
+	{
+		// Set per range, as whichever thread picks one up may be in the middle of another system
+		const EcsAccess* previous = EcsWorld::SetAccess(&system->Access);
+		for (unsigned int i = first; i < end; i++)
+		{
+			const EcsChunkRef& chunk = system->Chunks[i];
+#if defined(DEBUG) || defined(_DEBUG)
+			EnterChunk(*system, chunk);
+#endif
+			system->Process(deltaTime, chunk.Archetype, chunk.Archetype->Chunks[chunk.Chunk]);
+#if defined(DEBUG) || defined(_DEBUG)
+			LeaveChunk(*system, chunk);
+#endif
+		}
+		EcsWorld::SetAccess(previous);
+	});
+
+	system->Ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// Anything that was only waiting on this can go now
+	for (unsigned int dependent : system->Dependents)
+		if (systems[dependent]->Waiting.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			jobs->Run(systems[dependent]->Start);
+}
+
+void SystemScheduler::EnterChunk(const System& system, const EcsChunkRef& chunk)
+{
+	std::atomic<unsigned int>* usage = &chunkUsage[(firstChunk[chunk.Archetype->Index] + chunk.Chunk) * (size_t)ECS_MAX_COMPONENT_TYPES];
+	for (unsigned int type = 0; type < ECS_MAX_COMPONENT_TYPES; type++)
+	{
+		unsigned long long bit = 1ull << type;
+		if (!(system.Mask & bit))
+			continue;
+
+		// Writers need the chunk to themselves, readers only need there to be no writer
+		bool write = (system.Access.Writes & bit) != 0;
+		unsigned int before = usage[type].fetch_add(write ? SYSTEM_SCHEDULER_WRITER : 1, std::memory_order_acq_rel);
+		if (write ? before == 0 : before < SYSTEM_SCHEDULER_WRITER)
+			continue;
+
+		conflicts++;
+#if defined(DEBUG) || defined(_DEBUG)
+		printf("Systems: \"%s\" %s component type %u in a chunk another system was %s\n", system.Access.Name,
+			write ? "wrote" : "read", type, before >= SYSTEM_SCHEDULER_WRITER ? "writing" : "reading");
+#endif
+	}
+}
+
+void SystemScheduler::LeaveChunk(const System& system, const EcsChunkRef& chunk)
+{
+	std::atomic<unsigned int>* usage = &chunkUsage[(firstChunk[chunk.Archetype->Index] + chunk.Chunk) * (size_t)ECS_MAX_COMPONENT_TYPES];
+	for (unsigned int type = 0; type < ECS_MAX_COMPONENT_TYPES; type++)
+	{
+		unsigned long long bit = 1ull << type;
+		if (system.Mask & bit)
+			usage[type].fetch_sub((system.Access.Writes & bit) ? SYSTEM_SCHEDULER_WRITER : 1, std::memory_order_acq_rel);
+	}
+}
+
+// The rest of a CoolObject-style entity, for the benchmark
+struct SchedulerBenchmarkPosition
+{
+	XMFLOAT3 Position;
+};
+
+struct SchedulerBenchmarkShaderInputs
+{
+	float TotalTime;
+	XMFLOAT2 MousePos;
+};
+
+// What each entity does every frame, shared by both ways of updating so they can't drift apart
+static void ApplyGravity(Rigidbody& body, float deltaTime)
+{
+	body.linearVelocity.x = (body.linearVelocity.x + body.gravity.x * deltaTime) * (1.0f - body.linearDamping * deltaTime);
+	body.linearVelocity.y = (body.linearVelocity.y + body.gravity.y * deltaTime) * (1.0f - body.linearDamping * deltaTime);
+	body.linearVelocity.z = (body.linearVelocity.z + body.gravity.z * deltaTime) * (1.0f - body.linearDamping * deltaTime);
+}
+
+static void Integrate(const Rigidbody& body, SchedulerBenchmarkPosition& position, float deltaTime)
+{
+	position.Position.x += body.linearVelocity.x * deltaTime;
+	position.Position.y += body.linearVelocity.y * deltaTime;
+	position.Position.z += body.linearVelocity.z * deltaTime;
+}
+
+static void UpdateShaderInputs(SchedulerBenchmarkShaderInputs& inputs, float deltaTime)
+{
+	inputs.TotalTime += deltaTime;
+	inputs.MousePos = XMFLOAT2(sinf(inputs.TotalTime), cosf(inputs.TotalTime));
+}
+
+// The same entity, the way GameEntity subclasses are updated
+class SchedulerBenchmarkObject
+{
+public:
+	virtual ~SchedulerBenchmarkObject() {}
+	virtual void Update(float deltaTime)
+	{
+		ApplyGravity(body, deltaTime);
+		Integrate(body, position, deltaTime);
+		UpdateShaderInputs(inputs, deltaTime);
+	}
+
+	Rigidbody body;
+	SchedulerBenchmarkPosition position;
+	SchedulerBenchmarkShaderInputs inputs;
+};
+
+SystemSchedulerBenchmark SystemScheduler::Benchmark(unsigned int entityCount, unsigned int threadCount)
+{
+	SystemSchedulerBenchmark result = {};
+	JobSystem benchmarkJobs(threadCount);
+	EcsWorld benchmarkWorld;
+	result.Entities = entityCount;
+	result.Threads = benchmarkJobs.GetThreadCount();
+
+	// Spread out a bit, so they don't all do exactly the same thing
+	std::vector<std::unique_ptr<SchedulerBenchmarkObject>> objects;
+	std::vector<EcsEntity> entities;
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		Rigidbody body = Rigidbody();
+		body.gravity = XMFLOAT3(0, -9.8f, 0);
+		body.linearDamping = 0.01f * (i % 10);
+		body.linearVelocity = XMFLOAT3((float)(i % 7), (float)(i % 5), 0);
+		SchedulerBenchmarkPosition position = { XMFLOAT3((float)i, 0, 0) };
+		SchedulerBenchmarkShaderInputs inputs = { 0.001f * (i % 100), XMFLOAT2(0, 0) };
+
+		objects.push_back(std::unique_ptr<SchedulerBenchmarkObject>(new SchedulerBenchmarkObject()));
+		objects.back()->body = body;
+		objects.back()->position = position;
+		objects.back()->inputs = inputs;
+
+		EcsEntity entity = benchmarkWorld.Create();
+		benchmarkWorld.Add<Rigidbody>(entity, body);
+		benchmarkWorld.Add<SchedulerBenchmarkPosition>(entity, position);
+		benchmarkWorld.Add<SchedulerBenchmarkShaderInputs>(entity, inputs);
+		entities.push_back(entity);
+	}
+
+	// Integrating has to wait for gravity, the shader inputs don't have to wait for anything
+	SystemScheduler scheduler(&benchmarkWorld, &benchmarkJobs);
+	scheduler.Add<Rigidbody>("Gravity",
+		[](float deltaTime, EcsEntity entity, Rigidbody& body) { ApplyGravity(body, deltaTime); });
+	scheduler.Add<const Rigidbody, SchedulerBenchmarkPosition>("Integrate",
+		[](float deltaTime, EcsEntity entity, const Rigidbody& body, SchedulerBenchmarkPosition& position) { Integrate(body, position, deltaTime); });
+	scheduler.Add<SchedulerBenchmarkShaderInputs>("Shader inputs",
+		[](float deltaTime, EcsEntity entity, SchedulerBenchmarkShaderInputs& inputs) { UpdateShaderInputs(inputs, deltaTime); });
+
+	const unsigned int frames = 10;
+	const float deltaTime = 1.0f / 60.0f;
+
+	auto virtualStart = std::chrono::high_resolution_clock::now();
+	for (unsigned int frame = 0; frame < frames; frame++)
+		for (std::unique_ptr<SchedulerBenchmarkObject>& object : objects)
+			object->Update(deltaTime);
+	result.VirtualMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - virtualStart).count() / frames;
+
+	auto scheduledStart = std::chrono::high_resolution_clock::now();
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		scheduler.Run(deltaTime);
+		result.Conflicts += scheduler.GetStats().Conflicts;
+	}
+	result.ScheduledMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - scheduledStart).count() / frames;
+
+	// Allowing for the compiler contracting the arithmetic differently in each
+	auto close = [](float a, float b) { return fabsf(a - b) <= 0.0001f * (1.0f + fabsf(a)); };
+	result.Matches = true;
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		const XMFLOAT3& expected = objects[i]->position.Position;
+		const XMFLOAT3& actual = benchmarkWorld.Get<SchedulerBenchmarkPosition>(entities[i])->Position;
+		float time = benchmarkWorld.Get<SchedulerBenchmarkShaderInputs>(entities[i])->TotalTime;
+		if (!close(expected.x, actual.x) || !close(expected.y, actual.y) || !close(expected.z, actual.z) ||
+			!close(objects[i]->inputs.TotalTime, time))
+			result.Matches = false;
+	}
+	return result;
+}
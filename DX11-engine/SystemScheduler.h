@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "EcsWorld.h"
+#include "JobSystem.h"
+
+// Chunks each job gets by default. A chunk is 16 KB of components, usually a few hundred entities.
+#define SYSTEM_SCHEDULER_CHUNKS_PER_JOB 1
+
+struct SystemSchedulerStats
+{
+	unsigned int Systems;
+	unsigned int Dependencies;	// Pairs of systems that couldn't run side by side last frame
+	unsigned int Chunks;		// Visited last frame, over every system
+	double LastRunMs;
+	unsigned int Conflicts;		// Systems found touching the same chunk at once (debug builds only)
+	unsigned int AccessViolations;	// Systems touching components they didn't declare (debug builds only)
+};
+
+// Updating CoolObject-style entities through virtual calls, and with systems on one thread per core
+struct SystemSchedulerBenchmark
+{
+	unsigned int Entities;
+	unsigned int Threads;
+	double VirtualMs;		// Per frame, one virtual Update() per entity, like Game::Update()
+	double ScheduledMs;		// Per frame, the same work split into systems
+	bool Matches;			// Both ended up in the same place
+	unsigned int Conflicts;
+};
+
+// --------------------------------------------------------
+// Runs systems (functions over every entity with a given
+// set of components) on the job system, once a frame
+//
+// - Components a system takes as const are only read, and
+//   anything else may be written, which is all the
+//   scheduler needs to know to keep systems apart
+// - Every frame, each system waits for the systems added
+//   before it that write what it reads, or read or write
+//   what it writes, but only if there's an archetype they
+//   both touch. Everything else runs side by side, so the
+//   results are the same as running them one after another.
+// - Each system's chunks are split between threads too
+// - Debug builds check, per chunk, that no two systems ever
+//   touch one at the same time when either is writing, and
+//   that systems only Get() what they declared
+// - Systems mustn't add, remove, make or destroy anything
+// --------------------------------------------------------
+class SystemScheduler
+{
+public:
+
+	// Both have to outlive the scheduler. Only thread 0 of the job system can call Run().
+	SystemScheduler(EcsWorld* world, JobSystem* jobs);
+
+	// Adds a system calling function(deltaTime, entity, components...) for every entity with all of the
+	// given components (const for ones it only reads). Returns its index, in the order systems were added.
+	template <class... T, class Function>
+	unsigned int Add(const char* name, Function function, unsigned int chunksPerJob = SYSTEM_SCHEDULER_CHUNKS_PER_JOB)
+	{
+		std::unique_ptr<System> system(new System());
+		system->Access.Name = name;
+		system->Access.Reads = EcsWorld::GetMask<T...>();
+		system->Access.Writes = GetWrites<T...>();
+		system->Mask = system->Access.Reads;
+		system->ChunksPerJob = chunksPerJob;
+		system->Process = [function](float deltaTime, EcsArchetype* archetype, EcsArchetype::Chunk& chunk)
+		{
+			auto perEntity = [&](EcsEntity entity, T&... components) { function(deltaTime, entity, components...); };
+			EcsWorld::EachInChunk<T...>(archetype, chunk, perEntity);
+		};
+
+		systems.push_back(std::move(system));
+		return (unsigned int)systems.size() - 1;
+	}
+
+	// Runs every system once and waits for them all
+	void Run(float deltaTime);
+
+	unsigned int GetSystemCount();
+	const char* GetSystemName(unsigned int index);
+	double GetSystemMs(unsigned int index);	// From its first chunk starting to its last finishing, last frame
+
+	SystemSchedulerStats GetStats();
+
+	// Times a number of CoolObject-style entities (a Rigidbody, a position and shader inputs each)
+	// updated each way, with the job system on this many threads
+	static SystemSchedulerBenchmark Benchmark(unsigned int entityCount, unsigned int threadCount);
+
+private:
+
+	struct System
+	{
+		EcsAccess Access;
+		unsigned long long Mask;	// Every component it touches
+		unsigned int ChunksPerJob;
+		std::function<void(float, EcsArchetype*, EcsArchetype::Chunk&)> Process;
+
+		// Rebuilt every frame
+		std::vector<EcsChunkRef> Chunks;
+		std::vector<unsigned int> Dependents;	// Systems waiting for this one
+		std::atomic<unsigned int> Waiting;		// Systems this one still has to wait for
+		Job* Start;
+		double Ms;
+	};
+
+	EcsWorld* world;
+	JobSystem* jobs;
+	std::vector<std::unique_ptr<System>> systems;
+	SystemSchedulerStats stats;
+
+	// Per chunk and component type while systems run: readers in the low bits, writers from
+	// SYSTEM_SCHEDULER_WRITER up (debug builds only)
+	std::unique_ptr<std::atomic<unsigned int>[]> chunkUsage;
+	size_t chunkUsageSize;
+	std::vector<unsigned int> firstChunk;	// Per archetype, where its chunks start in chunkUsage
+	std::atomic<unsigned int> conflicts;
+
+	template <class... T>
+	static unsigned long long GetWrites()
+	{
+		unsigned long long bits[] = { 0ull, (std::is_const<T>::value ? 0ull : 1ull << EcsWorld::GetTypeId<T>())... };
+		unsigned long long mask = 0;
+		for (unsigned long long bit : bits)
+			mask |= bit;
+		return mask;
+	}
+
+	bool Conflict(const System& first, const System& second);
+	void Execute(System* system, float deltaTime);
+	void EnterChunk(const System& system, const EcsChunkRef& chunk);
+	void LeaveChunk(const System& system, const EcsChunkRef& chunk);
+};
@@ -0,0 +1,350 @@
+#include "TangentGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+using namespace DirectX;
+
+void TangentGenerator::Generate(Vertex* verts, unsigned int numVerts, const unsigned int* indices, unsigned int numIndices,
+	TangentMode mode, unsigned int threadCount)
+{
+	unsigned int numTriangles = numIndices / 3;
+	if (numVerts == 0)
+		return;
+
+	if (threadCount == 0)
+		threadCount = numTriangles >= TANGENT_PARALLEL_THRESHOLD ? std::thread::hardware_concurrency() : 1;
+
+	// Keep each thread's share of triangles a multiple of the batch size
+	unsigned int numBatches = (numTriangles + 3) / 4;
+	threadCount = std::max(1u, std::min(threadCount, numBatches));
+
+	// Every thread gets its own tangent (and for MikkTSpace, bitangent) buffer
+	size_t setSize = (size_t)numVerts * (mode == TANGENT_MODE_MIKKTSPACE ? 2 : 1);
+	std::vector<XMFLOAT4> buffers(setSize * threadCount, XMFLOAT4(0, 0, 0, 0));
+	auto firstTriangle = [&](unsigned int thread) { return (unsigned int)std::min((size_t)numBatches * thread / threadCount * 4, (size_t)numTriangles); };
+	auto bitangents = [&](unsigned int thread) { return mode == TANGENT_MODE_MIKKTSPACE ? &buffers[setSize * thread + numVerts] : 0; };
+	{
+		std::vector<std::thread> workers;
+		for (unsigned int i = 1; i < threadCount; i++)
+			workers.emplace_back(AccumulateTriangles, verts, indices, firstTriangle(i), firstTriangle(i + 1), mode, &buffers[setSize * i], bitangents(i));
+		AccumulateTriangles(verts, indices, 0, firstTriangle(1), mode, &buffers[0], bitangents(0));
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	// Add the buffers up and finish each vertex, splitting the vertices between the threads this time
+	auto firstVertex = [&](unsigned int thread) { return (unsigned int)((size_t)numVerts * thread / threadCount); };
+	{
+		std::vector<std::thread> workers;
+		for (unsigned int i = 1; i < threadCount; i++)
+			workers.emplace_back(ResolveVertices, verts, firstVertex(i), firstVertex(i + 1), numVerts, mode, &buffers[0], threadCount);
+		ResolveVertices(verts, 0, firstVertex(1), numVerts, mode, &buffers[0], threadCount);
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+}
+
+unsigned int TangentGenerator::SplitMirroredVertices(std::vector<Vertex>& verts, std::vector<unsigned int>& indices)
+{
+	// Which way each corner's triangle is mapped, as seen from its vertex's normal. That's the
+	// sign of the handedness ResolveVertices() would give the triangle on its own, as
+	// cross(T, B) works out to be the face normal over the uvs' determinant.
+	std::vector<signed char> cornerSides(indices.size(), 0);
+	std::vector<unsigned char> vertexSides(verts.size(), 0);	// Bit 0 for unmirrored, bit 1 for mirrored
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const Vertex& v1 = verts[indices[i + 0]];
+		const Vertex& v2 = verts[indices[i + 1]];
+		const Vertex& v3 = verts[indices[i + 2]];
+
+		XMVECTOR p1 = XMLoadFloat3(&v1.Position);
+		XMVECTOR faceNormal = XMVector3Cross(XMLoadFloat3(&v2.Position) - p1, XMLoadFloat3(&v3.Position) - p1);
+		float det = (v2.UV.x - v1.UV.x) * (v3.UV.y - v1.UV.y) - (v3.UV.x - v1.UV.x) * (v2.UV.y - v1.UV.y);
+
+		// Degenerate uvs don't add to the tangents, so they don't need a side
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int index = indices[i + c];
+			float side = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&verts[index].Normal), faceNormal)) * det;
+			cornerSides[i + c] = side > 0.0f ? 1 : side < 0.0f ? -1 : 0;
+			vertexSides[index] |= side > 0.0f ? 1 : side < 0.0f ? 2 : 0;
+		}
+	}
+
+	// The mirrored side of anything used both ways gets the copy
+	std::vector<unsigned int> mirroredCopies(verts.size(), 0xFFFFFFFF);
+	unsigned int added = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		unsigned int index = indices[i];
+		if (vertexSides[index] != 3 || cornerSides[i] >= 0)
+			continue;
+
+		if (mirroredCopies[index] == 0xFFFFFFFF)
+		{
+			Vertex copy = verts[index];
+			mirroredCopies[index] = (unsigned int)verts.size();
+			verts.push_back(copy);
+			added++;
+		}
+		indices[i] = mirroredCopies[index];
+	}
+	return added;
+}
+
+// Sums the tangents of a range of triangles into the given buffers. Triangles are
+// handled in batches of 4, transposed so each SIMD lane works on its own triangle.
+void TangentGenerator::AccumulateTriangles(const Vertex* verts, const unsigned int* indices, unsigned int firstTriangle, unsigned int endTriangle,
+	TangentMode mode, XMFLOAT4* tangents, XMFLOAT4* bitangents)
+{
+	for (unsigned int batch = firstTriangle; batch < endTriangle; batch += 4)
+	{
+		unsigned int count = std::min(4u, endTriangle - batch);
+
+		// One triangle per row: both edges and the uv deltas (s1, t1, s2, t2)
+		XMMATRIX edge1(XMVectorZero(), XMVectorZero(), XMVectorZero(), XMVectorZero());
+		XMMATRIX edge2 = edge1;
+		XMMATRIX uvDeltas = edge1;
+		for (unsigned int k = 0; k < count; k++)
+		{
+			const Vertex& v1 = verts[indices[(batch + k) * 3 + 0]];
+			const Vertex& v2 = verts[indices[(batch + k) * 3 + 1]];
+			const Vertex& v3 = verts[indices[(batch + k) * 3 + 2]];
+
+			XMVECTOR p1 = XMLoadFloat3(&v1.Position);
+			edge1.r[k] = XMLoadFloat3(&v2.Position) - p1;
+			edge2.r[k] = XMLoadFloat3(&v3.Position) - p1;
+			uvDeltas.r[k] = XMVectorSet(
+				v2.UV.x - v1.UV.x, v2.UV.y - v1.UV.y,
+				v3.UV.x - v1.UV.x, v3.UV.y - v1.UV.y);
+		}
+
+		// Now one component of all 4 triangles per row
+		XMMATRIX e1 = XMMatrixTranspose(edge1);
+		XMMATRIX e2 = XMMatrixTranspose(edge2);
+		XMMATRIX uv = XMMatrixTranspose(uvDeltas);
+		XMVECTOR s1 = uv.r[0], t1 = uv.r[1], s2 = uv.r[2], t2 = uv.r[3];
+
+		// Triangles with degenerate UVs don't contribute, instead of spreading infinities
+		XMVECTOR det = s1 * t2 - s2 * t1;
+		XMVECTOR r = XMVectorSelect(XMVectorZero(), XMVectorReciprocal(det), XMVectorNotEqual(det, XMVectorZero()));
+
+		XMMATRIX triTangents;
+		triTangents.r[0] = (t2 * e1.r[0] - t1 * e2.r[0]) * r;
+		triTangents.r[1] = (t2 * e1.r[1] - t1 * e2.r[1]) * r;
+		triTangents.r[2] = (t2 * e1.r[2] - t1 * e2.r[2]) * r;
+		triTangents.r[3] = XMVectorZero();
+		triTangents = XMMatrixTranspose(triTangents);
+
+		if (mode == TANGENT_MODE_ACCUMULATE)
+		{
+			for (unsigned int k = 0; k < count; k++)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					XMFLOAT4& t = tangents[indices[(batch + k) * 3 + c]];
+					XMStoreFloat4(&t, XMLoadFloat4(&t) + triTangents.r[k]);
+				}
+			}
+			continue;
+		}
+
+		XMMATRIX triBitangents;
+		triBitangents.r[0] = (s1 * e2.r[0] - s2 * e1.r[0]) * r;
+		triBitangents.r[1] = (s1 * e2.r[1] - s2 * e1.r[1]) * r;
+		triBitangents.r[2] = (s1 * e2.r[2] - s2 * e1.r[2]) * r;
+		triBitangents.r[3] = XMVectorZero();
+		triBitangents = XMMatrixTranspose(triBitangents);
+
+		// Corner angles, which weight each triangle's contribution to its vertices
+		XMVECTOR e3x = e2.r[0] - e1.r[0], e3y = e2.r[1] - e1.r[1], e3z = e2.r[2] - e1.r[2];
+		XMVECTOR len1 = XMVectorSqrt(e1.r[0] * e1.r[0] + e1.r[1] * e1.r[1] + e1.r[2] * e1.r[2]);
+		XMVECTOR len2 = XMVectorSqrt(e2.r[0] * e2.r[0] + e2.r[1] * e2.r[1] + e2.r[2] * e2.r[2]);
+		XMVECTOR len3 = XMVectorSqrt(e3x * e3x + e3y * e3y + e3z * e3z);
+		XMVECTOR dot12 = e1.r[0] * e2.r[0] + e1.r[1] * e2.r[1] + e1.r[2] * e2.r[2];
+		XMVECTOR dot13 = e1.r[0] * e3x + e1.r[1] * e3y + e1.r[2] * e3z;
+		XMVECTOR dot23 = e2.r[0] * e3x + e2.r[1] * e3y + e2.r[2] * e3z;
+
+		XMVECTOR one = XMVectorReplicate(1.0f);
+		XMVECTOR cornerAngles[3] =
+		{
+			XMVectorACos(XMVectorClamp(dot12 / (len1 * len2), -one, one)),
+			XMVectorACos(XMVectorClamp(-dot13 / (len1 * len3), -one, one)),
+			XMVectorACos(XMVectorClamp(dot23 / (len2 * len3), -one, one))
+		};
+
+		// Zero length edges give NaN angles, which shouldn't count at all
+		for (int c = 0; c < 3; c++)
+			cornerAngles[c] = XMVectorSelect(XMVectorZero(), cornerAngles[c], XMVectorEqual(cornerAngles[c], cornerAngles[c]));
+
+		for (unsigned int k = 0; k < count; k++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int index = indices[(batch + k) * 3 + c];
+				float angle = XMVectorGetByIndex(cornerAngles[c], k);
+
+				// Like MikkTSpace, project onto the vertex's tangent plane
+				// before normalizing, so only the direction counts
+				XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&verts[index].Normal));
+				XMVECTOR t = XMVector3Normalize(triTangents.r[k] - n * XMVector3Dot(n, triTangents.r[k]));
+				XMVECTOR b = XMVector3Normalize(triBitangents.r[k] - n * XMVector3Dot(n, triBitangents.r[k]));
+
+				XMStoreFloat4(&tangents[index], XMLoadFloat4(&tangents[index]) + t * angle);
+				XMStoreFloat4(&bitangents[index], XMLoadFloat4(&bitangents[index]) + b * angle);
+			}
+		}
+	}
+}
+
+// Adds up every thread's buffer for a range of vertices, then makes
+// the tangents orthogonal to the normals and works out handedness
+void TangentGenerator::ResolveVertices(Vertex* verts, unsigned int firstVertex, unsigned int endVertex, unsigned int numVerts,
+	TangentMode mode, const XMFLOAT4* buffers, unsigned int numBuffers)
+{
+	size_t setSize = (size_t)numVerts * (mode == TANGENT_MODE_MIKKTSPACE ? 2 : 1);
+	for (unsigned int i = firstVertex; i < endVertex; i++)
+	{
+		XMVECTOR tangent = XMVectorZero();
+		XMVECTOR bitangent = XMVectorZero();
+		for (unsigned int b = 0; b < numBuffers; b++)
+		{
+			tangent += XMLoadFloat4(&buffers[setSize * b + i]);
+			if (mode == TANGENT_MODE_MIKKTSPACE)
+				bitangent += XMLoadFloat4(&buffers[setSize * b + numVerts + i]);
+		}
+
+		// Use Gram-Schmidt orthonormalize to ensure
+		// the normal and tangent are exactly 90 degrees apart
+		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
+		tangent = XMVector3Normalize(tangent - normal * XMVector3Dot(normal, tangent));
+
+		// The pixel shaders build the bitangent as cross(T, N) * w, which points
+		// towards -v for the imported models (their V is flipped on load),
+		// so flip it wherever the UVs' bitangent points towards +v instead
+		float handedness = 1.0f;
+		if (mode == TANGENT_MODE_MIKKTSPACE && XMVectorGetX(XMVector3Dot(XMVector3Cross(tangent, normal), bitangent)) > 0.0f)
+			handedness = -1.0f;
+
+		XMStoreFloat4(&verts[i].Tangent, XMVectorSetW(tangent, handedness));
+	}
+}
+
+// --------------------------------------------------------
+// Author: Chris Cascioli
+// Purpose: Calculates the tangents of the vertices in a mesh
+//
+// - You are allowed to directly copy/paste this into your code base
+//   for assignments, given that you clearly cite that this is not
+//   code of your own design.
+//
+// - Code originally adapted from: http://www.terathon.com/code/tangent.html
+//   - Updated version now found here: http://foundationsofgameenginedev.com/FGED2-sample.pdf
+//   - See listing 7.4 in section 7.5 (page 9 of the PDF)
+//
+// - Note: For this code to work, your Vertex format must
+//         contain an XMFLOAT4 called Tangent
+//
+// - Be sure to call this BEFORE creating your D3D vertex/index buffers
+// --------------------------------------------------------
+void TangentGenerator::GenerateReference(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices)
+{
+	// Reset tangents
+	for (int i = 0; i < numVerts; i++)
+	{
+		verts[i].Tangent = XMFLOAT4(0, 0, 0, 0);
+	}
+
+	// Calculate tangents one whole triangle at a time
+	for (int i = 0; i < numIndices;)
+	{
+		// Grab indices and vertices of first triangle
+		unsigned int i1 = indices[i++];
+		unsigned int i2 = indices[i++];
+		unsigned int i3 = indices[i++];
+		Vertex* v1 = &verts[i1];
+		Vertex* v2 = &verts[i2];
+		Vertex* v3 = &verts[i3];
+
+		// Calculate vectors relative to triangle positions
+		float x1 = v2->Position.x - v1->Position.x;
+		float y1 = v2->Position.y - v1->Position.y;
+		float z1 = v2->Position.z - v1->Position.z;
+
+		float x2 = v3->Position.x - v1->Position.x;
+		float y2 = v3->Position.y - v1->Position.y;
+		float z2 = v3->Position.z - v1->Position.z;
+
+		// Do the same for vectors relative to triangle uv's
+		float s1 = v2->UV.x - v1->UV.x;
+		float t1 = v2->UV.y - v1->UV.y;
+
+		float s2 = v3->UV.x - v1->UV.x;
+		float t2 = v3->UV.y - v1->UV.y;
+
+		// Create vectors for tangent calculation
+		float r = 1.0f / (s1 * t2 - s2 * t1);
+
+		float tx = (t2 * x1 - t1 * x2) * r;
+		float ty = (t2 * y1 - t1 * y2) * r;
+		float tz = (t2 * z1 - t1 * z2) * r;
+
+		// Adjust tangents of each vert of the triangle
+		v1->Tangent.x += tx;
+		v1->Tangent.y += ty;
+		v1->Tangent.z += tz;
+
+		v2->Tangent.x += tx;
+		v2->Tangent.y += ty;
+		v2->Tangent.z += tz;
+
+		v3->Tangent.x += tx;
+		v3->Tangent.y += ty;
+		v3->Tangent.z += tz;
+	}
+
+	// Ensure all of the tangents are orthogonal to the normals
+	for (int i = 0; i < numVerts; i++)
+	{
+		// Grab the two vectors
+		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
+		XMVECTOR tangent = XMLoadFloat4(&verts[i].Tangent);
+
+		// Use Gram-Schmidt orthonormalize to ensure
+		// the normal and tangent are exactly 90 degrees apart
+		tangent = XMVector3Normalize(
+			tangent - normal * XMVector3Dot(normal, tangent));
+
+		// Store the tangent (always right handed)
+		XMStoreFloat4(&verts[i].Tangent, XMVectorSetW(tangent, 1.0f));
+	}
+}
+
+float TangentGenerator::CompareTangents(const Vertex* reference, const Vertex* other, unsigned int numVerts, bool compareHandedness)
+{
+	float largestAngle = 0.0f;
+	for (unsigned int i = 0; i < numVerts; i++)
+	{
+		XMVECTOR a = XMLoadFloat4(&reference[i].Tangent);
+		XMVECTOR b = XMLoadFloat4(&other[i].Tangent);
+		float lengthA = XMVectorGetX(XMVector3Length(a));
+		if (!std::isfinite(lengthA) || lengthA < 0.5f)
+			continue;
+
+		// Opposite handedness is as wrong as it gets
+		if (compareHandedness && reference[i].Tangent.w != other[i].Tangent.w)
+			return 180.0f;
+
+		// atan2 stays accurate for tiny angles, where acos of the dot product doesn't
+		float angle = XMConvertToDegrees(atan2f(
+			XMVectorGetX(XMVector3Length(XMVector3Cross(a, b))),
+			XMVectorGetX(XMVector3Dot(a, b))));
+
+		// NaN counts as a mismatch too
+		if (!(angle <= largestAngle))
+			largestAngle = std::isfinite(angle) ? angle : 180.0f;
+	}
+	return largestAngle;
+}
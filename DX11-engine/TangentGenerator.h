@@ -0,0 +1,59 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Vertex.h"
+
+// Meshes with at least this many triangles get their tangents calculated on multiple threads
+#define TANGENT_PARALLEL_THRESHOLD (64 * 1024)
+
+// How far (in degrees) Generate() may drift from GenerateReference() in TANGENT_MODE_ACCUMULATE
+#define TANGENT_TOLERANCE_DEGREES 0.01f
+
+// How vertex tangents are built from the triangles around them
+enum TangentMode
+{
+	TANGENT_MODE_ACCUMULATE,	// Sum of each triangle's tangent, like the original Mesh::CalculateTangents (handedness is always 1)
+	TANGENT_MODE_MIKKTSPACE		// Unit triangle tangents weighted by corner angle, with handedness, like MikkTSpace
+								// (which needs SplitMirroredVertices() first, like MikkTSpace does its own splitting)
+};
+
+// --------------------------------------------------------
+// Calculates per-vertex tangents for normal mapping
+//
+// - Triangles are processed 4 at a time, one per SIMD lane
+// - Big meshes are split across threads, each summing into
+//   its own tangent buffer so there are no write races, and
+//   the buffers are then added up (again in parallel)
+// - Tangent.w holds the handedness: the pixel shaders use
+//   cross(T, N) * w as the bitangent, so w is -1 wherever
+//   a mesh's UVs are mirrored
+// --------------------------------------------------------
+class TangentGenerator
+{
+public:
+
+	// A threadCount of 0 picks one based on the mesh's size
+	static void Generate(Vertex* verts, unsigned int numVerts, const unsigned int* indices, unsigned int numIndices,
+		TangentMode mode = TANGENT_MODE_ACCUMULATE, unsigned int threadCount = 0);
+
+	// Gives the mirrored triangles around a vertex that's also used by unmirrored ones (like
+	// along the seam of a symmetric model) their own copy of it, so every vertex has a single
+	// handedness. Only needs positions, normals and uvs. Returns how many vertices were added.
+	static unsigned int SplitMirroredVertices(std::vector<Vertex>& verts, std::vector<unsigned int>& indices);
+
+	// The original scalar implementation, kept to check Generate() against
+	static void GenerateReference(Vertex* verts, int numVerts, const unsigned int* indices, int numIndices);
+
+	// Largest angle between two sets of tangents, in degrees. Vertices without a usable
+	// tangent in the reference set (degenerate UVs) are skipped, as are differing handedness
+	// signs if compareHandedness is false.
+	static float CompareTangents(const Vertex* reference, const Vertex* other, unsigned int numVerts, bool compareHandedness = true);
+
+private:
+
+	static void AccumulateTriangles(const Vertex* verts, const unsigned int* indices, unsigned int firstTriangle, unsigned int endTriangle,
+		TangentMode mode, DirectX::XMFLOAT4* tangents, DirectX::XMFLOAT4* bitangents);
+	static void ResolveVertices(Vertex* verts, unsigned int firstVertex, unsigned int endVertex, unsigned int numVerts,
+		TangentMode mode, const DirectX::XMFLOAT4* buffers, unsigned int numBuffers);
+};
@@ -10,9 +10,12 @@ Terrain::Terrain(unsigned int rows, unsigned int columns,
 {
 	updateVBO = false;
 
+	// The vertices get edited on the CPU, and the indices are needed to recalculate
+	// the tangents and meshlet bounds when they are
+	residency = MESH_RESIDENCY_FULL;
+
 	resolution = XMINT2(columns, rows);
 	vector<Vertex> vertices;
-	vector<unsigned int> indices;
 
 	// Create the vertex array
 	for (unsigned int i = 0; i < rows; i++) // up
@@ -23,7 +26,7 @@ Terrain::Terrain(unsigned int rows, unsigned int columns,
 				XMFLOAT3(i, 0, j), // position
 				XMFLOAT3(0, 1, 0), // normal
 				XMFLOAT2(i, j),    // UV
-				XMFLOAT3(1, 0, 0)  // tangent
+				XMFLOAT4(1, 0, 0, 1)  // tangent
 				});
 		}
 	}
@@ -45,11 +48,15 @@ Terrain::Terrain(unsigned int rows, unsigned int columns,
 		}
 	}
 
+	// Group the grid's triangles into meshlets, so patches facing away or off screen can be skipped
+	MeshletBuilder::Build(&vertices[0], (unsigned int)vertices.size(), &indices[0], (unsigned int)indices.size(), true, meshlets);
+
 	// set context and index count, then create VBOs and IBOs
 	this->context = context;
-	this->vertices = vertices;
 	this->indexCount = (unsigned int)indices.size();
+	CalculateBounds(&vertices[0], (unsigned int)vertices.size());
 	CreateBuffers(&vertices[0], (unsigned int)vertices.size(), &indices[0], device, true);
+	this->vertices = std::move(vertices);
 }
 
 // Call this on the terrain object if you want its vertices updated next frame. 
@@ -57,9 +64,25 @@ Terrain::Terrain(unsigned int rows, unsigned int columns,
 void Terrain::UpdateVBO()
 {
 	updateVBO = true;
+	CalculateTangents(&vertices[0], (unsigned int)vertices.size(), &indices[0], (unsigned int)indices.size());
+	CalculateBounds(&vertices[0], (unsigned int)vertices.size());
+	for (Meshlet& meshlet : meshlets)
+		MeshletBuilder::ComputeBounds(meshlet, &vertices[0], &indices[0]);
+}
+
+void Terrain::Draw(unsigned int lod, MeshBindings* bindings)
+{
+	UploadVertices();
+	Mesh::Draw(lod, bindings); // call the parent's draw method to draw the terrain on the screen
 }
 
-void Terrain::Draw()
+void Terrain::Draw(const std::vector<IndexRange>& ranges, MeshBindings* bindings)
+{
+	UploadVertices();
+	Mesh::Draw(ranges, bindings);
+}
+
+void Terrain::UploadVertices()
 {
 	// only update VBO if it needs to be (to reduce locking/unlocking frequency)
 	if (updateVBO)
@@ -70,6 +93,4 @@ void Terrain::Draw()
 		memcpy(vData.pData, &vertices[0], sizeof(Vertex) * vertices.size()); // copy from vertices to GPU
 		context->Unmap(GetVertexBuffer().Get(), 0); // Unlock vertex buffer w/ new data
 	}
-
-	Mesh::Draw(); // call the parent's draw method to draw the terrain on the screen
 }
\ No newline at end of file
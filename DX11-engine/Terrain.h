@@ -10,7 +10,8 @@ public:
 		Microsoft::WRL::ComPtr<ID3D11Device> device,
 		Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
 
-	void Draw() override;
+	void Draw(unsigned int lod = 0, MeshBindings* bindings = 0) override;
+	void Draw(const std::vector<IndexRange>& ranges, MeshBindings* bindings = 0) override;
 
 	void UpdateVBO();
 
@@ -20,4 +21,7 @@ private:
 
 	bool updateVBO;
 
+	// Copies the vertices to the GPU if they changed since the last draw
+	void UploadVertices();
+
 };
\ No newline at end of file
@@ -0,0 +1,22 @@
+// Runs the job system's self test outside the engine, so it can be built
+// anywhere (see CMakeLists.txt here) and run under ThreadSanitizer
+#include "../JobSystem.h"
+#include <cstdio>
+
+// Races only show up when the timing's right, so go round a few times
+#define JOB_SYSTEM_TEST_ROUNDS 20
+
+int main()
+{
+	bool passed = true;
+	for (int i = 0; i < JOB_SYSTEM_TEST_ROUNDS; i++)
+		passed &= JobSystem::SelfTest();
+
+	JobSystemBenchmark benchmark = JobSystem::Benchmark(4);
+	passed &= benchmark.Matches;
+
+	printf("Job system: %d self test rounds, %u threads, spawn %.1f ns (%.1f ns from jobs), parallel for %.2f ms (serial %.2f ms)%s\n",
+		JOB_SYSTEM_TEST_ROUNDS, benchmark.Threads, benchmark.SpawnNs, benchmark.NestedSpawnNs, benchmark.ParallelForMs, benchmark.SerialMs,
+		passed ? "" : ", FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#include "TimerWheel.h"
+#include <algorithm>
+#include <cmath>
+
+TimerWheel::TimerWheel()
+{
+	this->time = 0.0;
+	this->tick = 0;
+	this->nextHandle = 1;
+}
+
+TimerHandle TimerWheel::After(double seconds, std::function<void()> callback)
+{
+	// The first tick that starts at or after the time it's due, and never the one that's already been run
+	unsigned long long dueTick = (unsigned long long)ceil((time + (std::max)(seconds, 0.0)) / TIMER_WHEEL_TICK);
+	dueTick = (std::max)(dueTick, tick + 1);
+
+	TimerHandle handle = nextHandle++;
+	if (nextHandle == TIMER_NO_HANDLE)
+		nextHandle++;
+
+	unsigned int slot = (unsigned int)(dueTick % TIMER_WHEEL_SLOTS);
+	slots[slot].push_back({ dueTick, handle, callback });
+	pending[handle] = slot;
+	return handle;
+}
+
+bool TimerWheel::Cancel(TimerHandle handle)
+{
+	std::unordered_map<TimerHandle, unsigned int>::iterator found = pending.find(handle);
+	if (found == pending.end())
+		return false;
+
+	// It may be in the middle of firing, in which case it's skipped for not being pending any more
+	std::vector<Timer>& slot = slots[found->second];
+	for (size_t i = 0; i < slot.size(); i++)
+	{
+		if (slot[i].Handle == handle)
+		{
+			slot[i] = std::move(slot.back());
+			slot.pop_back();
+			break;
+		}
+	}
+	pending.erase(found);
+	return true;
+}
+
+unsigned int TimerWheel::Advance(double deltaTime)
+{
+	time += deltaTime;
+
+	unsigned int fired = 0;
+	while ((tick + 1) * TIMER_WHEEL_TICK <= time)
+	{
+		tick++;
+
+		// Due ones are taken out first, so callbacks adding timers to this slot don't disturb it
+		std::vector<Timer>& slot = slots[tick % TIMER_WHEEL_SLOTS];
+		for (size_t i = 0; i < slot.size();)
+		{
+			if (slot[i].DueTick <= tick)
+			{
+				firing.push_back(std::move(slot[i]));
+				slot[i] = std::move(slot.back());
+				slot.pop_back();
+			}
+			else
+				i++;
+		}
+
+		for (size_t i = 0; i < firing.size(); i++)
+		{
+			// Cancelled by an earlier callback
+			if (pending.erase(firing[i].Handle) == 0)
+				continue;
+
+			firing[i].Callback();
+			fired++;
+		}
+		firing.clear();
+	}
+	return fired;
+}
+
+unsigned int TimerWheel::GetPendingCount()
+{
+	return (unsigned int)pending.size();
+}
+
+double TimerWheel::GetTime()
+{
+	return time;
+}
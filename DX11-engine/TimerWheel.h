@@ -0,0 +1,65 @@
+#pragma once
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+// Slots around the wheel, and how much time each one covers. Timers further off
+// than a whole turn wait in their slot for as many turns as it takes.
+#define TIMER_WHEEL_SLOTS 256
+#define TIMER_WHEEL_TICK (1.0 / 64.0)
+
+// Identifies a timer for cancelling it. Never reused (well, not for 4 billion timers).
+typedef unsigned int TimerHandle;
+#define TIMER_NO_HANDLE 0
+
+// --------------------------------------------------------
+// Calls functions after a delay, in game time
+//
+// - Each timer goes in the slot for the tick it's due on,
+//   so advancing time only looks at the slots for the ticks
+//   that have passed, however many timers are waiting
+// - Adding and cancelling timers is O(1) (cancelling is
+//   O(timers in the slot), which is a handful)
+// - Timers never fire early, and fire up to a tick late
+//   (plus however long is left of the frame)
+// - Callbacks can add and cancel timers, but ones due on
+//   the tick being run wait until the next one
+// --------------------------------------------------------
+class TimerWheel
+{
+public:
+
+	TimerWheel();
+	TimerWheel(const TimerWheel& other) = delete;
+	TimerWheel& operator=(const TimerWheel& other) = delete;
+
+	// Calls the callback once the given number of seconds have been advanced past
+	TimerHandle After(double seconds, std::function<void()> callback);
+
+	// Returns false if the timer has already fired or been cancelled
+	bool Cancel(TimerHandle handle);
+
+	// Moves time along, firing every timer that comes due. Returns how many fired.
+	unsigned int Advance(double deltaTime);
+
+	unsigned int GetPendingCount();
+	double GetTime();
+
+private:
+
+	struct Timer
+	{
+		unsigned long long DueTick;
+		TimerHandle Handle;
+		std::function<void()> Callback;
+	};
+
+	std::vector<Timer> slots[TIMER_WHEEL_SLOTS];
+	std::unordered_map<TimerHandle, unsigned int> pending;	// Slot each timer that hasn't fired is in
+	std::vector<Timer> firing;	// Reused every tick to avoid allocating
+
+	double time;
+	unsigned long long tick;	// The last one run
+	TimerHandle nextHandle;
+};
@@ -1,5 +1,7 @@
 #include "Transform.h"
+#include "TransformHierarchy.h"
 #include <iostream>
+#include <cmath>
 
 using namespace DirectX;
 
@@ -7,18 +9,64 @@ XMFLOAT3 Transform::WorldRight = XMFLOAT3(1.0f, 0.0f, 0.0f);
 XMFLOAT3 Transform::WorldUp = XMFLOAT3(0.0f, 1.0f, 0.0f);
 XMFLOAT3 Transform::WorldForward = XMFLOAT3(0.0f, 0.0f, 1.0f);
 
+unsigned int Transform::matrixBuildCount = 0;
+
 Transform::Transform()
 {
 	position = XMFLOAT3(0, 0, 0);
-	rotation = XMFLOAT3(0, 0, 0);
+	rotation = XMFLOAT4(0, 0, 0, 1);
+	pitchYawRoll = XMFLOAT3(0, 0, 0);
+	pitchYawRollDirty = false;
 	scale = XMFLOAT3(1, 1, 1);
 
 	forward = XMFLOAT3(0, 0, 1);
 	up = XMFLOAT3(0, 1, 0);
 	right = XMFLOAT3(1, 0, 0);
 
-	XMStoreFloat4x4(&worldMatrix, XMMatrixIdentity());
-	XMStoreFloat4x4(&worldInverseTranspose, XMMatrixIdentity());
+	XMStoreFloat4x4(&localMatrix, XMMatrixIdentity());
+	XMStoreFloat4x4(&localInverseTranspose, XMMatrixIdentity());
+	matricesDirty = false;
+	version = 0;
+	hierarchy = 0;
+	hierarchyIndex = 0;
+}
+
+Transform::Transform(const Transform& other)
+{
+	hierarchy = 0;
+	hierarchyIndex = 0;
+	*this = other;
+}
+
+Transform& Transform::operator=(const Transform& other)
+{
+	localMatrix = other.localMatrix;
+	localInverseTranspose = other.localInverseTranspose;
+	position = other.position;
+	scale = other.scale;
+	rotation = other.rotation;
+	pitchYawRoll = other.pitchYawRoll;
+	pitchYawRollDirty = other.pitchYawRollDirty;
+	right = other.right;
+	up = other.up;
+	forward = other.forward;
+	version = other.version;
+
+	// Counts as a change, so a hierarchy this is in picks it up
+	MarkDirty();
+	return *this;
+}
+
+Transform::~Transform()
+{
+	if (hierarchy)
+		hierarchy->Remove(this);
+}
+
+void Transform::MarkDirty()
+{
+	matricesDirty = true;
+	version++;
 }
 
 void Transform::UpdateMatrices()
@@ -27,35 +75,60 @@ void Transform::UpdateMatrices()
 	XMMATRIX t = XMMatrixTranslation(position.x, position.y, position.z);
 
 	// Rotation matrix (from quaternion)
-	XMVECTOR quatVec = XMQuaternionRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
-	XMMATRIX r = XMMatrixRotationQuaternion(quatVec);
+	XMMATRIX r = XMMatrixRotationQuaternion(XMLoadFloat4(&rotation));
 
 	// Scale matrix
 	XMMATRIX s = XMMatrixScaling(scale.x, scale.y, scale.z);
 
 	XMMATRIX world = XMMatrixMultiply(XMMatrixMultiply(s, r), t);
-	XMStoreFloat4x4(&worldMatrix, world);
-	XMStoreFloat4x4(&worldInverseTranspose, XMMatrixInverse(0, XMMatrixTranspose(world)));
+	XMStoreFloat4x4(&localMatrix, world);
+
+	// The upper 3x3 of the world matrix is S * R, whose inverse transpose is just R with each row
+	// divided by its axis' scale, so the general 4x4 inverse is only needed for a zero scale
+	// (which has no inverse anyway). The bottom row is then the usual -M^-T * t, moved to the
+	// right column, like transposing the inverse of [M 0; t 1] would give.
+	if (scale.x != 0.0f && scale.y != 0.0f && scale.z != 0.0f)
+	{
+		XMMATRIX invTranspose = r;
+		invTranspose.r[0] = XMVectorScale(r.r[0], 1.0f / scale.x);
+		invTranspose.r[1] = XMVectorScale(r.r[1], 1.0f / scale.y);
+		invTranspose.r[2] = XMVectorScale(r.r[2], 1.0f / scale.z);
+		XMVECTOR translation = XMVectorNegate(XMVector3Transform(XMLoadFloat3(&position), XMMatrixTranspose(invTranspose)));
+		invTranspose.r[3] = XMVectorSet(0, 0, 0, 1);
+		XMStoreFloat4x4(&localInverseTranspose, invTranspose);
+		localInverseTranspose._14 = XMVectorGetX(translation);
+		localInverseTranspose._24 = XMVectorGetY(translation);
+		localInverseTranspose._34 = XMVectorGetZ(translation);
+	}
+	else
+	{
+		XMStoreFloat4x4(&localInverseTranspose, XMMatrixInverse(0, XMMatrixTranspose(world)));
+	}
+
+	matricesDirty = false;
+	matrixBuildCount++;
 }
 
 // Transformation methods
 void Transform::MoveAbsolute(float x, float y, float z)
 {
+	MarkDirty();
 	XMVECTOR posVec = XMVectorAdd(XMLoadFloat3(&position), XMVectorSet(x, y, z, 0.0f));
 	XMStoreFloat3(&position, posVec);
 }
 
 void Transform::MoveAbsolute(DirectX::XMFLOAT3 offset)
 {
+	MarkDirty();
 	XMVECTOR posVec = XMVectorAdd(XMLoadFloat3(&position), XMLoadFloat3(&offset));
 	XMStoreFloat3(&position, posVec);
 }
 
 void Transform::MoveRelative(float x, float y, float z)
 {
+	MarkDirty();
 	// Create the movement vector rotated by transform's current rotation Quat
-	XMVECTOR rotVec = XMVector3Rotate(XMVectorSet(x, y, z, 0.0f), 
-		XMQuaternionRotationRollPitchYaw(rotation.x, rotation.y, rotation.z));
+	XMVECTOR rotVec = XMVector3Rotate(XMVectorSet(x, y, z, 0.0f), XMLoadFloat4(&rotation));
 
 	// Add the rotated movement vector to transform's current position
 	XMStoreFloat3(&position, 
@@ -64,26 +137,34 @@ void Transform::MoveRelative(float x, float y, float z)
 
 void Transform::Rotate(float pitch, float yaw, float roll)
 {
-	XMVECTOR rotVec = XMVectorAdd(XMLoadFloat3(&this->rotation), XMVectorSet(pitch, yaw, roll, 0.0f));
-	XMStoreFloat3(&this->rotation, rotVec);
-	UpdateLocalAxes();
+	Rotate(XMFLOAT3(pitch, yaw, roll));
 }
 
 void Transform::Rotate(DirectX::XMFLOAT3 rotation)
 {
-	XMVECTOR rotVec = XMVectorAdd(XMLoadFloat3(&this->rotation), XMLoadFloat3(&rotation));
-	XMStoreFloat3(&this->rotation, rotVec);
-	UpdateLocalAxes();
+	// Angles add to angles (which is what keeps a camera's pitch and yaw apart)
+	XMFLOAT3 angles;
+	XMStoreFloat3(&angles, XMVectorAdd(XMLoadFloat3(&GetPitchYawRoll()), XMLoadFloat3(&rotation)));
+	SetRotation(angles);
+}
+
+void Transform::Rotate(DirectX::XMFLOAT4 quaternion)
+{
+	XMFLOAT4 combined;
+	XMStoreFloat4(&combined, XMQuaternionMultiply(XMLoadFloat4(&rotation), XMLoadFloat4(&quaternion)));
+	SetRotation(combined);
 }
 
 void Transform::Scale(float x, float y, float z)
 {
+	MarkDirty();
 	XMVECTOR scaleVec = XMVectorAdd(XMLoadFloat3(&scale), XMVectorSet(x, y, z, 0.0f));
 	XMStoreFloat3(&scale, scaleVec);
 }
 
 void Transform::Scale(DirectX::XMFLOAT3 scale)
 {
+	MarkDirty();
 	XMVECTOR scaleVec = XMVectorAdd(XMLoadFloat3(&this->scale), XMLoadFloat3(&scale));
 	XMStoreFloat3(&this->scale, scaleVec);
 }
@@ -96,6 +177,7 @@ void Transform::SetPosition(float x, float y, float z)
 
 void Transform::SetPosition(DirectX::XMFLOAT3 position)
 {
+	MarkDirty();
 	this->position = position;
 }
 
@@ -106,7 +188,18 @@ void Transform::SetRotation(float pitch, float yaw, float roll)
 
 void Transform::SetRotation(DirectX::XMFLOAT3 rotation)
 {
-	this->rotation = rotation;
+	MarkDirty();
+	pitchYawRoll = rotation;
+	pitchYawRollDirty = false;
+	XMStoreFloat4(&this->rotation, XMQuaternionRotationRollPitchYaw(rotation.x, rotation.y, rotation.z));
+	UpdateLocalAxes();
+}
+
+void Transform::SetRotation(DirectX::XMFLOAT4 quaternion)
+{
+	MarkDirty();
+	XMStoreFloat4(&rotation, XMQuaternionNormalize(XMLoadFloat4(&quaternion)));
+	pitchYawRollDirty = true;
 	UpdateLocalAxes();
 }
 
@@ -117,69 +210,121 @@ void Transform::SetScale(float x, float y, float z)
 
 void Transform::SetScale(DirectX::XMFLOAT3 scale)
 {
+	MarkDirty();
 	this->scale = scale;
 }
 
 // Get Position, Rotation, and Scale
-DirectX::XMFLOAT3& Transform::GetPosition()
+const DirectX::XMFLOAT3& Transform::GetPosition()
 {
 	return this->position;
 }
 
-DirectX::XMFLOAT3& Transform::GetPitchYawRoll()
+const DirectX::XMFLOAT4& Transform::GetRotation()
 {
 	return this->rotation;
 }
 
-DirectX::XMFLOAT3& Transform::GetScale()
+const DirectX::XMFLOAT3& Transform::GetPitchYawRoll()
+{
+	if (!pitchYawRollDirty)
+		return this->pitchYawRoll;
+
+	// The local axes are the rows of the rotation matrix, which is roll, then pitch, then
+	// yaw (like XMQuaternionRotationRollPitchYaw() builds it), so forward is
+	// (cos(pitch) sin(yaw), -sin(pitch), cos(pitch) cos(yaw)) and so on. Pitch comes from
+	// atan2 rather than asin, which loses most of its precision close to straight up or down.
+	float cosPitch = sqrtf(forward.x * forward.x + forward.z * forward.z);
+	pitchYawRoll.x = atan2f(-forward.y, cosPitch);
+	if (cosPitch > 0.0001f)
+	{
+		pitchYawRoll.y = atan2f(forward.x, forward.z);
+		pitchYawRoll.z = atan2f(right.y, up.y);
+	}
+	else
+	{
+		// Straight up or down, where yaw and roll turn about the same axis, so it's all yaw
+		pitchYawRoll.y = atan2f(-right.z, right.x);
+		pitchYawRoll.z = 0.0f;
+	}
+	pitchYawRollDirty = false;
+	return this->pitchYawRoll;
+}
+
+const DirectX::XMFLOAT3& Transform::GetScale()
 {
 	return this->scale;
 }
 
 // Get Local Right, Up, and Forward
-DirectX::XMFLOAT3& Transform::GetRight()
+const DirectX::XMFLOAT3& Transform::GetRight()
 {
 	return this->right;
 }
 
-DirectX::XMFLOAT3& Transform::GetUp()
+const DirectX::XMFLOAT3& Transform::GetUp()
 {
 	return this->up;
 }
 
-DirectX::XMFLOAT3& Transform::GetForward()
+const DirectX::XMFLOAT3& Transform::GetForward()
 {
 	return this->forward;
 }
 
-// Get World and Inverse Transpose Matrices
-DirectX::XMFLOAT4X4& Transform::GetWorldMatrix()
+// Get Local and World Matrices, and their Inverse Transposes
+const DirectX::XMFLOAT4X4& Transform::GetLocalMatrix()
 {
-	UpdateMatrices();
-	return worldMatrix;
+	if (matricesDirty)
+		UpdateMatrices();
+	return localMatrix;
 }
 
-DirectX::XMFLOAT4X4& Transform::GetWorldInverseTransposeMatrix()
+const DirectX::XMFLOAT4X4& Transform::GetLocalInverseTransposeMatrix()
 {
-	UpdateMatrices();
-	return worldInverseTranspose;
+	if (matricesDirty)
+		UpdateMatrices();
+	return localInverseTranspose;
 }
 
-// Update transform's local right, up and forward axes
-void Transform::UpdateLocalAxes()
+unsigned int Transform::GetLocalVersion()
+{
+	return version;
+}
+
+const DirectX::XMFLOAT4X4& Transform::GetWorldMatrix()
+{
+	return hierarchy ? hierarchy->GetWorldMatrix(hierarchyIndex) : GetLocalMatrix();
+}
+
+const DirectX::XMFLOAT4X4& Transform::GetWorldInverseTransposeMatrix()
+{
+	return hierarchy ? hierarchy->GetWorldInverseTransposeMatrix(hierarchyIndex) : GetLocalInverseTransposeMatrix();
+}
+
+unsigned int Transform::GetVersion()
 {
-	// Create the rotation quat
-	XMVECTOR rotQuat = XMQuaternionRotationRollPitchYaw(rotation.x, rotation.y, rotation.z);
-	
-	// Rotate local right
-	XMStoreFloat3(&right, XMVector3Rotate(XMLoadFloat3(&WorldRight),
-		rotQuat));
+	return hierarchy ? hierarchy->GetWorldVersion(hierarchyIndex) : version;
+}
 
-	// Rotate local up
-	XMStoreFloat3(&up, XMVector3Rotate(XMLoadFloat3(&WorldUp),
-		rotQuat));
+Transform* Transform::GetParent()
+{
+	return hierarchy ? hierarchy->GetParent(this) : 0;
+}
 
-	// Rotate local forward
-	XMStoreFloat3(&forward, XMVector3Rotate(XMLoadFloat3(&WorldForward),
-		rotQuat));
+unsigned int Transform::TakeMatrixBuildCount()
+{
+	unsigned int count = matrixBuildCount;
+	matrixBuildCount = 0;
+	return count;
+}
+
+// Update transform's local right, up and forward axes
+void Transform::UpdateLocalAxes()
+{
+	// They're the rows of the rotation matrix
+	XMMATRIX r = XMMatrixRotationQuaternion(XMLoadFloat4(&rotation));
+	XMStoreFloat3(&right, r.r[0]);
+	XMStoreFloat3(&up, r.r[1]);
+	XMStoreFloat3(&forward, r.r[2]);
 }
\ No newline at end of file
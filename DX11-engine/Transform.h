@@ -2,20 +2,45 @@
 
 #include <DirectXMath.h>
 
+class TransformHierarchy;
+
 class Transform
 {
 private:
 
-	DirectX::XMFLOAT4X4 worldMatrix;
-	DirectX::XMFLOAT4X4 worldInverseTranspose;
+	// Just this transform's own scale, rotation and position. The world matrices
+	// are the same unless this has a parent (see TransformHierarchy).
+	DirectX::XMFLOAT4X4 localMatrix;
+	DirectX::XMFLOAT4X4 localInverseTranspose;
 	DirectX::XMFLOAT3 position;
 	DirectX::XMFLOAT3 scale;
-	DirectX::XMFLOAT3 rotation;
+
+	// The rotation is kept as a quaternion. Pitch, yaw and roll are only worked out from it
+	// when they're asked for, and kept as they were when it was set from them.
+	DirectX::XMFLOAT4 rotation;
+	DirectX::XMFLOAT3 pitchYawRoll;
+	bool pitchYawRollDirty;
 
 	DirectX::XMFLOAT3 right;
 	DirectX::XMFLOAT3 up;
 	DirectX::XMFLOAT3 forward;
 
+	// The matrices are only rebuilt when they're asked for after something changed
+	bool matricesDirty;
+
+	// Goes up every time the position, rotation or scale changes, so anything
+	// made from them (like world space bounds) knows when to update
+	unsigned int version;
+
+	// Set while this is part of a hierarchy, which holds its world matrices at this index
+	TransformHierarchy* hierarchy;
+	unsigned int hierarchyIndex;
+	friend class TransformHierarchy;
+
+	// Matrix builds since TakeMatrixBuildCount() was last called, across every transform
+	static unsigned int matrixBuildCount;
+
+	void MarkDirty();
 	void UpdateMatrices();
 	void UpdateLocalAxes();
 
@@ -27,12 +52,19 @@ public:
 
 	Transform();
 
+	// Copies are never part of the original's hierarchy (which knows transforms by address),
+	// and assigning to a transform in a hierarchy leaves it where it is in there
+	Transform(const Transform& other);
+	Transform& operator=(const Transform& other);
+	~Transform();
+
 	// Transformation methods
 	void MoveAbsolute(float x, float y, float z);
 	void MoveAbsolute(DirectX::XMFLOAT3 offset);
 	void MoveRelative(float x, float y, float z);
 	void Rotate(float pitch, float yaw, float roll);
 	void Rotate(DirectX::XMFLOAT3 rotation);
+	void Rotate(DirectX::XMFLOAT4 quaternion);	// Applied after the current rotation
 	void Scale(float x, float y, float z);
 	void Scale(DirectX::XMFLOAT3 scale);
 
@@ -41,18 +73,34 @@ public:
 	void SetPosition(DirectX::XMFLOAT3 position);
 	void SetRotation(float pitch, float yaw, float roll);
 	void SetRotation(DirectX::XMFLOAT3 rotation);
+	void SetRotation(DirectX::XMFLOAT4 quaternion);
 	void SetScale(float x, float y, float z);
 	void SetScale(DirectX::XMFLOAT3 scale);
 
-	// Getters
-	DirectX::XMFLOAT3& GetPosition();
-	DirectX::XMFLOAT3& GetPitchYawRoll();
-	DirectX::XMFLOAT3& GetScale();
+	// Getters (read only, so every change goes through the methods above and is noticed)
+	const DirectX::XMFLOAT3& GetPosition();
+	const DirectX::XMFLOAT4& GetRotation();
+	const DirectX::XMFLOAT3& GetPitchYawRoll();	// For editing, the rotation itself is GetRotation()
+	const DirectX::XMFLOAT3& GetScale();
+
+	const DirectX::XMFLOAT3& GetRight();
+	const DirectX::XMFLOAT3& GetUp();
+	const DirectX::XMFLOAT3& GetForward();
+
+	const DirectX::XMFLOAT4X4& GetLocalMatrix();
+	const DirectX::XMFLOAT4X4& GetLocalInverseTransposeMatrix();
+	unsigned int GetLocalVersion();
+
+	// With every parent applied. Changes to parents only show up here once the
+	// hierarchy has been updated (see TransformHierarchy::Update()), and so does
+	// the version, which goes up whenever the world matrix changes.
+	const DirectX::XMFLOAT4X4& GetWorldMatrix();
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix();
+	unsigned int GetVersion();
 
-	DirectX::XMFLOAT3& GetRight();
-	DirectX::XMFLOAT3& GetUp();
-	DirectX::XMFLOAT3& GetForward();
+	// Null for transforms that aren't in a hierarchy, or are at the top of one
+	Transform* GetParent();
 
-	DirectX::XMFLOAT4X4& GetWorldMatrix();
-	DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix();
+	// For the stats window: how many matrices were built since the last call
+	static unsigned int TakeMatrixBuildCount();
 };
\ No newline at end of file
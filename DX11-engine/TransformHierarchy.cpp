@@ -0,0 +1,327 @@
+#include "TransformHierarchy.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+TransformHierarchy::TransformHierarchy()
+{
+	this->sorted = true;
+	this->maxDepth = 0;
+	this->lastRecomputed = 0;
+	this->reorders = 0;
+}
+
+TransformHierarchy::~TransformHierarchy()
+{
+	for (Transform* transform : transforms)
+		if (transform)
+			transform->hierarchy = 0;
+}
+
+void TransformHierarchy::Add(Transform* transform, Transform* parent)
+{
+	if (transform->hierarchy == this)
+	{
+		SetParent(transform, parent);
+		return;
+	}
+	if (transform->hierarchy)
+		transform->hierarchy->Remove(transform);
+	if (parent && parent->hierarchy != this)
+		Add(parent);
+
+	unsigned int parentIndex = parent ? parent->hierarchyIndex : TRANSFORM_NO_PARENT;
+	unsigned int depth = parent ? depths[parentIndex] + 1 : 0;
+
+	// Appending keeps parents in front of children, but not necessarily the depth order
+	if (!depths.empty() && depth < depths.back())
+		sorted = false;
+	maxDepth = (std::max)(maxDepth, depth);
+
+	// Composed right away, so the world matrix is already usable before the next update
+	XMMATRIX world = XMLoadFloat4x4(&transform->GetLocalMatrix());
+	XMMATRIX worldInvTrans = XMLoadFloat4x4(&transform->GetLocalInverseTransposeMatrix());
+	if (parent)
+	{
+		world = XMMatrixMultiply(world, XMLoadFloat4x4(&worldMatrices[parentIndex]));
+		worldInvTrans = XMMatrixMultiply(worldInvTrans, XMLoadFloat4x4(&worldInverseTransposes[parentIndex]));
+	}
+
+	XMFLOAT4X4 worldMatrix, worldInverseTranspose;
+	XMStoreFloat4x4(&worldMatrix, world);
+	XMStoreFloat4x4(&worldInverseTranspose, worldInvTrans);
+
+	transform->hierarchy = this;
+	transform->hierarchyIndex = (unsigned int)transforms.size();
+	transforms.push_back(transform);
+	parents.push_back(parentIndex);
+	depths.push_back(depth);
+	localVersions.push_back(transform->GetLocalVersion());
+	worldVersions.push_back(transform->GetLocalVersion() + 1);	// Ahead of anything cached from the local version
+	dirty.push_back(0);
+	recomputed.push_back(0);
+	worldMatrices.push_back(worldMatrix);
+	worldInverseTransposes.push_back(worldInverseTranspose);
+}
+
+void TransformHierarchy::Remove(Transform* transform)
+{
+	if (transform->hierarchy != this)
+		return;
+	unsigned int index = transform->hierarchyIndex;
+
+	// Children keep their local transforms but now hang from the grandparent
+	for (unsigned int i = 0; i < transforms.size(); i++)
+	{
+		if (parents[i] != index)
+			continue;
+		parents[i] = parents[index];
+		dirty[i] = 1;
+	}
+
+	// Left as a gap until the next sort, so every other index stays valid
+	transforms[index] = 0;
+	transform->hierarchy = 0;
+	sorted = false;
+}
+
+bool TransformHierarchy::SetParent(Transform* transform, Transform* parent)
+{
+	if (parent == transform || (parent && parent->hierarchy && parent->hierarchy != this))
+		return false;
+	if (transform->hierarchy != this)
+	{
+		Add(transform, parent);
+		return true;
+	}
+	if (parent && parent->hierarchy != this)
+		Add(parent);
+
+	// Walking up from the new parent must never reach the transform itself
+	unsigned int index = transform->hierarchyIndex;
+	unsigned int parentIndex = parent ? parent->hierarchyIndex : TRANSFORM_NO_PARENT;
+	for (unsigned int ancestor = parentIndex; ancestor != TRANSFORM_NO_PARENT; ancestor = parents[ancestor])
+		if (ancestor == index)
+			return false;
+
+	if (parents[index] == parentIndex)
+		return true;
+	parents[index] = parentIndex;
+	dirty[index] = 1;
+	sorted = false;
+	return true;
+}
+
+Transform* TransformHierarchy::GetParent(Transform* transform)
+{
+	if (transform->hierarchy != this)
+		return 0;
+	unsigned int parentIndex = parents[transform->hierarchyIndex];
+	return parentIndex == TRANSFORM_NO_PARENT ? 0 : transforms[parentIndex];
+}
+
+void TransformHierarchy::Update()
+{
+	if (!sorted)
+		Sort();
+
+	// Parents always come first, so by the time a node is reached its parent's world matrix
+	// is final, and whether it was rebuilt this time says whether this one has to be too
+	lastRecomputed = 0;
+	unsigned int count = (unsigned int)transforms.size();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		Transform* transform = transforms[i];
+		unsigned int parent = parents[i];
+		unsigned int localVersion = transform->GetLocalVersion();
+
+		bool changed = dirty[i] || localVersion != localVersions[i] || (parent != TRANSFORM_NO_PARENT && recomputed[parent]);
+		recomputed[i] = changed;
+		if (!changed)
+			continue;
+
+		XMMATRIX world = XMLoadFloat4x4(&transform->GetLocalMatrix());
+		XMMATRIX worldInvTrans = XMLoadFloat4x4(&transform->GetLocalInverseTransposeMatrix());
+		if (parent != TRANSFORM_NO_PARENT)
+		{
+			world = XMMatrixMultiply(world, XMLoadFloat4x4(&worldMatrices[parent]));
+			worldInvTrans = XMMatrixMultiply(worldInvTrans, XMLoadFloat4x4(&worldInverseTransposes[parent]));
+		}
+		XMStoreFloat4x4(&worldMatrices[i], world);
+		XMStoreFloat4x4(&worldInverseTransposes[i], worldInvTrans);
+
+		localVersions[i] = localVersion;
+		dirty[i] = 0;
+		worldVersions[i]++;
+		lastRecomputed++;
+	}
+}
+
+const XMFLOAT4X4& TransformHierarchy::GetWorldMatrix(unsigned int index)
+{
+	return worldMatrices[index];
+}
+
+const XMFLOAT4X4& TransformHierarchy::GetWorldInverseTransposeMatrix(unsigned int index)
+{
+	return worldInverseTransposes[index];
+}
+
+unsigned int TransformHierarchy::GetWorldVersion(unsigned int index)
+{
+	return worldVersions[index];
+}
+
+TransformHierarchyStats TransformHierarchy::GetStats()
+{
+	TransformHierarchyStats stats = {};
+	for (Transform* transform : transforms)
+		if (transform)
+			stats.Nodes++;
+	stats.Depth = maxDepth;
+	stats.Recomputed = lastRecomputed;
+	stats.Reorders = reorders;
+	return stats;
+}
+
+void TransformHierarchy::Sort()
+{
+	// Moving a node changes the depth of everything under it, so every depth is found again
+	unsigned int count = (unsigned int)transforms.size();
+	std::fill(depths.begin(), depths.end(), TRANSFORM_NO_PARENT);
+	std::vector<unsigned int> order;
+	order.reserve(count);
+	maxDepth = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (!transforms[i])
+			continue;
+		order.push_back(i);
+		maxDepth = (std::max)(maxDepth, DepthOf(i));
+	}
+
+	// Stable, so siblings stay in the order they were added
+	std::stable_sort(order.begin(), order.end(),
+		[&](unsigned int a, unsigned int b) { return depths[a] < depths[b]; });
+
+	std::vector<unsigned int> newIndex(count, TRANSFORM_NO_PARENT);
+	for (unsigned int i = 0; i < order.size(); i++)
+		newIndex[order[i]] = i;
+
+	auto reorder = [&](auto& values)
+	{
+		auto old = values;
+		values.resize(order.size());
+		for (size_t i = 0; i < order.size(); i++)
+			values[i] = old[order[i]];
+	};
+	reorder(transforms);
+	reorder(parents);
+	reorder(depths);
+	reorder(localVersions);
+	reorder(worldVersions);
+	reorder(dirty);
+	reorder(recomputed);
+	reorder(worldMatrices);
+	reorder(worldInverseTransposes);
+
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		transforms[i]->hierarchyIndex = i;
+		if (parents[i] != TRANSFORM_NO_PARENT)
+			parents[i] = newIndex[parents[i]];
+	}
+
+	sorted = true;
+	reorders++;
+}
+
+unsigned int TransformHierarchy::DepthOf(unsigned int index)
+{
+	// Up to the first ancestor whose depth is already known (or the top)...
+	unsigned int top = index;
+	unsigned int steps = 0;
+	while (depths[top] == TRANSFORM_NO_PARENT && parents[top] != TRANSFORM_NO_PARENT)
+	{
+		top = parents[top];
+		steps++;
+	}
+	unsigned int depth = depths[top] == TRANSFORM_NO_PARENT ? 0 : depths[top];
+	depths[top] = depth;
+
+	// ...then back down, filling in the depths on the way
+	for (unsigned int node = index; node != top; node = parents[node])
+		depths[node] = depth + steps--;
+	return depths[index];
+}
+
+TransformHierarchyBenchmark TransformHierarchy::Benchmark(unsigned int nodeCount)
+{
+	TransformHierarchyBenchmark result = {};
+	if (nodeCount == 0)
+		return result;
+
+	// Declared first so they outlive the hierarchy
+	std::vector<Transform> nodes(nodeCount);
+	TransformHierarchy hierarchy;
+
+	// Random transforms kept close to identity, so errors can't grow with depth for other reasons
+	std::mt19937 random(17);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (unsigned int i = 0; i < nodeCount; i++)
+	{
+		nodes[i].SetPosition(unit(random), unit(random), unit(random));
+		nodes[i].SetRotation(unit(random) * XM_PI, unit(random) * XM_PI, unit(random) * XM_PI);
+		nodes[i].SetScale(1.0f + unit(random) * 0.1f, 1.0f + unit(random) * 0.1f, 1.0f + unit(random) * 0.1f);
+
+		// A few roots, everything else under an earlier node
+		bool root = i == 0 || random() % 64 == 0;
+		hierarchy.Add(&nodes[i], root ? 0 : &nodes[random() % i]);
+	}
+
+	// Then some moves, so the arrays really have to be sorted again
+	for (unsigned int i = 0; i < nodeCount / 100; i++)
+		hierarchy.SetParent(&nodes[random() % nodeCount], &nodes[random() % nodeCount]);
+
+	// Everything, including that sort
+	for (Transform& node : nodes)
+		node.MoveAbsolute(0, 0, 0);
+	auto fullStart = std::chrono::high_resolution_clock::now();
+	hierarchy.Update();
+	result.FullUpdateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - fullStart).count();
+
+	// Only the subtrees under a few moved nodes
+	for (unsigned int i = 0; i < 10; i++)
+		nodes[random() % nodeCount].MoveAbsolute(0.01f, 0, 0);
+	auto partialStart = std::chrono::high_resolution_clock::now();
+	hierarchy.Update();
+	result.PartialUpdateMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - partialStart).count();
+	result.PartialRecomputed = hierarchy.lastRecomputed;
+
+	// The reference: every node composed with each of its parents in turn
+	std::vector<XMFLOAT4X4> recursive(nodeCount);
+	auto recursiveStart = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < nodeCount; i++)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&nodes[i].GetLocalMatrix());
+		for (Transform* parent = nodes[i].GetParent(); parent; parent = parent->GetParent())
+			world = XMMatrixMultiply(world, XMLoadFloat4x4(&parent->GetLocalMatrix()));
+		XMStoreFloat4x4(&recursive[i], world);
+	}
+	result.RecursiveMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recursiveStart).count();
+
+	for (unsigned int i = 0; i < nodeCount; i++)
+	{
+		const XMFLOAT4X4& world = nodes[i].GetWorldMatrix();
+		for (int row = 0; row < 4; row++)
+			for (int column = 0; column < 4; column++)
+				result.MaxError = (std::max)(result.MaxError, fabsf(world.m[row][column] - recursive[i].m[row][column]));
+	}
+
+	result.Nodes = nodeCount;
+	result.Depth = hierarchy.maxDepth;
+	return result;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+#include "Transform.h"
+
+// The parent index of nodes at the top of the hierarchy
+#define TRANSFORM_NO_PARENT 0xFFFFFFFF
+
+// How much the last Update() had to do, for the stats window
+struct TransformHierarchyStats
+{
+	unsigned int Nodes;
+	unsigned int Depth;			// Levels below the top, 0 if nothing has a parent
+	unsigned int Recomputed;	// World matrices rebuilt by the last update
+	unsigned int Reorders;		// Times the arrays were sorted again after the structure changed
+};
+
+// Update() against composing each node's parents one by one, on a generated hierarchy
+struct TransformHierarchyBenchmark
+{
+	unsigned int Nodes;
+	unsigned int Depth;
+	double FullUpdateMs;		// Every node dirty
+	double PartialUpdateMs;		// A few subtrees dirty
+	unsigned int PartialRecomputed;
+	double RecursiveMs;			// Walking up the parents of every node
+	float MaxError;				// Largest difference from the recursive result, in any matrix element
+};
+
+// --------------------------------------------------------
+// Parent/child relationships between transforms, with
+// world matrices stored in flat arrays instead of a tree
+//
+// - Nodes are sorted by depth, so every parent comes before
+//   its children and one pass from the front propagates
+//   world matrices all the way down
+// - The pass skips any node whose own transform hasn't
+//   changed (see Transform::GetLocalVersion()) unless its
+//   parent was just recomputed, so only dirty subtrees cost
+//   anything beyond a version check
+// - Inverse transposes are propagated the same way, since
+//   the inverse transpose of a product is the product of
+//   the inverse transposes
+// - Changing the structure just marks the arrays unsorted,
+//   they're sorted again once, on the next update
+// - Transforms leave the hierarchy when they're destroyed,
+//   and their children move up to their parent
+// --------------------------------------------------------
+class TransformHierarchy
+{
+public:
+
+	TransformHierarchy();
+
+	// Lets go of every transform (they keep their local matrices)
+	~TransformHierarchy();
+
+	// Transforms can't be shared between hierarchies or copied between them
+	TransformHierarchy(const TransformHierarchy& other) = delete;
+	TransformHierarchy& operator=(const TransformHierarchy& other) = delete;
+
+	// Adds a transform, at the top or under a parent (which is added first if it isn't in yet)
+	void Add(Transform* transform, Transform* parent = 0);
+	void Remove(Transform* transform);
+
+	// Moves a transform (and everything under it) to a new parent, or to the top for null. Returns
+	// false if that would make it its own ancestor, or the parent is in another hierarchy.
+	bool SetParent(Transform* transform, Transform* parent);
+	Transform* GetParent(Transform* transform);
+
+	// Brings every world matrix up to date, parents first
+	void Update();
+
+	const DirectX::XMFLOAT4X4& GetWorldMatrix(unsigned int index);
+	const DirectX::XMFLOAT4X4& GetWorldInverseTransposeMatrix(unsigned int index);
+	unsigned int GetWorldVersion(unsigned int index);
+	TransformHierarchyStats GetStats();
+
+	// Builds a random hierarchy of the given size and times updating it, checking
+	// every world matrix against composing the parents one by one
+	static TransformHierarchyBenchmark Benchmark(unsigned int nodeCount);
+
+private:
+
+	// Indexed the same way, in depth order (as of the last sort)
+	std::vector<Transform*> transforms;
+	std::vector<unsigned int> parents;
+	std::vector<unsigned int> depths;
+	std::vector<unsigned int> localVersions;	// Each transform's local version when last propagated
+	std::vector<unsigned int> worldVersions;
+	std::vector<unsigned char> dirty;			// Recompute on the next update regardless of versions
+	std::vector<unsigned char> recomputed;		// Rebuilt during this update, so children must be too
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposes;
+
+	bool sorted;
+	unsigned int maxDepth;
+	unsigned int lastRecomputed;
+	unsigned int reorders;
+
+	void Sort();
+	unsigned int DepthOf(unsigned int index);
+};
@@ -0,0 +1,433 @@
+#include "TransformSystem.h"
+#include <immintrin.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TRANSFORM_SYSTEM_AVX2	// MSVC takes AVX intrinsics anywhere, it's only called when the CPU has them
+#else
+#define TRANSFORM_SYSTEM_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+using namespace DirectX;
+
+TransformSystem::TransformSystem()
+{
+	this->count = 0;
+	this->UseAvx2 = HasAvx2();
+}
+
+unsigned int TransformSystem::Add(XMFLOAT3 position, XMFLOAT4 rotation, XMFLOAT3 scale)
+{
+	// A whole batch of identity transforms at a time, so every batch is full
+	if (count == positionX.size())
+	{
+		size_t size = count + TRANSFORM_SYSTEM_BATCH;
+		positionX.resize(size, 0.0f);
+		positionY.resize(size, 0.0f);
+		positionZ.resize(size, 0.0f);
+		rotationX.resize(size, 0.0f);
+		rotationY.resize(size, 0.0f);
+		rotationZ.resize(size, 0.0f);
+		rotationW.resize(size, 1.0f);
+		scaleX.resize(size, 1.0f);
+		scaleY.resize(size, 1.0f);
+		scaleZ.resize(size, 1.0f);
+
+		XMFLOAT4X4 identity;
+		XMStoreFloat4x4(&identity, XMMatrixIdentity());
+		worldMatrices.resize(size, identity);
+		worldInverseTransposes.resize(size, identity);
+	}
+
+	unsigned int index = count++;
+	SetPosition(index, position);
+	SetRotation(index, rotation);
+	SetScale(index, scale);
+	return index;
+}
+
+unsigned int TransformSystem::GetCount()
+{
+	return count;
+}
+
+void TransformSystem::SetPosition(unsigned int index, XMFLOAT3 position)
+{
+	positionX[index] = position.x;
+	positionY[index] = position.y;
+	positionZ[index] = position.z;
+}
+
+void TransformSystem::SetRotation(unsigned int index, XMFLOAT4 rotation)
+{
+	// The matrices are only right for unit quaternions
+	XMFLOAT4 normalized;
+	XMStoreFloat4(&normalized, XMQuaternionNormalize(XMLoadFloat4(&rotation)));
+	rotationX[index] = normalized.x;
+	rotationY[index] = normalized.y;
+	rotationZ[index] = normalized.z;
+	rotationW[index] = normalized.w;
+}
+
+void TransformSystem::SetRotation(unsigned int index, float pitch, float yaw, float roll)
+{
+	XMFLOAT4 rotation;
+	XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(pitch, yaw, roll));
+	SetRotation(index, rotation);
+}
+
+void TransformSystem::SetScale(unsigned int index, XMFLOAT3 scale)
+{
+	scaleX[index] = scale.x;
+	scaleY[index] = scale.y;
+	scaleZ[index] = scale.z;
+}
+
+XMFLOAT3 TransformSystem::GetPosition(unsigned int index)
+{
+	return XMFLOAT3(positionX[index], positionY[index], positionZ[index]);
+}
+
+XMFLOAT4 TransformSystem::GetRotation(unsigned int index)
+{
+	return XMFLOAT4(rotationX[index], rotationY[index], rotationZ[index], rotationW[index]);
+}
+
+XMFLOAT3 TransformSystem::GetScale(unsigned int index)
+{
+	return XMFLOAT3(scaleX[index], scaleY[index], scaleZ[index]);
+}
+
+void TransformSystem::Update()
+{
+	// Padding makes the last batch full, so there's never a remainder to handle
+	unsigned int end = (unsigned int)positionX.size();
+	if (UseAvx2 && HasAvx2())
+		ComposeAvx2(0, end);
+	else
+		ComposeSse(0, end);
+}
+
+const XMFLOAT4X4* TransformSystem::GetWorldMatrices()
+{
+	return count > 0 ? &worldMatrices[0] : 0;
+}
+
+const XMFLOAT4X4* TransformSystem::GetWorldInverseTransposeMatrices()
+{
+	return count > 0 ? &worldInverseTransposes[0] : 0;
+}
+
+bool TransformSystem::HasAvx2()
+{
+	static const bool avx2 = []()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		// AVX and FMA, and an OS that saves the upper halves of the registers
+		__cpuid(info, 1);
+		bool osSaves = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		bool fma = (info[2] & (1 << 12)) != 0;
+		if (!osSaves || !avx || !fma || (_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}();
+	return avx2;
+}
+
+// --------------------------------------------------------
+// Both compose paths work out the same thing for a batch:
+//
+//   world = scale * rotation * translation, so each of the
+//   first three rows is a rotation matrix row times that
+//   axis' scale, and the last row is the position
+//
+//   inverse transpose = each rotation row divided by its
+//   scale instead, with -(row . position) / scale in the
+//   right column (see Transform::UpdateMatrices())
+//
+// Each value is computed for the whole batch at once, one
+// transform per lane, then the lanes are transposed back
+// into one matrix per transform for storing.
+// --------------------------------------------------------
+
+// Turns eight rows of eight values into eight columns, in place
+TRANSFORM_SYSTEM_AVX2 static inline void Transpose8(__m256* rows)
+{
+	__m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+	__m256 t1 = _mm256_unpackhi_ps(rows[0], rows[1]);
+	__m256 t2 = _mm256_unpacklo_ps(rows[2], rows[3]);
+	__m256 t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+	__m256 t4 = _mm256_unpacklo_ps(rows[4], rows[5]);
+	__m256 t5 = _mm256_unpackhi_ps(rows[4], rows[5]);
+	__m256 t6 = _mm256_unpacklo_ps(rows[6], rows[7]);
+	__m256 t7 = _mm256_unpackhi_ps(rows[6], rows[7]);
+
+	__m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	__m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	__m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+	rows[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+	rows[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+	rows[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+	rows[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+	rows[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+	rows[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+	rows[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+	rows[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+// Sixteen values per transform, as laid out in an XMFLOAT4X4, eight transforms at a time
+TRANSFORM_SYSTEM_AVX2 static inline void StoreMatrices8(__m256* elements, XMFLOAT4X4* out)
+{
+	// The first two rows of every matrix, then the last two
+	for (int half = 0; half < 2; half++)
+	{
+		Transpose8(elements + half * 8);
+		for (int i = 0; i < 8; i++)
+			_mm256_storeu_ps(&out[i].m[half * 2][0], elements[half * 8 + i]);
+	}
+}
+
+TRANSFORM_SYSTEM_AVX2 void TransformSystem::ComposeAvx2(unsigned int first, unsigned int end)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	for (unsigned int i = first; i < end; i += 8)
+	{
+		__m256 px = _mm256_loadu_ps(&positionX[i]);
+		__m256 py = _mm256_loadu_ps(&positionY[i]);
+		__m256 pz = _mm256_loadu_ps(&positionZ[i]);
+		__m256 qx = _mm256_loadu_ps(&rotationX[i]);
+		__m256 qy = _mm256_loadu_ps(&rotationY[i]);
+		__m256 qz = _mm256_loadu_ps(&rotationZ[i]);
+		__m256 qw = _mm256_loadu_ps(&rotationW[i]);
+		__m256 sx = _mm256_loadu_ps(&scaleX[i]);
+		__m256 sy = _mm256_loadu_ps(&scaleY[i]);
+		__m256 sz = _mm256_loadu_ps(&scaleZ[i]);
+
+		// The quaternion's products, doubled
+		__m256 x2 = _mm256_add_ps(qx, qx);
+		__m256 y2 = _mm256_add_ps(qy, qy);
+		__m256 z2 = _mm256_add_ps(qz, qz);
+		__m256 xx = _mm256_mul_ps(qx, x2);
+		__m256 yy = _mm256_mul_ps(qy, y2);
+		__m256 zz = _mm256_mul_ps(qz, z2);
+		__m256 xy = _mm256_mul_ps(qx, y2);
+		__m256 xz = _mm256_mul_ps(qx, z2);
+		__m256 yz = _mm256_mul_ps(qy, z2);
+		__m256 wx = _mm256_mul_ps(qw, x2);
+		__m256 wy = _mm256_mul_ps(qw, y2);
+		__m256 wz = _mm256_mul_ps(qw, z2);
+
+		// Rotation rows, as XMMatrixRotationQuaternion() lays them out
+		__m256 r00 = _mm256_sub_ps(one, _mm256_add_ps(yy, zz));
+		__m256 r01 = _mm256_add_ps(xy, wz);
+		__m256 r02 = _mm256_sub_ps(xz, wy);
+		__m256 r10 = _mm256_sub_ps(xy, wz);
+		__m256 r11 = _mm256_sub_ps(one, _mm256_add_ps(xx, zz));
+		__m256 r12 = _mm256_add_ps(yz, wx);
+		__m256 r20 = _mm256_add_ps(xz, wy);
+		__m256 r21 = _mm256_sub_ps(yz, wx);
+		__m256 r22 = _mm256_sub_ps(one, _mm256_add_ps(xx, yy));
+
+		__m256 world[16] =
+		{
+			_mm256_mul_ps(r00, sx), _mm256_mul_ps(r01, sx), _mm256_mul_ps(r02, sx), zero,
+			_mm256_mul_ps(r10, sy), _mm256_mul_ps(r11, sy), _mm256_mul_ps(r12, sy), zero,
+			_mm256_mul_ps(r20, sz), _mm256_mul_ps(r21, sz), _mm256_mul_ps(r22, sz), zero,
+			px, py, pz, one
+		};
+
+		__m256 ix = _mm256_div_ps(one, sx);
+		__m256 iy = _mm256_div_ps(one, sy);
+		__m256 iz = _mm256_div_ps(one, sz);
+		__m256 d0 = _mm256_fmadd_ps(r02, pz, _mm256_fmadd_ps(r01, py, _mm256_mul_ps(r00, px)));
+		__m256 d1 = _mm256_fmadd_ps(r12, pz, _mm256_fmadd_ps(r11, py, _mm256_mul_ps(r10, px)));
+		__m256 d2 = _mm256_fmadd_ps(r22, pz, _mm256_fmadd_ps(r21, py, _mm256_mul_ps(r20, px)));
+
+		__m256 inverseTranspose[16] =
+		{
+			_mm256_mul_ps(r00, ix), _mm256_mul_ps(r01, ix), _mm256_mul_ps(r02, ix), _mm256_sub_ps(zero, _mm256_mul_ps(d0, ix)),
+			_mm256_mul_ps(r10, iy), _mm256_mul_ps(r11, iy), _mm256_mul_ps(r12, iy), _mm256_sub_ps(zero, _mm256_mul_ps(d1, iy)),
+			_mm256_mul_ps(r20, iz), _mm256_mul_ps(r21, iz), _mm256_mul_ps(r22, iz), _mm256_sub_ps(zero, _mm256_mul_ps(d2, iz)),
+			zero, zero, zero, one
+		};
+
+		StoreMatrices8(world, &worldMatrices[i]);
+		StoreMatrices8(inverseTranspose, &worldInverseTransposes[i]);
+
+		// Zero scales have no inverse, so those few get the general (equally meaningless) one
+		__m256 singular = _mm256_or_ps(_mm256_or_ps(
+			_mm256_cmp_ps(sx, zero, _CMP_EQ_OQ), _mm256_cmp_ps(sy, zero, _CMP_EQ_OQ)), _mm256_cmp_ps(sz, zero, _CMP_EQ_OQ));
+		int singularLanes = _mm256_movemask_ps(singular);
+		if (singularLanes)
+			for (unsigned int lane = 0; lane < 8; lane++)
+				if (singularLanes & (1 << lane))
+					ComposeSingular(i + lane);
+	}
+}
+
+// Four values of one row for four transforms, transposed into that row of each transform's matrix
+static inline void StoreRows4(XMVECTOR a, XMVECTOR b, XMVECTOR c, XMVECTOR d, XMFLOAT4X4* out, int row)
+{
+	XMMATRIX rows = XMMatrixTranspose(XMMATRIX(a, b, c, d));
+	for (int i = 0; i < 4; i++)
+		XMStoreFloat4((XMFLOAT4*)&out[i].m[row][0], rows.r[i]);
+}
+
+void TransformSystem::ComposeSse(unsigned int first, unsigned int end)
+{
+	// DirectXMath's vectors are SSE registers, so this is the same math four transforms at a time
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR one = XMVectorReplicate(1.0f);
+
+	for (unsigned int i = first; i < end; i += 4)
+	{
+		XMVECTOR px = XMLoadFloat4((XMFLOAT4*)&positionX[i]);
+		XMVECTOR py = XMLoadFloat4((XMFLOAT4*)&positionY[i]);
+		XMVECTOR pz = XMLoadFloat4((XMFLOAT4*)&positionZ[i]);
+		XMVECTOR qx = XMLoadFloat4((XMFLOAT4*)&rotationX[i]);
+		XMVECTOR qy = XMLoadFloat4((XMFLOAT4*)&rotationY[i]);
+		XMVECTOR qz = XMLoadFloat4((XMFLOAT4*)&rotationZ[i]);
+		XMVECTOR qw = XMLoadFloat4((XMFLOAT4*)&rotationW[i]);
+		XMVECTOR sx = XMLoadFloat4((XMFLOAT4*)&scaleX[i]);
+		XMVECTOR sy = XMLoadFloat4((XMFLOAT4*)&scaleY[i]);
+		XMVECTOR sz = XMLoadFloat4((XMFLOAT4*)&scaleZ[i]);
+
+		XMVECTOR x2 = qx + qx;
+		XMVECTOR y2 = qy + qy;
+		XMVECTOR z2 = qz + qz;
+		XMVECTOR xx = qx * x2, yy = qy * y2, zz = qz * z2;
+		XMVECTOR xy = qx * y2, xz = qx * z2, yz = qy * z2;
+		XMVECTOR wx = qw * x2, wy = qw * y2, wz = qw * z2;
+
+		XMVECTOR r00 = one - (yy + zz), r01 = xy + wz, r02 = xz - wy;
+		XMVECTOR r10 = xy - wz, r11 = one - (xx + zz), r12 = yz + wx;
+		XMVECTOR r20 = xz + wy, r21 = yz - wx, r22 = one - (xx + yy);
+
+		XMFLOAT4X4* world = &worldMatrices[i];
+		StoreRows4(r00 * sx, r01 * sx, r02 * sx, zero, world, 0);
+		StoreRows4(r10 * sy, r11 * sy, r12 * sy, zero, world, 1);
+		StoreRows4(r20 * sz, r21 * sz, r22 * sz, zero, world, 2);
+		StoreRows4(px, py, pz, one, world, 3);
+
+		XMVECTOR ix = XMVectorReciprocal(sx);
+		XMVECTOR iy = XMVectorReciprocal(sy);
+		XMVECTOR iz = XMVectorReciprocal(sz);
+		XMVECTOR d0 = r00 * px + r01 * py + r02 * pz;
+		XMVECTOR d1 = r10 * px + r11 * py + r12 * pz;
+		XMVECTOR d2 = r20 * px + r21 * py + r22 * pz;
+
+		XMFLOAT4X4* inverseTranspose = &worldInverseTransposes[i];
+		StoreRows4(r00 * ix, r01 * ix, r02 * ix, zero - d0 * ix, inverseTranspose, 0);
+		StoreRows4(r10 * iy, r11 * iy, r12 * iy, zero - d1 * iy, inverseTranspose, 1);
+		StoreRows4(r20 * iz, r21 * iz, r22 * iz, zero - d2 * iz, inverseTranspose, 2);
+		StoreRows4(zero, zero, zero, one, inverseTranspose, 3);
+
+		for (unsigned int lane = i; lane < i + 4; lane++)
+			if (scaleX[lane] == 0.0f || scaleY[lane] == 0.0f || scaleZ[lane] == 0.0f)
+				ComposeSingular(lane);
+	}
+}
+
+void TransformSystem::ComposeSingular(unsigned int index)
+{
+	XMMATRIX world = XMLoadFloat4x4(&worldMatrices[index]);
+	XMStoreFloat4x4(&worldInverseTransposes[index], XMMatrixInverse(0, XMMatrixTranspose(world)));
+}
+
+TransformSystemBenchmark TransformSystem::Benchmark(unsigned int count)
+{
+	TransformSystemBenchmark result = {};
+	result.Transforms = count;
+	result.Avx2Available = HasAvx2();
+	if (count == 0)
+		return result;
+
+	TransformSystem system;
+	std::mt19937 random(23);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		unsigned int index = system.Add(
+			XMFLOAT3(unit(random) * 100.0f, unit(random) * 100.0f, unit(random) * 100.0f),
+			XMFLOAT4(0, 0, 0, 1),
+			XMFLOAT3(1.5f + unit(random), 1.5f + unit(random), 1.5f + unit(random)));
+		system.SetRotation(index, unit(random) * XM_PI, unit(random) * XM_PI, unit(random) * XM_PI);
+	}
+
+	// The same matrices built the way a Transform builds them
+	std::vector<XMFLOAT4X4> scalarWorld(count), scalarInverseTranspose(count);
+	auto scalarStart = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMFLOAT3 position = system.GetPosition(i);
+		XMFLOAT4 rotation = system.GetRotation(i);
+		XMFLOAT3 scale = system.GetScale(i);
+		XMMATRIX world = XMMatrixMultiply(XMMatrixMultiply(
+			XMMatrixScaling(scale.x, scale.y, scale.z),
+			XMMatrixRotationQuaternion(XMLoadFloat4(&rotation))),
+			XMMatrixTranslation(position.x, position.y, position.z));
+		XMStoreFloat4x4(&scalarWorld[i], world);
+		XMStoreFloat4x4(&scalarInverseTranspose[i], XMMatrixInverse(0, XMMatrixTranspose(world)));
+	}
+	result.ScalarMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - scalarStart).count();
+
+	// Best of a few runs, since the first one also faults in the output pages, then
+	// the error relative to each element's size (positions are up to 100)
+	auto timeAndCheck = [&](bool avx2)
+	{
+		system.UseAvx2 = avx2;
+		double best = 0.0;
+		for (int run = 0; run < 5; run++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			system.Update();
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			best = run == 0 ? ms : (std::min)(best, ms);
+		}
+
+		const XMFLOAT4X4* world = system.GetWorldMatrices();
+		const XMFLOAT4X4* inverseTranspose = system.GetWorldInverseTransposeMatrices();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				for (int column = 0; column < 4; column++)
+				{
+					float worldError = fabsf(world[i].m[row][column] - scalarWorld[i].m[row][column]) /
+						(std::max)(1.0f, fabsf(scalarWorld[i].m[row][column]));
+					float inverseError = fabsf(inverseTranspose[i].m[row][column] - scalarInverseTranspose[i].m[row][column]) /
+						(std::max)(1.0f, fabsf(scalarInverseTranspose[i].m[row][column]));
+					result.MaxError = (std::max)(result.MaxError, (std::max)(worldError, inverseError));
+				}
+			}
+		}
+		return best;
+	};
+	result.SseMs = timeAndCheck(false);
+	if (result.Avx2Available)
+		result.Avx2Ms = timeAndCheck(true);
+	return result;
+}
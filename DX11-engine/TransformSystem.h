@@ -0,0 +1,84 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <vector>
+
+// Transforms are composed this many at a time, and the arrays are padded to a multiple of it
+#define TRANSFORM_SYSTEM_BATCH 8
+
+// The same transforms composed each way, and how far the SIMD results are from DirectXMath's
+struct TransformSystemBenchmark
+{
+	unsigned int Transforms;
+	bool Avx2Available;
+	double Avx2Ms;		// 0 if the CPU doesn't have AVX2
+	double SseMs;
+	double ScalarMs;	// One XMMatrixMultiply chain per transform, like Transform::UpdateMatrices()
+	float MaxError;		// Largest difference in any element of either matrix
+};
+
+// --------------------------------------------------------
+// Positions, rotations and scales for large numbers of
+// transforms, stored as structure-of-arrays
+//
+// - Every component has its own array, so a batch of eight
+//   transforms is eight consecutive floats per component
+//   and loads straight into one AVX register (or two SSE
+//   ones, when the CPU doesn't have AVX2)
+// - Rotations are unit quaternions, so composing a matrix
+//   is only multiplies and adds, with no trigonometry
+// - World and inverse transpose matrices are written to
+//   two contiguous XMFLOAT4X4 arrays, laid out just like
+//   a structured or constant buffer of float4x4s, so they
+//   can be copied into a mapped buffer as they are
+// --------------------------------------------------------
+class TransformSystem
+{
+public:
+
+	TransformSystem();
+
+	// Returns the new transform's index, which it keeps
+	unsigned int Add(DirectX::XMFLOAT3 position, DirectX::XMFLOAT4 rotation, DirectX::XMFLOAT3 scale);
+	unsigned int GetCount();
+
+	void SetPosition(unsigned int index, DirectX::XMFLOAT3 position);
+	void SetRotation(unsigned int index, DirectX::XMFLOAT4 rotation);
+	void SetRotation(unsigned int index, float pitch, float yaw, float roll);
+	void SetScale(unsigned int index, DirectX::XMFLOAT3 scale);
+
+	DirectX::XMFLOAT3 GetPosition(unsigned int index);
+	DirectX::XMFLOAT4 GetRotation(unsigned int index);
+	DirectX::XMFLOAT3 GetScale(unsigned int index);
+
+	// Composes every transform's matrices, with AVX2 if UseAvx2 is set
+	void Update();
+
+	// GetCount() matrices each, as of the last Update(). Adding transforms can move them.
+	const DirectX::XMFLOAT4X4* GetWorldMatrices();
+	const DirectX::XMFLOAT4X4* GetWorldInverseTransposeMatrices();
+
+	// Whether the CPU (and OS) support AVX2 and FMA, checked once
+	static bool HasAvx2();
+
+	// Times composing the given number of random transforms each way
+	static TransformSystemBenchmark Benchmark(unsigned int count);
+
+	// Starts out as HasAvx2(), and can be turned off to compare against SSE
+	bool UseAvx2;
+
+private:
+
+	unsigned int count;
+
+	// Padded to a multiple of TRANSFORM_SYSTEM_BATCH with identity transforms
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposes;
+
+	void ComposeAvx2(unsigned int first, unsigned int end);
+	void ComposeSse(unsigned int first, unsigned int end);
+	void ComposeSingular(unsigned int index);
+};
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+
+// Set alongside the middle buffer's index once it holds something the reader hasn't acquired
+#define TRIPLE_BUFFER_FRESH 4
+
+// --------------------------------------------------------
+// Three copies of something, for handing the newest one
+// from one thread (the writer) to another (the reader)
+// without either ever taking a lock
+//
+// - The writer fills in its buffer and Publish()es it, which
+//   swaps it with the one in the middle. The reader Acquire()s
+//   the middle one in exchange for its own, if something's
+//   been published since it last did.
+// - Each side only touches its own buffer, so it can take as
+//   long as it likes with it
+// - If the writer publishes twice before the reader looks,
+//   the first one is never seen (wait for HasFresh() to be
+//   false before publishing if that matters)
+// - Buffers go round, so the writer's buffer holds whatever
+//   it had a couple of publishes ago, including anything the
+//   reader left in it
+// --------------------------------------------------------
+template <class T>
+class TripleBuffer
+{
+public:
+
+	TripleBuffer() : middle(1), writing(0), reading(2) {}
+	TripleBuffer(const TripleBuffer& other) = delete;
+	TripleBuffer& operator=(const TripleBuffer& other) = delete;
+
+	// Only for the writer
+	T& GetWriteBuffer() { return buffers[writing]; }
+
+	void Publish()
+	{
+		writing = middle.exchange(writing | TRIPLE_BUFFER_FRESH, std::memory_order_acq_rel) & ~TRIPLE_BUFFER_FRESH;
+	}
+
+	// Only for the reader. Returns false (keeping the buffer it has) if nothing's been published since last time.
+	bool Acquire()
+	{
+		if (!HasFresh())
+			return false;
+
+		reading = middle.exchange(reading, std::memory_order_acq_rel) & ~TRIPLE_BUFFER_FRESH;
+		return true;
+	}
+
+	T& GetReadBuffer() { return buffers[reading]; }
+
+	// Whether something's been published and not acquired yet (from either side)
+	bool HasFresh() { return (middle.load(std::memory_order_acquire) & TRIPLE_BUFFER_FRESH) != 0; }
+
+private:
+
+	T buffers[3];
+	std::atomic<unsigned int> middle;	// Index of the buffer in the middle, and TRIPLE_BUFFER_FRESH
+	unsigned int writing;
+	unsigned int reading;
+};
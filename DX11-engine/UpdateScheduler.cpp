@@ -0,0 +1,427 @@
+#include "UpdateScheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+using namespace DirectX;
+using namespace std::chrono;
+
+UpdateRate UpdateRate::EveryFrame()
+{
+	return { UPDATE_RATE_EVERY_FRAME, 1, 0.0f, 0.0f };
+}
+
+UpdateRate UpdateRate::EveryNFrames(unsigned int frames)
+{
+	return { UPDATE_RATE_EVERY_N_FRAMES, frames, 0.0f, 0.0f };
+}
+
+UpdateRate UpdateRate::Distance(float nearDistance, float farDistance, unsigned int farFrames)
+{
+	return { UPDATE_RATE_DISTANCE, farFrames, nearDistance, farDistance };
+}
+
+static UpdateRate ClampRate(UpdateRate rate)
+{
+	rate.Frames = (std::min)((std::max)(rate.Frames, 1u), (unsigned int)UPDATE_MAX_INTERVAL);
+	return rate;
+}
+
+UpdateScheduler::UpdateScheduler(EntityManager* entityManager)
+{
+	this->entityManager = entityManager;
+	this->frame = 0;
+	this->lastTotalTime = 0.0f;
+	this->entityCount = 0;
+	this->disabledCount = 0;
+	this->sleepingCount = 0;
+	this->stats = {};
+}
+
+void UpdateScheduler::Add(EntityHandle handle, UpdateRate rate)
+{
+	if (Find(handle))
+	{
+		SetRate(handle, rate);
+		return;
+	}
+
+	GameEntity* entity = entityManager->Get(handle);
+	if (!entity)
+		return;
+
+	// Anything still here belongs to an entity that was destroyed without being removed
+	unsigned int index = handle & ENTITY_INDEX_MASK;
+	if (index >= records.size())
+		records.resize(index + 1, { ENTITY_NO_HANDLE, UpdateRate::EveryFrame(), false, false, UPDATE_NOT_SCHEDULED, 0.0f, TIMER_NO_HANDLE });
+	if (records[index].Handle != ENTITY_NO_HANDLE)
+		Remove(records[index].Handle);
+
+	Record& record = records[index];
+	record = { handle, ClampRate(rate), entity->UpdateEnabled, false, UPDATE_NOT_SCHEDULED, lastTotalTime, TIMER_NO_HANDLE };
+	Count(record, 1);
+
+	// Spread out over the frames between updates, rather than starting them all together
+	if (record.Enabled)
+		Schedule(record, record.Rate.Type == UPDATE_RATE_EVERY_N_FRAMES ? 1 + index % record.Rate.Frames : 1);
+}
+
+void UpdateScheduler::Remove(EntityHandle handle)
+{
+	Record* record = Find(handle);
+	if (!record)
+		return;
+
+	Count(*record, -1);
+	timers.Cancel(record->WakeTimer);
+	record->Handle = ENTITY_NO_HANDLE;
+	record->DueFrame = UPDATE_NOT_SCHEDULED;
+	record->WakeTimer = TIMER_NO_HANDLE;
+}
+
+void UpdateScheduler::SetRate(EntityHandle handle, UpdateRate rate)
+{
+	Record* record = Find(handle);
+	if (!record)
+		return;
+
+	// Updated next frame, which works out when it's due after that at the new rate
+	record->Rate = ClampRate(rate);
+	if (record->DueFrame != UPDATE_NOT_SCHEDULED)
+		Schedule(*record, 1);
+}
+
+UpdateRate UpdateScheduler::GetRate(EntityHandle handle)
+{
+	Record* record = Find(handle);
+	return record ? record->Rate : UpdateRate::EveryFrame();
+}
+
+void UpdateScheduler::SetEnabled(EntityHandle handle, bool enabled)
+{
+	GameEntity* entity = entityManager->Get(handle);
+	Record* record = Find(handle);
+	if (!entity || !record)
+		return;
+
+	entity->UpdateEnabled = enabled;
+	if (record->Enabled == enabled)
+		return;
+
+	Count(*record, -1);
+	record->Enabled = enabled;
+	record->DueFrame = UPDATE_NOT_SCHEDULED;
+	if (enabled && !record->Sleeping)
+	{
+		record->LastUpdateTime = lastTotalTime;
+		Schedule(*record, 1);
+	}
+	Count(*record, 1);
+}
+
+void UpdateScheduler::Sleep(EntityHandle handle, float seconds)
+{
+	Record* record = Find(handle);
+	if (!record)
+		return;
+
+	// Sleeping again just moves the wake up
+	timers.Cancel(record->WakeTimer);
+	Count(*record, -1);
+	record->Sleeping = true;
+	record->DueFrame = UPDATE_NOT_SCHEDULED;
+	record->WakeTimer = timers.After(seconds, [this, handle]() { Wake(handle); });
+	Count(*record, 1);
+}
+
+void UpdateScheduler::Wake(EntityHandle handle)
+{
+	Record* record = Find(handle);
+	if (!record || !record->Sleeping)
+		return;
+
+	timers.Cancel(record->WakeTimer);
+	Count(*record, -1);
+	record->Sleeping = false;
+	record->WakeTimer = TIMER_NO_HANDLE;
+	if (record->Enabled)
+	{
+		record->LastUpdateTime = lastTotalTime;
+		Schedule(*record, 1);
+	}
+	Count(*record, 1);
+}
+
+bool UpdateScheduler::IsSleeping(EntityHandle handle)
+{
+	Record* record = Find(handle);
+	return record && record->Sleeping;
+}
+
+TimerHandle UpdateScheduler::After(float seconds, std::function<void()> callback)
+{
+	return timers.After(seconds, callback);
+}
+
+bool UpdateScheduler::Cancel(TimerHandle handle)
+{
+	return timers.Cancel(handle);
+}
+
+void UpdateScheduler::Run(float deltaTime, float totalTime, XMFLOAT3 focus, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	high_resolution_clock::time_point start = high_resolution_clock::now();
+
+	// Before moving on a frame, so anything woken up is updated in this one
+	stats.TimersFired = timers.Advance(deltaTime);
+	frame++;
+
+	// Anything rescheduled a whole wheel ahead goes back in the (now empty) slot
+	due.swap(wheel[frame % UPDATE_MAX_INTERVAL]);
+
+	unsigned int updated = 0;
+	for (size_t i = 0; i < due.size(); i++)
+	{
+		EntityHandle handle = due[i];
+		Record* record = Find(handle);
+		if (!record || record->DueFrame != frame)
+			continue;
+
+		GameEntity* entity = entityManager->Get(handle);
+		if (!entity)
+		{
+			Remove(handle);
+			continue;
+		}
+
+		if (!entity->UpdateEnabled)
+		{
+			Count(*record, -1);
+			record->Enabled = false;
+			record->DueFrame = UPDATE_NOT_SCHEDULED;
+			Count(*record, 1);
+			continue;
+		}
+
+		entity->Update(totalTime - record->LastUpdateTime, context);
+		updated++;
+
+		// The update may have added entities (moving the records), or put this one to sleep or changed its rate
+		record = Find(handle);
+		if (!record || record->DueFrame != frame)
+			continue;
+
+		record->LastUpdateTime = totalTime;
+		Schedule(*record, GetInterval(*record, entity, focus));
+	}
+	due.clear();
+	lastTotalTime = totalTime;
+
+	stats.Entities = entityCount;
+	stats.Updated = updated;
+	stats.Skipped = entityCount > updated ? entityCount - updated : 0;
+	stats.Disabled = disabledCount;
+	stats.Sleeping = sleepingCount;
+	unsigned int awake = entityCount - disabledCount - sleepingCount;
+	stats.NotDue = awake > updated ? awake - updated : 0;
+	stats.TimersPending = timers.GetPendingCount();
+	stats.LastRunMs = duration<double, std::milli>(high_resolution_clock::now() - start).count();
+}
+
+UpdateSchedulerStats UpdateScheduler::GetStats()
+{
+	return stats;
+}
+
+UpdateScheduler::Record* UpdateScheduler::Find(EntityHandle handle)
+{
+	unsigned int index = handle & ENTITY_INDEX_MASK;
+	if (handle == ENTITY_NO_HANDLE || index >= records.size() || records[index].Handle != handle)
+		return 0;
+	return &records[index];
+}
+
+void UpdateScheduler::Schedule(Record& record, unsigned int frames)
+{
+	// Whatever was in the wheel for it before no longer matches DueFrame, so it's dropped
+	record.DueFrame = frame + frames;
+	wheel[record.DueFrame % UPDATE_MAX_INTERVAL].push_back(record.Handle);
+}
+
+void UpdateScheduler::Count(const Record& record, int sign)
+{
+	entityCount += sign;
+	if (!record.Enabled)
+		disabledCount += sign;
+	else if (record.Sleeping)
+		sleepingCount += sign;
+}
+
+unsigned int UpdateScheduler::GetInterval(const Record& record, GameEntity* entity, XMFLOAT3 focus)
+{
+	switch (record.Rate.Type)
+	{
+	case UPDATE_RATE_EVERY_N_FRAMES:
+		return record.Rate.Frames;
+
+	case UPDATE_RATE_DISTANCE:
+	{
+		// Every frame at the near distance, down to every Frames frames at the far one. This runs
+		// before the hierarchy's updated for the frame, so its world matrix may not have caught up
+		// with this update (or its parents' ones) yet, and the position goes through the parents here.
+		Transform* transform = entity->GetTransform();
+		XMVECTOR position = XMLoadFloat3(&transform->GetPosition());
+		for (Transform* parent = transform->GetParent(); parent; parent = parent->GetParent())
+			position = XMVector3TransformCoord(position, XMLoadFloat4x4(&parent->GetLocalMatrix()));
+		float distance = XMVectorGetX(XMVector3Length(position - XMLoadFloat3(&focus)));
+
+		float range = record.Rate.FarDistance - record.Rate.NearDistance;
+		float t = range > 0.0f ? (distance - record.Rate.NearDistance) / range : (distance > record.Rate.NearDistance ? 1.0f : 0.0f);
+		t = (std::min)((std::max)(t, 0.0f), 1.0f);
+		return 1 + (unsigned int)(t * (record.Rate.Frames - 1) + 0.5f);
+	}
+
+	default:
+		return 1;
+	}
+}
+
+// Counts its updates, and the time it's been given, for checking against its rate
+static unsigned int benchmarkFrame;
+
+class BenchmarkEntity : public GameEntity
+{
+public:
+	unsigned int Updates;
+	unsigned int LastFrame;
+	float Elapsed;
+	float Value;
+
+	BenchmarkEntity()
+	{
+		Updates = 0;
+		LastFrame = 0;
+		Elapsed = 0.0f;
+		Value = 0.0f;
+	}
+
+	void Update(float deltaTime, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context) override
+	{
+		Updates++;
+		LastFrame = benchmarkFrame;
+		Elapsed += deltaTime;
+
+		// Something for it to do, about as much as a simple AI or animation would
+		for (int i = 0; i < 16; i++)
+			Value = Value * 0.99f + sinf(Elapsed + i);
+	}
+};
+
+UpdateSchedulerBenchmark UpdateScheduler::Benchmark(unsigned int entityCount, unsigned int frameCount)
+{
+	UpdateSchedulerBenchmark result = {};
+	result.Entities = entityCount;
+	result.Frames = frameCount;
+	result.Matches = true;
+	result.TimersOnTime = true;
+	if (entityCount == 0 || frameCount == 0)
+		return result;
+
+	const float deltaTime = 1.0f / 60.0f;
+	const float sleepSeconds = frameCount / 2 * deltaTime;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	// Spread out in a line from the focus, so some are near and some are far
+	EntityManager manager;
+	manager.Reserve<BenchmarkEntity>(entityCount);
+	std::vector<EntityHandle> handles(entityCount);
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		handles[i] = manager.Spawn<BenchmarkEntity>();
+		GameEntity* entity = manager.Get(handles[i]);
+		entity->GetTransform()->SetPosition((float)(i % 200), 0, 0);
+		entity->UpdateEnabled = i % 4 != 0;
+	}
+
+	// Everything, every frame
+	const std::vector<GameEntity*>& entities = manager.GetEntities();
+	high_resolution_clock::time_point start = high_resolution_clock::now();
+	for (unsigned int f = 0; f < frameCount; f++)
+		for (size_t i = 0; i < entities.size(); i++)
+			entities[i]->Update(deltaTime, context);
+	result.EveryFrameMs = duration<double, std::milli>(high_resolution_clock::now() - start).count() / frameCount;
+
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		BenchmarkEntity* entity = manager.Get<BenchmarkEntity>(handles[i]);
+		entity->Updates = 0;
+		entity->Elapsed = 0.0f;
+	}
+
+	UpdateScheduler scheduler(&manager);
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		switch (i % 4)
+		{
+		case 1: scheduler.Add(handles[i]); scheduler.Sleep(handles[i], sleepSeconds); break;
+		case 2: scheduler.Add(handles[i], UpdateRate::EveryNFrames(4)); break;
+		default: scheduler.Add(handles[i], UpdateRate::Distance(20.0f, 150.0f, 8)); break;
+		}
+	}
+
+	// Timers spread over the run, each noting when it went off
+	float totalTime = 0.0f;
+	std::vector<float> timerDelays(64), timerFired(64, -1.0f);
+	for (unsigned int i = 0; i < timerDelays.size(); i++)
+	{
+		timerDelays[i] = frameCount * deltaTime * i / timerDelays.size();
+		scheduler.After(timerDelays[i], [&, i]() { timerFired[i] = totalTime; });
+	}
+
+	unsigned long long updated = 0, skipped = 0;
+	start = high_resolution_clock::now();
+	for (unsigned int f = 0; f < frameCount; f++)
+	{
+		benchmarkFrame = f + 1;
+		totalTime = (f + 1) * deltaTime;
+		scheduler.Run(deltaTime, totalTime, XMFLOAT3(0, 0, 0), context);
+		updated += scheduler.GetStats().Updated;
+		skipped += scheduler.GetStats().Skipped;
+	}
+	result.ScheduledMs = duration<double, std::milli>(high_resolution_clock::now() - start).count() / frameCount;
+	result.UpdatesPerFrame = (double)updated / frameCount;
+	result.SkippedPerFrame = (double)skipped / frameCount;
+
+	// Whatever the rate, the time handed over adds up to the time up to the last update
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		BenchmarkEntity* entity = manager.Get<BenchmarkEntity>(handles[i]);
+		bool matches = true;
+		switch (i % 4)
+		{
+		case 0:
+			matches = entity->Updates == 0;
+			break;
+		case 1:
+			// Woken on the frame the timer's tick is passed, which may be a frame either side of half way
+			matches = entity->Updates + 3 >= frameCount - frameCount / 2 && entity->Updates <= frameCount - frameCount / 2 + 1 &&
+				fabsf(entity->Elapsed - entity->Updates * deltaTime) < 0.001f;
+			break;
+		case 2:
+			matches = entity->Updates + 1 >= frameCount / 4 && entity->Updates <= frameCount / 4 + 1 &&
+				fabsf(entity->Elapsed - entity->LastFrame * deltaTime) < 0.001f;
+			break;
+		default:
+			matches = entity->Updates + 1 >= frameCount / 8 && fabsf(entity->Elapsed - entity->LastFrame * deltaTime) < 0.001f;
+			break;
+		}
+		if (!matches)
+			result.Matches = false;
+	}
+
+	// Never early, and no later than the tick it's due on plus the frame that goes past it
+	for (unsigned int i = 0; i < timerDelays.size(); i++)
+		if (timerFired[i] < timerDelays[i] - 0.0001f || timerFired[i] > timerDelays[i] + TIMER_WHEEL_TICK + deltaTime + 0.0001f)
+			result.TimersOnTime = false;
+	return result;
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <DirectXMath.h>
+#include "EntityManager.h"
+#include "TimerWheel.h"
+
+// The most frames apart an entity's updates can be, and so how many slots the frame wheel has
+#define UPDATE_MAX_INTERVAL 64
+
+#define UPDATE_NOT_SCHEDULED 0xFFFFFFFF
+
+// How often an entity's Update() is called
+enum UpdateRateType
+{
+	UPDATE_RATE_EVERY_FRAME,
+	UPDATE_RATE_EVERY_N_FRAMES,	// Every Frames frames
+	UPDATE_RATE_DISTANCE		// Every frame up to NearDistance from the focus, falling to every Frames frames at FarDistance
+};
+
+struct UpdateRate
+{
+	UpdateRateType Type;
+	unsigned int Frames;	// At most UPDATE_MAX_INTERVAL
+	float NearDistance;
+	float FarDistance;
+
+	static UpdateRate EveryFrame();
+	static UpdateRate EveryNFrames(unsigned int frames);
+	static UpdateRate Distance(float nearDistance, float farDistance, unsigned int farFrames);
+};
+
+// What the last Run() did (disabled and sleeping as of the end of it)
+struct UpdateSchedulerStats
+{
+	unsigned int Entities;
+	unsigned int Updated;
+	unsigned int Skipped;			// Entities - Updated
+	unsigned int Disabled;			// UpdateEnabled is false
+	unsigned int Sleeping;
+	unsigned int NotDue;			// Updated less often than every frame, and not this frame
+	unsigned int TimersFired;
+	unsigned int TimersPending;		// Including sleeping entities' wake ups
+	double LastRunMs;
+};
+
+// A crowd where a quarter of the entities are disabled, a quarter sleep for the first half,
+// a quarter update every few frames and a quarter by distance, against updating every one every frame
+struct UpdateSchedulerBenchmark
+{
+	unsigned int Entities;
+	unsigned int Frames;
+	double EveryFrameMs;		// Per frame, calling every entity's Update() like Game::Update() used to
+	double ScheduledMs;			// Per frame, through the scheduler
+	double UpdatesPerFrame;		// Through the scheduler, on average
+	double SkippedPerFrame;
+	bool Matches;				// Each entity was updated as often as its rate says, with the time since its last update
+	bool TimersOnTime;			// No timer fired early, or more than a tick and a frame late
+};
+
+// --------------------------------------------------------
+// Calls entities' Update() as often as each one needs it
+//
+// - Entities are put in a wheel of frame slots by the frame
+//   they're next due on, so a frame only looks at the
+//   entities due on it. Disabled and sleeping entities
+//   aren't in the wheel at all, so they're never touched.
+// - An entity updated less often than every frame gets the
+//   time since its last update as its deltaTime (counting
+//   from when it was last woken or enabled)
+// - Entities every N frames are spread over those frames by
+//   handle, so they don't all land on the same one
+// - Sleeping entities wake up from a TimerWheel, which can
+//   call anything else later too (After())
+// - UpdateEnabled is read when an entity's added, and turning
+//   it off is noticed when it's next due. Turning it on has
+//   to go through SetEnabled(), since nothing looks at
+//   disabled entities.
+// - Destroyed entities are dropped when they're next due, or
+//   straight away with Remove()
+// --------------------------------------------------------
+class UpdateScheduler
+{
+public:
+
+	// The manager has to outlive the scheduler
+	UpdateScheduler(EntityManager* entityManager);
+	UpdateScheduler(const UpdateScheduler& other) = delete;
+	UpdateScheduler& operator=(const UpdateScheduler& other) = delete;
+
+	// Starts scheduling an entity (again, with a new rate, if it already is), from the next Run()
+	void Add(EntityHandle handle, UpdateRate rate = UpdateRate::EveryFrame());
+	void Remove(EntityHandle handle);
+
+	void SetRate(EntityHandle handle, UpdateRate rate);
+	UpdateRate GetRate(EntityHandle handle);
+
+	// Sets the entity's UpdateEnabled as well
+	void SetEnabled(EntityHandle handle, bool enabled);
+
+	// Stops updating the entity until Wake() or the given number of seconds have passed
+	void Sleep(EntityHandle handle, float seconds);
+	void Wake(EntityHandle handle);
+	bool IsSleeping(EntityHandle handle);
+
+	// Calls the callback once the given number of seconds of Run()s have passed, at the start of that Run()
+	TimerHandle After(float seconds, std::function<void()> callback);
+	bool Cancel(TimerHandle handle);
+
+	// Fires any timers that are due, then updates the entities that are. Distances are measured from the focus.
+	void Run(float deltaTime, float totalTime, DirectX::XMFLOAT3 focus, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	UpdateSchedulerStats GetStats();
+
+	// Runs the crowd described above for a number of frames, both ways
+	static UpdateSchedulerBenchmark Benchmark(unsigned int entityCount, unsigned int frameCount);
+
+private:
+
+	// One per entity manager slot, found by the handle's index
+	struct Record
+	{
+		EntityHandle Handle;		// ENTITY_NO_HANDLE if the slot's not scheduled
+		UpdateRate Rate;
+		bool Enabled;
+		bool Sleeping;
+		unsigned int DueFrame;		// UPDATE_NOT_SCHEDULED while disabled or sleeping
+		float LastUpdateTime;
+		TimerHandle WakeTimer;
+	};
+
+	EntityManager* entityManager;
+	TimerWheel timers;
+	std::vector<Record> records;
+
+	// Handles of the entities due on each frame, by frame modulo the size. Anything whose
+	// record isn't due on the frame any more (it was disabled, put to sleep or given a new
+	// rate) is just dropped when it comes round.
+	std::vector<EntityHandle> wheel[UPDATE_MAX_INTERVAL];
+	std::vector<EntityHandle> due;	// Reused every frame to avoid allocating
+
+	unsigned int frame;
+	float lastTotalTime;
+	unsigned int entityCount;
+	unsigned int disabledCount;
+	unsigned int sleepingCount;
+	UpdateSchedulerStats stats;
+
+	Record* Find(EntityHandle handle);
+
+	// Puts the record in the wheel for the given number of frames after the last Run()
+	void Schedule(Record& record, unsigned int frames);
+
+	// Counts the record towards (1) or takes it off (-1) the totals, around changing it
+	void Count(const Record& record, int sign);
+
+	unsigned int GetInterval(const Record& record, GameEntity* entity, DirectX::XMFLOAT3 focus);
+};
@@ -0,0 +1,27 @@
+#include "ShaderIncludes.hlsli"
+
+// Make sure the data in here does not overlap a 16-byte boundary (1 float = 4 bytes)
+cbuffer ExternalData : register(b0)
+{
+    matrix world;
+    matrix view;
+    matrix projection;
+
+    // Turns quantized positions back into local space (see Mesh::GetPositionScale)
+    float3 positionScale;
+    float padding0;
+    float3 positionOffset;
+    float padding1;
+}
+
+// --------------------------------------------------------
+// Same as VS_ScreenPosition.hlsl, but for meshes using one
+// of the compact vertex formats (see VertexCompression)
+// --------------------------------------------------------
+float4 main(VertexShaderInputCompact input) : SV_POSITION
+{
+	// Only need screen position of vertices
+    float3 localPosition = positionOffset + input.localPosition.xyz * positionScale;
+    matrix wvp = mul(projection, mul(view, world));
+    return mul(wvp, float4(localPosition, 1.0f));
+}
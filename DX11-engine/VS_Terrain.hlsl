@@ -79,7 +79,8 @@ VertexToPixel main(VertexShaderInput input)
 
 	// This normal is in LOCAL space, not WORLD space
     output.normal = mul((float3x3) worldInvTranspose, newNormal);
-    output.tangent = mul((float3x3) world, input.tangent);
+    output.tangent = mul((float3x3) world, input.tangent.xyz);
+    output.handedness = input.tangent.w;
 
 	// Pass UV to PS
     output.uv = input.uv;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
 
 // --------------------------------------------------------
 // A custom vertex definition
@@ -12,5 +13,38 @@ struct Vertex
 	DirectX::XMFLOAT3 Position;	    // The local position of the vertex
 	DirectX::XMFLOAT3 Normal;       // This vertex's normal
 	DirectX::XMFLOAT2 UV;           // The UV coord of this vertex
-	DirectX::XMFLOAT3 Tangent;      // Tangent for normal mapping
-};
\ No newline at end of file
+	DirectX::XMFLOAT4 Tangent;      // Tangent for normal mapping (w is the handedness, see TangentGenerator)
+};
+
+// Which of the vertex structs below a mesh's vertex buffer holds
+enum VertexFormat
+{
+	VERTEX_FORMAT_FULL,			// Vertex
+	VERTEX_FORMAT_COMPACT,		// VertexCompact
+	VERTEX_FORMAT_QUANTIZED		// VertexQuantized
+};
+
+// --------------------------------------------------------
+// Compact versions of Vertex for the GPU (see VertexCompression)
+//
+// Normals and tangents are octahedral encoded into two 16-bit
+// snorms each, and UVs are stored as half floats. These need
+// shaders that take VertexShaderInputCompact.
+// --------------------------------------------------------
+struct VertexCompact
+{
+	DirectX::XMFLOAT3 Position;						// The local position of the vertex
+	DirectX::PackedVector::XMSHORTN2 Normal;		// Octahedral encoded normal
+	DirectX::PackedVector::XMSHORTN2 Tangent;		// Octahedral encoded tangent
+	DirectX::PackedVector::XMHALF2 UV;				// Half float UV coord
+};
+
+// Same as VertexCompact, but the position is also quantized to
+// 16 bits per axis, relative to the mesh's bounding box
+struct VertexQuantized
+{
+	DirectX::PackedVector::XMUSHORTN4 Position;		// 0-1 across the mesh's bounds (w is unused)
+	DirectX::PackedVector::XMSHORTN2 Normal;		// Octahedral encoded normal
+	DirectX::PackedVector::XMSHORTN2 Tangent;		// Octahedral encoded tangent
+	DirectX::PackedVector::XMHALF2 UV;				// Half float UV coord
+};
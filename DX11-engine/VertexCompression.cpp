@@ -0,0 +1,329 @@
+#include "VertexCompression.h"
+#include <d3dcompiler.h>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// Largest angle an octahedral encoded unit vector can be off by, in degrees
+// (16-bit snorms come out around 0.005, this leaves some room)
+#define OCT_MAX_ERROR_DEGREES 0.02f
+
+// Encoded tangents squeeze the octahedral y coordinate into one half of
+// the snorm's range, picked by the handedness (see OctEncodeTangent)
+#define TANGENT_Y_SCALE 0.49f
+
+static const D3D11_INPUT_ELEMENT_DESC fullElements[] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Vertex, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(Vertex, Normal),   D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT,    0, offsetof(Vertex, UV),       D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TANGENT",  0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, offsetof(Vertex, Tangent), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+
+static const D3D11_INPUT_ELEMENT_DESC compactElements[] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, offsetof(VertexCompact, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL",   0, DXGI_FORMAT_R16G16_SNORM,    0, offsetof(VertexCompact, Normal),   D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT,    0, offsetof(VertexCompact, UV),       D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TANGENT",  0, DXGI_FORMAT_R16G16_SNORM,    0, offsetof(VertexCompact, Tangent),  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+
+static const D3D11_INPUT_ELEMENT_DESC quantizedElements[] =
+{
+	{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, offsetof(VertexQuantized, Position), D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "NORMAL",   0, DXGI_FORMAT_R16G16_SNORM,       0, offsetof(VertexQuantized, Normal),   D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT,       0, offsetof(VertexQuantized, UV),       D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	{ "TANGENT",  0, DXGI_FORMAT_R16G16_SNORM,       0, offsetof(VertexQuantized, Tangent),  D3D11_INPUT_PER_VERTEX_DATA, 0 },
+};
+
+unsigned int VertexCompression::GetStride(VertexFormat format)
+{
+	switch (format)
+	{
+	case VERTEX_FORMAT_COMPACT: return sizeof(VertexCompact);
+	case VERTEX_FORMAT_QUANTIZED: return sizeof(VertexQuantized);
+	default: return sizeof(Vertex);
+	}
+}
+
+const D3D11_INPUT_ELEMENT_DESC* VertexCompression::GetInputElements(VertexFormat format, unsigned int& numElements)
+{
+	numElements = 4;
+	switch (format)
+	{
+	case VERTEX_FORMAT_COMPACT: return compactElements;
+	case VERTEX_FORMAT_QUANTIZED: return quantizedElements;
+	default: return fullElements;
+	}
+}
+
+// Input layouts have to be validated against the shader's byte code,
+// so the compiled shader is loaded here just for that
+Microsoft::WRL::ComPtr<ID3D11InputLayout> VertexCompression::CreateInputLayout(VertexFormat format,
+	const wchar_t* vertexShaderFile, Microsoft::WRL::ComPtr<ID3D11Device> device)
+{
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+	if (FAILED(D3DReadFileToBlob(vertexShaderFile, shaderBlob.GetAddressOf())))
+		return inputLayout;
+
+	unsigned int numElements = 0;
+	const D3D11_INPUT_ELEMENT_DESC* elements = GetInputElements(format, numElements);
+	device->CreateInputLayout(
+		elements,
+		numElements,
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize(),
+		inputLayout.GetAddressOf());
+	return inputLayout;
+}
+
+XMFLOAT3 VertexCompression::GetPositionScale(VertexFormat format, XMFLOAT3 boundsMin, XMFLOAT3 boundsMax)
+{
+	if (format != VERTEX_FORMAT_QUANTIZED)
+		return XMFLOAT3(1, 1, 1);
+
+	return XMFLOAT3(
+		boundsMax.x - boundsMin.x,
+		boundsMax.y - boundsMin.y,
+		boundsMax.z - boundsMin.z);
+}
+
+XMFLOAT3 VertexCompression::GetPositionOffset(VertexFormat format, XMFLOAT3 boundsMin, XMFLOAT3 boundsMax)
+{
+	return format == VERTEX_FORMAT_QUANTIZED ? boundsMin : XMFLOAT3(0, 0, 0);
+}
+
+void VertexCompression::Encode(const Vertex* verts, unsigned int numVerts, VertexFormat format,
+	XMFLOAT3 boundsMin, XMFLOAT3 boundsMax, std::vector<unsigned char>& out)
+{
+	out.resize((size_t)GetStride(format) * numVerts);
+	if (format == VERTEX_FORMAT_FULL)
+	{
+		if (numVerts > 0)
+			memcpy(&out[0], verts, out.size());
+		return;
+	}
+
+	// Flat axes have no extent, so anything along them quantizes to 0
+	XMFLOAT3 scale = GetPositionScale(format, boundsMin, boundsMax);
+	XMVECTOR invScale = XMVectorSet(
+		scale.x > 0.0f ? 1.0f / scale.x : 0.0f,
+		scale.y > 0.0f ? 1.0f / scale.y : 0.0f,
+		scale.z > 0.0f ? 1.0f / scale.z : 0.0f, 0.0f);
+	XMVECTOR offset = XMLoadFloat3(&boundsMin);
+
+	for (unsigned int i = 0; i < numVerts; i++)
+	{
+		const Vertex& v = verts[i];
+		XMSHORTN2 normal = OctEncode(v.Normal);
+		XMSHORTN2 tangent = OctEncodeTangent(v.Tangent);
+		XMHALF2 uv;
+		XMStoreHalf2(&uv, XMLoadFloat2(&v.UV));
+
+		if (format == VERTEX_FORMAT_COMPACT)
+		{
+			VertexCompact* c = (VertexCompact*)&out[0] + i;
+			c->Position = v.Position;
+			c->Normal = normal;
+			c->Tangent = tangent;
+			c->UV = uv;
+		}
+		else
+		{
+			VertexQuantized* q = (VertexQuantized*)&out[0] + i;
+			XMStoreUShortN4(&q->Position, (XMLoadFloat3(&v.Position) - offset) * invScale);
+			q->Normal = normal;
+			q->Tangent = tangent;
+			q->UV = uv;
+		}
+	}
+}
+
+void VertexCompression::Decode(const void* data, unsigned int numVerts, VertexFormat format,
+	XMFLOAT3 boundsMin, XMFLOAT3 boundsMax, Vertex* out)
+{
+	if (format == VERTEX_FORMAT_FULL)
+	{
+		memcpy(out, data, sizeof(Vertex) * numVerts);
+		return;
+	}
+
+	XMFLOAT3 scaleF = GetPositionScale(format, boundsMin, boundsMax);
+	XMVECTOR scale = XMLoadFloat3(&scaleF);
+	XMVECTOR offset = XMLoadFloat3(&boundsMin);
+
+	for (unsigned int i = 0; i < numVerts; i++)
+	{
+		Vertex& v = out[i];
+		if (format == VERTEX_FORMAT_COMPACT)
+		{
+			const VertexCompact* c = (const VertexCompact*)data + i;
+			v.Position = c->Position;
+			v.Normal = OctDecode(c->Normal);
+			v.Tangent = OctDecodeTangent(c->Tangent);
+			XMStoreFloat2(&v.UV, XMLoadHalf2(&c->UV));
+		}
+		else
+		{
+			const VertexQuantized* q = (const VertexQuantized*)data + i;
+			XMStoreFloat3(&v.Position, offset + XMLoadUShortN4(&q->Position) * scale);
+			v.Normal = OctDecode(q->Normal);
+			v.Tangent = OctDecodeTangent(q->Tangent);
+			XMStoreFloat2(&v.UV, XMLoadHalf2(&q->UV));
+		}
+	}
+}
+
+// Angle between two directions in degrees, or 0 if the
+// original had no usable direction to begin with
+static float AngleBetween(XMFLOAT3 original, XMFLOAT3 decoded)
+{
+	XMVECTOR a = XMLoadFloat3(&original);
+	float length = XMVectorGetX(XMVector3Length(a));
+	if (!(length > 1e-6f) || !std::isfinite(length))
+		return 0.0f;
+
+	// atan2 stays accurate for tiny angles, where acos of the dot product doesn't
+	XMVECTOR b = XMVector3Normalize(XMLoadFloat3(&decoded));
+	a /= length;
+	return XMConvertToDegrees(atan2f(
+		XMVectorGetX(XMVector3Length(XMVector3Cross(a, b))),
+		XMVectorGetX(XMVector3Dot(a, b))));
+}
+
+bool VertexCompression::CheckRoundTrip(const Vertex* verts, unsigned int numVerts, VertexFormat format,
+	XMFLOAT3 boundsMin, XMFLOAT3 boundsMax, VertexEncodeError& error)
+{
+	std::vector<unsigned char> encoded;
+	std::vector<Vertex> decoded(numVerts);
+	Encode(verts, numVerts, format, boundsMin, boundsMax, encoded);
+	if (numVerts > 0)
+		Decode(&encoded[0], numVerts, format, boundsMin, boundsMax, &decoded[0]);
+
+	// Quantized positions should be within half a step of the original,
+	// plus a little for the float math on either side
+	XMFLOAT3 scale = GetPositionScale(format, boundsMin, boundsMax);
+	float largestCoord = (std::max)(
+		(std::max)((std::max)(fabsf(boundsMin.x), fabsf(boundsMin.y)), fabsf(boundsMin.z)),
+		(std::max)((std::max)(fabsf(boundsMax.x), fabsf(boundsMax.y)), fabsf(boundsMax.z)));
+	float positionBound = format == VERTEX_FORMAT_QUANTIZED ?
+		(std::max)((std::max)(scale.x, scale.y), scale.z) * (0.5f / 65535.0f) + largestCoord * 1e-6f : 0.0f;
+
+	error = {};
+	bool withinBounds = true;
+	for (unsigned int i = 0; i < numVerts; i++)
+	{
+		const Vertex& a = verts[i];
+		const Vertex& b = decoded[i];
+
+		float position = (std::max)((std::max)(
+			fabsf(a.Position.x - b.Position.x),
+			fabsf(a.Position.y - b.Position.y)),
+			fabsf(a.Position.z - b.Position.z));
+		float normal = AngleBetween(a.Normal, b.Normal);
+		float tangent = AngleBetween(
+			XMFLOAT3(a.Tangent.x, a.Tangent.y, a.Tangent.z),
+			XMFLOAT3(b.Tangent.x, b.Tangent.y, b.Tangent.z));
+		bool sameHandedness = (a.Tangent.w < 0.0f) == (b.Tangent.w < 0.0f);
+
+		// Half floats keep 11 significant bits, so the error scales with
+		// the value (down to the smallest normal half, below which it's fixed)
+		float uvBound = (std::max)((std::max)(fabsf(a.UV.x), fabsf(a.UV.y)), 6.1e-5f) * (1.0f / 2048.0f);
+		float uv = (std::max)(fabsf(a.UV.x - b.UV.x), fabsf(a.UV.y - b.UV.y));
+
+		// The full format is a plain copy, so it has to come back bit for bit.
+		// Negated tests so NaNs count as failures
+		if (format == VERTEX_FORMAT_FULL ?
+			memcmp(&a, &b, sizeof(Vertex)) != 0 :
+			(!(position <= positionBound) ||
+			 !(normal <= OCT_MAX_ERROR_DEGREES) ||
+			 !(tangent <= OCT_MAX_ERROR_DEGREES) || !sameHandedness ||
+			 !(uv <= uvBound)))
+			withinBounds = false;
+
+		error.Position = (std::max)(error.Position, position);
+		error.Normal = (std::max)(error.Normal, normal);
+		error.Tangent = (std::max)(error.Tangent, tangent);
+		error.UV = (std::max)(error.UV, uv);
+	}
+
+	return withinBounds;
+}
+
+// Projects a direction onto the octahedron |x| + |y| + |z| = 1,
+// then unfolds it into the [-1, 1] square
+static XMFLOAT2 OctProject(XMFLOAT3 v)
+{
+	float sum = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+	float x = sum > 0.0f ? v.x / sum : 0.0f;
+	float y = sum > 0.0f ? v.y / sum : 0.0f;
+
+	// Fold the lower half over the upper half's corners
+	if (v.z < 0.0f)
+	{
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+	return XMFLOAT2(x, y);
+}
+
+// The reverse of OctProject()
+static XMFLOAT3 OctUnfold(XMFLOAT2 e)
+{
+	XMFLOAT3 n(e.x, e.y, 1.0f - fabsf(e.x) - fabsf(e.y));
+	float t = (std::max)(-n.z, 0.0f);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, XMVector3Normalize(XMLoadFloat3(&n)));
+	return result;
+}
+
+XMSHORTN2 VertexCompression::OctEncode(XMFLOAT3 v)
+{
+	XMFLOAT2 e = OctProject(v);
+	XMSHORTN2 encoded;
+	XMStoreShortN2(&encoded, XMLoadFloat2(&e));
+	return encoded;
+}
+
+// Matches OctDecode() in ShaderIncludes.hlsli
+XMFLOAT3 VertexCompression::OctDecode(XMSHORTN2 encoded)
+{
+	XMFLOAT2 e;
+	XMStoreFloat2(&e, XMLoadShortN2(&encoded));
+	return OctUnfold(e);
+}
+
+// The tangent's direction is octahedral encoded like a normal, and its handedness
+// picks which half of the y snorm's range the direction's y coordinate goes in.
+// The gap around 0 keeps the two halves from ever meeting after rounding.
+XMSHORTN2 VertexCompression::OctEncodeTangent(XMFLOAT4 tangent)
+{
+	XMFLOAT2 e = OctProject(XMFLOAT3(tangent.x, tangent.y, tangent.z));
+	e.y = e.y * TANGENT_Y_SCALE + (tangent.w < 0.0f ? -0.5f : 0.5f);
+
+	XMSHORTN2 encoded;
+	XMStoreShortN2(&encoded, XMLoadFloat2(&e));
+	return encoded;
+}
+
+// Matches OctDecodeTangent() in ShaderIncludes.hlsli
+XMFLOAT4 VertexCompression::OctDecodeTangent(XMSHORTN2 encoded)
+{
+	XMFLOAT2 e;
+	XMStoreFloat2(&e, XMLoadShortN2(&encoded));
+
+	float handedness = e.y < 0.0f ? -1.0f : 1.0f;
+	e.y = (e.y - 0.5f * handedness) / TANGENT_Y_SCALE;
+
+	XMFLOAT3 t = OctUnfold(e);
+	return XMFLOAT4(t.x, t.y, t.z, handedness);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <vector>
+#include "Vertex.h"
+
+// The largest differences between a set of vertices and
+// what comes back out of encoding and decoding them
+struct VertexEncodeError
+{
+	float Position;		// Largest distance along any axis
+	float Normal;		// Largest angle, in degrees
+	float Tangent;		// Largest angle, in degrees
+	float UV;			// Largest difference in either coordinate
+};
+
+// --------------------------------------------------------
+// Converts vertices to and from the compact formats in Vertex.h
+//
+// - Normals and tangents use octahedral encoding: the unit
+//   vector is projected onto an octahedron, which is then
+//   unfolded into a square and stored as two 16-bit snorms
+// - Quantized positions are stored as 16-bit unorms across
+//   the mesh's bounding box, so shaders need the scale and
+//   offset from GetPositionScale() and GetPositionOffset()
+// --------------------------------------------------------
+class VertexCompression
+{
+public:
+
+	// Size of one vertex in the given format
+	static unsigned int GetStride(VertexFormat format);
+
+	// Matches the formats in Vertex.h. The compact layouts need a
+	// vertex shader taking VertexShaderInputCompact (see ShaderIncludes.hlsli).
+	static const D3D11_INPUT_ELEMENT_DESC* GetInputElements(VertexFormat format, unsigned int& numElements);
+	static Microsoft::WRL::ComPtr<ID3D11InputLayout> CreateInputLayout(VertexFormat format,
+		const wchar_t* vertexShaderFile, Microsoft::WRL::ComPtr<ID3D11Device> device);
+
+	// What a vertex shader has to scale and offset the stored positions by
+	static DirectX::XMFLOAT3 GetPositionScale(VertexFormat format, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax);
+	static DirectX::XMFLOAT3 GetPositionOffset(VertexFormat format, DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax);
+
+	// Converts vertices into the given format, or back again.
+	// The bounds only matter for VERTEX_FORMAT_QUANTIZED.
+	static void Encode(const Vertex* verts, unsigned int numVerts, VertexFormat format,
+		DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax, std::vector<unsigned char>& out);
+	static void Decode(const void* data, unsigned int numVerts, VertexFormat format,
+		DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax, Vertex* out);
+
+	// Encodes and decodes the vertices, measuring how far off the results are.
+	// Returns false if any of them are further off than the format allows.
+	static bool CheckRoundTrip(const Vertex* verts, unsigned int numVerts, VertexFormat format,
+		DirectX::XMFLOAT3 boundsMin, DirectX::XMFLOAT3 boundsMax, VertexEncodeError& error);
+
+	static DirectX::PackedVector::XMSHORTN2 OctEncode(DirectX::XMFLOAT3 unitVector);
+	static DirectX::XMFLOAT3 OctDecode(DirectX::PackedVector::XMSHORTN2 encoded);
+
+	// Same as above, but also keeps the tangent's handedness (w)
+	static DirectX::PackedVector::XMSHORTN2 OctEncodeTangent(DirectX::XMFLOAT4 tangent);
+	static DirectX::XMFLOAT4 OctDecodeTangent(DirectX::PackedVector::XMSHORTN2 encoded);
+};
@@ -34,7 +34,8 @@ VertexToPixel main( VertexShaderInput input )
 	// This normal is in LOCAL space, not WORLD space
 	// To go from local -> world, we need a world matrix (specifically its rotation and scale components)
     output.normal = mul((float3x3)worldInvTranspose, input.normal);
-	output.tangent = mul((float3x3)world, input.tangent);
+	output.tangent = mul((float3x3)world, input.tangent.xyz);
+	output.handedness = input.tangent.w;
 
 	// Pass UV to PS
 	output.uv = input.uv;
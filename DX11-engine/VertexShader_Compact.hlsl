@@ -0,0 +1,54 @@
+#include "ShaderIncludes.hlsli"
+
+// Make sure the data in here does not overlap a 16-byte boundary (1 float = 4 bytes)
+cbuffer ExternalData : register(b0)
+{
+	matrix world;
+    matrix worldInvTranspose;
+	matrix view;
+	matrix projection;
+
+	matrix lightView;
+	matrix lightProjection;
+
+	// Turns quantized positions back into local space (see Mesh::GetPositionScale)
+	float3 positionScale;
+	float padding0;
+	float3 positionOffset;
+	float padding1;
+}
+
+// --------------------------------------------------------
+// Same as VertexShader.hlsl, but for meshes using one of
+// the compact vertex formats (see VertexCompression)
+// --------------------------------------------------------
+VertexToPixel main( VertexShaderInputCompact input )
+{
+	// Set up output struct
+	VertexToPixel output;
+
+	// Unpack the vertex
+	float3 localPosition = positionOffset + input.localPosition.xyz * positionScale;
+	float3 normal = OctDecode(input.normal);
+	float4 tangent = OctDecodeTangent(input.tangent);
+	
+	// Multiply the three matrices together first
+	matrix wvp = mul(projection, mul(view, world));
+	output.screenPosition = mul(wvp, float4(localPosition, 1.0f));
+
+	// world position of the vertex
+	output.worldPosition = mul(world, float4(localPosition, 1.0f)).xyz;
+
+	// Local -> world, same as the regular vertex shader
+    output.normal = mul((float3x3)worldInvTranspose, normal);
+	output.tangent = mul((float3x3)world, tangent.xyz);
+	output.handedness = tangent.w;
+
+	// Pass UV to PS
+	output.uv = input.uv;
+
+	matrix shadowWVP = mul(lightProjection, mul(lightView, world));
+	output.shadowMapPos = mul(shadowWVP, float4(localPosition, 1.0f));
+
+	return output;
+}